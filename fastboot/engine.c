@@ -76,6 +76,7 @@ char *mkmsg(const char *fmt, ...)
 #define OP_NOTICE     4
 #define OP_FORMAT     5
 #define OP_DOWNLOAD_SPARSE 6
+#define OP_DEFERRED   7
 
 typedef struct Action Action;
 
@@ -93,6 +94,7 @@ struct Action
 
     const char *msg;
     int (*func)(Action *a, int status, char *resp);
+    int (*deferred)(void *data);
 
     double start;
 };
@@ -100,6 +102,9 @@ struct Action
 static Action *action_list = 0;
 static Action *action_last = 0;
 
+/* while an OP_DEFERRED action runs, the actions it queues go right after it */
+static Action *action_insert = 0;
+
 
 struct image_data {
     long long partition_size;
@@ -206,12 +211,20 @@ static Action *queue_action(unsigned op, const char *fmt, ...)
         die("Command length (%d) exceeds maximum size (%d)", cmdsize, sizeof(a->cmd));
     }
 
-    if (action_last) {
+    if (action_insert) {
+        a->next = action_insert->next;
+        action_insert->next = a;
+        if (action_last == action_insert) {
+            action_last = a;
+        }
+        action_insert = a;
+    } else if (action_last) {
         action_last->next = a;
+        action_last = a;
     } else {
         action_list = a;
+        action_last = a;
     }
-    action_last = a;
     a->op = op;
     a->func = cb_default;
 
@@ -573,6 +586,22 @@ void fb_queue_notice(const char *notice)
     a->data = (void*) notice;
 }
 
+static int cb_quiet(Action *a, int status, char *resp)
+{
+    return status;
+}
+
+void fb_queue_deferred(const char *msg, int (*func)(void *data), void *data)
+{
+    Action *a = queue_action(OP_DEFERRED, "");
+    a->deferred = func;
+    a->data = data;
+    a->msg = msg;
+    if (msg == 0) {
+        a->func = cb_quiet;
+    }
+}
+
 int fb_execute_queue(transport_t *transport)
 {
     Action *a;
@@ -614,6 +643,12 @@ int fb_execute_queue(transport_t *transport)
             status = fb_download_data_sparse(transport, a->data);
             status = a->func(a, status, status ? fb_get_error() : "");
             if (status) break;
+        } else if (a->op == OP_DEFERRED) {
+            action_insert = a;
+            status = a->deferred(a->data);
+            action_insert = 0;
+            status = a->func(a, status, "deferred action failed");
+            if (status) break;
         } else {
             die("bogus action");
         }
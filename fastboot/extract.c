@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifndef USE_MINGW
+#include <pthread.h>
+#endif
+
+#include <zipfile/zipfile.h>
+
+#include "fastboot.h"
+
+/* Update packages are inflated on worker threads while the queue sends the
+ * images inflated before them. Entries are started in the order they were
+ * queued, and only while the entries inflated but not released yet fit in
+ * the budget; an entry bigger than the whole budget is inflated alone.
+ *
+ * Windows builds have no pthreads, the entries are inflated by the caller
+ * when it waits for them.
+ */
+
+#define EXTRACT_MAX_THREADS 3
+
+enum {
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_DONE,
+    JOB_FAILED,
+};
+
+struct extract_job {
+    extract_job *next;
+    zipentry_t entry;
+    int64_t size;
+    FILE *file;
+    int fd;
+    int state;
+    double inflate_time;
+};
+
+static extract_job *pending_head = 0;
+static extract_job *pending_tail = 0;
+static int64_t budget = 0;
+static int64_t in_use = 0;
+static int outstanding = 0;
+static int threads = 0;
+
+#ifdef USE_MINGW
+#define lock()
+#define unlock()
+#else
+static pthread_mutex_t extract_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t extract_cond = PTHREAD_COND_INITIALIZER;
+#define lock()      pthread_mutex_lock(&extract_lock)
+#define unlock()    pthread_mutex_unlock(&extract_lock)
+#endif
+
+static void run_job(extract_job *job)
+{
+    double start = now();
+
+    job->file = tmpfile();
+    if (job->file) {
+        job->fd = fileno(job->file);
+        if (decompress_zipentry_fd(job->entry, job->fd) ||
+                lseek(job->fd, 0, SEEK_SET) != 0) {
+            fclose(job->file);
+            job->file = 0;
+        }
+    }
+    job->inflate_time = now() - start;
+}
+
+/* called with the lock held */
+static extract_job *next_job(void)
+{
+    extract_job *job = pending_head;
+    if (job == 0) {
+        return 0;
+    }
+    if (outstanding && in_use + job->size > budget) {
+        return 0;
+    }
+    pending_head = job->next;
+    if (pending_head == 0) {
+        pending_tail = 0;
+    }
+    in_use += job->size;
+    outstanding++;
+    job->state = JOB_RUNNING;
+    return job;
+}
+
+#ifndef USE_MINGW
+static void *extract_thread(void *arg)
+{
+    extract_job *job;
+
+    lock();
+    for (;;) {
+        job = next_job();
+        if (job == 0) {
+            pthread_cond_wait(&extract_cond, &extract_lock);
+            continue;
+        }
+        unlock();
+        run_job(job);
+        lock();
+        job->state = job->file ? JOB_DONE : JOB_FAILED;
+        pthread_cond_broadcast(&extract_cond);
+    }
+    return 0;
+}
+#endif
+
+void extract_init(int64_t size)
+{
+    budget = size;
+
+#ifndef USE_MINGW
+    /* leave a CPU to the thread doing the transfers */
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    if (cpus < 1) cpus = 1;
+    if (cpus > EXTRACT_MAX_THREADS) cpus = EXTRACT_MAX_THREADS;
+
+    while (threads < cpus) {
+        pthread_t thread;
+        if (pthread_create(&thread, 0, extract_thread, 0)) {
+            break;
+        }
+        pthread_detach(thread);
+        threads++;
+    }
+#endif
+}
+
+extract_job *extract_queue(zipfile_t zip, const char *name)
+{
+    extract_job *job;
+    zipentry_t entry;
+
+    entry = lookup_zipentry(zip, name);
+    if (entry == 0) {
+        return 0;
+    }
+
+    job = calloc(1, sizeof(extract_job));
+    if (job == 0) die("out of memory");
+    job->entry = entry;
+    job->size = get_zipentry_size(entry);
+    job->fd = -1;
+    job->state = JOB_QUEUED;
+
+    lock();
+    if (pending_tail) {
+        pending_tail->next = job;
+    } else {
+        pending_head = job;
+    }
+    pending_tail = job;
+#ifndef USE_MINGW
+    pthread_cond_broadcast(&extract_cond);
+#endif
+    unlock();
+
+    return job;
+}
+
+int extract_wait(extract_job *job, double *inflate_time)
+{
+    lock();
+    while (job->state == JOB_QUEUED || job->state == JOB_RUNNING) {
+        if (threads == 0) {
+            /* entries are waited for in order, so this one is next */
+            extract_job *next = next_job();
+            if (next == 0) die("extract: %s called out of order", __FUNCTION__);
+            run_job(next);
+            next->state = next->file ? JOB_DONE : JOB_FAILED;
+            continue;
+        }
+#ifndef USE_MINGW
+        pthread_cond_wait(&extract_cond, &extract_lock);
+#endif
+    }
+    unlock();
+
+    *inflate_time = job->inflate_time;
+    return job->state == JOB_DONE ? job->fd : -1;
+}
+
+void extract_release(extract_job *job)
+{
+    lock();
+    if (job->file) {
+        fclose(job->file);
+        job->file = 0;
+        job->fd = -1;
+    }
+    in_use -= job->size;
+    outstanding--;
+#ifndef USE_MINGW
+    pthread_cond_broadcast(&extract_cond);
+#endif
+    unlock();
+}
@@ -426,31 +426,6 @@ void *unzip_file(zipfile_t zip, const char *name, unsigned *sz)
     return data;
 }
 
-static int unzip_to_file(zipfile_t zip, char *name)
-{
-    int fd;
-    char *data;
-    unsigned sz;
-
-    fd = fileno(tmpfile());
-    if (fd < 0) {
-        return -1;
-    }
-
-    data = unzip_file(zip, name, &sz);
-    if (data == 0) {
-        return -1;
-    }
-
-    if (write(fd, data, sz) != sz) {
-        fd = -1;
-    }
-
-    free(data);
-    lseek(fd, 0, SEEK_SET);
-    return fd;
-}
-
 static char *strip(char *s)
 {
     int n;
@@ -731,6 +706,59 @@ void do_update_signature(zipfile_t zip, char *fn)
     fb_queue_command("signature", "installing signature");
 }
 
+/* Memory the update images inflated ahead of the transfers may take up */
+#define UPDATE_BUDGET (512 * 1024 * 1024)
+
+struct update_image {
+    const char *img_name;
+    const char *part_name;
+    extract_job *job;
+    struct fastboot_buffer buf;
+    double inflate_time;
+    double wait_time;
+    double load_time;
+    double sent;
+};
+
+static int flash_update_image(void *data)
+{
+    struct update_image *img = data;
+    double start = now();
+    double loaded;
+    int fd;
+
+    fd = extract_wait(img->job, &img->inflate_time);
+    if (fd < 0) die("failed to unzip '%s' from archive", img->img_name);
+    loaded = now();
+    img->wait_time = loaded - start;
+    if (load_buf_fd(&transport, fd, &img->buf)) {
+        die("cannot load %s from flash", img->img_name);
+    }
+    img->sent = now();
+    img->load_time = img->sent - loaded;
+    flash_buf(img->part_name, &img->buf);
+    return 0;
+}
+
+static int release_update_image(void *data)
+{
+    struct update_image *img = data;
+    struct sparse_file **s;
+
+    if (img->buf.type == FB_BUFFER_SPARSE) {
+        for (s = img->buf.data; *s; s++) {
+            sparse_file_destroy(*s);
+        }
+    }
+    free(img->buf.data);
+    extract_release(img->job);
+
+    fprintf(stderr, "'%s': inflate %.3fs, wait %.3fs, load %.3fs, "
+            "send+write %.3fs\n", img->img_name, img->inflate_time,
+            img->wait_time, img->load_time, now() - img->sent);
+    return 0;
+}
+
 void do_update(transport_t *trans, char *fn, int erase_first)
 {
     void *zdata;
@@ -738,9 +766,8 @@ void do_update(transport_t *trans, char *fn, int erase_first)
     void *data;
     unsigned sz;
     zipfile_t zip;
-    int fd;
-    int rc;
-    struct fastboot_buffer buf;
+    struct update_image *img;
+    extract_job *job;
     int i;
 
     queue_info_dump();
@@ -770,24 +797,32 @@ void do_update(transport_t *trans, char *fn, int erase_first)
 
     setup_requirements(data, sz);
 
+    /* The images are inflated on worker threads, and only loaded and
+     * flashed when the queue gets to them, so that inflating the next
+     * image overlaps with sending the current one.
+     */
+    extract_init(UPDATE_BUDGET);
+
     for (i = 0; i < ARRAY_SIZE(images); i++) {
-        fd = unzip_to_file(zip, images[i].img_name);
-        if (fd < 0) {
+        job = extract_queue(zip, images[i].img_name);
+        if (job == 0) {
             if (images[i].is_optional)
                 continue;
             die("update package missing %s", images[i].img_name);
         }
-        rc = load_buf_fd(trans, fd, &buf);
-        if (rc) die("cannot load %s from flash", images[i].img_name);
+        img = calloc(1, sizeof(*img));
+        if (img == 0) die("out of memory");
+        img->img_name = images[i].img_name;
+        img->part_name = images[i].part_name;
+        img->job = job;
+
         do_update_signature(zip, images[i].sig_name);
         if (erase_first && needs_erase(images[i].part_name)) {
             fb_queue_erase(images[i].part_name);
         }
-        flash_buf(images[i].part_name, &buf);
-        /* not closing the fd here since the sparse code keeps the fd around
-         * but hasn't mmaped data yet. The tmpfile will get cleaned up when the
-         * program exits.
-         */
+        fb_queue_deferred(mkmsg("extracting '%s'", img->img_name),
+                flash_update_image, img);
+        fb_queue_deferred(0, release_update_image, img);
     }
 }
 
@@ -29,6 +29,9 @@
 #ifndef _FASTBOOT_H_
 #define _FASTBOOT_H_
 
+#include <stdint.h>
+#include <zipfile/zipfile.h>
+
 #include "transport.h"
 #include "usb.h"
 #include "tcp.h"
@@ -60,8 +63,23 @@ void fb_queue_reboot(void);
 void fb_queue_command(const char *cmd, const char *msg);
 void fb_queue_download(const char *name, void *data, unsigned size);
 void fb_queue_notice(const char *notice);
+/* calls func(data) when the queue gets there; actions queued from func
+ * run right after it, before the rest of the queue */
+void fb_queue_deferred(const char *msg, int (*func)(void *data), void *data);
 int fb_execute_queue(transport_t *trans);
 int fb_queue_is_empty(void);
+double now();
+char *mkmsg(const char *fmt, ...);
+
+/* extract.c - inflates update package entries on worker threads */
+typedef struct extract_job extract_job;
+void extract_init(int64_t budget);
+/* returns NULL if the archive has no such entry */
+extract_job *extract_queue(zipfile_t zip, const char *name);
+/* returns an fd to the inflated entry, -1 on failure */
+int extract_wait(extract_job *job, double *inflate_time);
+/* closes the fd and gives the entry's size back to the budget */
+void extract_release(extract_job *job);
 
 /* util stuff */
 void die(const char *fmt, ...);
@@ -27,6 +27,9 @@
 #include <sys/wait.h>
 #include <libgen.h>
 #include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
 #include <sys/swap.h>
 /* XXX These need to be obtained from kernel headers. See b/9336527 */
 #define SWAP_FLAG_PREFER        0x8000
@@ -50,6 +53,8 @@
 #define KEY_LOC_PROP   "ro.crypto.keyfile.userdata"
 #define KEY_IN_FOOTER  "footer"
 
+#define PARALLEL_MOUNT_PROP "ro.fs_mgr.parallel_mount"
+
 #define E2FSCK_BIN      "/system/bin/e2fsck"
 #define MKSWAP_BIN      "/system/bin/mkswap"
 
@@ -126,6 +131,24 @@ static time_t gettime(void)
     return ts.tv_sec;
 }
 
+/*
+ * gettime_ms() - returns the time in milliseconds of the system's monotonic
+ * clock or zero on error.
+ */
+static long long gettime_ms(void)
+{
+    struct timespec ts;
+    int ret;
+
+    ret = clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (ret < 0) {
+        ERROR("clock_gettime(CLOCK_MONOTONIC) failed: %s\n", strerror(errno));
+        return 0;
+    }
+
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
 static int wait_for_file(const char *filename, int timeout)
 {
     struct stat info;
@@ -528,7 +551,8 @@ void fs_mgr_free_fstab(struct fstab *fstab)
     free(fstab);
 }
 
-static void check_fs(char *blk_device, char *fs_type, char *target)
+static void check_fs(char *blk_device, char *fs_type, char *target,
+                     bool ignore_int_quit)
 {
     int status;
     int ret;
@@ -562,9 +586,17 @@ static void check_fs(char *blk_device, char *fs_type, char *target)
 
         INFO("Running %s on %s\n", E2FSCK_BIN, blk_device);
 
-        ret = android_fork_execvp_ext(ARRAY_SIZE(e2fsck_argv), e2fsck_argv,
-                                      &status, true, LOG_KLOG | LOG_FILE,
-                                      true, FSCK_LOG_FILE);
+        if (ignore_int_quit) {
+            ret = android_fork_execvp_ext(ARRAY_SIZE(e2fsck_argv), e2fsck_argv,
+                                          &status, true, LOG_KLOG | LOG_FILE,
+                                          true, FSCK_LOG_FILE);
+        } else {
+            /* the parallel mode ignores SIGINT and SIGQUIT itself */
+            ret = android_fork_execvp_dfl_int_quit(ARRAY_SIZE(e2fsck_argv),
+                                                   e2fsck_argv, &status,
+                                                   LOG_KLOG | LOG_FILE,
+                                                   true, FSCK_LOG_FILE);
+        }
 
         if (ret < 0) {
             /* No need to check for error in fork, we can't really handle it now */
@@ -643,85 +675,344 @@ static int fs_match(char *in1, char *in2)
     return ret;
 }
 
-int fs_mgr_mount_all(struct fstab *fstab)
-{
-    int i = 0;
-    int encrypted = 0;
-    int ret = -1;
-    int mret;
+/* Time spent on each step of mounting an entry, in milliseconds */
+struct entry_times {
+    long long wait;
+    long long check;
+    long long verity;
+    long long mount;
+};
 
-    if (!fstab) {
-        return ret;
+/* Returns 1 for the entries fs_mgr_mount_all() leaves alone */
+static int skip_entry(struct fstab_rec *rec)
+{
+    /* Don't mount entries that are managed by vold */
+    if (rec->fs_mgr_flags & (MF_VOLDMANAGED | MF_RECOVERYONLY)) {
+        return 1;
     }
 
-    for (i = 0; i < fstab->num_entries; i++) {
-        /* Don't mount entries that are managed by vold */
-        if (fstab->recs[i].fs_mgr_flags & (MF_VOLDMANAGED | MF_RECOVERYONLY)) {
-            continue;
-        }
+    /* Skip swap and raw partition entries such as boot, recovery, etc */
+    if (!strcmp(rec->fs_type, "swap") ||
+        !strcmp(rec->fs_type, "emmc") ||
+        !strcmp(rec->fs_type, "mtd")) {
+        return 1;
+    }
 
-        /* Skip swap and raw partition entries such as boot, recovery, etc */
-        if (!strcmp(fstab->recs[i].fs_type, "swap") ||
-            !strcmp(fstab->recs[i].fs_type, "emmc") ||
-            !strcmp(fstab->recs[i].fs_type, "mtd")) {
-            continue;
-        }
+    return 0;
+}
 
-        if (fstab->recs[i].fs_mgr_flags & MF_WAIT) {
-            wait_for_file(fstab->recs[i].blk_device, WAIT_TIMEOUT);
-        }
+/*
+ * Waits for the block device, checks the filesystem and sets up verity.
+ * Returns -1 if the entry should not be mounted.
+ */
+static int prepare_entry(struct fstab_rec *rec, struct entry_times *times,
+                         bool ignore_int_quit)
+{
+    long long t = gettime_ms();
+    long long split;
 
-        if (fstab->recs[i].fs_mgr_flags & MF_CHECK) {
-            check_fs(fstab->recs[i].blk_device, fstab->recs[i].fs_type,
-                     fstab->recs[i].mount_point);
-        }
+    if (rec->fs_mgr_flags & MF_WAIT) {
+        wait_for_file(rec->blk_device, WAIT_TIMEOUT);
+    }
+    split = gettime_ms();
+    times->wait = split - t;
+    t = split;
 
-        if (fstab->recs[i].fs_mgr_flags & MF_VERIFY) {
-            if (fs_mgr_setup_verity(&fstab->recs[i]) < 0) {
-                ERROR("Could not set up verified partition, skipping!");
-                continue;
-            }
+    if (rec->fs_mgr_flags & MF_CHECK) {
+        check_fs(rec->blk_device, rec->fs_type, rec->mount_point,
+                 ignore_int_quit);
+    }
+    split = gettime_ms();
+    times->check = split - t;
+    t = split;
+
+    if (rec->fs_mgr_flags & MF_VERIFY) {
+        if (fs_mgr_setup_verity(rec) < 0) {
+            ERROR("Could not set up verified partition, skipping!");
+            return -1;
         }
+    }
+    times->verity = gettime_ms() - t;
 
-        mret = __mount(fstab->recs[i].blk_device, fstab->recs[i].mount_point,
-                     fstab->recs[i].fs_type, fstab->recs[i].flags,
-                     fstab->recs[i].fs_options);
+    return 0;
+}
 
-        if (!mret) {
-            /* Success!  Go get the next one */
-            continue;
-        }
+/*
+ * Mounts a prepared entry. Returns 0 on success, 1 if a tmpfs was mounted
+ * in place of an encrypted filesystem, and -1 on error.
+ */
+static int mount_entry(struct fstab_rec *rec, struct entry_times *times)
+{
+    long long t = gettime_ms();
+    int ret = 0;
 
+    if (__mount(rec->blk_device, rec->mount_point, rec->fs_type,
+                rec->flags, rec->fs_options)) {
         /* mount(2) returned an error, check if it's encrypted and deal with it */
-        if ((fstab->recs[i].fs_mgr_flags & MF_CRYPT) &&
-            !partition_wiped(fstab->recs[i].blk_device)) {
+        if ((rec->fs_mgr_flags & MF_CRYPT) && !partition_wiped(rec->blk_device)) {
             /* Need to mount a tmpfs at this mountpoint for now, and set
              * properties that vold will query later for decrypting
              */
-            if (mount("tmpfs", fstab->recs[i].mount_point, "tmpfs",
+            if (mount("tmpfs", rec->mount_point, "tmpfs",
                   MS_NOATIME | MS_NOSUID | MS_NODEV, CRYPTO_TMPFS_OPTIONS) < 0) {
                 ERROR("Cannot mount tmpfs filesystem for encrypted fs at %s\n",
-                        fstab->recs[i].mount_point);
-                goto out;
+                        rec->mount_point);
+                ret = -1;
+            } else {
+                ret = 1;
             }
-            encrypted = 1;
         } else {
             ERROR("Cannot mount filesystem on %s at %s\n",
-                    fstab->recs[i].blk_device, fstab->recs[i].mount_point);
-            goto out;
+                    rec->blk_device, rec->mount_point);
+            ret = -1;
         }
     }
+    times->mount = gettime_ms() - t;
 
-    if (encrypted) {
-        ret = 1;
-    } else {
-        ret = 0;
-    }
+    INFO("%s: wait %lldms, check %lldms, verity %lldms, mount %lldms\n",
+         rec->mount_point, times->wait, times->check, times->verity,
+         times->mount);
 
-out:
     return ret;
 }
 
+static int mount_all_serial(struct fstab *fstab)
+{
+    struct entry_times times;
+    int encrypted = 0;
+    int mret;
+    int i;
+
+    for (i = 0; i < fstab->num_entries; i++) {
+        if (skip_entry(&fstab->recs[i])) {
+            continue;
+        }
+
+        if (prepare_entry(&fstab->recs[i], &times, true) < 0) {
+            continue;
+        }
+
+        mret = mount_entry(&fstab->recs[i], &times);
+        if (mret < 0) {
+            return -1;
+        }
+        if (mret > 0) {
+            encrypted = 1;
+        }
+    }
+
+    return encrypted;
+}
+
+/*
+ * In parallel mode, entries are prepared on their own threads as soon as
+ * every earlier entry they overlap is mounted, and mounted by the calling
+ * thread as soon as they are prepared. Two entries overlap when the mount
+ * point of one is the same as or below the other's, whichever comes first
+ * in the fstab, so the mounts end up stacked like the serial ones and the
+ * temporary mounts of check_fs() never land under or over another entry's.
+ */
+
+enum {
+    JOB_WAITING,
+    JOB_PREPARING,
+    JOB_PREPARED,
+    JOB_DONE,
+};
+
+struct mount_job {
+    struct mount_all_state *state;
+    struct fstab_rec *rec;
+    pthread_t thread;
+    int threaded;
+    int status;
+    int prepared;
+    struct entry_times times;
+};
+
+struct mount_all_state {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct mount_job *jobs;
+    int count;
+};
+
+/* Returns 1 if path is mount_point, or a path below it */
+static int is_below(const char *path, const char *mount_point)
+{
+    size_t len = strlen(mount_point);
+
+    while (len > 1 && mount_point[len - 1] == '/') {
+        len--;
+    }
+    if (strncmp(path, mount_point, len)) {
+        return 0;
+    }
+    return path[len] == '\0' || path[len] == '/' || mount_point[len - 1] == '/';
+}
+
+/* Called with the lock held */
+static int job_is_ready(struct mount_all_state *state, int n)
+{
+    const char *mount_point = state->jobs[n].rec->mount_point;
+    const char *other;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (state->jobs[i].status == JOB_DONE) {
+            continue;
+        }
+        other = state->jobs[i].rec->mount_point;
+        if (is_below(mount_point, other) || is_below(other, mount_point)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void *prepare_thread(void *arg)
+{
+    struct mount_job *job = arg;
+    int prepared;
+
+    prepared = prepare_entry(job->rec, &job->times, false);
+
+    pthread_mutex_lock(&job->state->lock);
+    job->prepared = prepared;
+    job->status = JOB_PREPARED;
+    pthread_cond_signal(&job->state->cond);
+    pthread_mutex_unlock(&job->state->lock);
+    return NULL;
+}
+
+static int mount_all_parallel(struct fstab *fstab)
+{
+    struct mount_all_state state;
+    struct sigaction ignact;
+    struct sigaction intact;
+    struct sigaction quitact;
+    struct mount_job *job;
+    int encrypted = 0;
+    int failed = 0;
+    int progress;
+    int busy;
+    int mret;
+    int i;
+
+    state.jobs = calloc(fstab->num_entries, sizeof(struct mount_job));
+    if (!state.jobs) {
+        ERROR("Cannot allocate mount jobs, mounting serially\n");
+        return mount_all_serial(fstab);
+    }
+    state.count = fstab->num_entries;
+    pthread_mutex_init(&state.lock, NULL);
+    pthread_cond_init(&state.cond, NULL);
+
+    for (i = 0; i < state.count; i++) {
+        job = &state.jobs[i];
+        job->state = &state;
+        job->rec = &fstab->recs[i];
+        job->status = skip_entry(job->rec) ? JOB_DONE : JOB_WAITING;
+    }
+
+    /* Several e2fsck can run at once only if logwrap doesn't have to
+     * change the signal dispositions for each of them, so ignore SIGINT
+     * and SIGQUIT once for all of them, like the serial mode does for
+     * each e2fsck. check_fs() has logwrap put back the defaults in the
+     * e2fsck children.
+     */
+    memset(&ignact, 0, sizeof(ignact));
+    ignact.sa_handler = SIG_IGN;
+    sigaction(SIGINT, &ignact, &intact);
+    sigaction(SIGQUIT, &ignact, &quitact);
+
+    pthread_mutex_lock(&state.lock);
+    for (;;) {
+        busy = 0;
+        progress = 0;
+        for (i = 0; i < state.count; i++) {
+            job = &state.jobs[i];
+            if (job->status == JOB_WAITING && !failed && job_is_ready(&state, i)) {
+                job->status = JOB_PREPARING;
+                job->threaded = !pthread_create(&job->thread, NULL,
+                                                prepare_thread, job);
+                if (!job->threaded) {
+                    /* prepare it here, this only costs the parallelism */
+                    pthread_mutex_unlock(&state.lock);
+                    job->prepared = prepare_entry(job->rec, &job->times, false);
+                    pthread_mutex_lock(&state.lock);
+                    job->status = JOB_PREPARED;
+                }
+            }
+            if (job->status == JOB_PREPARED) {
+                pthread_mutex_unlock(&state.lock);
+                if (job->threaded) {
+                    pthread_join(job->thread, NULL);
+                }
+                mret = 0;
+                if (job->prepared == 0 && !failed) {
+                    mret = mount_entry(job->rec, &job->times);
+                }
+                pthread_mutex_lock(&state.lock);
+                job->status = JOB_DONE;
+                if (mret < 0) {
+                    failed = 1;
+                } else if (mret > 0) {
+                    encrypted = 1;
+                }
+                progress = 1;
+            } else if (job->status == JOB_PREPARING ||
+                       (job->status == JOB_WAITING && !failed)) {
+                busy = 1;
+            }
+        }
+        if (progress) {
+            /* entries before the ones just mounted may be ready now */
+            continue;
+        }
+        if (!busy) {
+            break;
+        }
+        pthread_cond_wait(&state.cond, &state.lock);
+    }
+    pthread_mutex_unlock(&state.lock);
+
+    sigaction(SIGINT, &intact, NULL);
+    sigaction(SIGQUIT, &quitact, NULL);
+
+    pthread_cond_destroy(&state.cond);
+    pthread_mutex_destroy(&state.lock);
+    free(state.jobs);
+
+    if (failed) {
+        return -1;
+    }
+    return encrypted;
+}
+
+/*
+ * Returns 1 if a tmpfs was mounted in place of an encrypted filesystem,
+ * 0 if everything was mounted, and -1 on error. Setting
+ * ro.fs_mgr.parallel_mount to 1 prepares independent entries in parallel.
+ * mount_all runs on the fs trigger, before init loads /system/build.prop,
+ * so the property must be set in the ramdisk's /default.prop (through
+ * ADDITIONAL_DEFAULT_PROPERTIES, not PRODUCT_PROPERTY_OVERRIDES).
+ */
+int fs_mgr_mount_all(struct fstab *fstab)
+{
+    char propbuf[PROPERTY_VALUE_MAX];
+
+    if (!fstab) {
+        return -1;
+    }
+
+    property_get(PARALLEL_MOUNT_PROP, propbuf, "0");
+    if (!strcmp(propbuf, "1")) {
+        return mount_all_parallel(fstab);
+    }
+    return mount_all_serial(fstab);
+}
+
 /* If tmp_mount_point is non-null, mount the filesystem there.  This is for the
  * tmp mount we do to check the user password
  */
@@ -758,7 +1049,7 @@ int fs_mgr_do_mount(struct fstab *fstab, char *n_name, char *n_blk_device,
 
         if (fstab->recs[i].fs_mgr_flags & MF_CHECK) {
             check_fs(n_blk_device, fstab->recs[i].fs_type,
-                     fstab->recs[i].mount_point);
+                     fstab->recs[i].mount_point, true);
         }
 
         if (fstab->recs[i].fs_mgr_flags & MF_VERIFY) {
@@ -27,6 +27,7 @@
 #include <sys/wait.h>
 #include <libgen.h>
 #include <time.h>
+#include <limits.h>
 
 #include <private/android_filesystem_config.h>
 #include <logwrap/logwrap.h>
@@ -45,8 +46,6 @@
 #define VERITY_METADATA_MAGIC_NUMBER 0xb001b001
 #define VERITY_TABLE_RSA_KEY "/verity_key"
 
-extern struct fs_info info;
-
 static RSAPublicKey *load_key(char *path)
 {
     FILE *f;
@@ -85,7 +84,6 @@ static RSAPublicKey *load_key(char *path)
 
 static int verify_table(char *signature, char *table, int table_length)
 {
-    int fd;
     RSAPublicKey *key;
     uint8_t hash_buf[SHA_DIGEST_SIZE];
     int retval = -1;
@@ -117,119 +115,134 @@ out:
     return retval;
 }
 
-static int get_target_device_size(char *blk_device, uint64_t *device_size)
+static int get_target_device_size(int fd, char *blk_device, uint64_t *device_size)
 {
-    int data_device;
     struct ext4_super_block sb;
 
-    data_device = open(blk_device, O_RDONLY);
-    if (data_device < 0) {
-        ERROR("Error opening block device (%s)", strerror(errno));
+    if (TEMP_FAILURE_RETRY(pread64(fd, &sb, sizeof(sb), 1024)) != sizeof(sb)) {
+        ERROR("Error reading superblock");
         return -1;
     }
 
-    if (lseek64(data_device, 1024, SEEK_SET) < 0) {
-        ERROR("Error seeking to superblock");
-        close(data_device);
+    if (sb.s_magic != EXT4_SUPER_MAGIC) {
+        ERROR("Invalid superblock magic on %s", blk_device);
         return -1;
     }
 
-    if (read(data_device, &sb, sizeof(sb)) != sizeof(sb)) {
-        ERROR("Error reading superblock");
-        close(data_device);
-        return -1;
-    }
-
-    ext4_parse_sb(&sb);
-    *device_size = info.len;
-
-    close(data_device);
+    /* Not using ext4_parse_sb(), which fills in the global struct fs_info:
+     * fs_mgr_mount_all() can set up several verity devices at once.
+     */
+    *device_size = (((uint64_t) sb.s_blocks_count_hi << 32) |
+            sb.s_blocks_count_lo) * (1024 << sb.s_log_block_size);
     return 0;
 }
 
-static int read_verity_metadata(char *block_device, char **signature, char **table)
+/* The metadata block follows the filesystem, it starts with:
+ *   u32 magic number
+ *   u32 protocol version
+ *   u8  signature[RSANUMBYTES]
+ *   u32 table length
+ * and then the table.
+ */
+#define VERITY_METADATA_HEADER_SIZE (3 * sizeof(uint32_t) + RSANUMBYTES)
+
+static int read_verity_metadata(char *block_device, uint64_t *device_size,
+                                char **signature, char **table)
 {
-    unsigned magic_number;
-    unsigned table_length;
+    uint32_t magic_number;
+    uint32_t protocol_version;
+    uint32_t table_length;
     uint64_t device_length;
-    int protocol_version;
-    FILE *device;
+    char *metadata = NULL;
+    char *newline;
+    int device;
     int retval = -1;
 
-    device = fopen(block_device, "r");
-    if (!device) {
+    *signature = NULL;
+    *table = NULL;
+
+    device = open(block_device, O_RDONLY | O_CLOEXEC);
+    if (device < 0) {
         ERROR("Could not open block device %s (%s).\n", block_device, strerror(errno));
         goto out;
     }
 
     // find the start of the verity metadata
-    if (get_target_device_size(block_device, &device_length) < 0) {
+    if (get_target_device_size(device, block_device, &device_length) < 0) {
         ERROR("Could not get target device size.\n");
         goto out;
     }
-    if (fseek(device, device_length, SEEK_SET) < 0) {
-        ERROR("Could not seek to start of verity metadata block.\n");
+
+    // read the whole block at once rather than field by field
+    metadata = malloc(VERITY_METADATA_SIZE);
+    if (!metadata) {
+        ERROR("Couldn't allocate memory for verity metadata!\n");
         goto out;
     }
-
-    // check the magic number
-    if (!fread(&magic_number, sizeof(int), 1, device)) {
-        ERROR("Couldn't read magic number!\n");
+    if (TEMP_FAILURE_RETRY(pread64(device, metadata, VERITY_METADATA_SIZE,
+            device_length)) != VERITY_METADATA_SIZE) {
+        ERROR("Couldn't read verity metadata at offset %llu!\n", device_length);
         goto out;
     }
+
+    // check the magic number
+    memcpy(&magic_number, metadata, sizeof(magic_number));
     if (magic_number != VERITY_METADATA_MAGIC_NUMBER) {
         ERROR("Couldn't find verity metadata at offset %llu!\n", device_length);
         goto out;
     }
 
     // check the protocol version
-    if (!fread(&protocol_version, sizeof(int), 1, device)) {
-        ERROR("Couldn't read verity metadata protocol version!\n");
-        goto out;
-    }
+    memcpy(&protocol_version, metadata + sizeof(uint32_t), sizeof(protocol_version));
     if (protocol_version != 0) {
         ERROR("Got unknown verity metadata protocol version %d!\n", protocol_version);
         goto out;
     }
 
+    // get the size of the table
+    memcpy(&table_length, metadata + 2 * sizeof(uint32_t) + RSANUMBYTES,
+           sizeof(table_length));
+    if (table_length > VERITY_METADATA_SIZE - VERITY_METADATA_HEADER_SIZE) {
+        ERROR("Invalid verity table length %u!\n", table_length);
+        goto out;
+    }
+
     // get the signature
     *signature = (char*) malloc(RSANUMBYTES * sizeof(char));
     if (!*signature) {
         ERROR("Couldn't allocate memory for signature!\n");
         goto out;
     }
-    if (!fread(*signature, RSANUMBYTES, 1, device)) {
-        ERROR("Couldn't read signature from verity metadata!\n");
-        free(*signature);
-        goto out;
-    }
-
-    // get the size of the table
-    if (!fread(&table_length, sizeof(int), 1, device)) {
-        ERROR("Couldn't get the size of the verity table from metadata!\n");
-        free(*signature);
-        goto out;
-    }
+    memcpy(*signature, metadata + 2 * sizeof(uint32_t), RSANUMBYTES);
 
     // get the table + null terminator
-    table_length += 1;
-    *table = malloc(table_length);
+    *table = malloc(table_length + 1);
     if(!*table) {
         ERROR("Couldn't allocate memory for verity table!\n");
         goto out;
     }
-    if (!fgets(*table, table_length, device)) {
-        ERROR("Couldn't read the verity table from metadata!\n");
-        free(*table);
-        free(*signature);
-        goto out;
+    memcpy(*table, metadata + VERITY_METADATA_HEADER_SIZE, table_length);
+    (*table)[table_length] = '\0';
+
+    // the table used to be read with fgets(), which stops after a newline
+    newline = strchr(*table, '\n');
+    if (newline) {
+        newline[1] = '\0';
     }
 
+    *device_size = device_length;
     retval = 0;
 
 out:
-    if (device)
-        fclose(device);
+    if (retval < 0) {
+        free(*table);
+        free(*signature);
+        *table = NULL;
+        *signature = NULL;
+    }
+    free(metadata);
+    if (device >= 0)
+        close(device);
     return retval;
 }
 
@@ -272,15 +285,10 @@ static int get_verity_device_name(struct dm_ioctl *io, char *name, int fd, char
     return 0;
 }
 
-static int load_verity_table(struct dm_ioctl *io, char *name, char *blockdev, int fd, char *table)
+static int load_verity_table(struct dm_ioctl *io, char *name, uint64_t device_size, int fd, char *table)
 {
     char *verity_params;
     char *buffer = (char*) io;
-    uint64_t device_size = 0;
-
-    if (get_target_device_size(blockdev, &device_size) < 0) {
-        return -1;
-    }
 
     verity_ioctl_init(io, name, DM_STATUS_TABLE_FLAG);
 
@@ -341,10 +349,17 @@ int fs_mgr_setup_verity(struct fstab_rec *fstab) {
     char *verity_blk_name;
     char *verity_table;
     char *verity_table_signature;
+    uint64_t device_size;
 
     char buffer[DM_BUF_SIZE];
     struct dm_ioctl *io = (struct dm_ioctl *) buffer;
-    char *mount_point = basename(fstab->mount_point);
+    char mount_point[PATH_MAX];
+
+    // basename() returns a static buffer, and entries may be set up in parallel
+    if (basename_r(fstab->mount_point, mount_point, sizeof(mount_point)) < 0) {
+        ERROR("Invalid mount point %s", fstab->mount_point);
+        return retval;
+    }
 
     // set the dm_ioctl flags
     io->flags |= 1;
@@ -371,6 +386,7 @@ int fs_mgr_setup_verity(struct fstab_rec *fstab) {
 
     // read the verity block at the end of the block device
     if (read_verity_metadata(fstab->blk_device,
+                                    &device_size,
                                     &verity_table_signature,
                                     &verity_table) < 0) {
         goto out;
@@ -384,7 +400,7 @@ int fs_mgr_setup_verity(struct fstab_rec *fstab) {
     }
 
     // load the verity mapping table
-    if (load_verity_table(io, mount_point, fstab->blk_device, fd, verity_table) < 0) {
+    if (load_verity_table(io, mount_point, device_size, fd, verity_table) < 0) {
         goto out;
     }
 
@@ -23,6 +23,7 @@
 extern "C" {
 #endif
 
+#include <signal.h>
 #include <sys/types.h>
 #include <corkscrew/ptrace.h>
 #include <corkscrew/map_info.h>
@@ -67,6 +68,20 @@ ssize_t unwind_backtrace(backtrace_frame_t* backtrace, size_t ignore_depth, size
 ssize_t unwind_backtrace_thread(pid_t tid, backtrace_frame_t* backtrace,
         size_t ignore_depth, size_t max_depth);
 
+/*
+ * Unwinds the call stack of the current thread from within a signal handler,
+ * starting at the context that was interrupted by the signal.
+ * Populates the backtrace array with the program counters from the call stack.
+ * Returns the number of frames collected, or -1 if an error occurred.
+ *
+ * The map info list must have been acquired outside of the signal handler.
+ * Memory is only read from readable maps in that list, so a corrupt stack
+ * ends the backtrace instead of faulting.
+ */
+ssize_t unwind_backtrace_signal(siginfo_t* siginfo, void* sigcontext,
+        const map_info_t* map_info_list,
+        backtrace_frame_t* backtrace, size_t ignore_depth, size_t max_depth);
+
 /*
  * Unwinds the call stack of a task within a remote process using ptrace().
  * Populates the backtrace array with the program counters from the call stack.
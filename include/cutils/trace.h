@@ -136,6 +136,88 @@ extern uint64_t atrace_enabled_tags;
  */
 extern int atrace_marker_fd;
 
+/**
+ * Targets for atrace_buffer_start().  While a buffer target is active the
+ * ATRACE_* functions below append a fixed-size binary record (timestamp,
+ * interned name id, event type and value) to a buffer owned by the calling
+ * thread instead of formatting and writing a message per event.  A thread's
+ * buffer is flushed when it fills up, when atrace_buffer_flush() is called on
+ * that thread, when the thread exits, and when atrace_buffer_stop() is called.
+ *
+ * ATRACE_BUFFER_MARKER writes the buffered events to trace_marker as regular
+ * systrace messages.  The kernel timestamps them when the batch is flushed, so
+ * this target keeps event order but not timing; use it to cut the cost of
+ * tracing hot loops when only the sequence matters.
+ *
+ * ATRACE_BUFFER_FILE writes each batch to a file as one atrace_buffer_header
+ * followed by the names interned since the previous batch and the events,
+ * with their original CLOCK_MONOTONIC timestamps.
+ */
+#define ATRACE_BUFFER_OFF       0
+#define ATRACE_BUFFER_MARKER    1
+#define ATRACE_BUFFER_FILE      2
+
+/**
+ * Number of events a thread can buffer before it flushes.
+ */
+#define ATRACE_BUFFER_EVENTS    1024
+
+#define ATRACE_BUFFER_MAGIC     0x46425441  // "ATBF"
+#define ATRACE_BUFFER_VERSION   1
+
+/**
+ * Layout of a batch in an ATRACE_BUFFER_FILE trace, in native byte order.
+ * The header is followed by string_count name records, each a uint32_t id, a
+ * uint32_t length and the name bytes padded to a multiple of 4, and then by
+ * event_count atrace_buffer_event records.  Name id 0 is the empty name.
+ */
+struct atrace_buffer_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t pid;
+    uint32_t tid;
+    uint32_t string_count;
+    uint32_t event_count;
+};
+
+struct atrace_buffer_event {
+    uint64_t timestamp;     // CLOCK_MONOTONIC, in nanoseconds
+    int64_t value;          // counter value or async cookie
+    uint32_t name_id;
+    uint32_t type;          // 'B', 'E', 'S', 'F' or 'C', as in systrace
+};
+
+/**
+ * Nonzero while events are being buffered; one of the ATRACE_BUFFER_* values.
+ */
+extern volatile int32_t atrace_buffer_mode;
+
+/**
+ * Starts buffering trace events for all threads of the process.  path names
+ * the output file for ATRACE_BUFFER_FILE and is ignored otherwise.  Events are
+ * still only recorded for enabled tags.  Returns 0 on success or a negative
+ * errno value.
+ */
+int atrace_buffer_start(int target, const char* path);
+
+/**
+ * Flushes the buffers of all threads and stops buffering.  Events recorded by
+ * other threads while the stop is in progress may be discarded.
+ */
+void atrace_buffer_stop();
+
+/**
+ * Writes out the events buffered by the calling thread.
+ */
+void atrace_buffer_flush();
+
+/**
+ * Appends an event to the calling thread's buffer.  Called by the ATRACE_*
+ * functions below while buffering is active.
+ */
+void atrace_buffer_record(char type, const char* name, int64_t value);
+
 /**
  * atrace_init readies the process for tracing by opening the trace_marker file.
  * Calling any trace function causes this to be run, so calling it is optional.
@@ -183,6 +265,10 @@ static inline void atrace_begin(uint64_t tag, const char* name)
         char buf[ATRACE_MESSAGE_LENGTH];
         size_t len;
 
+        if (atrace_buffer_mode != ATRACE_BUFFER_OFF) {
+            atrace_buffer_record('B', name, 0);
+            return;
+        }
         len = snprintf(buf, ATRACE_MESSAGE_LENGTH, "B|%d|%s", getpid(), name);
         write(atrace_marker_fd, buf, len);
     }
@@ -197,6 +283,11 @@ static inline void atrace_end(uint64_t tag)
 {
     if (CC_UNLIKELY(atrace_is_tag_enabled(tag))) {
         char c = 'E';
+
+        if (atrace_buffer_mode != ATRACE_BUFFER_OFF) {
+            atrace_buffer_record('E', NULL, 0);
+            return;
+        }
         write(atrace_marker_fd, &c, 1);
     }
 }
@@ -217,6 +308,10 @@ static inline void atrace_async_begin(uint64_t tag, const char* name,
         char buf[ATRACE_MESSAGE_LENGTH];
         size_t len;
 
+        if (atrace_buffer_mode != ATRACE_BUFFER_OFF) {
+            atrace_buffer_record('S', name, cookie);
+            return;
+        }
         len = snprintf(buf, ATRACE_MESSAGE_LENGTH, "S|%d|%s|%d", getpid(),
                 name, cookie);
         write(atrace_marker_fd, buf, len);
@@ -235,6 +330,10 @@ static inline void atrace_async_end(uint64_t tag, const char* name,
         char buf[ATRACE_MESSAGE_LENGTH];
         size_t len;
 
+        if (atrace_buffer_mode != ATRACE_BUFFER_OFF) {
+            atrace_buffer_record('F', name, cookie);
+            return;
+        }
         len = snprintf(buf, ATRACE_MESSAGE_LENGTH, "F|%d|%s|%d", getpid(),
                 name, cookie);
         write(atrace_marker_fd, buf, len);
@@ -253,6 +352,10 @@ static inline void atrace_int(uint64_t tag, const char* name, int32_t value)
         char buf[ATRACE_MESSAGE_LENGTH];
         size_t len;
 
+        if (atrace_buffer_mode != ATRACE_BUFFER_OFF) {
+            atrace_buffer_record('C', name, value);
+            return;
+        }
         len = snprintf(buf, ATRACE_MESSAGE_LENGTH, "C|%d|%s|%d",
                 getpid(), name, value);
         write(atrace_marker_fd, buf, len);
@@ -270,6 +373,10 @@ static inline void atrace_int64(uint64_t tag, const char* name, int64_t value)
         char buf[ATRACE_MESSAGE_LENGTH];
         size_t len;
 
+        if (atrace_buffer_mode != ATRACE_BUFFER_OFF) {
+            atrace_buffer_record('C', name, value);
+            return;
+        }
         len = snprintf(buf, ATRACE_MESSAGE_LENGTH, "C|%d|%s|%lld",
                 getpid(), name, value);
         write(atrace_marker_fd, buf, len);
@@ -27,6 +27,8 @@ extern "C" {
 int uevent_open_socket(int buf_sz, bool passcred);
 ssize_t uevent_kernel_multicast_recv(int socket, void *buffer, size_t length);
 ssize_t uevent_kernel_multicast_uid_recv(int socket, void *buffer, size_t length, uid_t *uid);
+int uevent_kernel_multicast_uid_recv_batch(int socket, void *buffer, size_t slot_size,
+                                           int count, ssize_t *lengths, uid_t *uid);
 
 #ifdef __cplusplus
 }
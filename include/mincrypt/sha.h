@@ -21,6 +21,12 @@ const uint8_t* SHA_final(SHA_CTX* ctx);
 // NOTE: *digest needs to hold SHA_DIGEST_SIZE bytes.
 const uint8_t* SHA_hash(const void* data, int len, uint8_t* digest);
 
+// Hashes count independent buffers of len bytes each, several at a time
+// where the CPU allows it. The digests are stored one after the other.
+// NOTE: *digest needs to hold count * SHA_DIGEST_SIZE bytes.
+void SHA_hash_multi(const void* const* data, int len, int count,
+                    uint8_t* digest);
+
 #define SHA_DIGEST_SIZE 20
 
 #ifdef __cplusplus
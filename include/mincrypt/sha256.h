@@ -20,6 +20,12 @@ const uint8_t* SHA256_final(SHA256_CTX* ctx);
 // Convenience method. Returns digest address.
 const uint8_t* SHA256_hash(const void* data, int len, uint8_t* digest);
 
+// Hashes count independent buffers of len bytes each, several at a time
+// where the CPU allows it. The digests are stored one after the other.
+// NOTE: *digest needs to hold count * SHA256_DIGEST_SIZE bytes.
+void SHA256_hash_multi(const void* const* data, int len, int count,
+                       uint8_t* digest);
+
 #define SHA256_DIGEST_SIZE 32
 
 #ifdef __cplusplus
@@ -121,7 +121,10 @@ template<bool> struct CTA;
 template<> struct CTA<true> { };
 
 #define GGL_CONTEXT(con, c)         context_t *con = static_cast<context_t *>(c)
-#define GGL_OFFSETOF(field)         int(&(((context_t*)0)->field))
+// offsetof() only takes constant array indices, but the code generator
+// indexes texture units and color components at run time. Going through
+// uintptr_t keeps the pointer to int conversion legal on LP64.
+#define GGL_OFFSETOF(field)         int(uintptr_t(&(((context_t*)0)->field)))
 #define GGL_INIT_PROC(p, f)         p.f = ggl_ ## f;
 #define GGL_BETWEEN(x, L, H)        (uint32_t((x)-(L)) <= ((H)-(L)))
 
@@ -255,6 +258,18 @@ inline int compare_type(const needs_t& lhs, const needs_t& rhs) {
     return memcmp(&lhs, &rhs, sizeof(needs_t));
 }
 
+inline uint32_t hash_type(const needs_t& k) {
+    uint32_t h = k.n;
+    h = h * 31 + k.p;
+    h = h * 31 + k.t[0];
+    h = h * 31 + k.t[1];
+    // fold the high bits down, the cache indexes buckets with the low bits
+    h ^= h >> 16;
+    h *= 0x45d9f3b;
+    h ^= h >> 16;
+    return h;
+}
+
 struct needs_filter_t {
     needs_t     value;
     needs_t     mask;
@@ -272,6 +287,7 @@ int needs_t::match(const needs_filter_t& filter) {
 // ----------------------------------------------------------------------------
 
 struct context_t;
+struct tiler_t;
 class Assembly;
 
 struct blend_state_t {
@@ -322,6 +338,12 @@ struct depth_test_state_t {
     GGLclampx           clearValue;
 };
 
+// rows [top, bottom) a context may write to, see tiler.h
+struct band_t {
+    int32_t             top;
+    int32_t             bottom;
+};
+
 struct scissor_t {
     uint32_t            user_left;
     uint32_t            user_right;
@@ -480,7 +502,7 @@ struct generated_tex_vars_t {
     uint32_t    width;
     uint32_t    height;
     uint32_t    stride;
-    int32_t     data;
+    uintptr_t   data;
     int32_t     dsdx;
     int32_t     dtdx;
     int32_t     spill[2];
@@ -493,7 +515,7 @@ struct generated_vars_t {
     } argb[4];
     int32_t     aref;
     int32_t     dzdx;
-    int32_t     zbase;
+    uintptr_t   zbase;
     int32_t     f;
     int32_t     dfdx;
     int32_t     spill[3];
@@ -546,6 +568,10 @@ struct context_t {
     void*               base;
     Assembly*           scanline_as;
     GGLenum             error;
+
+    band_t              band;
+    tiler_t*            tiler;
+    uint32_t            generic_pipeline;   // see ggl_set_codegen()
 };
 
 // ----------------------------------------------------------------------------
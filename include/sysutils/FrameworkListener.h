@@ -29,14 +29,28 @@ public:
     int errorRate;
 
 private:
-    int mCommandCount;
+    static const int CMD_HASH_BUCKETS = 64;
+
+    /* Bumped by every worker thread, see SocketListener::setWorkerCount() */
+    int32_t mCommandCount;
     bool mWithSeq;
+    bool mPipelined;
     FrameworkCommandCollection *mCommands;
+    /* Same commands as mCommands, hashed by name for dispatch */
+    FrameworkCommandCollection *mCommandBuckets[CMD_HASH_BUCKETS];
 
 public:
     FrameworkListener(const char *socketName);
     FrameworkListener(const char *socketName, bool withSeq);
-    virtual ~FrameworkListener() {}
+    virtual ~FrameworkListener();
+
+    /*
+     * In pipelined mode a client may write several commands back to back:
+     * a command split across reads is kept on its SocketClient and completed
+     * by a later read rather than dropped, and the replies to all commands
+     * in one read are sent as a single batch.
+     */
+    void setPipelined(bool pipelined) { mPipelined = pipelined; }
 
 protected:
     void registerCmd(FrameworkCommand *cmd);
@@ -44,6 +58,7 @@ protected:
 
 private:
     void dispatchCommand(SocketClient *c, char *data);
+    FrameworkCommand *findCommand(const char *name);
     void init(const char *socketName, bool withSeq);
 };
 #endif
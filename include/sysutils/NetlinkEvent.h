@@ -19,13 +19,21 @@
 #include <sysutils/NetlinkListener.h>
 
 #define NL_PARAMS_MAX 32
+#define NL_PARAMS_HASH_SIZE 64
 
 class NetlinkEvent {
     int  mSeq;
-    char *mPath;
+    const char *mPath;
     int  mAction;
-    char *mSubsystem;
+    const char *mSubsystem;
     char *mParams[NL_PARAMS_MAX];
+    /* true if mParams were allocated individually (binary messages) */
+    bool mParamsOwned;
+    /* private copy of the message made by decode() */
+    char *mBuffer;
+    /* open-addressed index of mParams by name, built by findParam() */
+    signed char mParamIndex[NL_PARAMS_HASH_SIZE];
+    bool mParamIndexBuilt;
 
 public:
     const static int NlActionUnknown;
@@ -41,9 +49,15 @@ public:
     virtual ~NetlinkEvent();
 
     bool decode(char *buffer, int size, int format = NetlinkListener::NETLINK_FORMAT_ASCII);
+    /*
+     * Like decode(), but the event keeps pointing into buffer instead of
+     * copying it, so buffer must not be modified or freed before the event.
+     */
+    bool decodeInPlace(char *buffer, int size, int format = NetlinkListener::NETLINK_FORMAT_ASCII);
     const char *findParam(const char *paramName);
 
     const char *getSubsystem() { return mSubsystem; }
+    const char *getPath() { return mPath; }
     int getAction() { return mAction; }
 
     void dump();
@@ -52,6 +66,9 @@ public:
     bool parseIfAddrMessage(int type, struct ifaddrmsg *ifaddr, int rtasize);
     bool parseBinaryNetlinkMessage(char *buffer, int size);
     bool parseAsciiNetlinkMessage(char *buffer, int size);
+
+ private:
+    void buildParamIndex();
 };
 
 #endif
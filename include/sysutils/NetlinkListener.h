@@ -28,6 +28,9 @@ public:
     static const int NETLINK_FORMAT_ASCII = 0;
     static const int NETLINK_FORMAT_BINARY = 1;
 
+    /* uevents are read in batches of this many, each in its own slice of mBuffer */
+    static const int NETLINK_BATCH_MAX = 16;
+
 #if 1
     /* temporary version until we can get Motorola to update their
      * ril.so.  Their prebuilt ril.so is using this private class
@@ -43,6 +46,20 @@ public:
 protected:
     virtual bool onDataAvailable(SocketClient *cli);
     virtual void onEvent(NetlinkEvent *evt) = 0;
+
+    /*
+     * Called for events read in the same batch: return true if evt is made
+     * redundant by next, which arrived after it, so that evt is dropped
+     * instead of being passed to onEvent().  The default keeps every event.
+     *
+     * This is virtual because only the listener knows which of its events
+     * may replace each other (vold's disk events and netd's interface events
+     * follow different rules), so like onEvent() it is meant to be overridden.
+     * It comes after the existing virtual functions, so their vtable slots
+     * don't move, but a subclass built against the previous header has no
+     * slot for it and has to be rebuilt.
+     */
+    virtual bool canCoalesce(NetlinkEvent *evt, NetlinkEvent *next) { return false; }
 };
 
 #endif
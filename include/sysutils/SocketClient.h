@@ -29,6 +29,22 @@ class SocketClient {
 
     bool mUseCmdNum;
 
+    /*
+     * Responses queued between beginBatch() and endBatch().  Only writes
+     * from mBatchOwner are queued; anything sent from another thread, such
+     * as a broadcast, flushes the queue and goes out straight away.
+     */
+    bool mBatching;
+    pthread_t mBatchOwner;
+    char *mBatchBuf;
+    int mBatchLen;
+    int mBatchSize;
+
+    /* Unfinished pipelined command, completed by the next read */
+    char *mPendingCmd;
+    int mPendingCmdLen;
+    bool mDiscardingCmd;
+
 public:
     SocketClient(int sock, bool owned);
     SocketClient(int sock, bool owned, bool useCmdNum);
@@ -57,6 +73,28 @@ public:
     // Sending binary data:
     int sendData(const void *data, int len);
 
+    // Coalesces everything the calling thread sends until endBatch() into
+    // as few writes as possible, for replies to pipelined commands.  Sends
+    // from other threads are not held back, so a broadcast waits at most
+    // for the write lock.  A broadcast sent by a command handler itself is
+    // queued, at most until the commands from the same read are handled.
+    // endBatch() flushes and returns 0 on success, -1 if any queued data
+    // could not be sent.
+    void beginBatch();
+    int endBatch();
+
+    // Keeps the start of a pipelined command whose end hasn't been read yet,
+    // so that the listener can go back to waiting for the socket instead of
+    // blocking on it.  takePendingCommand() moves the saved bytes into buf
+    // and returns how many there were.
+    int takePendingCommand(char *buf, int size);
+    int setPendingCommand(const char *data, int len);
+
+    // Set after a command that was too long, until its terminating zero
+    // has been read and thrown away.
+    bool isDiscardingCommand() const { return mDiscardingCmd; }
+    void setDiscardingCommand(bool discarding) { mDiscardingCmd = discarding; }
+
     // Optional reference counting.  Reference count starts at 1.  If
     // it's decremented to 0, it deletes itself.
     // SocketListener creates a SocketClient (at refcount 1) and calls
@@ -77,6 +115,8 @@ private:
     // returns 0 if successful, -1 if there is a 0 byte write and -2 if any other
     // error occurred (use errno to get the error)
     int sendDataLocked(const void *data, int len);
+    int writeLocked(const void *data, int len);
+    int flushBatchLocked();
 };
 
 typedef android::sysutils::List<SocketClient *> SocketClientCollection;
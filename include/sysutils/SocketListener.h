@@ -27,9 +27,18 @@ class SocketListener {
     SocketClientCollection  *mClients;
     pthread_mutex_t         mClientsLock;
     int                     mCtrlPipe[2];
+    int                     mEpollFd;
     pthread_t               mThread;
     bool                    mUseCmdNum;
 
+    /* Optional pool that runs onDataAvailable() off the listener thread */
+    int                     mWorkerCount;
+    pthread_t               *mWorkers;
+    SocketClientCollection  *mPendingWork;
+    pthread_mutex_t         mWorkLock;
+    pthread_cond_t          mWorkCond;
+    bool                    mWorkersExit;
+
 public:
     SocketListener(const char *socketName, bool listen);
     SocketListener(const char *socketName, bool listen, bool useCmdNum);
@@ -39,6 +48,16 @@ public:
     int startListener();
     int stopListener();
 
+    /*
+     * Dispatch onDataAvailable() on a pool of workerCount threads instead
+     * of the listener thread, so one slow client does not stall the others.
+     * A client is never handled by two workers at once, so the commands of
+     * a single client are still processed in order.  onDataAvailable() must
+     * be safe to call concurrently for different clients.  Must be called
+     * before startListener(); 0 (the default) keeps serial dispatch.
+     */
+    void setWorkerCount(int workerCount);
+
     void sendBroadcast(int code, const char *msg, bool addErrno);
 
 protected:
@@ -46,7 +65,14 @@ protected:
 
 private:
     static void *threadStart(void *obj);
+    static void *workerStart(void *obj);
     void runListener();
+    void runWorker();
+    int watchClient(SocketClient *c, int op);
+    void handleClient(SocketClient *c);
+    void stopWorkers(int count);
+    void releaseResources();
+    int failStart(int workersStarted);
     void init(const char *socketName, int socketFd, bool listen, bool useCmdNum);
 };
 #endif
@@ -19,16 +19,21 @@
 
 #include <stddef.h>
 
+#include <utils/BasicHashtable.h>
 #include <utils/Flattenable.h>
 #include <utils/RefBase.h>
-#include <utils/SortedVector.h>
 #include <utils/threads.h>
 
 namespace android {
 
+class FileMap;
+
 // A BlobCache is an in-memory cache for binary key/value pairs.  A BlobCache
 // does NOT provide any thread-safety guarantees.
 //
+// When the cache fills up, the least recently used entries (those that have
+// gone the longest without a set or a successful get) are evicted first.
+//
 // The cache contents can be serialized to an in-memory buffer or mmap'd file
 // and then reloaded in a subsequent execution of the program.  This
 // serialization is non-portable and the data should only be used by the device
@@ -42,6 +47,7 @@ public:
     // maxValueSize, respectively. The total combined size of ALL cache entries
     // (key sizes plus value sizes) will not exceed maxTotalSize.
     BlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize);
+    virtual ~BlobCache();
 
     // set inserts a new binary value into the cache and associates it with the
     // given binary key.  If the key or value are too large for the cache then
@@ -63,7 +69,8 @@ public:
 
     // get retrieves from the cache the binary value associated with a given
     // binary key.  If the key is present in the cache then the length of the
-    // binary value associated with that key is returned.  If the value argument
+    // binary value associated with that key is returned and the entry becomes
+    // the most recently used one.  If the value argument
     // is non-NULL and the size of the cached value is less than valueSize bytes
     // then the cached value is copied into the buffer pointed to by the value
     // argument.  If the key is not present in the cache then 0 is returned and
@@ -87,7 +94,8 @@ public:
     // flatten serializes the current contents of the cache into the memory
     // pointed to by 'buffer'.  The serialized cache contents can later be
     // loaded into a BlobCache object using the unflatten method.  The contents
-    // of the BlobCache object will not be modified.
+    // of the BlobCache object will not be modified.  Entries are written from
+    // least to most recently used so that unflatten restores the same order.
     //
     // Preconditions:
     //   size >= this.getFlattenedSize()
@@ -101,15 +109,46 @@ public:
     //
     status_t unflatten(void const* buffer, size_t size);
 
+    // unflattenMapped behaves like unflatten, except that the serialized cache
+    // contents are read from a memory-mapped file and the keys and values are
+    // not copied.  The cache entries point directly into the mapping, and each
+    // one holds a reference to 'map' (see FileMap::acquire) for as long as it
+    // stays in the cache, so the caller may release its own reference as soon
+    // as this returns.  Values replaced by a later set are copied as usual.
+    status_t unflattenMapped(FileMap* map);
+
 private:
     // Copying is disallowed.
     BlobCache(const BlobCache&);
     void operator=(const BlobCache&);
 
-    // A random function helper to get around MinGW not having nrand48()
-    long int blob_random();
+    class CacheEntry;
+
+    // set is the implementation of the public set method.  If map is non-NULL
+    // then key and value point into it and are referenced rather than copied.
+    void set(const void* key, size_t keySize, const void* value,
+            size_t valueSize, FileMap* map);
+
+    // unflatten is the implementation of the public unflatten methods.
+    status_t unflatten(void const* buffer, size_t size, FileMap* map);
 
-    // clean evicts a randomly chosen set of entries from the cache such that
+    // findEntry returns the cache entry for the given key, or NULL if there
+    // is none.
+    CacheEntry* findEntry(const void* key, size_t keySize, hash_t hash) const;
+
+    // addEntry adds a new entry to the index as the most recently used one.
+    void addEntry(CacheEntry* entry);
+
+    // removeEntry removes an entry from the index and deletes it.
+    void removeEntry(CacheEntry* entry);
+
+    // touchEntry marks an entry as the most recently used one.
+    void touchEntry(CacheEntry* entry);
+
+    // clear evicts all entries from the cache.
+    void clear();
+
+    // clean evicts the least recently used entries from the cache such that
     // the total size of all remaining entries is less than mMaxTotalSize/2.
     void clean();
 
@@ -121,10 +160,9 @@ private:
     class Blob : public RefBase {
     public:
         Blob(const void* data, size_t size, bool copyData);
+        Blob(const void* data, size_t size, FileMap* map);
         ~Blob();
 
-        bool operator<(const Blob& rhs) const;
-
         const void* getData() const;
         size_t getSize() const;
 
@@ -142,30 +180,58 @@ private:
         // mOwnsData indicates whether or not this Blob object should free the
         // memory pointed to by mData when the Blob gets destructed.
         bool mOwnsData;
+
+        // mMap is the file mapping that mData points into, if any.  The Blob
+        // holds a reference to it until the Blob gets destructed.
+        FileMap* mMap;
     };
 
-    // A CacheEntry is a single key/value pair in the cache.
+    // A CacheEntry is a single key/value pair in the cache.  Entries are kept
+    // on a doubly-linked list ordered from least to most recently used.
     class CacheEntry {
     public:
-        CacheEntry();
-        CacheEntry(const sp<Blob>& key, const sp<Blob>& value);
-        CacheEntry(const CacheEntry& ce);
-
-        bool operator<(const CacheEntry& rhs) const;
-        const CacheEntry& operator=(const CacheEntry&);
+        CacheEntry(const sp<Blob>& key, const sp<Blob>& value, hash_t hash);
 
         sp<Blob> getKey() const;
         sp<Blob> getValue() const;
+        hash_t getHash() const;
 
         void setValue(const sp<Blob>& value);
 
+        // mOlder and mNewer are the neighbouring entries in use order.
+        CacheEntry* mOlder;
+        CacheEntry* mNewer;
+
     private:
+        // Copying is not allowed.
+        CacheEntry(const CacheEntry&);
+        void operator=(const CacheEntry&);
 
         // mKey is the key that identifies the cache entry.
         sp<Blob> mKey;
 
         // mValue is the cached data associated with the key.
         sp<Blob> mValue;
+
+        // mHash is the hash of the key data.
+        hash_t mHash;
+    };
+
+    // A KeyRef refers to the data of a key without owning it.  Two KeyRefs are
+    // equal if they refer to identical byte sequences.
+    struct KeyRef {
+        const void* data;
+        size_t size;
+
+        bool operator==(const KeyRef& rhs) const;
+    };
+
+    // An IndexEntry maps the key of a cache entry to the entry itself.
+    struct IndexEntry {
+        KeyRef key;
+        CacheEntry* entry;
+
+        const KeyRef& getKey() const { return key; }
     };
 
     // A Header is the header for the entire BlobCache serialization format. No
@@ -229,13 +295,14 @@ private:
     // the cache.
     size_t mTotalSize;
 
-    // mRandState is the pseudo-random number generator state. It is passed to
-    // nrand48 to generate random numbers when needed.
-    unsigned short mRandState[3];
+    // mIndex stores all the cache entries that are resident in memory, hashed
+    // by key.  Cache entries are added to it by the 'set' method.
+    BasicHashtable<KeyRef, IndexEntry> mIndex;
 
-    // mCacheEntries stores all the cache entries that are resident in memory.
-    // Cache entries are added to it by the 'set' method.
-    SortedVector<CacheEntry> mCacheEntries;
+    // mOldest and mNewest are the ends of the use-ordered entry list.
+    // Entries are evicted starting from mOldest.
+    CacheEntry* mOldest;
+    CacheEntry* mNewest;
 };
 
 }
@@ -0,0 +1,446 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_FLAT_HASH_MAP_H
+#define ANDROID_FLAT_HASH_MAP_H
+
+#include <new>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <utils/Errors.h>
+#include <utils/TypeHelpers.h>
+
+// ---------------------------------------------------------------------------
+
+namespace android {
+
+/*
+ * A FlatHashMap is an unordered map from keys to values with an API close to
+ * KeyedVector's.  Lookups, insertions and removals take expected constant
+ * time, where KeyedVector takes O(log n) to look up and O(n) to insert.
+ *
+ * Entries are stored inline in a single power-of-two sized array using open
+ * addressing with linear probing and robin hood displacement: an entry being
+ * inserted takes the slot of any entry that sits closer to its home slot,
+ * which keeps probe sequences short even at a high load factor.  Removal
+ * shifts the following entries back rather than leaving tombstones.  The
+ * 32-bit hash of each entry is kept in a separate parallel array so that
+ * probing touches keys only when the hashes match.
+ *
+ * Indices are positions in the slot array, not ranks: they are only valid
+ * until the next insertion or removal.  Use next() to iterate:
+ *
+ *     for (ssize_t i = map.next(-1); i >= 0; i = map.next(i)) {
+ *         use(map.keyAt(i), map.valueAt(i));
+ *     }
+ *
+ * The key type must provide operator== and a hash_type() specialization
+ * (see TypeHelpers.h).  Unlike KeyedVector, copying a FlatHashMap copies
+ * its entries immediately.
+ */
+template <typename KEY, typename VALUE>
+class FlatHashMap
+{
+public:
+    typedef KEY    key_type;
+    typedef VALUE  value_type;
+
+    /* Creates an empty map.  defValue is returned by valueFor() for keys
+     * that are not in the map.
+     */
+                            FlatHashMap(const VALUE& defValue = VALUE());
+                            FlatHashMap(const FlatHashMap& other);
+                            ~FlatHashMap();
+
+            FlatHashMap&    operator = (const FlatHashMap& other);
+
+    /*
+     * empty the map
+     */
+
+            void            clear();
+
+    /*
+     * map stats
+     */
+
+    //! returns number of items in the map
+    inline  size_t          size() const                { return mSize; }
+    //! returns whether or not the map is empty
+    inline  bool            isEmpty() const             { return mSize == 0; }
+    //! returns how many items can be stored without rehashing
+    inline  size_t          capacity() const            { return maxSizeFor(mBucketCount); }
+    //! sets the capacity. capacity can never be reduced less than size()
+            ssize_t         setCapacity(size_t size);
+
+    /*
+     * accessors
+     */
+
+    //! returns the value for key, or the default value if key is absent
+            const VALUE&    valueFor(const KEY& key) const;
+            const VALUE&    valueAt(size_t index) const;
+            const KEY&      keyAt(size_t index) const;
+            ssize_t         indexOfKey(const KEY& key) const;
+
+    //! returns the index of the first entry after index, or -1 at the end.
+    //! pass -1 to get the first entry.
+            ssize_t         next(ssize_t index) const;
+
+    /*
+     * modifying the map
+     */
+
+    //! key must be present in the map
+            VALUE&          editValueFor(const KEY& key);
+            VALUE&          editValueAt(size_t index);
+
+    //! adds an item, or replaces the value of an existing one. returns its index.
+            ssize_t         add(const KEY& key, const VALUE& item);
+            ssize_t         replaceValueFor(const KEY& key, const VALUE& item);
+            ssize_t         replaceValueAt(size_t index, const VALUE& item);
+
+    //! removes an item. returns the index it had, or NAME_NOT_FOUND.
+            ssize_t         removeItem(const KEY& key);
+            ssize_t         removeItemAt(size_t index);
+
+private:
+    typedef key_value_pair_t<KEY, VALUE> Entry;
+
+    enum {
+        // smallest non-empty bucket array
+        MIN_BUCKET_COUNT = 8,
+    };
+
+    // Entries are kept at a load factor of at most 7/8.
+    static inline size_t maxSizeFor(size_t bucketCount) {
+        return bucketCount - bucketCount / 8;
+    }
+
+    // Mixes the key's hash so that keys differing only in their high bits
+    // (aligned pointers, for instance) still get distinct home slots.
+    // 0 marks an empty slot, so it is never returned.
+    static inline hash_t hashOf(const KEY& key) {
+        hash_t hash = hash_type(key) * 0x9E3779B1U;
+        hash ^= hash >> 16;
+        return hash ? hash : 1;
+    }
+
+    inline size_t homeOf(hash_t hash) const {
+        return hash & (mBucketCount - 1);
+    }
+
+    inline size_t distanceOf(size_t index) const {
+        return (index - homeOf(mHashes[index])) & (mBucketCount - 1);
+    }
+
+            ssize_t         find(hash_t hash, const KEY& key) const;
+            size_t          insert(hash_t hash, const KEY& key, const VALUE& item);
+            void            rehash(size_t bucketCount);
+            void            copyFrom(const FlatHashMap& other);
+            void            dispose();
+
+    hash_t* mHashes;        // per-slot hash, or 0 if the slot is empty
+    Entry*  mEntries;       // per-slot entry, constructed only if the slot is used
+    size_t  mBucketCount;   // number of slots, 0 or a power of two
+    size_t  mSize;          // number of used slots
+    VALUE   mDefault;
+};
+
+// ---------------------------------------------------------------------------
+// No user serviceable parts from here...
+// ---------------------------------------------------------------------------
+
+template<typename KEY, typename VALUE>
+FlatHashMap<KEY,VALUE>::FlatHashMap(const VALUE& defValue)
+    : mHashes(NULL), mEntries(NULL), mBucketCount(0), mSize(0), mDefault(defValue)
+{
+}
+
+template<typename KEY, typename VALUE>
+FlatHashMap<KEY,VALUE>::FlatHashMap(const FlatHashMap<KEY,VALUE>& other)
+    : mHashes(NULL), mEntries(NULL), mBucketCount(0), mSize(0), mDefault(other.mDefault)
+{
+    copyFrom(other);
+}
+
+template<typename KEY, typename VALUE>
+FlatHashMap<KEY,VALUE>::~FlatHashMap() {
+    dispose();
+}
+
+template<typename KEY, typename VALUE>
+FlatHashMap<KEY,VALUE>& FlatHashMap<KEY,VALUE>::operator = (const FlatHashMap<KEY,VALUE>& other) {
+    if (this != &other) {
+        dispose();
+        mDefault = other.mDefault;
+        copyFrom(other);
+    }
+    return *this;
+}
+
+template<typename KEY, typename VALUE>
+void FlatHashMap<KEY,VALUE>::clear() {
+    if (mSize) {
+        for (size_t i = 0; i < mBucketCount; i++) {
+            if (mHashes[i]) {
+                destroy_type(&mEntries[i], 1);
+                mHashes[i] = 0;
+            }
+        }
+        mSize = 0;
+    }
+}
+
+template<typename KEY, typename VALUE>
+ssize_t FlatHashMap<KEY,VALUE>::setCapacity(size_t size) {
+    if (size < mSize) {
+        size = mSize;
+    }
+    size_t bucketCount = MIN_BUCKET_COUNT;
+    while (maxSizeFor(bucketCount) < size) {
+        bucketCount <<= 1;
+    }
+    if (bucketCount != mBucketCount) {
+        rehash(bucketCount);
+        if (mBucketCount != bucketCount) {
+            return NO_MEMORY;
+        }
+    }
+    return capacity();
+}
+
+template<typename KEY, typename VALUE> inline
+const VALUE& FlatHashMap<KEY,VALUE>::valueFor(const KEY& key) const {
+    ssize_t i = find(hashOf(key), key);
+    return i >= 0 ? mEntries[i].value : mDefault;
+}
+
+template<typename KEY, typename VALUE> inline
+const VALUE& FlatHashMap<KEY,VALUE>::valueAt(size_t index) const {
+    return mEntries[index].value;
+}
+
+template<typename KEY, typename VALUE> inline
+const KEY& FlatHashMap<KEY,VALUE>::keyAt(size_t index) const {
+    return mEntries[index].key;
+}
+
+template<typename KEY, typename VALUE> inline
+ssize_t FlatHashMap<KEY,VALUE>::indexOfKey(const KEY& key) const {
+    return find(hashOf(key), key);
+}
+
+template<typename KEY, typename VALUE>
+ssize_t FlatHashMap<KEY,VALUE>::next(ssize_t index) const {
+    for (size_t i = size_t(index + 1); i < mBucketCount; i++) {
+        if (mHashes[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+template<typename KEY, typename VALUE> inline
+VALUE& FlatHashMap<KEY,VALUE>::editValueFor(const KEY& key) {
+    return mEntries[find(hashOf(key), key)].value;
+}
+
+template<typename KEY, typename VALUE> inline
+VALUE& FlatHashMap<KEY,VALUE>::editValueAt(size_t index) {
+    return mEntries[index].value;
+}
+
+template<typename KEY, typename VALUE>
+ssize_t FlatHashMap<KEY,VALUE>::add(const KEY& key, const VALUE& item) {
+    hash_t hash = hashOf(key);
+    ssize_t i = find(hash, key);
+    if (i >= 0) {
+        mEntries[i].value = item;
+        return i;
+    }
+    if (mSize >= maxSizeFor(mBucketCount)) {
+        rehash(mBucketCount ? mBucketCount * 2 : size_t(MIN_BUCKET_COUNT));
+        if (mSize >= maxSizeFor(mBucketCount)) {
+            return NO_MEMORY;
+        }
+    }
+    return insert(hash, key, item);
+}
+
+template<typename KEY, typename VALUE> inline
+ssize_t FlatHashMap<KEY,VALUE>::replaceValueFor(const KEY& key, const VALUE& item) {
+    return add(key, item);
+}
+
+template<typename KEY, typename VALUE> inline
+ssize_t FlatHashMap<KEY,VALUE>::replaceValueAt(size_t index, const VALUE& item) {
+    if (index < mBucketCount && mHashes[index]) {
+        mEntries[index].value = item;
+        return index;
+    }
+    return BAD_INDEX;
+}
+
+template<typename KEY, typename VALUE>
+ssize_t FlatHashMap<KEY,VALUE>::removeItem(const KEY& key) {
+    ssize_t i = find(hashOf(key), key);
+    return i >= 0 ? removeItemAt(i) : ssize_t(NAME_NOT_FOUND);
+}
+
+template<typename KEY, typename VALUE>
+ssize_t FlatHashMap<KEY,VALUE>::removeItemAt(size_t index) {
+    if (index >= mBucketCount || !mHashes[index]) {
+        return BAD_INDEX;
+    }
+    destroy_type(&mEntries[index], 1);
+    mSize--;
+
+    // Shift the rest of the probe run back by one slot so that lookups never
+    // have to step over holes.
+    const size_t mask = mBucketCount - 1;
+    size_t hole = index;
+    size_t i = (hole + 1) & mask;
+    while (mHashes[i] && distanceOf(i) != 0) {
+        move_backward_type(&mEntries[hole], &mEntries[i]);
+        mHashes[hole] = mHashes[i];
+        hole = i;
+        i = (i + 1) & mask;
+    }
+    mHashes[hole] = 0;
+    return index;
+}
+
+template<typename KEY, typename VALUE>
+ssize_t FlatHashMap<KEY,VALUE>::find(hash_t hash, const KEY& key) const {
+    if (!mSize) {
+        return NAME_NOT_FOUND;
+    }
+    const size_t mask = mBucketCount - 1;
+    size_t i = homeOf(hash);
+    for (size_t distance = 0; ; distance++, i = (i + 1) & mask) {
+        hash_t h = mHashes[i];
+        // An entry closer to its home than we are to ours means the key
+        // would have displaced it, so the key isn't here.
+        if (!h || distanceOf(i) < distance) {
+            return NAME_NOT_FOUND;
+        }
+        if (h == hash && mEntries[i].key == key) {
+            return i;
+        }
+    }
+}
+
+template<typename KEY, typename VALUE>
+size_t FlatHashMap<KEY,VALUE>::insert(hash_t hash, const KEY& key, const VALUE& item) {
+    // Find the slot the new entry belongs in: the first one that is either
+    // empty or held by an entry closer to its home.
+    const size_t mask = mBucketCount - 1;
+    size_t index = homeOf(hash);
+    for (size_t distance = 0; mHashes[index] && distanceOf(index) >= distance; distance++) {
+        index = (index + 1) & mask;
+    }
+
+    // Shift the rest of the run forward by one slot, up to the next empty one.
+    // This is equivalent to the usual chain of swaps but moves each entry once.
+    size_t hole = index;
+    while (mHashes[hole]) {
+        hole = (hole + 1) & mask;
+    }
+    while (hole != index) {
+        size_t prev = (hole - 1) & mask;
+        move_forward_type(&mEntries[hole], &mEntries[prev]);
+        mHashes[hole] = mHashes[prev];
+        hole = prev;
+    }
+
+    new(&mEntries[index]) Entry(key, item);
+    mHashes[index] = hash;
+    mSize++;
+    return index;
+}
+
+template<typename KEY, typename VALUE>
+void FlatHashMap<KEY,VALUE>::rehash(size_t bucketCount) {
+    hash_t* hashes = static_cast<hash_t*>(calloc(bucketCount, sizeof(hash_t)));
+    Entry* entries = static_cast<Entry*>(malloc(bucketCount * sizeof(Entry)));
+    if (!hashes || !entries) {
+        free(hashes);
+        free(entries);
+        return;
+    }
+
+    hash_t* oldHashes = mHashes;
+    Entry* oldEntries = mEntries;
+    size_t oldBucketCount = mBucketCount;
+    mHashes = hashes;
+    mEntries = entries;
+    mBucketCount = bucketCount;
+    mSize = 0;
+
+    for (size_t i = 0; i < oldBucketCount; i++) {
+        if (oldHashes[i]) {
+            insert(oldHashes[i], oldEntries[i].key, oldEntries[i].value);
+            destroy_type(&oldEntries[i], 1);
+        }
+    }
+    free(oldHashes);
+    free(oldEntries);
+}
+
+template<typename KEY, typename VALUE>
+void FlatHashMap<KEY,VALUE>::copyFrom(const FlatHashMap<KEY,VALUE>& other) {
+    if (!other.mSize) {
+        return;
+    }
+    mHashes = static_cast<hash_t*>(malloc(other.mBucketCount * sizeof(hash_t)));
+    mEntries = static_cast<Entry*>(malloc(other.mBucketCount * sizeof(Entry)));
+    if (!mHashes || !mEntries) {
+        free(mHashes);
+        free(mEntries);
+        mHashes = NULL;
+        mEntries = NULL;
+        return;
+    }
+    // The layout only depends on the hashes, so it can be copied as is.
+    memcpy(mHashes, other.mHashes, other.mBucketCount * sizeof(hash_t));
+    for (size_t i = 0; i < other.mBucketCount; i++) {
+        if (mHashes[i]) {
+            new(&mEntries[i]) Entry(other.mEntries[i]);
+        }
+    }
+    mBucketCount = other.mBucketCount;
+    mSize = other.mSize;
+}
+
+template<typename KEY, typename VALUE>
+void FlatHashMap<KEY,VALUE>::dispose() {
+    clear();
+    free(mHashes);
+    free(mEntries);
+    mHashes = NULL;
+    mEntries = NULL;
+    mBucketCount = 0;
+}
+
+}; // namespace android
+
+// ---------------------------------------------------------------------------
+
+#endif // ANDROID_FLAT_HASH_MAP_H
@@ -40,6 +40,18 @@ public:
 
     inline                  KeyedVector();
 
+#if __cplusplus >= 201103L
+                            KeyedVector(const KeyedVector& rhs) = default;
+            KeyedVector&    operator = (const KeyedVector& rhs) = default;
+    /*! move constructor and operator: take over rhs's storage, leaving it empty */
+    inline                  KeyedVector(KeyedVector&& rhs)
+        : mVector(static_cast<SortedVector< key_value_pair_t<KEY, VALUE> >&&>(rhs.mVector)) { }
+    inline  KeyedVector&    operator = (KeyedVector&& rhs) {
+        mVector = static_cast<SortedVector< key_value_pair_t<KEY, VALUE> >&&>(rhs.mVector);
+        return *this;
+    }
+#endif
+
     /*
      * empty the vector
      */
@@ -190,7 +190,8 @@ public:
      * Wakes the poll asynchronously.
      *
      * This method can be called on any thread.
-     * This method returns immediately.
+     * This method returns immediately.  Wakes requested while one is already
+     * pending are coalesced and do not make a system call.
      */
     void wake();
 
@@ -254,7 +255,7 @@ public:
      * Enqueues a message to be processed by the specified handler.
      *
      * The handler must not be null.
-     * This method can be called on any thread.
+     * This method can be called on any thread.  It does not take the Looper's lock.
      */
     void sendMessage(const sp<MessageHandler>& handler, const Message& message);
 
@@ -340,24 +341,51 @@ private:
     };
 
     struct MessageEnvelope {
-        MessageEnvelope() : uptime(0) { }
+        MessageEnvelope() : uptime(0), seq(0) { }
+
+        MessageEnvelope(nsecs_t uptime, uint64_t seq, const sp<MessageHandler> handler,
+                const Message& message) : uptime(uptime), seq(seq), handler(handler),
+                message(message) {
+        }
 
-        MessageEnvelope(nsecs_t uptime, const sp<MessageHandler> handler,
-                const Message& message) : uptime(uptime), handler(handler), message(message) {
+        // Messages run in uptime order; seq keeps FIFO order among equal uptimes.
+        inline bool isBefore(const MessageEnvelope& other) const {
+            return uptime < other.uptime || (uptime == other.uptime && seq < other.seq);
         }
 
         nsecs_t uptime;
+        uint64_t seq;
         sp<MessageHandler> handler;
         Message message;
     };
 
+    // Message sent with sendMessage(), queued without taking mLock.
+    struct PendingMessage {
+        PendingMessage(nsecs_t uptime, const sp<MessageHandler>& handler,
+                const Message& message) : uptime(uptime), handler(handler), message(message),
+                next(NULL) {
+        }
+
+        nsecs_t uptime;
+        sp<MessageHandler> handler;
+        Message message;
+        PendingMessage* next;
+    };
+
     const bool mAllowNonCallbacks; // immutable
 
-    int mWakeReadPipeFd;  // immutable
-    int mWakeWritePipeFd; // immutable
+    int mWakeEventFd;  // immutable
+    volatile int32_t mWakePending; // 1 while a wake-up is signalled but not yet consumed
     Mutex mLock;
 
+    // Lock-free LIFO of messages from sendMessage(), newest first.  Producers push with
+    // compare-and-swap; it is detached and moved into mMessageEnvelopes under mLock.
+    PendingMessage* volatile mPendingMessages;
+
+    // Binary min-heap of pending messages ordered by MessageEnvelope::isBefore(),
+    // so the next message due is always at index 0.
     Vector<MessageEnvelope> mMessageEnvelopes; // guarded by mLock
+    uint64_t mNextMessageSeq; // guarded by mLock
     bool mSendingMessage; // guarded by mLock
 
     // Whether we are currently waiting for work.  Not protected by a lock,
@@ -376,6 +404,12 @@ private:
     nsecs_t mNextMessageUptime; // set to LLONG_MAX when none
 
     int pollInner(int timeoutMillis);
+    size_t enqueueMessageLocked(const MessageEnvelope& messageEnvelope);
+    void removeHeadMessageLocked();
+    void drainPendingMessagesLocked();
+    void removeMessagesLocked(const sp<MessageHandler>& handler, bool matchWhat, int what);
+    size_t siftUpLocked(size_t index);
+    void siftDownLocked(size_t index);
     void awoken();
     void pushResponse(int events, const Request& request);
 
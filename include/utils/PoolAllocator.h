@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_POOLALLOCATOR_H
+#define ANDROID_POOLALLOCATOR_H
+
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(HAVE_PTHREADS)
+# include <pthread.h>
+#endif
+
+#include <utils/Mutex.h>
+
+namespace android {
+
+/**
+ * A memory manager for many small, fixed-size objects with unrelated lifetimes.
+ *
+ * Requests of up to MAX_POOLED_SIZE bytes are rounded up to one of a set of size classes,
+ * each with its own free list of blocks carved out of large slabs, so that neither alloc()
+ * nor free() normally goes through malloc.  Each thread keeps a cache of free blocks per
+ * size class and moves them to and from the shared pool in batches, so the pool lock is
+ * taken about once every BATCH_SIZE operations.  Larger requests go straight to malloc.
+ *
+ * Unlike with LinearAllocator, blocks can be freed individually, in any order and from any
+ * thread.  The caller must pass the size it allocated to free().  Slabs are only returned
+ * to the system when the PoolAllocator is destroyed, which must not happen while other
+ * threads may still use it.
+ */
+class PoolAllocator {
+public:
+    enum {
+        // Granularity of the size classes.  Pooled blocks are aligned at least as well as
+        // malloc's.
+        SIZE_CLASS_STEP = 16,
+        // Largest request served from the pool.
+        MAX_POOLED_SIZE = 256,
+        NUM_SIZE_CLASSES = MAX_POOLED_SIZE / SIZE_CLASS_STEP,
+        // Number of blocks moved between a thread cache and the shared pool at once.
+        BATCH_SIZE = 32,
+        // Size of the slabs that blocks are carved from.
+        SLAB_SIZE = 64 * 1024,
+    };
+
+    PoolAllocator();
+    ~PoolAllocator();
+
+    /**
+     * Returns the process-wide pool used by PoolObject and PoolStlAllocator by default.
+     */
+    static PoolAllocator& getDefault();
+
+    /**
+     * Returns a block of at least 'size' bytes, or NULL if out of memory.
+     */
+    void* alloc(size_t size);
+
+    /**
+     * Returns a block obtained from alloc(size) to the pool.  NULL is ignored.
+     */
+    void free(void* ptr, size_t size);
+
+    /**
+     * Dump memory usage statistics to the log (slabs and blocks held by the shared pool)
+     */
+    void dumpMemoryStats(const char* prefix = "");
+
+private:
+    PoolAllocator(const PoolAllocator& other);
+    PoolAllocator& operator=(const PoolAllocator& other);
+
+    struct Block {
+        Block* next;
+    };
+
+    struct Slab {
+        Slab* next;
+    };
+
+    class ThreadCache;
+
+    static inline size_t sizeClassOf(size_t size) {
+        return size ? (size - 1) / SIZE_CLASS_STEP : 0;
+    }
+
+    ThreadCache* getThreadCache();
+    void refillLocked(size_t sizeClass);
+    size_t takeBatch(size_t sizeClass, Block** outHead);
+    void giveBatch(size_t sizeClass, Block* head, Block* tail, size_t count);
+    void releaseThreadCache(ThreadCache* cache);
+
+#if defined(HAVE_PTHREADS)
+    static void threadCacheDestructor(void* cache);
+
+    pthread_key_t mCacheKey;
+    bool mHasCacheKey;
+#endif
+
+    // Guards everything below.
+    Mutex mLock;
+
+    Block* mFreeLists[NUM_SIZE_CLASSES];
+    size_t mFreeCounts[NUM_SIZE_CLASSES];
+    Slab* mSlabs;
+    size_t mSlabCount;
+    ThreadCache* mThreadCaches;
+};
+
+/**
+ * Base class for objects that should be allocated from the default PoolAllocator, e.g.
+ *
+ *     class Event : public RefBase, public PoolObject { ... };
+ *
+ * The sized operator delete lets the pool find the right size class, including for objects
+ * deleted through a base class with a virtual destructor such as RefBase.
+ */
+class PoolObject {
+public:
+    static void* operator new(size_t size) {
+        return PoolAllocator::getDefault().alloc(size);
+    }
+    static void* operator new(size_t, void* ptr) {
+        return ptr;
+    }
+    static void operator delete(void* ptr, size_t size) {
+        PoolAllocator::getDefault().free(ptr, size);
+    }
+    static void operator delete(void*, void*) {
+    }
+};
+
+/**
+ * Adapter for using a PoolAllocator as the allocator of an STL container, e.g.
+ *
+ *     std::list<int, PoolStlAllocator<int> > list;
+ */
+template <typename T>
+class PoolStlAllocator {
+public:
+    typedef T           value_type;
+    typedef T*          pointer;
+    typedef const T*    const_pointer;
+    typedef T&          reference;
+    typedef const T&    const_reference;
+    typedef size_t      size_type;
+    typedef ptrdiff_t   difference_type;
+
+    template <typename U>
+    struct rebind {
+        typedef PoolStlAllocator<U> other;
+    };
+
+    PoolStlAllocator() : mPool(&PoolAllocator::getDefault()) { }
+    explicit PoolStlAllocator(PoolAllocator& pool) : mPool(&pool) { }
+    template <typename U>
+    PoolStlAllocator(const PoolStlAllocator<U>& other) : mPool(other.pool()) { }
+
+    pointer address(reference x) const { return &x; }
+    const_pointer address(const_reference x) const { return &x; }
+
+    pointer allocate(size_type n, const void* = 0) {
+        return static_cast<pointer>(mPool->alloc(n * sizeof(T)));
+    }
+    void deallocate(pointer p, size_type n) {
+        mPool->free(p, n * sizeof(T));
+    }
+
+    size_type max_size() const { return size_type(-1) / sizeof(T); }
+
+    void construct(pointer p, const T& value) { new(p) T(value); }
+    void destroy(pointer p) { p->~T(); }
+
+    PoolAllocator* pool() const { return mPool; }
+
+private:
+    PoolAllocator* mPool;
+};
+
+template <typename T, typename U>
+inline bool operator==(const PoolStlAllocator<T>& lhs, const PoolStlAllocator<U>& rhs) {
+    return lhs.pool() == rhs.pool();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const PoolStlAllocator<T>& lhs, const PoolStlAllocator<U>& rhs) {
+    return lhs.pool() != rhs.pool();
+}
+
+}; // namespace android
+
+#endif // ANDROID_POOLALLOCATOR_H
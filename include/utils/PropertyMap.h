@@ -17,7 +17,9 @@
 #ifndef _UTILS_PROPERTY_MAP_H
 #define _UTILS_PROPERTY_MAP_H
 
+#include <utils/FileMap.h>
 #include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
 #include <utils/String8.h>
 #include <utils/Errors.h>
 #include <utils/Tokenizer.h>
@@ -43,14 +45,21 @@ namespace android {
  *
  * The file must not contain duplicate keys.
  *
+ * A property map can also be saved in a precompiled binary form with writeBinary().
+ * loadBinary() maps such files into memory instead of parsing them; lookups then
+ * binary search the sorted keys in place.
+ *
  * TODO Support escape sequences and quoted values when needed.
  */
 class PropertyMap {
 public:
     /* Creates an empty property map. */
     PropertyMap();
+    PropertyMap(const PropertyMap& other);
     ~PropertyMap();
 
+    PropertyMap& operator=(const PropertyMap& other);
+
     /* Clears the property map. */
     void clear();
 
@@ -74,13 +83,54 @@ public:
     /* Adds all values from the specified property map. */
     void addAll(const PropertyMap* map);
 
-    /* Gets the underlying property map. */
-    inline const KeyedVector<String8, String8>& getProperties() const { return mProperties; }
+    /* Gets the underlying property map.
+     * For a map loaded from a binary file, this builds a copy of all properties the
+     * first time.  The copy is made under a lock, so concurrent readers are safe.
+     */
+    const KeyedVector<String8, String8>& getProperties() const;
 
-    /* Loads a property map from a file. */
+    /* Loads a property map from a text property file. */
     static status_t load(const String8& filename, PropertyMap** outMap);
 
+    /* Loads a property map from a binary property file written by writeBinary().
+     * Returns BAD_VALUE if the file is not a valid binary property file.
+     */
+    static status_t loadBinary(const String8& filename, PropertyMap** outMap);
+
+    /* Writes the properties to a file in binary form, replacing the file if it exists.
+     * The file is written under a temporary name and then renamed, so it is replaced
+     * atomically.
+     */
+    status_t writeBinary(const String8& filename) const;
+
 private:
+    /* Binary file layout, in native byte order.  The header is followed by 'count'
+     * entries sorted by key, and then by the null-terminated keys and values that the
+     * entries refer to by offset from the start of the file.
+     */
+    enum {
+        BINARY_MAGIC = 0x50414d50, // "PMAP"
+        BINARY_VERSION = 1,
+    };
+
+    struct BinaryHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t count;
+    };
+
+    struct BinaryEntry {
+        uint32_t keyOffset;
+        uint32_t keyLength;
+        uint32_t valueOffset;
+        uint32_t valueLength;
+    };
+
+    status_t setBinary(FileMap* map);
+    const BinaryEntry* findBinaryEntry(const char* key) const;
+    const char* findValue(const String8& key, size_t* outLength) const;
+    void clearMergedProperties();
+
     class Parser {
         PropertyMap* mMap;
         Tokenizer* mTokenizer;
@@ -99,6 +149,15 @@ private:
     };
 
     KeyedVector<String8, String8> mProperties;
+
+    // Properties of a binary file, or NULL.  Properties in mProperties take precedence.
+    FileMap* mBinaryMap;
+    const BinaryEntry* mBinaryEntries;
+    size_t mBinaryCount;
+
+    // Properties of the binary file merged with mProperties, built by getProperties().
+    mutable Mutex mMergedLock;
+    mutable KeyedVector<String8, String8>* mMergedProperties;
 };
 
 } // namespace android
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SAMPLING_PROFILER_H
+#define ANDROID_SAMPLING_PROFILER_H
+
+#include <android/log.h>
+#include <corkscrew/backtrace.h>
+#include <utils/CallStack.h>
+#include <utils/Errors.h>
+#include <utils/FlatHashMap.h>
+#include <utils/JenkinsHash.h>
+#include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
+#include <utils/StrongPointer.h>
+#include <utils/String8.h>
+#include <utils/Vector.h>
+
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+namespace android {
+
+class Printer;
+
+// Samples the call stacks of the threads in this process that are using CPU, and reports
+// how often each stack was seen in the "folded" format used by flame graph tools:
+//
+//     surfaceflinger-1234;main;android::SurfaceFlinger::run();... 42
+//
+// A profiling timer (ITIMER_PROF) sends SIGPROF to whichever thread is running.  The signal
+// handler unwinds that thread's stack into a lock-free ring; a background thread moves the
+// samples from the ring into a table of distinct stacks.  Program counters are only turned
+// into names when a report is printed, and the symbol table of each library is loaded once
+// and kept for later reports.
+//
+// SamplingProfiler needs libcorkscrew's unwinder, so it is only built for the device.
+// Only one SamplingProfiler can run in a process at a time, and the process must not use
+// SIGPROF or ITIMER_PROF for anything else.  SIGPROF interrupts system calls that don't
+// restart automatically, such as nanosleep() and epoll_wait(); code being profiled must
+// handle EINTR from those.
+class SamplingProfiler {
+public:
+    enum {
+        // Frames kept per sample, counting from the innermost one.
+        MAX_DEPTH = CallStack::MAX_DEPTH,
+        // Samples that can wait for aggregation before new ones are dropped.
+        // Must be a power of 2.
+        RING_SIZE = 512,
+        DEFAULT_FREQUENCY = 100,
+    };
+
+    // A distinct stack of a thread.
+    struct Stack {
+        pid_t tid;
+        uint32_t depth;
+        uintptr_t pcs[MAX_DEPTH];     // innermost frame first
+
+        bool operator == (const Stack& rhs) const {
+            return tid == rhs.tid && depth == rhs.depth
+                    && !memcmp(pcs, rhs.pcs, depth * sizeof(uintptr_t));
+        }
+    };
+
+    SamplingProfiler();
+    // Stops the profiler if it is running.
+    ~SamplingProfiler();
+
+    // Starts taking 'frequency' samples per second of CPU time used by the process.
+    // Samples are added to those already collected.  Returns INVALID_OPERATION if a
+    // profiler is already running in this process.
+    status_t start(int frequency = DEFAULT_FREQUENCY);
+
+    // Stops taking samples.  Samples already taken are kept until clear() is called.
+    void stop();
+
+    // Indicates whether this profiler is taking samples.
+    bool isRunning() const;
+
+    // Discards the samples taken so far.
+    void clear();
+
+    // Get the number of samples aggregated so far.
+    size_t getSampleCount() const;
+
+    // Get the number of samples lost because the ring was full.
+    size_t getDroppedCount() const;
+
+    // Copies the distinct stacks sampled so far, and how many times each was seen, in
+    // no particular order.  The program counters are left unsymbolized.
+    void getStacks(Vector<Stack>* outStacks, Vector<uint32_t>* outCounts) const;
+
+    // Print the report to the log using the supplied logtag.
+    void log(const char* logtag,
+             android_LogPriority priority = ANDROID_LOG_DEBUG,
+             const char* prefix = 0) const;
+
+    // Dump the report to the specified file descriptor.
+    void dump(int fd, int indent = 0, const char* prefix = 0) const;
+
+    // Return a string containing the report.
+    String8 toString(const char* prefix = 0) const;
+
+    // Print the report, one folded stack per line, to the specified printer.
+    void print(Printer& printer) const;
+
+private:
+    class DrainThread;
+    friend class DrainThread;
+
+    struct Sample {
+        volatile int32_t ready;
+        Stack stack;
+    };
+
+    SamplingProfiler(const SamplingProfiler&);
+    SamplingProfiler& operator = (const SamplingProfiler&);
+
+    static void signalHandler(int signal, siginfo_t* info, void* context);
+
+    // Called from the signal handler.
+    void record(siginfo_t* info, void* context);
+
+    // Moves samples from the ring into mStacks.
+    void drainLocked() const;
+
+    String8 frameNameLocked(const map_info_t* milist, uintptr_t pc) const;
+    symbol_table_t* symbolTableLocked(const char* mapName) const;
+
+    // Written by the signal handler, read by the drain thread.
+    Sample* mRing;
+    volatile int32_t mHead;
+    mutable volatile int32_t mTail;
+    volatile int32_t mDropped;
+    map_info_t* mMapInfoList;
+
+    sp<DrainThread> mDrainThread;
+
+    // Guards everything below, and draining the ring.
+    mutable Mutex mLock;
+    mutable FlatHashMap<Stack, uint32_t> mStacks;
+    mutable size_t mSampleCount;
+    // Symbolization caches, kept until the profiler is destroyed.
+    mutable KeyedVector<String8, symbol_table_t*> mSymbolTables;
+    mutable FlatHashMap<uintptr_t, String8> mFrameNames;
+};
+
+template<> inline hash_t hash_type(const SamplingProfiler::Stack& stack) {
+    uint32_t hash = JenkinsHashMix(0, uint32_t(stack.tid));
+    hash = JenkinsHashMixBytes(hash, reinterpret_cast<const uint8_t*>(stack.pcs),
+            stack.depth * sizeof(uintptr_t));
+    return JenkinsHashWhiten(hash);
+}
+
+}; // namespace android
+
+#endif // ANDROID_SAMPLING_PROFILER_H
@@ -51,6 +51,12 @@ public:
     const SortedVector<TYPE>&   operator = (const SortedVector<TYPE>& rhs) const;    
     SortedVector<TYPE>&         operator = (const SortedVector<TYPE>& rhs);    
 
+#if __cplusplus >= 201103L
+    /*! move constructor and operator: take over rhs's storage, leaving it empty */
+                            SortedVector(SortedVector<TYPE>&& rhs);
+    SortedVector<TYPE>&         operator = (SortedVector<TYPE>&& rhs);
+#endif
+
     /*
      * empty the vector
      */
@@ -156,6 +162,19 @@ SortedVector<TYPE>::SortedVector(const SortedVector<TYPE>& rhs)
     : SortedVectorImpl(rhs) {
 }
 
+#if __cplusplus >= 201103L
+template<class TYPE> inline
+SortedVector<TYPE>::SortedVector(SortedVector<TYPE>&& rhs)
+    : SortedVectorImpl(static_cast<SortedVectorImpl&&>(rhs)) {
+}
+
+template<class TYPE> inline
+SortedVector<TYPE>& SortedVector<TYPE>::operator = (SortedVector<TYPE>&& rhs) {
+    SortedVectorImpl::operator = (static_cast<SortedVectorImpl&&>(rhs));
+    return *this;
+}
+#endif
+
 template<class TYPE> inline
 SortedVector<TYPE>::~SortedVector() {
     finish_vector();
@@ -169,7 +188,7 @@ SortedVector<TYPE>& SortedVector<TYPE>::operator = (const SortedVector<TYPE>& rh
 
 template<class TYPE> inline
 const SortedVector<TYPE>& SortedVector<TYPE>::operator = (const SortedVector<TYPE>& rhs) const {
-    SortedVectorImpl::operator = (rhs);
+    const_cast<SortedVector<TYPE>*>(this)->SortedVectorImpl::operator = (rhs);
     return *this; 
 }
 
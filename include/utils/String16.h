@@ -52,6 +52,10 @@ public:
                                 String16();
     explicit                    String16(StaticLinkage);
                                 String16(const String16& o);
+#if __cplusplus >= 201103L
+    //! takes over o's buffer and leaves o empty
+    inline                      String16(String16&& o);
+#endif
                                 String16(const String16& o,
                                          size_t len,
                                          size_t begin=0);
@@ -79,6 +83,9 @@ public:
             status_t            append(const char16_t* other, size_t len);
             
     inline  String16&           operator=(const String16& other);
+#if __cplusplus >= 201103L
+    inline  String16&           operator=(String16&& other);
+#endif
     
     inline  String16&           operator+=(const String16& other);
     inline  String16            operator+(const String16& other) const;
@@ -119,6 +126,9 @@ public:
     inline                      operator const char16_t*() const;
     
 private:
+    // returns a new reference to the shared empty string
+    static  const char16_t*     emptyString();
+
             const char16_t*     mString;
 };
 
@@ -160,6 +170,24 @@ inline String16& String16::operator=(const String16& other)
     return *this;
 }
 
+#if __cplusplus >= 201103L
+inline String16::String16(String16&& o)
+    : mString(o.mString)
+{
+    o.mString = emptyString();
+}
+
+inline String16& String16::operator=(String16&& other)
+{
+    if (this != &other) {
+        SharedBuffer::bufferFromData(mString)->release();
+        mString = other.mString;
+        other.mString = emptyString();
+    }
+    return *this;
+}
+#endif
+
 inline String16& String16::operator+=(const String16& other)
 {
     append(other);
@@ -48,6 +48,10 @@ public:
                                 String8();
     explicit                    String8(StaticLinkage);
                                 String8(const String8& o);
+#if __cplusplus >= 201103L
+    //! takes over o's buffer and leaves o empty
+    inline                      String8(String8&& o);
+#endif
     explicit                    String8(const char* o);
     explicit                    String8(const char* o, size_t numChars);
     
@@ -97,6 +101,9 @@ public:
 
     inline  String8&            operator=(const String8& other);
     inline  String8&            operator=(const char* other);
+#if __cplusplus >= 201103L
+    inline  String8&            operator=(String8&& other);
+#endif
     
     inline  String8&            operator+=(const String8& other);
     inline  String8             operator+(const String8& other) const;
@@ -223,6 +230,9 @@ public:
     String8& convertToResPath();
 
 private:
+    // returns a new reference to the shared empty string
+    static  const char*         emptyString();
+
             status_t            real_append(const char* other, size_t numChars);
             char*               find_extension(void) const;
 
@@ -292,6 +302,24 @@ inline String8& String8::operator=(const char* other)
     return *this;
 }
 
+#if __cplusplus >= 201103L
+inline String8::String8(String8&& o)
+    : mString(o.mString)
+{
+    o.mString = emptyString();
+}
+
+inline String8& String8::operator=(String8&& other)
+{
+    if (this != &other) {
+        SharedBuffer::bufferFromData(mString)->release();
+        mString = other.mString;
+        other.mString = emptyString();
+    }
+    return *this;
+}
+#endif
+
 inline String8& String8::operator+=(const String8& other)
 {
     append(other);
@@ -103,6 +103,13 @@ public:
      */
     String8 nextToken(const char* delimiters);
 
+    /**
+     * Like nextToken() but does not copy the token: returns a pointer to its first character
+     * in the tokenizer's buffer and sets outLength to its length.  The token is not
+     * null-terminated.  The pointer remains valid until the tokenizer is deleted.
+     */
+    const char* nextTokenView(const char* delimiters, size_t* outLength);
+
     /**
      * Advances to the next line.
      * Does nothing if already at the end of the file.
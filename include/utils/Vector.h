@@ -58,6 +58,12 @@ public:
             const Vector<TYPE>&     operator = (const Vector<TYPE>& rhs) const;
             Vector<TYPE>&           operator = (const Vector<TYPE>& rhs);    
 
+#if __cplusplus >= 201103L
+    /*! move constructor and operator: take over rhs's storage, leaving it empty */
+                            Vector(Vector<TYPE>&& rhs);
+            Vector<TYPE>&           operator = (Vector<TYPE>&& rhs);
+#endif
+
             const Vector<TYPE>&     operator = (const SortedVector<TYPE>& rhs) const;
             Vector<TYPE>&           operator = (const SortedVector<TYPE>& rhs);
 
@@ -155,6 +161,16 @@ public:
     //! replace an item with a new one
             ssize_t         replaceAt(const TYPE& item, size_t index);
 
+#if __cplusplus >= 201103L
+    //! insert an item constructed in place from args, which must not refer
+    //! to items of this vector. returns its index (or an error)
+    template<typename... Args>
+            ssize_t         emplaceAt(size_t index, Args&&... args);
+    //! same as emplaceAt() at the end of the vector
+    template<typename... Args>
+            ssize_t         emplace(Args&&... args);
+#endif
+
     /*!
      * remove items
      */
@@ -235,6 +251,19 @@ Vector<TYPE>::Vector(const SortedVector<TYPE>& rhs)
     : VectorImpl(static_cast<const VectorImpl&>(rhs)) {
 }
 
+#if __cplusplus >= 201103L
+template<class TYPE> inline
+Vector<TYPE>::Vector(Vector<TYPE>&& rhs)
+    : VectorImpl(static_cast<VectorImpl&&>(rhs)) {
+}
+
+template<class TYPE> inline
+Vector<TYPE>& Vector<TYPE>::operator = (Vector<TYPE>&& rhs) {
+    VectorImpl::operator = (static_cast<VectorImpl&&>(rhs));
+    return *this;
+}
+#endif
+
 template<class TYPE> inline
 Vector<TYPE>::~Vector() {
     finish_vector();
@@ -248,7 +277,8 @@ Vector<TYPE>& Vector<TYPE>::operator = (const Vector<TYPE>& rhs) {
 
 template<class TYPE> inline
 const Vector<TYPE>& Vector<TYPE>::operator = (const Vector<TYPE>& rhs) const {
-    VectorImpl::operator = (static_cast<const VectorImpl&>(rhs));
+    const_cast<Vector<TYPE>*>(this)->VectorImpl::operator = (
+            static_cast<const VectorImpl&>(rhs));
     return *this;
 }
 
@@ -260,7 +290,8 @@ Vector<TYPE>& Vector<TYPE>::operator = (const SortedVector<TYPE>& rhs) {
 
 template<class TYPE> inline
 const Vector<TYPE>& Vector<TYPE>::operator = (const SortedVector<TYPE>& rhs) const {
-    VectorImpl::operator = (rhs);
+    const_cast<Vector<TYPE>*>(this)->VectorImpl::operator = (
+            static_cast<const VectorImpl&>(rhs));
     return *this; 
 }
 
@@ -343,6 +374,26 @@ ssize_t Vector<TYPE>::replaceAt(const TYPE& item, size_t index) {
     return VectorImpl::replaceAt(&item, index);
 }
 
+#if __cplusplus >= 201103L
+template<class TYPE> template<typename... Args>
+ssize_t Vector<TYPE>::emplaceAt(size_t index, Args&&... args) {
+    if (index > size()) {
+        return BAD_INDEX;
+    }
+    void* where = insertUninitializedAt(index);
+    if (!where) {
+        return NO_MEMORY;
+    }
+    new(where) TYPE(static_cast<Args&&>(args)...);
+    return index;
+}
+
+template<class TYPE> template<typename... Args> inline
+ssize_t Vector<TYPE>::emplace(Args&&... args) {
+    return emplaceAt(size(), static_cast<Args&&>(args)...);
+}
+#endif
+
 template<class TYPE> inline
 ssize_t Vector<TYPE>::insertAt(size_t index, size_t numItems) {
     return VectorImpl::insertAt(index, numItems);
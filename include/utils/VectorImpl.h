@@ -54,6 +54,26 @@ public:
             void            finish_vector();
 
             VectorImpl&     operator = (const VectorImpl& rhs);    
+
+#if __cplusplus >= 201103L
+    /*! move: takes over rhs's storage and leaves rhs empty */
+    inline                  VectorImpl(VectorImpl&& rhs)
+        :   mStorage(rhs.mStorage), mCount(rhs.mCount),
+            mFlags(rhs.mFlags), mItemSize(rhs.mItemSize) {
+        rhs.mStorage = 0;
+        rhs.mCount = 0;
+    }
+    inline  VectorImpl&     operator = (VectorImpl&& rhs) {
+        if (this != &rhs) {
+            release_storage();
+            mStorage = rhs.mStorage;
+            mCount = rhs.mCount;
+            rhs.mStorage = 0;
+            rhs.mCount = 0;
+        }
+        return *this;
+    }
+#endif
             
     /*! C-style array access */
     inline  const void*     arrayImpl() const       { return mStorage; }
@@ -99,6 +119,10 @@ protected:
             size_t          itemSize() const;
             void            release_storage();
 
+            /*! makes room for numItems at index without constructing them.
+             * returns their location, or NULL on error. */
+            void*           insertUninitializedAt(size_t index, size_t numItems = 1);
+
     virtual void            do_construct(void* storage, size_t num) const = 0;
     virtual void            do_destroy(void* storage, size_t num) const = 0;
     virtual void            do_copy(void* dest, const void* from, size_t num) const = 0;
@@ -137,6 +161,16 @@ public:
     
     SortedVectorImpl&     operator = (const SortedVectorImpl& rhs);    
 
+#if __cplusplus >= 201103L
+                            SortedVectorImpl(const SortedVectorImpl& rhs) = default;
+    inline                  SortedVectorImpl(SortedVectorImpl&& rhs)
+        : VectorImpl(static_cast<VectorImpl&&>(rhs)) { }
+    inline SortedVectorImpl& operator = (SortedVectorImpl&& rhs) {
+        VectorImpl::operator = (static_cast<VectorImpl&&>(rhs));
+        return *this;
+    }
+#endif
+
     //! finds the index of an item
             ssize_t         indexOf(const void* item) const;
 
@@ -47,6 +47,19 @@ char* get_zipentry_name(zipentry_t entry);
 // by get_zipentry_size.  Returns nonzero on failure.
 int decompress_zipentry(zipentry_t entry, void* buf, int bufsize);
 
+// Receives the decompressed data of an entry, one chunk at a time and in
+// order.  Returns nonzero to abort the decompression.
+typedef int (*zipentry_writer_t)(void* cookie, const void* data, size_t size);
+
+// Decompress the entry without holding all of it in memory, passing each
+// chunk to writer.  Returns nonzero on failure or if writer failed.
+int decompress_zipentry_stream(zipentry_t entry, zipentry_writer_t writer,
+        void* cookie);
+
+// Decompress the entry to the file descriptor, from its current offset.
+// Returns nonzero on failure.
+int decompress_zipentry_fd(zipentry_t entry, int fd);
+
 // iterate through the entries in the zip file.  pass a pointer to
 // a void* initialized to NULL to start.  Returns NULL when done
 zipentry_t iterate_zipfile(zipfile_t file, void** cookie);
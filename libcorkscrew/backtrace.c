@@ -233,6 +233,17 @@ ssize_t unwind_backtrace_thread(pid_t tid, backtrace_frame_t* backtrace,
 #endif
 }
 
+ssize_t unwind_backtrace_signal(siginfo_t* siginfo, void* sigcontext,
+        const map_info_t* map_info_list,
+        backtrace_frame_t* backtrace, size_t ignore_depth, size_t max_depth) {
+#ifdef CORKSCREW_HAVE_ARCH
+    return unwind_backtrace_signal_arch(siginfo, sigcontext, map_info_list,
+            backtrace, ignore_depth, max_depth);
+#else
+    return -1;
+#endif
+}
+
 ssize_t unwind_backtrace_ptrace(pid_t tid, const ptrace_context_t* context,
         backtrace_frame_t* backtrace, size_t ignore_depth, size_t max_depth) {
 #ifdef CORKSCREW_HAVE_ARCH
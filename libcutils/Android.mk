@@ -118,7 +118,11 @@ LOCAL_SRC_FILES := $(commonSources) \
         uevent.c
 
 ifeq ($(TARGET_ARCH),arm)
-    LOCAL_SRC_FILES += arch-arm/memset32.S
+    ifeq ($(ARCH_ARM_HAVE_NEON),true)
+        LOCAL_SRC_FILES += memory.c
+    else
+        LOCAL_SRC_FILES += arch-arm/memset32.S
+    endif
 else  # !arm
     ifeq ($(TARGET_ARCH),x86)
         LOCAL_CFLAGS += -DHAVE_MEMSET16 -DHAVE_MEMSET32
@@ -16,12 +16,178 @@
 
 #include <cutils/memory.h>
 
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <immintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#if !HAVE_MEMSET16 || !HAVE_MEMSET32
+
+/* Fills at least this large bypass the caches with non-temporal stores */
+#define NON_TEMPORAL_THRESHOLD (512 * 1024)
+
+#if defined(__x86_64__)
+
+static void fill32_sse2(uint32_t* dst, uint32_t value, size_t count)
+{
+    while (count && ((uintptr_t)dst & 15)) {
+        *dst++ = value;
+        count--;
+    }
+
+    __m128i v = _mm_set1_epi32(value);
+    if (count * 4 >= NON_TEMPORAL_THRESHOLD) {
+        for (; count >= 16; count -= 16, dst += 16) {
+            _mm_stream_si128((__m128i*)dst, v);
+            _mm_stream_si128((__m128i*)(dst + 4), v);
+            _mm_stream_si128((__m128i*)(dst + 8), v);
+            _mm_stream_si128((__m128i*)(dst + 12), v);
+        }
+        _mm_sfence();
+    } else {
+        for (; count >= 16; count -= 16, dst += 16) {
+            _mm_store_si128((__m128i*)dst, v);
+            _mm_store_si128((__m128i*)(dst + 4), v);
+            _mm_store_si128((__m128i*)(dst + 8), v);
+            _mm_store_si128((__m128i*)(dst + 12), v);
+        }
+    }
+    for (; count >= 4; count -= 4, dst += 4) {
+        _mm_store_si128((__m128i*)dst, v);
+    }
+
+    while (count--) {
+        *dst++ = value;
+    }
+}
+
+__attribute__((target("avx2")))
+static void fill32_avx2(uint32_t* dst, uint32_t value, size_t count)
+{
+    while (count && ((uintptr_t)dst & 31)) {
+        *dst++ = value;
+        count--;
+    }
+
+    __m256i v = _mm256_set1_epi32(value);
+    if (count * 4 >= NON_TEMPORAL_THRESHOLD) {
+        for (; count >= 32; count -= 32, dst += 32) {
+            _mm256_stream_si256((__m256i*)dst, v);
+            _mm256_stream_si256((__m256i*)(dst + 8), v);
+            _mm256_stream_si256((__m256i*)(dst + 16), v);
+            _mm256_stream_si256((__m256i*)(dst + 24), v);
+        }
+        _mm_sfence();
+    } else {
+        for (; count >= 32; count -= 32, dst += 32) {
+            _mm256_store_si256((__m256i*)dst, v);
+            _mm256_store_si256((__m256i*)(dst + 8), v);
+            _mm256_store_si256((__m256i*)(dst + 16), v);
+            _mm256_store_si256((__m256i*)(dst + 24), v);
+        }
+    }
+    for (; count >= 8; count -= 8, dst += 8) {
+        _mm256_store_si256((__m256i*)dst, v);
+    }
+
+    while (count--) {
+        *dst++ = value;
+    }
+}
+
+static int cpu_has_avx2(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+    /* The OS must save the YMM registers (OSXSAVE, then XCR0 bits 1-2) */
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) {
+        return 0;
+    }
+    unsigned int xcr0_lo, xcr0_hi;
+    __asm__ ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+    if ((xcr0_lo & 6) != 6) {
+        return 0;
+    }
+    if (__get_cpuid_max(0, NULL) < 7) {
+        return 0;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & bit_AVX2) != 0;
+}
+
+typedef void (*fill32_func)(uint32_t* dst, uint32_t value, size_t count);
+
+static fill32_func fill32_impl;
+
+static void fill32(uint32_t* dst, uint32_t value, size_t count)
+{
+    /* Racing first calls all pick the same function, so no lock is needed */
+    fill32_func impl = fill32_impl;
+    if (impl == NULL) {
+        impl = cpu_has_avx2() ? fill32_avx2 : fill32_sse2;
+        fill32_impl = impl;
+    }
+    impl(dst, value, count);
+}
+
+#elif defined(__ARM_NEON__)
+
+/* ARMv7 NEON has no non-temporal stores, so every size takes the same path */
+static void fill32(uint32_t* dst, uint32_t value, size_t count)
+{
+    while (count && ((uintptr_t)dst & 15)) {
+        *dst++ = value;
+        count--;
+    }
+
+    uint32x4_t v = vdupq_n_u32(value);
+    for (; count >= 16; count -= 16, dst += 16) {
+        vst1q_u32(dst, v);
+        vst1q_u32(dst + 4, v);
+        vst1q_u32(dst + 8, v);
+        vst1q_u32(dst + 12, v);
+    }
+    for (; count >= 4; count -= 4, dst += 4) {
+        vst1q_u32(dst, v);
+    }
+
+    while (count--) {
+        *dst++ = value;
+    }
+}
+
+#else
+
+static void fill32(uint32_t* dst, uint32_t value, size_t count)
+{
+    while (count--) {
+        *dst++ = value;
+    }
+}
+
+#endif
+
+#endif // !HAVE_MEMSET16 || !HAVE_MEMSET32
+
 #if !HAVE_MEMSET16
 void android_memset16(uint16_t* dst, uint16_t value, size_t size)
 {
     size >>= 1;
-    while (size--) {
+
+    /* Align to 32 bits and fill pairs of values with the 32-bit kernel */
+    if (size && ((uintptr_t)dst & 2)) {
         *dst++ = value;
+        size--;
+    }
+    fill32((uint32_t*)dst, ((uint32_t)value << 16) | value, size >> 1);
+    if (size & 1) {
+        dst[size - 1] = value;
     }
 }
 #endif
@@ -29,10 +195,7 @@ void android_memset16(uint16_t* dst, uint16_t value, size_t size)
 #if !HAVE_MEMSET32
 void android_memset32(uint32_t* dst, uint32_t value, size_t size)
 {
-    size >>= 2;
-    while (size--) {
-        *dst++ = value;
-    }
+    fill32(dst, value, size >> 2);
 }
 #endif
 
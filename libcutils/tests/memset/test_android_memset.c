@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks android_memset16/android_memset32 against a scalar reference for
+ * every alignment and a range of sizes, then reports fill throughput.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <cutils/memory.h>
+
+#define GUARD 64
+#define MAX_CHECK_BYTES 4096
+#define GUARD_BYTE 0xa5
+
+/* memory.c switches to non-temporal stores at this size on x86-64 */
+#define NON_TEMPORAL_THRESHOLD (512 * 1024)
+#define MAX_LARGE_CHECK_BYTES (2 * NON_TEMPORAL_THRESHOLD + 256)
+
+static uint8_t* arena;
+
+static int failures;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* offset and size are in bytes; the fill must cover exactly that range */
+static void check_one(int width, size_t offset, size_t size)
+{
+    /* only the filled range and its guards are checked, so large sizes stay cheap */
+    const size_t length = GUARD + offset + size + GUARD;
+    uint8_t* dst = arena + GUARD + offset;
+    size_t i;
+
+    memset(arena, GUARD_BYTE, length);
+    if (width == 16) {
+        android_memset16((uint16_t*)dst, 0x1234, size);
+    } else {
+        android_memset32((uint32_t*)dst, 0x12345678, size);
+    }
+
+    for (i = 0; i < length; i++) {
+        uint8_t* p = arena + i;
+        uint8_t expected = GUARD_BYTE;
+        if (p >= dst && p < dst + size) {
+            size_t k = p - dst;
+            if (width == 16) {
+                uint16_t v = 0x1234;
+                expected = ((uint8_t*)&v)[k & 1];
+            } else {
+                uint32_t v = 0x12345678;
+                expected = ((uint8_t*)&v)[k & 3];
+            }
+        }
+        if (*p != expected) {
+            fprintf(stderr, "memset%d offset=%zu size=%zu: byte %zd is 0x%02x, expected 0x%02x\n",
+                    width, offset, size, (ssize_t)(p - dst), *p, expected);
+            failures++;
+            return;
+        }
+    }
+}
+
+static void check_all(int width)
+{
+    size_t unit = width / 8;
+    size_t offset, count;
+
+    for (offset = 0; offset < 64; offset += unit) {
+        for (count = 0; count * unit + offset <= MAX_CHECK_BYTES; count += (count < 128) ? 1 : 61) {
+            check_one(width, offset, count * unit);
+        }
+    }
+}
+
+/*
+ * Sizes on both sides of the non-temporal threshold, from starts that need
+ * an alignment prologue and with tails shorter than one vector. An
+ * unaligned start shifts the threshold crossing by its prologue, so each
+ * size is also tried a few elements larger.
+ */
+static void check_large(int width)
+{
+    static const size_t offsets[] = { 0, 4, 12, 28, 60 };
+    static const size_t sizes[] = {
+        NON_TEMPORAL_THRESHOLD - 64,
+        NON_TEMPORAL_THRESHOLD,
+        NON_TEMPORAL_THRESHOLD + 64,
+        2 * NON_TEMPORAL_THRESHOLD,
+    };
+    static const size_t tails[] = { 0, 1, 3, 7, 13, 31 };
+    size_t unit = width / 8;
+    size_t o, s, t;
+
+    for (o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++) {
+        /* memset16 also gets starts that are only 16-bit aligned */
+        size_t offset = offsets[o] + (width == 16 ? 2 : 0);
+        for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            for (t = 0; t < sizeof(tails) / sizeof(tails[0]); t++) {
+                check_one(width, offset, sizes[s] + tails[t] * unit);
+            }
+        }
+    }
+}
+
+static void bench(int width, size_t size, int iterations)
+{
+    void* buf;
+    int64_t start, elapsed;
+    int i;
+
+    if (posix_memalign(&buf, 64, size)) {
+        return;
+    }
+    memset(buf, 0, size);
+
+    start = now_ns();
+    for (i = 0; i < iterations; i++) {
+        if (width == 16) {
+            android_memset16((uint16_t*)buf, (uint16_t)i, size);
+        } else {
+            android_memset32((uint32_t*)buf, (uint32_t)i, size);
+        }
+    }
+    elapsed = now_ns() - start;
+
+    printf("memset%d %8zu bytes: %8.1f MB/s\n", width, size,
+           (double)size * iterations / (elapsed / 1e9) / (1024 * 1024));
+    free(buf);
+}
+
+int main(void)
+{
+    static const size_t sizes[] = { 64, 1024, 16 * 1024, 256 * 1024, 4 * 1024 * 1024 };
+    size_t i;
+
+    if (posix_memalign((void**)&arena, 64, GUARD + 64 + MAX_LARGE_CHECK_BYTES + GUARD)) {
+        printf("FAILED: out of memory\n");
+        return 1;
+    }
+    check_all(16);
+    check_all(32);
+    check_large(16);
+    check_large(32);
+    free(arena);
+    if (failures) {
+        printf("FAILED: %d mismatches\n", failures);
+        return 1;
+    }
+    printf("correctness: PASSED\n");
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        int iterations = (int)((256 * 1024 * 1024) / sizes[i]);
+        bench(16, sizes[i], iterations);
+        bench(32, sizes[i], iterations);
+    }
+    return 0;
+}
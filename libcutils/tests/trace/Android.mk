@@ -0,0 +1,13 @@
+# Copyright 2013 The Android Open Source Project
+
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= test_atrace_buffer.c
+
+LOCAL_MODULE:= test_atrace_buffer
+
+LOCAL_STATIC_LIBRARIES := libcutils liblog libc
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Records events from several threads into an ATRACE_BUFFER_FILE trace and
+ * checks that reading the file back gives the same events, then compares the
+ * cost per event of buffering against formatting and writing each message.
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/trace.h>
+
+#define THREADS 4
+#define EVENTS_PER_THREAD 10000
+#define MAX_NAMES 64
+
+static const char* trace_path = "/data/local/tmp/test_atrace_buffer.trace";
+static int failures;
+
+// Lets the recording threads stay alive until atrace_buffer_stop() returns.
+static pthread_mutex_t stop_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stop_cond = PTHREAD_COND_INITIALIZER;
+static bool wait_for_stop;
+static int threads_done;
+static bool stopped;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void* record_thread(void* arg)
+{
+    int index = (int)(intptr_t)arg;
+    char name[32];
+    int i;
+
+    for (i = 0; i < EVENTS_PER_THREAD; i++) {
+        // Reuse the same buffer for several names.
+        snprintf(name, sizeof(name), "thread%d-%d", index, i % 4);
+        atrace_buffer_record('B', name, 0);
+        atrace_buffer_record('C', "counter", i);
+        atrace_buffer_record('E', NULL, 0);
+    }
+
+    pthread_mutex_lock(&stop_mutex);
+    threads_done++;
+    pthread_cond_broadcast(&stop_cond);
+    while (wait_for_stop && !stopped) {
+        pthread_cond_wait(&stop_cond, &stop_mutex);
+    }
+    pthread_mutex_unlock(&stop_mutex);
+    return NULL;
+}
+
+static void check_file(void)
+{
+    char* names[MAX_NAMES] = { NULL };
+    int events[THREADS] = { 0 };
+    int fd = open(trace_path, O_RDONLY);
+    struct atrace_buffer_header header;
+    uint64_t last_timestamp[THREADS] = { 0 };
+    pid_t tids[THREADS] = { 0 };
+    uint32_t i;
+    int t;
+
+    if (fd < 0) {
+        perror(trace_path);
+        failures++;
+        return;
+    }
+
+    while (read(fd, &header, sizeof(header)) == sizeof(header)) {
+        if (header.magic != ATRACE_BUFFER_MAGIC || header.version != ATRACE_BUFFER_VERSION) {
+            fprintf(stderr, "bad batch header\n");
+            failures++;
+            break;
+        }
+        for (i = 0; i < header.string_count; i++) {
+            uint32_t id_length[2];
+            char* name;
+            read(fd, id_length, sizeof(id_length));
+            name = calloc(1, (id_length[1] + 4) & ~3);
+            read(fd, name, (id_length[1] + 3) & ~3);
+            if (id_length[0] < MAX_NAMES) {
+                names[id_length[0]] = name;
+            } else {
+                free(name);
+            }
+        }
+        for (i = 0; i < header.event_count; i++) {
+            struct atrace_buffer_event event;
+            const char* name;
+            read(fd, &event, sizeof(event));
+            name = event.name_id < MAX_NAMES ? names[event.name_id] : NULL;
+            if (event.name_id != 0 && name == NULL) {
+                fprintf(stderr, "event uses name %u before it is defined\n", event.name_id);
+                failures++;
+                goto out;
+            }
+            if (event.type == 'B') {
+                if (sscanf(name, "thread%d-", &t) != 1 || t < 0 || t >= THREADS) {
+                    fprintf(stderr, "unexpected name %s\n", name);
+                    failures++;
+                    goto out;
+                }
+                if (tids[t] == 0) {
+                    tids[t] = header.tid;
+                } else if (tids[t] != (pid_t)header.tid) {
+                    fprintf(stderr, "events of thread %d come from two tids\n", t);
+                    failures++;
+                }
+                if (event.timestamp < last_timestamp[t]) {
+                    fprintf(stderr, "timestamps of thread %d go backwards\n", t);
+                    failures++;
+                }
+                last_timestamp[t] = event.timestamp;
+                events[t]++;
+            }
+        }
+    }
+
+    for (t = 0; t < THREADS; t++) {
+        if (events[t] != EVENTS_PER_THREAD) {
+            fprintf(stderr, "thread %d: read %d begin events, expected %d\n",
+                    t, events[t], EVENTS_PER_THREAD);
+            failures++;
+        }
+    }
+out:
+    for (i = 0; i < MAX_NAMES; i++) {
+        free(names[i]);
+    }
+    close(fd);
+}
+
+/*
+ * With stop_first, the threads are still running when the trace stops, so
+ * their events only reach the file if atrace_buffer_stop() flushes them.
+ */
+static void check_round_trip(bool stop_first)
+{
+    pthread_t threads[THREADS];
+    int t;
+
+    wait_for_stop = stop_first;
+    threads_done = 0;
+    stopped = false;
+    if (atrace_buffer_start(ATRACE_BUFFER_FILE, trace_path) != 0) {
+        fprintf(stderr, "could not start buffering to %s\n", trace_path);
+        failures++;
+        return;
+    }
+    for (t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, record_thread, (void*)(intptr_t)t);
+    }
+    if (stop_first) {
+        pthread_mutex_lock(&stop_mutex);
+        while (threads_done < THREADS) {
+            pthread_cond_wait(&stop_cond, &stop_mutex);
+        }
+        pthread_mutex_unlock(&stop_mutex);
+        atrace_buffer_stop();
+        pthread_mutex_lock(&stop_mutex);
+        stopped = true;
+        pthread_cond_broadcast(&stop_cond);
+        pthread_mutex_unlock(&stop_mutex);
+    }
+    // Otherwise, exiting threads flush their buffers.
+    for (t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    if (!stop_first) {
+        atrace_buffer_stop();
+    }
+    check_file();
+    unlink(trace_path);
+}
+
+static void bench(void)
+{
+    const int iterations = 200000;
+    char buf[ATRACE_MESSAGE_LENGTH];
+    int64_t start, elapsed;
+    int fd, i;
+
+    // Unbuffered, as atrace_begin/atrace_end do it.  /dev/null stands in for
+    // trace_marker, which is usually slower.
+    fd = open("/dev/null", O_WRONLY);
+    start = now_ns();
+    for (i = 0; i < iterations; i++) {
+        size_t len = snprintf(buf, sizeof(buf), "B|%d|%s", getpid(), "bench");
+        write(fd, buf, len);
+        write(fd, "E", 1);
+    }
+    elapsed = now_ns() - start;
+    close(fd);
+    printf("snprintf + write:   %6.1f ns/event\n", (double)elapsed / (2.0 * iterations));
+
+    atrace_buffer_start(ATRACE_BUFFER_FILE, "/dev/null");
+    start = now_ns();
+    for (i = 0; i < iterations; i++) {
+        atrace_buffer_record('B', "bench", 0);
+        atrace_buffer_record('E', NULL, 0);
+    }
+    atrace_buffer_flush();
+    elapsed = now_ns() - start;
+    atrace_buffer_stop();
+    printf("buffered (file):    %6.1f ns/event\n", (double)elapsed / (2.0 * iterations));
+
+    if (atrace_is_tag_enabled(ATRACE_TAG_ALWAYS)) {
+        atrace_buffer_start(ATRACE_BUFFER_FILE, "/dev/null");
+        start = now_ns();
+        for (i = 0; i < iterations; i++) {
+            atrace_begin(ATRACE_TAG_ALWAYS, "bench");
+            atrace_end(ATRACE_TAG_ALWAYS);
+        }
+        atrace_buffer_flush();
+        elapsed = now_ns() - start;
+        atrace_buffer_stop();
+        printf("atrace_begin/end:   %6.1f ns/event (buffered)\n",
+                (double)elapsed / (2.0 * iterations));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) {
+        trace_path = argv[1];
+    }
+
+    check_round_trip(false);
+    check_round_trip(true);
+    if (failures) {
+        printf("FAILED: %d errors\n", failures);
+        return 1;
+    }
+    printf("round trip: PASSED\n");
+
+    bench();
+    return 0;
+}
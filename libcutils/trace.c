@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <time.h>
 #include <cutils/atomic.h>
 #include <cutils/compiler.h>
 #include <cutils/properties.h>
@@ -184,3 +185,465 @@ void atrace_setup()
 {
     pthread_once(&atrace_once_control, atrace_init_once);
 }
+
+/*
+ * Per-thread event buffers.
+ *
+ * Names are interned into a process-wide table so that an event only stores a
+ * 32-bit id.  Each thread keeps a small direct-mapped cache from name pointers
+ * to interned names, so the table lock is only taken the first time a thread
+ * sees a name.  Interned names are never freed, which keeps the pointers held
+ * by the caches valid.
+ *
+ * Every buffer is also linked into a process-wide list, so that
+ * atrace_buffer_stop() can flush the events other threads still hold.  The
+ * owning thread records under the buffer's own lock, which is uncontended
+ * except while a stop is flushing it.
+ */
+
+#define ATRACE_NAME_CACHE_SIZE  64      // must be a power of 2
+
+struct atrace_name_cache_entry {
+    const char* key;
+    const char* name;
+    uint32_t id;
+};
+
+struct atrace_thread_buffer {
+    pthread_mutex_t lock;
+    struct atrace_thread_buffer* prev;
+    struct atrace_thread_buffer* next;
+    pid_t tid;
+    int32_t session;
+    uint32_t count;
+    struct atrace_name_cache_entry cache[ATRACE_NAME_CACHE_SIZE];
+    struct atrace_buffer_event events[ATRACE_BUFFER_EVENTS];
+};
+
+volatile int32_t        atrace_buffer_mode    = ATRACE_BUFFER_OFF;
+static volatile int32_t atrace_buffer_session = 0;
+static int              atrace_buffer_fd      = -1;
+static pthread_key_t    atrace_buffer_key;
+static pthread_once_t   atrace_buffer_once    = PTHREAD_ONCE_INIT;
+static bool             atrace_buffer_has_key = false;
+
+// Guards the list of thread buffers.  Taken before any buffer's lock.
+static pthread_mutex_t  atrace_buffers_mutex  = PTHREAD_MUTEX_INITIALIZER;
+static struct atrace_thread_buffer* atrace_buffers = NULL;
+
+// Guards the output file and the number of names written to it.
+static pthread_mutex_t  atrace_buffer_mutex   = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t         atrace_names_written  = 0;
+
+// Guards the interned name table.
+static pthread_mutex_t  atrace_names_mutex    = PTHREAD_MUTEX_INITIALIZER;
+static char**           atrace_names          = NULL;
+static uint32_t         atrace_name_count     = 0;
+static uint32_t         atrace_name_capacity  = 0;
+static uint32_t*        atrace_name_slots     = NULL;   // open addressing, 0 is empty
+static uint32_t         atrace_name_slot_count = 0;
+
+static uint32_t atrace_hash_name(const char* name)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash = (hash ^ (uint8_t)*name++) * 16777619u;
+    }
+    return hash;
+}
+
+// Grows the slot table to twice its size.  Called with atrace_names_mutex held.
+static bool atrace_grow_name_slots()
+{
+    uint32_t slot_count = atrace_name_slot_count ? atrace_name_slot_count * 2 : 256;
+    uint32_t* slots = calloc(slot_count, sizeof(uint32_t));
+    uint32_t id;
+
+    if (slots == NULL) {
+        return false;
+    }
+    for (id = 1; id < atrace_name_count; id++) {
+        uint32_t i = atrace_hash_name(atrace_names[id]) & (slot_count - 1);
+        while (slots[i] != 0) {
+            i = (i + 1) & (slot_count - 1);
+        }
+        slots[i] = id;
+    }
+    free(atrace_name_slots);
+    atrace_name_slots = slots;
+    atrace_name_slot_count = slot_count;
+    return true;
+}
+
+// Returns the interned copy of name and stores its id, or returns NULL if out
+// of memory.
+static const char* atrace_intern_name(const char* name, uint32_t* out_id)
+{
+    const char* result = NULL;
+    uint32_t hash = atrace_hash_name(name);
+    uint32_t i;
+
+    pthread_mutex_lock(&atrace_names_mutex);
+    if (atrace_name_count == 0) {
+        // Reserve id 0 for events without a name.
+        atrace_names = malloc(64 * sizeof(char*));
+        if (atrace_names == NULL || !atrace_grow_name_slots()) {
+            goto done;
+        }
+        atrace_names[0] = "";
+        atrace_name_capacity = 64;
+        atrace_name_count = 1;
+    }
+
+    for (i = hash & (atrace_name_slot_count - 1); atrace_name_slots[i] != 0;
+            i = (i + 1) & (atrace_name_slot_count - 1)) {
+        uint32_t id = atrace_name_slots[i];
+        if (strcmp(atrace_names[id], name) == 0) {
+            *out_id = id;
+            result = atrace_names[id];
+            goto done;
+        }
+    }
+
+    if (atrace_name_count == atrace_name_capacity) {
+        char** names = realloc(atrace_names, atrace_name_capacity * 2 * sizeof(char*));
+        if (names == NULL) {
+            goto done;
+        }
+        atrace_names = names;
+        atrace_name_capacity *= 2;
+    }
+    atrace_names[atrace_name_count] = strdup(name);
+    if (atrace_names[atrace_name_count] == NULL) {
+        goto done;
+    }
+    atrace_name_slots[i] = atrace_name_count;
+    *out_id = atrace_name_count;
+    result = atrace_names[atrace_name_count];
+    atrace_name_count++;
+    if (atrace_name_count * 4 > atrace_name_slot_count * 3) {
+        atrace_grow_name_slots();
+    }
+
+done:
+    pthread_mutex_unlock(&atrace_names_mutex);
+    return result;
+}
+
+static inline uint32_t atrace_lookup_name(struct atrace_thread_buffer* buffer,
+        const char* name)
+{
+    struct atrace_name_cache_entry* entry;
+
+    if (name == NULL) {
+        return 0;
+    }
+    entry = &buffer->cache[((uintptr_t)name >> 3) & (ATRACE_NAME_CACHE_SIZE - 1)];
+    // The pointer alone isn't enough, callers may reuse a buffer for a
+    // different name.
+    if (CC_UNLIKELY(entry->key != name || strcmp(entry->name, name) != 0)) {
+        uint32_t id;
+        const char* interned = atrace_intern_name(name, &id);
+        if (interned == NULL) {
+            return 0;
+        }
+        entry->key = name;
+        entry->name = interned;
+        entry->id = id;
+    }
+    return entry->id;
+}
+
+static void atrace_flush_to_marker(struct atrace_thread_buffer* buffer)
+{
+    char buf[ATRACE_MESSAGE_LENGTH];
+    pid_t pid = getpid();
+    uint32_t i;
+    int len;
+
+    for (i = 0; i < buffer->count; i++) {
+        const struct atrace_buffer_event* event = &buffer->events[i];
+        const char* name;
+
+        // Interned names never move, but the table holding them can.
+        pthread_mutex_lock(&atrace_names_mutex);
+        name = atrace_names[event->name_id];
+        pthread_mutex_unlock(&atrace_names_mutex);
+
+        switch (event->type) {
+        case 'B':
+            len = snprintf(buf, sizeof(buf), "B|%d|%s", pid, name);
+            break;
+        case 'E':
+            buf[0] = 'E';
+            len = 1;
+            break;
+        case 'S':
+        case 'F':
+            len = snprintf(buf, sizeof(buf), "%c|%d|%s|%d", event->type, pid, name,
+                    (int32_t)event->value);
+            break;
+        default:
+            len = snprintf(buf, sizeof(buf), "C|%d|%s|%lld", pid, name,
+                    (long long)event->value);
+            break;
+        }
+        if (len >= (int)sizeof(buf)) {
+            len = sizeof(buf) - 1;
+        }
+        write(atrace_marker_fd, buf, len);
+    }
+}
+
+// Writes all of buf, retrying on short writes.
+static bool atrace_write_fully(int fd, const void* buf, size_t size)
+{
+    const uint8_t* p = buf;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static void atrace_flush_to_file(struct atrace_thread_buffer* buffer)
+{
+    struct atrace_buffer_header header;
+    uint8_t* strings = NULL;
+    size_t strings_size = 0;
+    uint32_t first_id, name_count, id;
+    bool ok;
+
+    pthread_mutex_lock(&atrace_buffer_mutex);
+    if (atrace_buffer_fd < 0 || buffer->session != atrace_buffer_session) {
+        pthread_mutex_unlock(&atrace_buffer_mutex);
+        return;
+    }
+
+    // Emit every name interned since the last batch, so that readers see each
+    // name before any event that uses it.
+    pthread_mutex_lock(&atrace_names_mutex);
+    first_id = atrace_names_written ? atrace_names_written : 1;
+    name_count = atrace_name_count > first_id ? atrace_name_count - first_id : 0;
+    for (id = first_id; id < first_id + name_count; id++) {
+        strings_size += 8 + ((strlen(atrace_names[id]) + 3) & ~3);
+    }
+    if (strings_size > 0) {
+        strings = calloc(1, strings_size);
+    }
+    if (strings != NULL) {
+        uint8_t* p = strings;
+        for (id = first_id; id < first_id + name_count; id++) {
+            uint32_t length = strlen(atrace_names[id]);
+            memcpy(p, &id, 4);
+            memcpy(p + 4, &length, 4);
+            memcpy(p + 8, atrace_names[id], length);
+            p += 8 + ((length + 3) & ~3);
+        }
+    } else {
+        name_count = 0;
+        strings_size = 0;
+    }
+    pthread_mutex_unlock(&atrace_names_mutex);
+
+    header.magic = ATRACE_BUFFER_MAGIC;
+    header.version = ATRACE_BUFFER_VERSION;
+    header.header_size = sizeof(header);
+    header.pid = getpid();
+    header.tid = buffer->tid;
+    header.string_count = name_count;
+    header.event_count = buffer->count;
+
+    ok = atrace_write_fully(atrace_buffer_fd, &header, sizeof(header))
+            && atrace_write_fully(atrace_buffer_fd, strings, strings_size)
+            && atrace_write_fully(atrace_buffer_fd, buffer->events,
+                    buffer->count * sizeof(struct atrace_buffer_event));
+    if (ok) {
+        atrace_names_written = first_id + name_count;
+    } else {
+        ALOGE("Error writing trace buffer: %s (%d)", strerror(errno), errno);
+    }
+    pthread_mutex_unlock(&atrace_buffer_mutex);
+    free(strings);
+}
+
+// Called with buffer->lock held.
+static void atrace_flush_buffer(struct atrace_thread_buffer* buffer)
+{
+    if (buffer->count == 0) {
+        return;
+    }
+    if (buffer->session == android_atomic_acquire_load(&atrace_buffer_session)) {
+        switch (android_atomic_acquire_load(&atrace_buffer_mode)) {
+        case ATRACE_BUFFER_MARKER:
+            atrace_flush_to_marker(buffer);
+            break;
+        case ATRACE_BUFFER_FILE:
+            atrace_flush_to_file(buffer);
+            break;
+        }
+    }
+    buffer->count = 0;
+}
+
+static void atrace_buffer_destructor(void* arg)
+{
+    struct atrace_thread_buffer* buffer = arg;
+
+    pthread_mutex_lock(&buffer->lock);
+    atrace_flush_buffer(buffer);
+    pthread_mutex_unlock(&buffer->lock);
+
+    pthread_mutex_lock(&atrace_buffers_mutex);
+    if (buffer->prev != NULL) {
+        buffer->prev->next = buffer->next;
+    } else {
+        atrace_buffers = buffer->next;
+    }
+    if (buffer->next != NULL) {
+        buffer->next->prev = buffer->prev;
+    }
+    pthread_mutex_unlock(&atrace_buffers_mutex);
+
+    pthread_mutex_destroy(&buffer->lock);
+    free(buffer);
+}
+
+static void atrace_buffer_init_once()
+{
+    atrace_buffer_has_key =
+            pthread_key_create(&atrace_buffer_key, atrace_buffer_destructor) == 0;
+}
+
+static struct atrace_thread_buffer* atrace_get_thread_buffer(bool create)
+{
+    struct atrace_thread_buffer* buffer;
+
+    pthread_once(&atrace_buffer_once, atrace_buffer_init_once);
+    if (!atrace_buffer_has_key) {
+        return NULL;
+    }
+    buffer = pthread_getspecific(atrace_buffer_key);
+    if (buffer == NULL && create) {
+        buffer = calloc(1, sizeof(*buffer));
+        if (buffer == NULL) {
+            return NULL;
+        }
+        pthread_mutex_init(&buffer->lock, NULL);
+        buffer->tid = gettid();
+        buffer->session = android_atomic_acquire_load(&atrace_buffer_session);
+        if (pthread_setspecific(atrace_buffer_key, buffer) != 0) {
+            pthread_mutex_destroy(&buffer->lock);
+            free(buffer);
+            return NULL;
+        }
+
+        pthread_mutex_lock(&atrace_buffers_mutex);
+        buffer->next = atrace_buffers;
+        if (atrace_buffers != NULL) {
+            atrace_buffers->prev = buffer;
+        }
+        atrace_buffers = buffer;
+        pthread_mutex_unlock(&atrace_buffers_mutex);
+    }
+    return buffer;
+}
+
+void atrace_buffer_record(char type, const char* name, int64_t value)
+{
+    struct atrace_thread_buffer* buffer = atrace_get_thread_buffer(true);
+    struct atrace_buffer_event* event;
+    struct timespec ts;
+    int32_t session;
+
+    if (CC_UNLIKELY(buffer == NULL)) {
+        return;
+    }
+    pthread_mutex_lock(&buffer->lock);
+    session = android_atomic_acquire_load(&atrace_buffer_session);
+    if (CC_UNLIKELY(buffer->session != session)) {
+        // Left over from an earlier session.
+        buffer->count = 0;
+        buffer->session = session;
+    }
+
+    event = &buffer->events[buffer->count];
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    event->timestamp = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    event->value = value;
+    event->name_id = atrace_lookup_name(buffer, name);
+    event->type = type;
+    if (++buffer->count == ATRACE_BUFFER_EVENTS) {
+        atrace_flush_buffer(buffer);
+    }
+    pthread_mutex_unlock(&buffer->lock);
+}
+
+void atrace_buffer_flush()
+{
+    struct atrace_thread_buffer* buffer = atrace_get_thread_buffer(false);
+    if (buffer != NULL) {
+        pthread_mutex_lock(&buffer->lock);
+        atrace_flush_buffer(buffer);
+        pthread_mutex_unlock(&buffer->lock);
+    }
+}
+
+int atrace_buffer_start(int target, const char* path)
+{
+    int fd = -1;
+
+    if (target != ATRACE_BUFFER_MARKER && target != ATRACE_BUFFER_FILE) {
+        return -EINVAL;
+    }
+    if (target == ATRACE_BUFFER_FILE) {
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            int err = errno;
+            ALOGE("Error opening trace buffer file %s: %s (%d)", path, strerror(err), err);
+            return -err;
+        }
+    }
+
+    pthread_mutex_lock(&atrace_buffer_mutex);
+    if (atrace_buffer_fd >= 0) {
+        close(atrace_buffer_fd);
+    }
+    atrace_buffer_fd = fd;
+    atrace_names_written = 0;
+    android_atomic_inc(&atrace_buffer_session);
+    android_atomic_release_store(target, &atrace_buffer_mode);
+    pthread_mutex_unlock(&atrace_buffer_mutex);
+    return 0;
+}
+
+void atrace_buffer_stop()
+{
+    struct atrace_thread_buffer* buffer;
+
+    // Flush every thread's events while the session is still current.
+    pthread_mutex_lock(&atrace_buffers_mutex);
+    for (buffer = atrace_buffers; buffer != NULL; buffer = buffer->next) {
+        pthread_mutex_lock(&buffer->lock);
+        atrace_flush_buffer(buffer);
+        pthread_mutex_unlock(&buffer->lock);
+    }
+    pthread_mutex_unlock(&atrace_buffers_mutex);
+
+    pthread_mutex_lock(&atrace_buffer_mutex);
+    android_atomic_release_store(ATRACE_BUFFER_OFF, &atrace_buffer_mode);
+    android_atomic_inc(&atrace_buffer_session);
+    if (atrace_buffer_fd >= 0) {
+        close(atrace_buffer_fd);
+        atrace_buffer_fd = -1;
+    }
+    pthread_mutex_unlock(&atrace_buffer_mutex);
+}
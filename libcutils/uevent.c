@@ -21,11 +21,51 @@
 #include <string.h>
 #include <strings.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
 #include <sys/un.h>
 #include <unistd.h>
 
 #include <linux/netlink.h>
 
+#define UEVENT_BATCH_MAX 32
+
+#ifndef MSG_WAITFORONE
+#define MSG_WAITFORONE 0x10000
+#endif
+
+/* Kernel layout of struct mmsghdr, which not every libc declares */
+struct uevent_mmsghdr {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+};
+
+/**
+ * Checks the sender of a received netlink message: it must carry root
+ * credentials and come from the kernel on a multicast group.
+ */
+static bool is_kernel_multicast(struct msghdr *hdr, struct sockaddr_nl *addr, uid_t *user)
+{
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(hdr);
+    if (cmsg == NULL || cmsg->cmsg_type != SCM_CREDENTIALS) {
+        /* ignoring netlink message with no sender credentials */
+        return false;
+    }
+
+    struct ucred *cred = (struct ucred *)CMSG_DATA(cmsg);
+    *user = cred->uid;
+    if (cred->uid != 0) {
+        /* ignoring netlink message from non-root user */
+        return false;
+    }
+
+    if (addr->nl_groups == 0 || addr->nl_pid != 0) {
+        /* ignoring non-kernel or unicast netlink message */
+        return false;
+    }
+
+    return true;
+}
+
 /**
  * Like recv(), but checks that messages actually originate from the kernel.
  */
@@ -66,31 +106,99 @@ ssize_t uevent_kernel_multicast_uid_recv(int socket, void *buffer,
         return n;
     }
 
-    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
-    if (cmsg == NULL || cmsg->cmsg_type != SCM_CREDENTIALS) {
-        /* ignoring netlink message with no sender credentials */
-        goto out;
+    if (!is_kernel_multicast(&hdr, &addr, user)) {
+        /* clear residual potentially malicious data */
+        bzero(buffer, length);
+        errno = EIO;
+        return -1;
     }
 
-    struct ucred *cred = (struct ucred *)CMSG_DATA(cmsg);
-    *user = cred->uid;
-    if (cred->uid != 0) {
-        /* ignoring netlink message from non-root user */
-        goto out;
+    return n;
+}
+
+/* The batch of one read where recvmmsg() isn't available */
+static int recv_single(int socket, void *buffer, size_t length, ssize_t *lengths,
+                       uid_t *user)
+{
+    uid_t sender = -1;
+
+    lengths[0] = uevent_kernel_multicast_uid_recv(socket, buffer, length, &sender);
+    if (lengths[0] < 0) {
+        if (errno != EIO) {
+            return -1;
+        }
+        if (sender != (uid_t) -1) {
+            *user = sender;
+        }
     }
+    return lengths[0] == 0 ? 0 : 1;
+}
 
-    if (addr.nl_groups == 0 || addr.nl_pid != 0) {
-        /* ignoring non-kernel or unicast netlink message */
-        goto out;
+/**
+ * Batched form of uevent_kernel_multicast_uid_recv(). "buffer" is split into
+ * "count" slots of "slot_size" bytes and up to "count" messages are received
+ * with one recvmmsg() call, blocking only until the first one arrives.
+ *
+ * Returns the number of slots filled, or -1 with errno set. lengths[i] is the
+ * size of the message in slot i, or -1 if it was rejected (not from the
+ * kernel, or truncated). "user" is only written for a rejected message that
+ * carried credentials, and then holds its sender's uid; it is left alone
+ * when every message was accepted. Falls back to a single recvmsg() where
+ * recvmmsg() is unavailable.
+ */
+int uevent_kernel_multicast_uid_recv_batch(int socket, void *buffer, size_t slot_size,
+                                           int count, ssize_t *lengths, uid_t *user)
+{
+#ifdef __NR_recvmmsg
+    struct uevent_mmsghdr msgs[UEVENT_BATCH_MAX];
+    struct iovec iovs[UEVENT_BATCH_MAX];
+    struct sockaddr_nl addrs[UEVENT_BATCH_MAX];
+    char controls[UEVENT_BATCH_MAX][CMSG_SPACE(sizeof(struct ucred))];
+    char *slots = buffer;
+    int i, n;
+
+    if (count > UEVENT_BATCH_MAX) {
+        count = UEVENT_BATCH_MAX;
     }
 
+    memset(msgs, 0, sizeof(msgs[0]) * count);
+    for (i = 0; i < count; i++) {
+        iovs[i].iov_base = slots + i * slot_size;
+        iovs[i].iov_len = slot_size;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_control = controls[i];
+        msgs[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+    }
+
+    n = syscall(__NR_recvmmsg, socket, msgs, count, MSG_WAITFORONE, NULL);
+    if (n < 0 && errno == ENOSYS) {
+        goto single;
+    }
+    if (n <= 0) {
+        return n;
+    }
+
+    for (i = 0; i < n; i++) {
+        uid_t sender = -1;
+
+        lengths[i] = msgs[i].msg_len;
+        if ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) ||
+                !is_kernel_multicast(&msgs[i].msg_hdr, &addrs[i], &sender)) {
+            bzero(iovs[i].iov_base, slot_size);
+            lengths[i] = -1;
+            if (sender != (uid_t) -1) {
+                *user = sender;
+            }
+        }
+    }
     return n;
 
-out:
-    /* clear residual potentially malicious data */
-    bzero(buffer, length);
-    errno = EIO;
-    return -1;
+single:
+#endif
+    return recv_single(socket, buffer, slot_size * count, lengths, user);
 }
 
 int uevent_open_socket(int buf_sz, bool passcred)
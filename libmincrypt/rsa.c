@@ -29,21 +29,69 @@
 #include "mincrypt/sha.h"
 #include "mincrypt/sha256.h"
 
+// The arithmetic below works on limbs of the native word size: hosts
+// with a 128-bit integer type do a quarter of the multiplications a
+// 32-bit build does. The key is converted once per modpow().
+#if defined(__SIZEOF_INT128__)
+typedef uint64_t limb_t;
+typedef unsigned __int128 dlimb_t;
+#else
+typedef uint32_t limb_t;
+typedef uint64_t dlimb_t;
+#endif
+
+#define LIMB_BITS (sizeof(limb_t) * 8)
+#define RSANUMLIMBS (RSANUMBYTES / sizeof(limb_t))
+
+typedef struct MontKey {
+    int len;                    // length of n[] in limbs
+    limb_t n0inv;               // -1 / n[0] mod 2^LIMB_BITS
+    limb_t n[RSANUMLIMBS];
+    limb_t rr[RSANUMLIMBS];
+} MontKey;
+
+// Converts the little endian words in src[] to limbs in dst[].
+static void toLimbs(limb_t* dst, const uint32_t* src, int words) {
+    int i;
+    for (i = 0; i < words; ++i) {
+        if (i % (sizeof(limb_t) / 4) == 0) {
+            dst[i / (sizeof(limb_t) / 4)] = 0;
+        }
+        dst[i / (sizeof(limb_t) / 4)] |=
+            (limb_t)src[i] << (32 * (i % (sizeof(limb_t) / 4)));
+    }
+}
+
+static void initMontKey(MontKey* m, const RSAPublicKey* key) {
+    limb_t inv;
+    m->len = key->len * 4 / sizeof(limb_t);
+    toLimbs(m->n, key->n, key->len);
+    toLimbs(m->rr, key->rr, key->len);
+
+    // Newton's iteration doubles the number of correct low bits of
+    // inv = 1 / n[0], starting from the 32 key->n0inv gives.
+    inv = -(limb_t)key->n0inv;
+    if (sizeof(limb_t) > 4) {
+        inv *= 2 - m->n[0] * inv;
+    }
+    m->n0inv = -inv;
+}
+
 // a[] -= mod
-static void subM(const RSAPublicKey* key,
-                 uint32_t* a) {
-    int64_t A = 0;
+static void subM(const MontKey* key,
+                 limb_t* a) {
+    limb_t borrow = 0;
     int i;
     for (i = 0; i < key->len; ++i) {
-        A += (uint64_t)a[i] - key->n[i];
-        a[i] = (uint32_t)A;
-        A >>= 32;
+        dlimb_t A = (dlimb_t)a[i] - key->n[i] - borrow;
+        a[i] = (limb_t)A;
+        borrow = (limb_t)(A >> LIMB_BITS) & 1;
     }
 }
 
 // return a[] >= mod
-static int geM(const RSAPublicKey* key,
-               const uint32_t* a) {
+static int geM(const MontKey* key,
+               const limb_t* a) {
     int i;
     for (i = key->len; i;) {
         --i;
@@ -54,35 +102,35 @@ static int geM(const RSAPublicKey* key,
 }
 
 // montgomery c[] += a * b[] / R % mod
-static void montMulAdd(const RSAPublicKey* key,
-                       uint32_t* c,
-                       const uint32_t a,
-                       const uint32_t* b) {
-    uint64_t A = (uint64_t)a * b[0] + c[0];
-    uint32_t d0 = (uint32_t)A * key->n0inv;
-    uint64_t B = (uint64_t)d0 * key->n[0] + (uint32_t)A;
+static void montMulAdd(const MontKey* key,
+                       limb_t* c,
+                       const limb_t a,
+                       const limb_t* b) {
+    dlimb_t A = (dlimb_t)a * b[0] + c[0];
+    limb_t d0 = (limb_t)A * key->n0inv;
+    dlimb_t B = (dlimb_t)d0 * key->n[0] + (limb_t)A;
     int i;
 
     for (i = 1; i < key->len; ++i) {
-        A = (A >> 32) + (uint64_t)a * b[i] + c[i];
-        B = (B >> 32) + (uint64_t)d0 * key->n[i] + (uint32_t)A;
-        c[i - 1] = (uint32_t)B;
+        A = (A >> LIMB_BITS) + (dlimb_t)a * b[i] + c[i];
+        B = (B >> LIMB_BITS) + (dlimb_t)d0 * key->n[i] + (limb_t)A;
+        c[i - 1] = (limb_t)B;
     }
 
-    A = (A >> 32) + (B >> 32);
+    A = (A >> LIMB_BITS) + (B >> LIMB_BITS);
 
-    c[i - 1] = (uint32_t)A;
+    c[i - 1] = (limb_t)A;
 
-    if (A >> 32) {
+    if (A >> LIMB_BITS) {
         subM(key, c);
     }
 }
 
 // montgomery c[] = a[] * b[] / R % mod
-static void montMul(const RSAPublicKey* key,
-                    uint32_t* c,
-                    const uint32_t* a,
-                    const uint32_t* b) {
+static void montMul(const MontKey* key,
+                    limb_t* c,
+                    const limb_t* a,
+                    const limb_t* b) {
     int i;
     for (i = 0; i < key->len; ++i) {
         c[i] = 0;
@@ -92,53 +140,116 @@ static void montMul(const RSAPublicKey* key,
     }
 }
 
+// montgomery c[] = a[] * a[] / R % mod
+// Computes a[i] * a[j] only once for i != j, which saves a quarter of the
+// multiplications of montMul(); modpow() is mostly squarings.
+static void montSqr(const MontKey* key,
+                    limb_t* c,
+                    const limb_t* a) {
+    limb_t t[2 * RSANUMLIMBS + 1];
+    const int len = key->len;
+    dlimb_t A;
+    limb_t carry;
+    int i, j;
+
+    // t[] = sum of a[i] * a[j] for i < j
+    for (i = 0; i < 2 * len + 1; ++i) {
+        t[i] = 0;
+    }
+    for (i = 0; i < len - 1; ++i) {
+        A = 0;
+        for (j = i + 1; j < len; ++j) {
+            A = (A >> LIMB_BITS) + (dlimb_t)a[i] * a[j] + t[i + j];
+            t[i + j] = (limb_t)A;
+        }
+        t[i + len] = (limb_t)(A >> LIMB_BITS);
+    }
+
+    // t[] = 2 * t[] + sum of a[i]^2, which is a[]^2 < R^2
+    for (i = 2 * len - 1; i > 0; --i) {
+        t[i] = (t[i] << 1) | (t[i - 1] >> (LIMB_BITS - 1));
+    }
+    t[0] <<= 1;
+    A = 0;
+    for (i = 0; i < len; ++i) {
+        A = (A >> LIMB_BITS) + (dlimb_t)a[i] * a[i] + t[2 * i];
+        t[2 * i] = (limb_t)A;
+        A = (A >> LIMB_BITS) + t[2 * i + 1];
+        t[2 * i + 1] = (limb_t)A;
+    }
+
+    // t[] = (t[] + d * mod) / R, with d such that the division is exact
+    for (i = 0; i < len; ++i) {
+        limb_t d = t[i] * key->n0inv;
+        A = 0;
+        for (j = 0; j < len; ++j) {
+            A = (A >> LIMB_BITS) + (dlimb_t)d * key->n[j] + t[i + j];
+            t[i + j] = (limb_t)A;
+        }
+        carry = (limb_t)(A >> LIMB_BITS);
+        for (j = i + len; carry; ++j) {
+            t[j] += carry;
+            carry = t[j] < carry;
+        }
+    }
+
+    for (i = 0; i < len; ++i) {
+        c[i] = t[len + i];
+    }
+    if (t[2 * len]) {
+        subM(key, c);
+    }
+}
+
 // In-place public exponentiation.
 // Input and output big-endian byte array in inout.
-static void modpow(const RSAPublicKey* key,
+static void modpow(const RSAPublicKey* pubkey,
                    uint8_t* inout) {
-    uint32_t a[RSANUMWORDS];
-    uint32_t aR[RSANUMWORDS];
-    uint32_t aaR[RSANUMWORDS];
-    uint32_t* aaa = 0;
-    int i;
-
-    // Convert from big endian byte array to little endian word array.
-    for (i = 0; i < key->len; ++i) {
-        uint32_t tmp =
-            (inout[((key->len - 1 - i) * 4) + 0] << 24) |
-            (inout[((key->len - 1 - i) * 4) + 1] << 16) |
-            (inout[((key->len - 1 - i) * 4) + 2] << 8) |
-            (inout[((key->len - 1 - i) * 4) + 3] << 0);
+    MontKey key;
+    limb_t a[RSANUMLIMBS];
+    limb_t aR[RSANUMLIMBS];
+    limb_t aaR[RSANUMLIMBS];
+    limb_t* aaa = 0;
+    int i, j;
+
+    initMontKey(&key, pubkey);
+
+    // Convert from big endian byte array to little endian limb array.
+    for (i = 0; i < key.len; ++i) {
+        const uint8_t* p = inout + (key.len - 1 - i) * sizeof(limb_t);
+        limb_t tmp = 0;
+        for (j = 0; j < (int)sizeof(limb_t); ++j) {
+            tmp = (tmp << 8) | p[j];
+        }
         a[i] = tmp;
     }
 
-    if (key->exponent == 65537) {
+    if (pubkey->exponent == 65537) {
         aaa = aaR;  // Re-use location.
-        montMul(key, aR, a, key->rr);  // aR = a * RR / R mod M
+        montMul(&key, aR, a, key.rr);  // aR = a * RR / R mod M
         for (i = 0; i < 16; i += 2) {
-            montMul(key, aaR, aR, aR);  // aaR = aR * aR / R mod M
-            montMul(key, aR, aaR, aaR);  // aR = aaR * aaR / R mod M
+            montSqr(&key, aaR, aR);  // aaR = aR * aR / R mod M
+            montSqr(&key, aR, aaR);  // aR = aaR * aaR / R mod M
         }
-        montMul(key, aaa, aR, a);  // aaa = aR * a / R mod M
-    } else if (key->exponent == 3) {
+        montMul(&key, aaa, aR, a);  // aaa = aR * a / R mod M
+    } else if (pubkey->exponent == 3) {
         aaa = aR;  // Re-use location.
-        montMul(key, aR, a, key->rr);  /* aR = a * RR / R mod M   */
-        montMul(key, aaR, aR, aR);     /* aaR = aR * aR / R mod M */
-        montMul(key, aaa, aaR, a);     /* aaa = aaR * a / R mod M */
+        montMul(&key, aR, a, key.rr);  /* aR = a * RR / R mod M   */
+        montSqr(&key, aaR, aR);        /* aaR = aR * aR / R mod M */
+        montMul(&key, aaa, aaR, a);    /* aaa = aaR * a / R mod M */
     }
 
     // Make sure aaa < mod; aaa is at most 1x mod too large.
-    if (geM(key, aaa)) {
-        subM(key, aaa);
+    if (geM(&key, aaa)) {
+        subM(&key, aaa);
     }
 
     // Convert to bigendian byte array
-    for (i = key->len - 1; i >= 0; --i) {
-        uint32_t tmp = aaa[i];
-        *inout++ = tmp >> 24;
-        *inout++ = tmp >> 16;
-        *inout++ = tmp >> 8;
-        *inout++ = tmp >> 0;
+    for (i = key.len - 1; i >= 0; --i) {
+        limb_t tmp = aaa[i];
+        for (j = sizeof(limb_t) - 1; j >= 0; --j) {
+            *inout++ = (uint8_t)(tmp >> (8 * j));
+        }
     }
 }
 
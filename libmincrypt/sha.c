@@ -25,9 +25,11 @@
 ** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-// Optimized for minimal code size.
+// The portable code is optimized for minimal code size. Where the CPU has
+// SHA instructions, sha_hw.c provides the block function instead.
 
 #include "mincrypt/sha.h"
+#include "sha_hw.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -35,54 +37,64 @@
 
 #define rol(bits, value) (((value) << (bits)) | ((value) >> (32 - (bits))))
 
-static void SHA1_Transform(SHA_CTX* ctx) {
-    uint32_t W[80];
-    uint32_t A, B, C, D, E;
-    uint8_t* p = ctx->buf;
-    int t;
+#define be32(p) (((uint32_t) (p)[0] << 24) | ((uint32_t) (p)[1] << 16) | \
+                 ((uint32_t) (p)[2] << 8) | (uint32_t) (p)[3])
 
-    for(t = 0; t < 16; ++t) {
-        uint32_t tmp =  *p++ << 24;
-        tmp |= *p++ << 16;
-        tmp |= *p++ << 8;
-        tmp |= *p++;
-        W[t] = tmp;
-    }
+void SHA1_blocks_c(uint32_t* state, const uint8_t* data, int blocks) {
+    for (; blocks > 0; --blocks, data += 64) {
+        uint32_t W[80];
+        uint32_t A, B, C, D, E;
+        int t;
 
-    for(; t < 80; t++) {
-        W[t] = rol(1,W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16]);
-    }
+        for(t = 0; t < 16; ++t) {
+            W[t] = be32(data + t * 4);
+        }
 
-    A = ctx->state[0];
-    B = ctx->state[1];
-    C = ctx->state[2];
-    D = ctx->state[3];
-    E = ctx->state[4];
+        for(; t < 80; t++) {
+            W[t] = rol(1,W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16]);
+        }
 
-    for(t = 0; t < 80; t++) {
-        uint32_t tmp = rol(5,A) + E + W[t];
+        A = state[0];
+        B = state[1];
+        C = state[2];
+        D = state[3];
+        E = state[4];
 
-        if (t < 20)
-            tmp += (D^(B&(C^D))) + 0x5A827999;
-        else if ( t < 40)
-            tmp += (B^C^D) + 0x6ED9EBA1;
-        else if ( t < 60)
-            tmp += ((B&C)|(D&(B|C))) + 0x8F1BBCDC;
-        else
-            tmp += (B^C^D) + 0xCA62C1D6;
+        for(t = 0; t < 80; t++) {
+            uint32_t tmp = rol(5,A) + E + W[t];
 
-        E = D;
-        D = C;
-        C = rol(30,B);
-        B = A;
-        A = tmp;
+            if (t < 20)
+                tmp += (D^(B&(C^D))) + 0x5A827999;
+            else if ( t < 40)
+                tmp += (B^C^D) + 0x6ED9EBA1;
+            else if ( t < 60)
+                tmp += ((B&C)|(D&(B|C))) + 0x8F1BBCDC;
+            else
+                tmp += (B^C^D) + 0xCA62C1D6;
+
+            E = D;
+            D = C;
+            C = rol(30,B);
+            B = A;
+            A = tmp;
+        }
+
+        state[0] += A;
+        state[1] += B;
+        state[2] += C;
+        state[3] += D;
+        state[4] += E;
     }
+}
 
-    ctx->state[0] += A;
-    ctx->state[1] += B;
-    ctx->state[2] += C;
-    ctx->state[3] += D;
-    ctx->state[4] += E;
+static SHA_blocks_fn sha1_blocks;
+
+static SHA_blocks_fn SHA1_blocks(void) {
+    if (sha1_blocks == NULL) {
+        SHA_blocks_fn hw = SHA1_blocks_hw();
+        sha1_blocks = hw ? hw : SHA1_blocks_c;
+    }
+    return sha1_blocks;
 }
 
 static const HASH_VTAB SHA_VTAB = {
@@ -108,31 +120,35 @@ void SHA_update(SHA_CTX* ctx, const void* data, int len) {
     int i = (int) (ctx->count & 63);
     const uint8_t* p = (const uint8_t*)data;
 
+    if (len <= 0) return;
     ctx->count += len;
 
-    while (len--) {
-        ctx->buf[i++] = *p++;
-        if (i == 64) {
-            SHA1_Transform(ctx);
-            i = 0;
-        }
+    if (i) {
+        int n = 64 - i < len ? 64 - i : len;
+        memcpy(ctx->buf + i, p, n);
+        if (i + n < 64) return;
+        SHA1_blocks()(ctx->state, ctx->buf, 1);
+        p += n;
+        len -= n;
     }
+
+    // Whole blocks are hashed straight from the caller's buffer.
+    if (len >= 64) {
+        SHA1_blocks()(ctx->state, p, len / 64);
+        p += len & ~63;
+        len &= 63;
+    }
+    memcpy(ctx->buf, p, len);
 }
 
 
 const uint8_t* SHA_final(SHA_CTX* ctx) {
+    uint8_t tail[128];
     uint8_t *p = ctx->buf;
-    uint64_t cnt = ctx->count * 8;
     int i;
 
-    SHA_update(ctx, (uint8_t*)"\x80", 1);
-    while ((ctx->count & 63) != 56) {
-        SHA_update(ctx, (uint8_t*)"\0", 1);
-    }
-    for (i = 0; i < 8; ++i) {
-        uint8_t tmp = (uint8_t) (cnt >> ((7 - i) * 8));
-        SHA_update(ctx, &tmp, 1);
-    }
+    memcpy(tail, ctx->buf, ctx->count & 63);
+    SHA1_blocks()(ctx->state, tail, SHA_pad(tail, ctx->count));
 
     for (i = 0; i < 5; i++) {
         uint32_t tmp = ctx->state[i];
@@ -153,3 +169,118 @@ const uint8_t* SHA_hash(const void* data, int len, uint8_t* digest) {
     memcpy(digest, SHA_final(&ctx), SHA_DIGEST_SIZE);
     return digest;
 }
+
+#if SHA_MULTI_LANES > 1
+
+// SHA1_blocks_c, on one block from each of the lanes.
+static void SHA1_block_lanes(sha_vec_t* state, const uint8_t* const* data) {
+    sha_vec_t W[80];
+    sha_vec_t A, B, C, D, E;
+    int t, l;
+
+    for(t = 0; t < 16; ++t) {
+        for (l = 0; l < SHA_MULTI_LANES; ++l) {
+            W[t][l] = be32(data[l] + t * 4);
+        }
+    }
+
+    for(; t < 80; t++) {
+        W[t] = rol(1,W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16]);
+    }
+
+    A = state[0];
+    B = state[1];
+    C = state[2];
+    D = state[3];
+    E = state[4];
+
+    for(t = 0; t < 80; t++) {
+        sha_vec_t tmp = rol(5,A) + E + W[t];
+
+        if (t < 20)
+            tmp += (D^(B&(C^D))) + 0x5A827999;
+        else if ( t < 40)
+            tmp += (B^C^D) + 0x6ED9EBA1;
+        else if ( t < 60)
+            tmp += ((B&C)|(D&(B|C))) + 0x8F1BBCDC;
+        else
+            tmp += (B^C^D) + 0xCA62C1D6;
+
+        E = D;
+        D = C;
+        C = rol(30,B);
+        B = A;
+        A = tmp;
+    }
+
+    state[0] += A;
+    state[1] += B;
+    state[2] += C;
+    state[3] += D;
+    state[4] += E;
+}
+
+void SHA1_hash_lanes(const void* const* data, int len, uint8_t* digest) {
+    sha_vec_t state[5];
+    const uint8_t* p[SHA_MULTI_LANES];
+    uint8_t tail[SHA_MULTI_LANES][128];
+    const int blocks = len / 64;
+    int tail_blocks = 0;
+    int b, i, l;
+
+    SHA_CTX ctx;
+    SHA_init(&ctx);
+    for (i = 0; i < 5; i++) {
+        for (l = 0; l < SHA_MULTI_LANES; ++l) {
+            state[i][l] = ctx.state[i];
+        }
+    }
+
+    for (b = 0; b < blocks; ++b) {
+        for (l = 0; l < SHA_MULTI_LANES; ++l) {
+            p[l] = (const uint8_t*) data[l] + b * 64;
+        }
+        SHA1_block_lanes(state, p);
+    }
+
+    for (l = 0; l < SHA_MULTI_LANES; ++l) {
+        memcpy(tail[l], (const uint8_t*) data[l] + blocks * 64, len & 63);
+        tail_blocks = SHA_pad(tail[l], len);
+    }
+    for (b = 0; b < tail_blocks; ++b) {
+        for (l = 0; l < SHA_MULTI_LANES; ++l) {
+            p[l] = tail[l] + b * 64;
+        }
+        SHA1_block_lanes(state, p);
+    }
+
+    for (l = 0; l < SHA_MULTI_LANES; ++l) {
+        for (i = 0; i < 5; i++) {
+            uint32_t tmp = state[i][l];
+            *digest++ = tmp >> 24;
+            *digest++ = tmp >> 16;
+            *digest++ = tmp >> 8;
+            *digest++ = tmp >> 0;
+        }
+    }
+}
+
+#endif  // SHA_MULTI_LANES > 1
+
+void SHA_hash_multi(const void* const* data, int len, int count,
+                    uint8_t* digest) {
+#if SHA_MULTI_LANES > 1
+    // The hash instructions beat the vector code.
+    if (SHA1_blocks() == SHA1_blocks_c) {
+        for (; count >= SHA_MULTI_LANES; count -= SHA_MULTI_LANES) {
+            SHA1_hash_lanes(data, len, digest);
+            data += SHA_MULTI_LANES;
+            digest += SHA_MULTI_LANES * SHA_DIGEST_SIZE;
+        }
+    }
+#endif
+    for (; count > 0; --count) {
+        SHA_hash(*data++, len, digest);
+        digest += SHA_DIGEST_SIZE;
+    }
+}
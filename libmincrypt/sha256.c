@@ -25,9 +25,11 @@
 ** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-// Optimized for minimal code size.
+// The portable code is optimized for minimal code size. Where the CPU has
+// SHA instructions, sha_hw.c provides the block function instead.
 
 #include "mincrypt/sha256.h"
+#include "sha_hw.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -36,6 +38,9 @@
 #define ror(value, bits) (((value) >> (bits)) | ((value) << (32 - (bits))))
 #define shr(value, bits) ((value) >> (bits))
 
+#define be32(p) (((uint32_t) (p)[0] << 24) | ((uint32_t) (p)[1] << 16) | \
+                 ((uint32_t) (p)[2] << 8) | (uint32_t) (p)[3])
+
 static const uint32_t K[64] = {
     0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
     0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
@@ -54,61 +59,68 @@ static const uint32_t K[64] = {
     0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
     0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
 
-static void SHA256_Transform(SHA256_CTX* ctx) {
-    uint32_t W[64];
-    uint32_t A, B, C, D, E, F, G, H;
-    uint8_t* p = ctx->buf;
-    int t;
+void SHA256_blocks_c(uint32_t* state, const uint8_t* data, int blocks) {
+    for (; blocks > 0; --blocks, data += 64) {
+        uint32_t W[64];
+        uint32_t A, B, C, D, E, F, G, H;
+        int t;
 
-    for(t = 0; t < 16; ++t) {
-        uint32_t tmp =  *p++ << 24;
-        tmp |= *p++ << 16;
-        tmp |= *p++ << 8;
-        tmp |= *p++;
-        W[t] = tmp;
-    }
+        for(t = 0; t < 16; ++t) {
+            W[t] = be32(data + t * 4);
+        }
 
-    for(; t < 64; t++) {
-        uint32_t s0 = ror(W[t-15], 7) ^ ror(W[t-15], 18) ^ shr(W[t-15], 3);
-        uint32_t s1 = ror(W[t-2], 17) ^ ror(W[t-2], 19) ^ shr(W[t-2], 10);
-        W[t] = W[t-16] + s0 + W[t-7] + s1;
-    }
+        for(; t < 64; t++) {
+            uint32_t s0 = ror(W[t-15], 7) ^ ror(W[t-15], 18) ^ shr(W[t-15], 3);
+            uint32_t s1 = ror(W[t-2], 17) ^ ror(W[t-2], 19) ^ shr(W[t-2], 10);
+            W[t] = W[t-16] + s0 + W[t-7] + s1;
+        }
 
-    A = ctx->state[0];
-    B = ctx->state[1];
-    C = ctx->state[2];
-    D = ctx->state[3];
-    E = ctx->state[4];
-    F = ctx->state[5];
-    G = ctx->state[6];
-    H = ctx->state[7];
+        A = state[0];
+        B = state[1];
+        C = state[2];
+        D = state[3];
+        E = state[4];
+        F = state[5];
+        G = state[6];
+        H = state[7];
 
-    for(t = 0; t < 64; t++) {
-        uint32_t s0 = ror(A, 2) ^ ror(A, 13) ^ ror(A, 22);
-        uint32_t maj = (A & B) ^ (A & C) ^ (B & C);
-        uint32_t t2 = s0 + maj;
-        uint32_t s1 = ror(E, 6) ^ ror(E, 11) ^ ror(E, 25);
-        uint32_t ch = (E & F) ^ ((~E) & G);
-        uint32_t t1 = H + s1 + ch + K[t] + W[t];
+        for(t = 0; t < 64; t++) {
+            uint32_t s0 = ror(A, 2) ^ ror(A, 13) ^ ror(A, 22);
+            uint32_t maj = (A & B) ^ (A & C) ^ (B & C);
+            uint32_t t2 = s0 + maj;
+            uint32_t s1 = ror(E, 6) ^ ror(E, 11) ^ ror(E, 25);
+            uint32_t ch = (E & F) ^ ((~E) & G);
+            uint32_t t1 = H + s1 + ch + K[t] + W[t];
 
-        H = G;
-        G = F;
-        F = E;
-        E = D + t1;
-        D = C;
-        C = B;
-        B = A;
-        A = t1 + t2;
+            H = G;
+            G = F;
+            F = E;
+            E = D + t1;
+            D = C;
+            C = B;
+            B = A;
+            A = t1 + t2;
+        }
+
+        state[0] += A;
+        state[1] += B;
+        state[2] += C;
+        state[3] += D;
+        state[4] += E;
+        state[5] += F;
+        state[6] += G;
+        state[7] += H;
     }
+}
+
+static SHA_blocks_fn sha256_blocks;
 
-    ctx->state[0] += A;
-    ctx->state[1] += B;
-    ctx->state[2] += C;
-    ctx->state[3] += D;
-    ctx->state[4] += E;
-    ctx->state[5] += F;
-    ctx->state[6] += G;
-    ctx->state[7] += H;
+static SHA_blocks_fn SHA256_blocks(void) {
+    if (sha256_blocks == NULL) {
+        SHA_blocks_fn hw = SHA256_blocks_hw();
+        sha256_blocks = hw ? hw : SHA256_blocks_c;
+    }
+    return sha256_blocks;
 }
 
 static const HASH_VTAB SHA256_VTAB = {
@@ -137,31 +149,35 @@ void SHA256_update(SHA256_CTX* ctx, const void* data, int len) {
     int i = (int) (ctx->count & 63);
     const uint8_t* p = (const uint8_t*)data;
 
+    if (len <= 0) return;
     ctx->count += len;
 
-    while (len--) {
-        ctx->buf[i++] = *p++;
-        if (i == 64) {
-            SHA256_Transform(ctx);
-            i = 0;
-        }
+    if (i) {
+        int n = 64 - i < len ? 64 - i : len;
+        memcpy(ctx->buf + i, p, n);
+        if (i + n < 64) return;
+        SHA256_blocks()(ctx->state, ctx->buf, 1);
+        p += n;
+        len -= n;
+    }
+
+    // Whole blocks are hashed straight from the caller's buffer.
+    if (len >= 64) {
+        SHA256_blocks()(ctx->state, p, len / 64);
+        p += len & ~63;
+        len &= 63;
     }
+    memcpy(ctx->buf, p, len);
 }
 
 
 const uint8_t* SHA256_final(SHA256_CTX* ctx) {
+    uint8_t tail[128];
     uint8_t *p = ctx->buf;
-    uint64_t cnt = ctx->count * 8;
     int i;
 
-    SHA256_update(ctx, (uint8_t*)"\x80", 1);
-    while ((ctx->count & 63) != 56) {
-        SHA256_update(ctx, (uint8_t*)"\0", 1);
-    }
-    for (i = 0; i < 8; ++i) {
-        uint8_t tmp = (uint8_t) (cnt >> ((7 - i) * 8));
-        SHA256_update(ctx, &tmp, 1);
-    }
+    memcpy(tail, ctx->buf, ctx->count & 63);
+    SHA256_blocks()(ctx->state, tail, SHA_pad(tail, ctx->count));
 
     for (i = 0; i < 8; i++) {
         uint32_t tmp = ctx->state[i];
@@ -182,3 +198,125 @@ const uint8_t* SHA256_hash(const void* data, int len, uint8_t* digest) {
     memcpy(digest, SHA256_final(&ctx), SHA256_DIGEST_SIZE);
     return digest;
 }
+
+#if SHA_MULTI_LANES > 1
+
+// SHA256_blocks_c, on one block from each of the lanes.
+static void SHA256_block_lanes(sha_vec_t* state, const uint8_t* const* data) {
+    sha_vec_t W[64];
+    sha_vec_t A, B, C, D, E, F, G, H;
+    int t, l;
+
+    for(t = 0; t < 16; ++t) {
+        for (l = 0; l < SHA_MULTI_LANES; ++l) {
+            W[t][l] = be32(data[l] + t * 4);
+        }
+    }
+
+    for(; t < 64; t++) {
+        sha_vec_t s0 = ror(W[t-15], 7) ^ ror(W[t-15], 18) ^ shr(W[t-15], 3);
+        sha_vec_t s1 = ror(W[t-2], 17) ^ ror(W[t-2], 19) ^ shr(W[t-2], 10);
+        W[t] = W[t-16] + s0 + W[t-7] + s1;
+    }
+
+    A = state[0];
+    B = state[1];
+    C = state[2];
+    D = state[3];
+    E = state[4];
+    F = state[5];
+    G = state[6];
+    H = state[7];
+
+    for(t = 0; t < 64; t++) {
+        sha_vec_t s0 = ror(A, 2) ^ ror(A, 13) ^ ror(A, 22);
+        sha_vec_t maj = (A & B) ^ (A & C) ^ (B & C);
+        sha_vec_t t2 = s0 + maj;
+        sha_vec_t s1 = ror(E, 6) ^ ror(E, 11) ^ ror(E, 25);
+        sha_vec_t ch = (E & F) ^ ((~E) & G);
+        sha_vec_t t1 = H + s1 + ch + K[t] + W[t];
+
+        H = G;
+        G = F;
+        F = E;
+        E = D + t1;
+        D = C;
+        C = B;
+        B = A;
+        A = t1 + t2;
+    }
+
+    state[0] += A;
+    state[1] += B;
+    state[2] += C;
+    state[3] += D;
+    state[4] += E;
+    state[5] += F;
+    state[6] += G;
+    state[7] += H;
+}
+
+void SHA256_hash_lanes(const void* const* data, int len, uint8_t* digest) {
+    sha_vec_t state[8];
+    const uint8_t* p[SHA_MULTI_LANES];
+    uint8_t tail[SHA_MULTI_LANES][128];
+    const int blocks = len / 64;
+    int tail_blocks = 0;
+    int b, i, l;
+
+    SHA256_CTX ctx;
+    SHA256_init(&ctx);
+    for (i = 0; i < 8; i++) {
+        for (l = 0; l < SHA_MULTI_LANES; ++l) {
+            state[i][l] = ctx.state[i];
+        }
+    }
+
+    for (b = 0; b < blocks; ++b) {
+        for (l = 0; l < SHA_MULTI_LANES; ++l) {
+            p[l] = (const uint8_t*) data[l] + b * 64;
+        }
+        SHA256_block_lanes(state, p);
+    }
+
+    for (l = 0; l < SHA_MULTI_LANES; ++l) {
+        memcpy(tail[l], (const uint8_t*) data[l] + blocks * 64, len & 63);
+        tail_blocks = SHA_pad(tail[l], len);
+    }
+    for (b = 0; b < tail_blocks; ++b) {
+        for (l = 0; l < SHA_MULTI_LANES; ++l) {
+            p[l] = tail[l] + b * 64;
+        }
+        SHA256_block_lanes(state, p);
+    }
+
+    for (l = 0; l < SHA_MULTI_LANES; ++l) {
+        for (i = 0; i < 8; i++) {
+            uint32_t tmp = state[i][l];
+            *digest++ = tmp >> 24;
+            *digest++ = tmp >> 16;
+            *digest++ = tmp >> 8;
+            *digest++ = tmp >> 0;
+        }
+    }
+}
+
+#endif  // SHA_MULTI_LANES > 1
+
+void SHA256_hash_multi(const void* const* data, int len, int count,
+                       uint8_t* digest) {
+#if SHA_MULTI_LANES > 1
+    // The hash instructions beat the vector code.
+    if (SHA256_blocks() == SHA256_blocks_c) {
+        for (; count >= SHA_MULTI_LANES; count -= SHA_MULTI_LANES) {
+            SHA256_hash_lanes(data, len, digest);
+            data += SHA_MULTI_LANES;
+            digest += SHA_MULTI_LANES * SHA256_DIGEST_SIZE;
+        }
+    }
+#endif
+    for (; count > 0; --count) {
+        SHA256_hash(*data++, len, digest);
+        digest += SHA256_DIGEST_SIZE;
+    }
+}
@@ -0,0 +1,240 @@
+/* sha_hw.c
+**
+** Copyright 2013, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of Google Inc. nor the names of its contributors may
+**       be used to endorse or promote products derived from this software
+**       without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY Google Inc. ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+** MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+** EVENT SHALL Google Inc. BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// SHA-1 and SHA-256 block functions using the x86 SHA extensions. They
+// are compiled for these instructions whatever the target flags are, and
+// only handed out when cpuid says the CPU has them.
+
+#include "sha_hw.h"
+
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__clang__)
+#if __has_builtin(__builtin_ia32_sha256rnds2)
+#define SHA_HW_X86 1
+#endif
+#elif __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#define SHA_HW_X86 1
+#endif
+#endif
+
+#ifdef SHA_HW_X86
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define SHA_TARGET __attribute__((target("sha,sse4.1")))
+
+static int has_sha_extensions(void) {
+    unsigned int a, b, c, d;
+
+    if (!__get_cpuid(1, &a, &b, &c, &d)) return 0;
+    // SSSE3 and SSE4.1, for the byte swap and the final blend.
+    if ((c & (1 << 9)) == 0 || (c & (1 << 19)) == 0) return 0;
+    if (__get_cpuid_max(0, NULL) < 7) return 0;
+    __cpuid_count(7, 0, a, b, c, d);
+    return (b & (1 << 29)) != 0;
+}
+
+// Four rounds of SHA-1. m[] holds the message words of the last four
+// groups of rounds, and is updated in place to those of the next ones:
+// sha1msg1 and the xor start a new group from older ones, sha1msg2
+// finishes the one for the next group. e0 holds E with the words of
+// the group added, e1 receives A for the next group.
+#define SHA1_ROUNDS(g, f, e0, e1) do {                          \
+    if ((g) < 4) {                                              \
+        m[(g) & 3] = _mm_shuffle_epi8(                          \
+                _mm_loadu_si128((const __m128i*)(data + 16 * (g))), mask); \
+    }                                                           \
+    if ((g) == 0) {                                             \
+        e0 = _mm_add_epi32(e0, m[0]);                           \
+    } else {                                                    \
+        e0 = _mm_sha1nexte_epu32(e0, m[(g) & 3]);               \
+    }                                                           \
+    e1 = abcd;                                                  \
+    if ((g) >= 3 && (g) <= 18) {                                \
+        m[((g) + 1) & 3] = _mm_sha1msg2_epu32(m[((g) + 1) & 3], m[(g) & 3]); \
+    }                                                           \
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, f);                    \
+    if ((g) >= 1 && (g) <= 16) {                                \
+        m[((g) - 1) & 3] = _mm_sha1msg1_epu32(m[((g) - 1) & 3], m[(g) & 3]); \
+    }                                                           \
+    if ((g) >= 2 && (g) <= 17) {                                \
+        m[((g) - 2) & 3] = _mm_xor_si128(m[((g) - 2) & 3], m[(g) & 3]); \
+    }                                                           \
+} while (0)
+
+SHA_TARGET
+static void SHA1_blocks_x86(uint32_t* state, const uint8_t* data, int blocks) {
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,
+                                        0x08090a0b0c0d0e0fULL);
+    __m128i abcd = _mm_shuffle_epi32(
+            _mm_loadu_si128((const __m128i*)state), 0x1b);
+    __m128i e = _mm_set_epi32(state[4], 0, 0, 0);
+
+    for (; blocks > 0; --blocks, data += 64) {
+        const __m128i abcd_save = abcd;
+        const __m128i e_save = e;
+        __m128i m[4];
+        __m128i e1;
+
+        SHA1_ROUNDS( 0, 0, e, e1);
+        SHA1_ROUNDS( 1, 0, e1, e);
+        SHA1_ROUNDS( 2, 0, e, e1);
+        SHA1_ROUNDS( 3, 0, e1, e);
+        SHA1_ROUNDS( 4, 0, e, e1);
+        SHA1_ROUNDS( 5, 1, e1, e);
+        SHA1_ROUNDS( 6, 1, e, e1);
+        SHA1_ROUNDS( 7, 1, e1, e);
+        SHA1_ROUNDS( 8, 1, e, e1);
+        SHA1_ROUNDS( 9, 1, e1, e);
+        SHA1_ROUNDS(10, 2, e, e1);
+        SHA1_ROUNDS(11, 2, e1, e);
+        SHA1_ROUNDS(12, 2, e, e1);
+        SHA1_ROUNDS(13, 2, e1, e);
+        SHA1_ROUNDS(14, 2, e, e1);
+        SHA1_ROUNDS(15, 3, e1, e);
+        SHA1_ROUNDS(16, 3, e, e1);
+        SHA1_ROUNDS(17, 3, e1, e);
+        SHA1_ROUNDS(18, 3, e, e1);
+        SHA1_ROUNDS(19, 3, e1, e);
+
+        e = _mm_sha1nexte_epu32(e, e_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1b));
+    state[4] = _mm_extract_epi32(e, 3);
+}
+
+static const uint32_t K256[64] __attribute__((aligned(16))) = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+
+// Four rounds of SHA-256, same idea as SHA1_ROUNDS: the words of group
+// g + 1 are W[t-16] + s0(W[t-15]) from sha256msg1, plus W[t-7] which
+// straddles groups g - 1 and g, plus s1(W[t-2]) from sha256msg2. They
+// must be done before sha256msg1 overwrites group g - 1.
+#define SHA256_ROUNDS(g) do {                                   \
+    __m128i k;                                                  \
+    if ((g) < 4) {                                              \
+        m[(g) & 3] = _mm_shuffle_epi8(                          \
+                _mm_loadu_si128((const __m128i*)(data + 16 * (g))), mask); \
+    }                                                           \
+    k = _mm_add_epi32(m[(g) & 3],                               \
+            _mm_load_si128((const __m128i*)(K256 + 4 * (g))));  \
+    cdgh = _mm_sha256rnds2_epu32(cdgh, abef, k);                \
+    if ((g) >= 3 && (g) <= 14) {                                \
+        m[((g) + 1) & 3] = _mm_add_epi32(m[((g) + 1) & 3],      \
+                _mm_alignr_epi8(m[(g) & 3], m[((g) - 1) & 3], 4)); \
+        m[((g) + 1) & 3] = _mm_sha256msg2_epu32(m[((g) + 1) & 3], m[(g) & 3]); \
+    }                                                           \
+    abef = _mm_sha256rnds2_epu32(abef, cdgh,                    \
+            _mm_shuffle_epi32(k, 0x0e));                        \
+    if ((g) >= 1 && (g) <= 12) {                                \
+        m[((g) - 1) & 3] = _mm_sha256msg1_epu32(m[((g) - 1) & 3], m[(g) & 3]); \
+    }                                                           \
+} while (0)
+
+SHA_TARGET
+static void SHA256_blocks_x86(uint32_t* state, const uint8_t* data, int blocks) {
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                        0x0405060700010203ULL);
+    // The instructions want the state as ABEF and CDGH.
+    __m128i cdab = _mm_shuffle_epi32(
+            _mm_loadu_si128((const __m128i*)state), 0xb1);
+    __m128i efgh = _mm_shuffle_epi32(
+            _mm_loadu_si128((const __m128i*)(state + 4)), 0x1b);
+    __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+    for (; blocks > 0; --blocks, data += 64) {
+        const __m128i abef_save = abef;
+        const __m128i cdgh_save = cdgh;
+        __m128i m[4];
+
+        SHA256_ROUNDS( 0);
+        SHA256_ROUNDS( 1);
+        SHA256_ROUNDS( 2);
+        SHA256_ROUNDS( 3);
+        SHA256_ROUNDS( 4);
+        SHA256_ROUNDS( 5);
+        SHA256_ROUNDS( 6);
+        SHA256_ROUNDS( 7);
+        SHA256_ROUNDS( 8);
+        SHA256_ROUNDS( 9);
+        SHA256_ROUNDS(10);
+        SHA256_ROUNDS(11);
+        SHA256_ROUNDS(12);
+        SHA256_ROUNDS(13);
+        SHA256_ROUNDS(14);
+        SHA256_ROUNDS(15);
+
+        abef = _mm_add_epi32(abef, abef_save);
+        cdgh = _mm_add_epi32(cdgh, cdgh_save);
+    }
+
+    cdab = _mm_shuffle_epi32(abef, 0x1b);   // now FEBA
+    efgh = _mm_shuffle_epi32(cdgh, 0xb1);   // now DCHG
+    _mm_storeu_si128((__m128i*)state, _mm_blend_epi16(cdab, efgh, 0xf0));
+    _mm_storeu_si128((__m128i*)(state + 4), _mm_alignr_epi8(efgh, cdab, 8));
+}
+
+SHA_blocks_fn SHA1_blocks_hw(void) {
+    return has_sha_extensions() ? SHA1_blocks_x86 : NULL;
+}
+
+SHA_blocks_fn SHA256_blocks_hw(void) {
+    return has_sha_extensions() ? SHA256_blocks_x86 : NULL;
+}
+
+#else  // !SHA_HW_X86
+
+SHA_blocks_fn SHA1_blocks_hw(void) {
+    return NULL;
+}
+
+SHA_blocks_fn SHA256_blocks_hw(void) {
+    return NULL;
+}
+
+#endif  // SHA_HW_X86
@@ -0,0 +1,88 @@
+/* sha_hw.h
+**
+** Copyright 2013, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of Google Inc. nor the names of its contributors may
+**       be used to endorse or promote products derived from this software
+**       without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY Google Inc. ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+** MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+** EVENT SHALL Google Inc. BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Block functions shared by sha.c, sha256.c and sha_hw.c. Not part of
+// the public API.
+
+#ifndef SYSTEM_CORE_LIBMINCRYPT_SHA_HW_H_
+#define SYSTEM_CORE_LIBMINCRYPT_SHA_HW_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// Hashes blocks consecutive 64-byte blocks of data into state.
+typedef void (*SHA_blocks_fn)(uint32_t* state, const uint8_t* data, int blocks);
+
+// Portable implementations.
+void SHA1_blocks_c(uint32_t* state, const uint8_t* data, int blocks);
+void SHA256_blocks_c(uint32_t* state, const uint8_t* data, int blocks);
+
+// Implementations using the CPU's hash instructions, or NULL if the CPU
+// running this (or the compiler that built it) has none.
+SHA_blocks_fn SHA1_blocks_hw(void);
+SHA_blocks_fn SHA256_blocks_hw(void);
+
+// Pads a message of count bytes, whose last count & 63 bytes are at the
+// start of tail, and appends its length in bits. tail must hold two
+// blocks, returns how many are used.
+static inline int SHA_pad(uint8_t* tail, uint64_t count) {
+    const int rest = (int) (count & 63);
+    const int blocks = rest < 56 ? 1 : 2;
+    uint8_t* p = tail + blocks * 64;
+    int i;
+
+    tail[rest] = 0x80;
+    memset(tail + rest + 1, 0, blocks * 64 - rest - 1);
+    count *= 8;
+    for (i = 1; i <= 8; ++i) {
+        p[-i] = (uint8_t) (count >> ((i - 1) * 8));
+    }
+    return blocks;
+}
+
+// The multi-buffer functions hash that many messages of the same length
+// at once, each in a lane of a vector. Only worth it where the vectors
+// are native, otherwise they're not built.
+#if defined(__SSE2__) || defined(__ARM_NEON__)
+#define SHA_MULTI_LANES 4
+typedef uint32_t sha_vec_t __attribute__((vector_size(16)));
+
+void SHA1_hash_lanes(const void* const* data, int len, uint8_t* digest);
+void SHA256_hash_lanes(const void* const* data, int len, uint8_t* digest);
+#else
+#define SHA_MULTI_LANES 1
+#endif
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif  // SYSTEM_CORE_LIBMINCRYPT_SHA_HW_H_
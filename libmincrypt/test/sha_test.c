@@ -0,0 +1,277 @@
+/* sha_test.c
+**
+** Copyright 2013, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of Google Inc. nor the names of its contributors may
+**       be used to endorse or promote products derived from this software
+**       without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY Google Inc. ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+** MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+** EVENT SHALL Google Inc. BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Checks the SHA-1 and SHA-256 implementations against each other and
+// the FIPS 180-2 examples, then measures their throughput.
+//
+// usage: sha_test [-n]      -n skips the benchmarks
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mincrypt/sha.h"
+#include "mincrypt/sha256.h"
+#include "../sha_hw.h"
+
+typedef struct {
+    const char* name;
+    int size;
+    void (*init)(HASH_CTX*);
+    const uint8_t* (*hash)(const void*, int, uint8_t*);
+    void (*hash_multi)(const void* const*, int, int, uint8_t*);
+    SHA_blocks_fn blocks_c;
+    SHA_blocks_fn blocks_hw;
+    void (*hash_lanes)(const void* const*, int, uint8_t*);
+    const char* expected[3];
+} Algorithm;
+
+// FIPS 180-2 appendix A and B: "abc", the 448-bit message, and a million
+// times 'a'.
+static const char* kMessage2 =
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+
+static Algorithm algorithms[2] = {
+    { "SHA-1", SHA_DIGEST_SIZE, SHA_init, SHA_hash, SHA_hash_multi,
+      SHA1_blocks_c, NULL, NULL,
+      { "a9993e364706816aba3e25717850c26c9cd0d89d",
+        "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+        "34aa973cd4c4daa4f61eeb2bdbad27316534016f" } },
+    { "SHA-256", SHA256_DIGEST_SIZE, SHA256_init, SHA256_hash, SHA256_hash_multi,
+      SHA256_blocks_c, NULL, NULL,
+      { "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+        "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" } },
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void tohex(const uint8_t* digest, int size, char* hex) {
+    int i;
+    for (i = 0; i < size; ++i) {
+        sprintf(hex + i * 2, "%02x", digest[i]);
+    }
+}
+
+// Hashes data with the given block function, bypassing HASH_CTX.
+static void hash_with(const Algorithm* alg, SHA_blocks_fn blocks,
+                      const uint8_t* data, int len, uint8_t* digest) {
+    HASH_CTX ctx;
+    uint8_t tail[128];
+    int i;
+
+    alg->init(&ctx);
+    blocks(ctx.state, data, len / 64);
+    memcpy(tail, data + (len & ~63), len & 63);
+    blocks(ctx.state, tail, SHA_pad(tail, len));
+    for (i = 0; i < alg->size; ++i) {
+        digest[i] = ctx.state[i / 4] >> (24 - (i % 4) * 8);
+    }
+}
+
+static int check_vectors(const Algorithm* alg) {
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    char hex[SHA256_DIGEST_SIZE * 2 + 1];
+    const int million = 1000000;
+    uint8_t* a = malloc(million);
+    HASH_CTX ctx;
+    int errors = 0;
+    int i;
+
+    memset(a, 'a', million);
+
+    tohex(alg->hash("abc", 3, digest), alg->size, hex);
+    errors += strcmp(hex, alg->expected[0]) != 0;
+    tohex(alg->hash(kMessage2, strlen(kMessage2), digest), alg->size, hex);
+    errors += strcmp(hex, alg->expected[1]) != 0;
+    tohex(alg->hash(a, million, digest), alg->size, hex);
+    errors += strcmp(hex, alg->expected[2]) != 0;
+
+    // Same thing, fed in odd sized pieces.
+    alg->init(&ctx);
+    for (i = 0; i < million; i += 997) {
+        HASH_update(&ctx, a + i, i + 997 < million ? 997 : million - i);
+    }
+    tohex(HASH_final(&ctx), alg->size, hex);
+    errors += strcmp(hex, alg->expected[2]) != 0;
+
+    free(a);
+    if (errors) {
+        printf("%s: %d FIPS 180-2 examples failed\n", alg->name, errors);
+    }
+    return errors;
+}
+
+// Random messages of every length up to a few blocks, through all the
+// implementations this machine can run.
+static int check_implementations(const Algorithm* alg) {
+    enum { MAX_LEN = 300, LANES = SHA_MULTI_LANES };
+    uint8_t* data[LANES];
+    uint8_t ref[LANES][SHA256_DIGEST_SIZE];
+    uint8_t digest[LANES * SHA256_DIGEST_SIZE];
+    int errors = 0;
+    int len, l;
+
+    for (l = 0; l < LANES; ++l) {
+        data[l] = malloc(MAX_LEN);
+    }
+
+    for (len = 0; len < MAX_LEN; ++len) {
+        for (l = 0; l < LANES; ++l) {
+            int i;
+            for (i = 0; i < len; ++i) {
+                data[l][i] = rand();
+            }
+            hash_with(alg, alg->blocks_c, data[l], len, ref[l]);
+        }
+
+        alg->hash(data[0], len, digest);
+        errors += memcmp(digest, ref[0], alg->size) != 0;
+
+        if (alg->blocks_hw) {
+            hash_with(alg, alg->blocks_hw, data[0], len, digest);
+            errors += memcmp(digest, ref[0], alg->size) != 0;
+        }
+
+        if (alg->hash_lanes) {
+            alg->hash_lanes((const void* const*) data, len, digest);
+            for (l = 0; l < LANES; ++l) {
+                errors += memcmp(digest + l * alg->size, ref[l], alg->size) != 0;
+            }
+        }
+
+        alg->hash_multi((const void* const*) data, len, LANES, digest);
+        for (l = 0; l < LANES; ++l) {
+            errors += memcmp(digest + l * alg->size, ref[l], alg->size) != 0;
+        }
+    }
+
+    for (l = 0; l < LANES; ++l) {
+        free(data[l]);
+    }
+    if (errors) {
+        printf("%s: %d mismatches between implementations\n", alg->name, errors);
+    }
+    return errors;
+}
+
+static void report(const char* what, int len, uint64_t bytes, uint64_t ns) {
+    printf("  %-12s %7d bytes  %8.1f MB/s\n", what, len,
+           (double) bytes * 1000 / ns);
+}
+
+static void benchmark(const Algorithm* alg) {
+    enum { TOTAL = 64 << 20, COUNT = 64 };
+    static const int sizes[] = { 64, 512, 4096, 65536 };
+    static uint8_t buffer[COUNT * 65536];
+    const void* data[COUNT];
+    uint8_t digests[COUNT * SHA256_DIGEST_SIZE];
+    unsigned int s;
+
+    printf("%s\n", alg->name);
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        const int len = sizes[s];
+        const int rounds = TOTAL / (len * COUNT);
+        uint64_t start;
+        int i, r;
+
+        for (i = 0; i < COUNT; ++i) {
+            data[i] = buffer + i * len;
+        }
+
+        start = now_ns();
+        for (r = 0; r < rounds; ++r) {
+            for (i = 0; i < COUNT; ++i) {
+                hash_with(alg, alg->blocks_c, data[i], len, digests);
+            }
+        }
+        report("portable", len, (uint64_t) rounds * COUNT * len, now_ns() - start);
+
+        if (alg->blocks_hw) {
+            start = now_ns();
+            for (r = 0; r < rounds; ++r) {
+                for (i = 0; i < COUNT; ++i) {
+                    hash_with(alg, alg->blocks_hw, data[i], len, digests);
+                }
+            }
+            report("instructions", len, (uint64_t) rounds * COUNT * len,
+                   now_ns() - start);
+        }
+
+        if (alg->hash_lanes) {
+            start = now_ns();
+            for (r = 0; r < rounds; ++r) {
+                for (i = 0; i < COUNT; i += SHA_MULTI_LANES) {
+                    alg->hash_lanes(data + i, len, digests);
+                }
+            }
+            report("vector lanes", len, (uint64_t) rounds * COUNT * len,
+                   now_ns() - start);
+        }
+
+        start = now_ns();
+        for (r = 0; r < rounds; ++r) {
+            alg->hash_multi(data, len, COUNT, digests);
+        }
+        report("hash_multi", len, (uint64_t) rounds * COUNT * len,
+               now_ns() - start);
+    }
+}
+
+int main(int argc, char** argv) {
+    int errors = 0;
+    int i;
+
+    algorithms[0].blocks_hw = SHA1_blocks_hw();
+    algorithms[1].blocks_hw = SHA256_blocks_hw();
+#if SHA_MULTI_LANES > 1
+    algorithms[0].hash_lanes = SHA1_hash_lanes;
+    algorithms[1].hash_lanes = SHA256_hash_lanes;
+#endif
+
+    for (i = 0; i < 2; ++i) {
+        errors += check_vectors(&algorithms[i]);
+        errors += check_implementations(&algorithms[i]);
+    }
+    if (errors) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("PASS\n");
+
+    if (argc < 2 || strcmp(argv[1], "-n") != 0) {
+        for (i = 0; i < 2; ++i) {
+            benchmark(&algorithms[i]);
+        }
+    }
+    return 0;
+}
@@ -23,6 +23,8 @@ PIXELFLINGER_SRC_FILES:= \
 	pixelflinger.cpp.arm \
 	trap.cpp.arm \
 	scanline.cpp.arm \
+	scanline_simd.cpp \
+	tiler.cpp \
 	format.cpp \
 	clear.cpp \
 	raster.cpp \
@@ -50,6 +52,11 @@ PIXELFLINGER_SRC_FILES += arch-mips/t32cb16blend.S
 PIXELFLINGER_CFLAGS += -fstrict-aliasing -fomit-frame-pointer
 endif
 
+ifeq ($(TARGET_ARCH),x86_64)
+PIXELFLINGER_SRC_FILES += codeflinger/X86_64Assembler.cpp
+PIXELFLINGER_CFLAGS += -fstrict-aliasing -fomit-frame-pointer
+endif
+
 LOCAL_SHARED_LIBRARIES := libcutils liblog
 
 #
@@ -19,6 +19,7 @@
 
 #include "clear.h"
 #include "buffer.h"
+#include "tiler.h"
 
 namespace android {
 
@@ -85,6 +86,33 @@ static void memset2d(context_t* c, const surface_t& s, uint32_t packed,
     }    
 }
 
+struct clear_args_t {
+    GGLbitfield mask;
+    uint32_t    l, t, w, h;
+};
+
+static void clear_tile(context_t* c, const void* args)
+{
+    const clear_args_t* clear = static_cast<const clear_args_t*>(args);
+    int32_t t = clear->t;
+    int32_t b = clear->t + clear->h;
+    if (t < c->band.top)
+        t = c->band.top;
+    if (b > c->band.bottom)
+        b = c->band.bottom;
+    if (t >= b)
+        return;
+
+    if (clear->mask & GGL_COLOR_BUFFER_BIT) {
+        memset2d(c, c->state.buffers.color, c->state.clear.colorPacked,
+                clear->l, t, clear->w, b - t);
+    }
+    if (clear->mask & GGL_DEPTH_BUFFER_BIT) {
+        memset2d(c, c->state.buffers.depth, c->state.clear.depthPacked,
+                clear->l, t, clear->w, b - t);
+    }
+}
+
 static inline GGLfixed fixedToZ(GGLfixed z) {
     return GGLfixed(((int64_t(z) << 16) - z) >> 16);
 }
@@ -127,8 +155,6 @@ static void ggl_clear(void* con, GGLbitfield mask)
 
             c->state.clear.colorPacked = GGL_HOST_TO_RGBA(colorPacked);
         }
-        const uint32_t packed = c->state.clear.colorPacked;
-        memset2d(c, c->state.buffers.color, packed, l, t, w, h);
     }
     if (mask & GGL_DEPTH_BUFFER_BIT) {
         if (c->state.clear.dirty & GGL_DEPTH_BUFFER_BIT) {
@@ -136,11 +162,14 @@ static void ggl_clear(void* con, GGLbitfield mask)
             uint32_t depth = fixedToZ(c->state.clear.depth);
             c->state.clear.depthPacked = (depth<<16)|depth;
         }
-        const uint32_t packed = c->state.clear.depthPacked;
-        memset2d(c, c->state.buffers.depth, packed, l, t, w, h);
     }
 
     // XXX: do stencil buffer
+
+    if (mask & (GGL_COLOR_BUFFER_BIT|GGL_DEPTH_BUFFER_BIT)) {
+        const clear_args_t args = { mask, l, t, w, h };
+        ggl_rasterize(c, t, t + h, w * h, clear_tile, &args);
+    }
 }
 
 static void ggl_clearColorx(void* con,
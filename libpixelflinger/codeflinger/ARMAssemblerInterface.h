@@ -63,7 +63,7 @@ public:
     };
 
     enum {
-        CODEGEN_ARCH_ARM = 1, CODEGEN_ARCH_MIPS
+        CODEGEN_ARCH_ARM = 1, CODEGEN_ARCH_MIPS, CODEGEN_ARCH_X86_64
     };
 
     // -----------------------------------------------------------------------
@@ -217,6 +217,19 @@ public:
     // bit manipulation...
     virtual void UBFX(int cc, int Rd, int Rn, int lsb, int width) = 0;
 
+    // pointers...
+    // these load, store and offset registers holding addresses. On 32-bit
+    // targets they are plain LDR/STR/ADD/SUB; 64-bit targets override them
+    // to use the full register width (Op2 is sign extended).
+    virtual void ADDR_LDR(int cc, int Rd,
+                int Rn, uint32_t offset = __immed12_pre(0));
+    virtual void ADDR_STR(int cc, int Rd,
+                int Rn, uint32_t offset = __immed12_pre(0));
+    virtual void ADDR_ADD(int cc, int s, int Rd,
+                int Rn, uint32_t Op2);
+    virtual void ADDR_SUB(int cc, int s, int Rd,
+                int Rn, uint32_t Op2);
+
     // -----------------------------------------------------------------------
     // convenience...
     // -----------------------------------------------------------------------
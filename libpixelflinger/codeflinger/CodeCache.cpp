@@ -17,8 +17,10 @@
 
 
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/mman.h>
 
@@ -28,6 +30,7 @@
 #include <cutils/log.h>
 
 
+#include "tinyutils/Errors.h"
 #include "CodeCache.h"
 
 namespace android {
@@ -151,69 +154,182 @@ ssize_t Assembly::resize(size_t newSize)
 // ----------------------------------------------------------------------------
 
 CodeCache::CodeCache(size_t size)
-    : mCacheSize(size), mCacheInUse(0)
+    : mCacheSize(size), mCacheInUse(0),
+      mBuckets(0), mBucketCount(0), mCount(0), mOldest(0), mNewest(0),
+      mHits(0), mMisses(0), mEvictions(0), mBytesEvicted(0), mJitTime(0)
 {
-    pthread_mutex_init(&mLock, 0);
+    pthread_rwlock_init(&mLock, 0);
+    grow();
 }
 
 CodeCache::~CodeCache()
 {
-    pthread_mutex_destroy(&mLock);
+    while (mOldest) {
+        cache_entry_t* e = mOldest;
+        remove(e);
+        delete e;
+    }
+    delete [] mBuckets;
+    pthread_rwlock_destroy(&mLock);
+}
+
+CodeCache::cache_entry_t* CodeCache::find(const AssemblyKeyBase& key,
+        uint32_t hash) const
+{
+    cache_entry_t* e = mBuckets[hash & (mBucketCount - 1)];
+    while (e) {
+        if (e->hash == hash && e->key->compare_type(key) == 0)
+            break;
+        e = e->next;
+    }
+    return e;
+}
+
+void CodeCache::insert(cache_entry_t* e)
+{
+    cache_entry_t** bucket = &mBuckets[e->hash & (mBucketCount - 1)];
+    e->next = *bucket;
+    *bucket = e;
+
+    e->older = mNewest;
+    e->newer = 0;
+    if (mNewest)    mNewest->newer = e;
+    else            mOldest = e;
+    mNewest = e;
+    mCount++;
+}
+
+void CodeCache::remove(cache_entry_t* e)
+{
+    cache_entry_t** p = &mBuckets[e->hash & (mBucketCount - 1)];
+    while (*p != e)
+        p = &(*p)->next;
+    *p = e->next;
+
+    if (e->older)   e->older->newer = e->newer;
+    else            mOldest = e->newer;
+    if (e->newer)   e->newer->older = e->older;
+    else            mNewest = e->older;
+    mCount--;
+}
+
+void CodeCache::evict()
+{
+    // second chance: entries hit since they were last looked at here
+    // go back to the newest end of the ring
+    cache_entry_t* e = mOldest;
+    while (e->referenced && e != mNewest) {
+        e->referenced = 0;
+        remove(e);
+        insert(e);
+        e = mOldest;
+    }
+    const ssize_t size = e->entry->size();
+    mCacheInUse -= size;
+    mBytesEvicted += size;
+    mEvictions++;
+    remove(e);
+    delete e;
+}
+
+void CodeCache::grow()
+{
+    const size_t count = mBucketCount ? mBucketCount * 2 : 16;
+    cache_entry_t** buckets = new cache_entry_t*[count];
+    memset(buckets, 0, count * sizeof(cache_entry_t*));
+    for (size_t i=0 ; i<mBucketCount ; i++) {
+        cache_entry_t* e = mBuckets[i];
+        while (e) {
+            cache_entry_t* next = e->next;
+            e->next = buckets[e->hash & (count - 1)];
+            buckets[e->hash & (count - 1)] = e;
+            e = next;
+        }
+    }
+    delete [] mBuckets;
+    mBuckets = buckets;
+    mBucketCount = count;
 }
 
 sp<Assembly> CodeCache::lookup(const AssemblyKeyBase& keyBase) const
 {
-    pthread_mutex_lock(&mLock);
+    const uint32_t hash = keyBase.hash();
     sp<Assembly> r;
-    ssize_t index = mCacheData.indexOfKey(key_t(keyBase));
-    if (index >= 0) {
-        const cache_entry_t& e = mCacheData.valueAt(index);
-        e.when = mWhen++;
-        r = e.entry;
+    pthread_rwlock_rdlock(&mLock);
+    cache_entry_t* e = find(keyBase, hash);
+    if (e) {
+        if (!e->referenced) {
+            android_atomic_release_store(1, &e->referenced);
+        }
+        r = e->entry;
     }
-    pthread_mutex_unlock(&mLock);
+    pthread_rwlock_unlock(&mLock);
+    android_atomic_inc(r != 0 ? &mHits : &mMisses);
     return r;
 }
 
 int CodeCache::cache(  const AssemblyKeyBase& keyBase,
-                            const sp<Assembly>& assembly)
+                            const sp<Assembly>& assembly,
+                            int64_t jitTime)
 {
-    pthread_mutex_lock(&mLock);
+    const uint32_t hash = keyBase.hash();
+    pthread_rwlock_wrlock(&mLock);
+
+    if (find(keyBase, hash)) {
+        // another thread got there first, its copy is as good as ours
+        pthread_rwlock_unlock(&mLock);
+        return NO_ERROR;
+    }
 
     const ssize_t assemblySize = assembly->size();
-    while (mCacheInUse + assemblySize > mCacheSize) {
-        // evict the LRU
-        size_t lru = 0;
-        size_t count = mCacheData.size();
-        for (size_t i=0 ; i<count ; i++) {
-            const cache_entry_t& e = mCacheData.valueAt(i);
-            if (e.when < mCacheData.valueAt(lru).when) {
-                lru = i;
-            }
-        }
-        const cache_entry_t& e = mCacheData.valueAt(lru);
-        mCacheInUse -= e.entry->size();
-        mCacheData.removeItemsAt(lru);
+    while (mOldest && mCacheInUse + assemblySize > mCacheSize) {
+        evict();
+    }
+
+    if (mCount >= mBucketCount) {
+        grow();
     }
+    insert(new cache_entry_t(keyBase, hash, assembly));
+    mCacheInUse += assemblySize;
+    mJitTime += jitTime;
 
-    ssize_t err = mCacheData.add(key_t(keyBase), cache_entry_t(assembly, mWhen));
-    if (err >= 0) {
-        mCacheInUse += assemblySize;
-        mWhen++;
-        // synchronize caches...
+    // synchronize caches...
+    int err = NO_ERROR;
 #if defined(__arm__) || defined(__mips__)
-        const long base = long(assembly->base());
-        const long curr = base + long(assembly->size());
-        err = cacheflush(base, curr, 0);
-        ALOGE_IF(err, "cacheflush error %s\n",
-                 strerror(errno));
+    const long base = long(assembly->base());
+    const long curr = base + long(assembly->size());
+    err = cacheflush(base, curr, 0);
+    ALOGE_IF(err, "cacheflush error %s\n",
+             strerror(errno));
 #endif
-    }
 
-    pthread_mutex_unlock(&mLock);
+    pthread_rwlock_unlock(&mLock);
     return err;
 }
 
+void CodeCache::getAssemblies(Vector< sp<Assembly> >* out) const
+{
+    pthread_rwlock_rdlock(&mLock);
+    out->setCapacity(mCount);
+    for (cache_entry_t* e = mOldest ; e ; e = e->newer) {
+        out->push(e->entry);
+    }
+    pthread_rwlock_unlock(&mLock);
+}
+
+void CodeCache::getStats(stats_t* stats) const
+{
+    pthread_rwlock_rdlock(&mLock);
+    stats->hits = mHits;
+    stats->misses = mMisses;
+    stats->evictions = mEvictions;
+    stats->bytesEvicted = mBytesEvicted;
+    stats->bytesInUse = mCacheInUse;
+    stats->entries = mCount;
+    stats->jitTime = mJitTime;
+    pthread_rwlock_unlock(&mLock);
+}
+
 // ----------------------------------------------------------------------------
 
 }; // namespace android
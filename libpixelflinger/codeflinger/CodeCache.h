@@ -23,7 +23,8 @@
 #include <pthread.h>
 #include <sys/types.h>
 
-#include "tinyutils/KeyedVector.h"
+#include "tinyutils/TypeHelpers.h"
+#include "tinyutils/Vector.h"
 #include "tinyutils/smartpointer.h"
 
 namespace android {
@@ -36,6 +37,7 @@ class AssemblyKeyBase {
 public:
     virtual ~AssemblyKeyBase() { }
     virtual int compare_type(const AssemblyKeyBase& key) const = 0;
+    virtual uint32_t hash() const = 0;
 };
 
 template  <typename T>
@@ -47,6 +49,10 @@ public:
         const T& rhs = static_cast<const AssemblyKey&>(key).mKey;
         return android::compare_type(mKey, rhs);
     }
+    virtual uint32_t hash() const {
+        return hash_type(mKey);
+    }
+    const T& value() const { return mKey; }
 private:
     T mKey;
 };
@@ -86,48 +92,67 @@ public:
             sp<Assembly>        lookup(const AssemblyKeyBase& key) const;
 
             int                 cache(  const AssemblyKeyBase& key,
-                                        const sp<Assembly>& assembly);
+                                        const sp<Assembly>& assembly,
+                                        int64_t jitTime = 0);
+
+    // the cached assemblies, from the least to the most recently inserted
+            void                getAssemblies(Vector< sp<Assembly> >* out) const;
+
+    // counters, for profiling
+    struct stats_t {
+        uint32_t    hits;
+        uint32_t    misses;
+        uint32_t    evictions;
+        size_t      bytesEvicted;
+        size_t      bytesInUse;
+        size_t      entries;
+        int64_t     jitTime;        // total ns spent generating cached code
+    };
+            void                getStats(stats_t* stats) const;
 
 private:
     // nothing to see here...
+    // Entries live both on a hash chain and on a ring ordered from the
+    // least to the most recently inserted. A hit only sets the entry's
+    // referenced bit, so lookups can share the lock; eviction gives
+    // referenced entries a second chance by moving them to the back.
     struct cache_entry_t {
-        inline cache_entry_t() { }
-        inline cache_entry_t(const sp<Assembly>& a, int64_t w)
-                : entry(a), when(w) { }
+        cache_entry_t(const AssemblyKeyBase& k, uint32_t h,
+                const sp<Assembly>& a)
+                : key(&k), hash(h), entry(a), referenced(0),
+                  next(0), older(0), newer(0) { }
+        const AssemblyKeyBase*  key;
+        uint32_t                hash;
         sp<Assembly>            entry;
-        mutable int64_t         when;
+        mutable int32_t         referenced;
+        cache_entry_t*          next;       // hash chain
+        cache_entry_t*          older;      // LRU ring
+        cache_entry_t*          newer;
     };
 
-    class key_t {
-        friend int compare_type(
-            const key_value_pair_t<key_t, cache_entry_t>&,
-            const key_value_pair_t<key_t, cache_entry_t>&);
-        const AssemblyKeyBase* mKey;
-    public:
-        key_t() { };
-        key_t(const AssemblyKeyBase& k) : mKey(&k)  { }
-    };
+            cache_entry_t*      find(const AssemblyKeyBase& key,
+                                     uint32_t hash) const;
+            void                insert(cache_entry_t* e);
+            void                remove(cache_entry_t* e);
+            void                evict();
+            void                grow();
 
-    mutable pthread_mutex_t             mLock;
-    mutable int64_t                     mWhen;
+    mutable pthread_rwlock_t            mLock;
     size_t                              mCacheSize;
     size_t                              mCacheInUse;
-    KeyedVector<key_t, cache_entry_t>   mCacheData;
-
-    friend int compare_type(
-        const key_value_pair_t<key_t, cache_entry_t>&,
-        const key_value_pair_t<key_t, cache_entry_t>&);
+    cache_entry_t**                     mBuckets;
+    size_t                              mBucketCount;   // power of two
+    size_t                              mCount;
+    cache_entry_t*                      mOldest;
+    cache_entry_t*                      mNewest;
+
+    mutable int32_t                     mHits;
+    mutable int32_t                     mMisses;
+    uint32_t                            mEvictions;
+    size_t                              mBytesEvicted;
+    int64_t                             mJitTime;
 };
 
-// KeyedVector uses compare_type(), which is more efficient, than
-// just using operator < ()
-inline int compare_type(
-    const key_value_pair_t<CodeCache::key_t, CodeCache::cache_entry_t>& lhs,
-    const key_value_pair_t<CodeCache::key_t, CodeCache::cache_entry_t>& rhs)
-{
-    return lhs.key.mKey->compare_type(*(rhs.key.mKey));
-}
-
 // ----------------------------------------------------------------------------
 
 }; // namespace android
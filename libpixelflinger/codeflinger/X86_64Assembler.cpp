@@ -0,0 +1,1689 @@
+/* libs/pixelflinger/codeflinger/X86_64Assembler.cpp
+**
+** Copyright 2013, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+
+/* x86-64 assembler and ARM->x86-64 assembly translator
+**
+** Like the MIPS back-end, this leaves GGLAssembler generating Arm
+** instructions, and translates each of them to one or more x86-64
+** instructions.
+**
+**
+** Registers
+**
+** Arm registers map one to one onto x86-64 registers, with the context
+** (R0) in rdi where the SysV ABI passes the first argument. r11 and rcx
+** are scratch registers for the translation. That leaves no register for
+** R11, which the register allocator keeps reserved on x86-64; pipelines
+** that run out of registers are retried at a lower optimization level.
+**
+** Known limitation: there is no spilling, so a pipeline that still needs
+** more registers fails, and scanline.cpp renders it with the generic
+** pipeline. That is the case of every pipeline that filters a texture
+** linearly: filter16() and filter32() want all the registers Arm has.
+**
+** Data processing uses the 32-bit forms of instructions, which clear the
+** upper half of the destination. Pointers are 64-bit: GGLAssembler moves
+** them with ADDR_LDR/ADDR_STR/ADDR_ADD/ADDR_SUB, and plain register moves
+** copy the whole register.
+**
+**
+** Condition flags
+**
+** Arm only writes the flags in S-instructions, while most x86-64 arithmetic
+** writes them. Non-S instructions use lea and mov where they can; when one
+** must destroy flags that are still needed, the flags are saved to a stack
+** slot first (pushf), and reloaded (popf) by the next instruction that
+** tests them. Conditional instructions become a short branch around their
+** translation.
+*/
+
+
+#define LOG_TAG "X86_64Assembler"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/log.h>
+#include <cutils/properties.h>
+
+#include <private/pixelflinger/ggl_context.h>
+
+#include "X86_64Assembler.h"
+#include "CodeCache.h"
+
+#define NOT_IMPLEMENTED()  LOG_ALWAYS_FATAL("Arm instruction %s not yet implemented\n", __func__)
+
+// ----------------------------------------------------------------------------
+
+namespace android {
+
+// ----------------------------------------------------------------------------
+#if 0
+#pragma mark -
+#pragma mark ArmToX86_64Assembler...
+#endif
+
+typedef X86_64Assembler X86;
+
+// x86-64 register for each Arm register, -1 when it has none
+static const int8_t gArmToX86[16] = {
+    X86::RDI, X86::RSI, X86::RDX, X86::RAX,     // R0 - R3
+    X86::R10, X86::RBX, X86::RBP, X86::R12,     // R4 - R7
+    X86::R13, X86::R14, X86::R15, -1,           // R8 - R11
+    X86::R8,  -1,       X86::R9,  -1            // R12, SP, LR, PC
+};
+// SP is only accessed by push and pop, GGLAssembler uses it as a data
+// register only when it runs out of registers.
+
+// Arm registers living in x86-64 callee-saved registers, in push order
+static const int8_t gCalleeSaved[] = {
+    ARMAssemblerInterface::R5, ARMAssemblerInterface::R6,
+    ARMAssemblerInterface::R7, ARMAssemblerInterface::R8,
+    ARMAssemblerInterface::R9, ARMAssemblerInterface::R10
+};
+
+// pushes of all the callee-saved registers, and of the flags slot
+static const int PROLOG_SIZE = 11;
+
+ArmToX86_64Assembler::ArmToX86_64Assembler(const sp<Assembly>& assembly)
+    :   ARMAssemblerInterface(),
+        mAssembly(assembly)
+{
+    mX86 = new X86_64Assembler(assembly);
+    reset();
+}
+
+ArmToX86_64Assembler::~ArmToX86_64Assembler()
+{
+    delete mX86;
+}
+
+uint32_t* ArmToX86_64Assembler::pc() const
+{
+    return (uint32_t*)mX86->pc();
+}
+
+uint32_t* ArmToX86_64Assembler::base() const
+{
+    return (uint32_t*)mX86->base();
+}
+
+void ArmToX86_64Assembler::reset()
+{
+    mX86->reset();
+    memset(&mFlags, 0, sizeof(mFlags));
+    mStackDepth = 0;
+    mPrologPC = 0;
+    mBadRegister = 0;
+}
+
+int ArmToX86_64Assembler::getCodegenArch()
+{
+    return CODEGEN_ARCH_X86_64;
+}
+
+void ArmToX86_64Assembler::disassemble(const char* name)
+{
+    mX86->disassemble(name);
+}
+
+int ArmToX86_64Assembler::generate(const char* name)
+{
+    if (mBadRegister) {
+        ALOGE("%s uses Arm register r%d, which has no x86-64 register\n",
+              name, mBadRegister);
+        return BAD_VALUE;
+    }
+    return mX86->generate(name);
+}
+
+void ArmToX86_64Assembler::comment(const char* string)
+{
+    mX86->comment(string);
+}
+
+void ArmToX86_64Assembler::label(const char* theLabel)
+{
+    mX86->label(theLabel);
+    // GGLAssembler never tests flags set before a label
+    mFlags.live = false;
+    mFlags.saved = false;
+}
+
+uint32_t* ArmToX86_64Assembler::pcForLabel(const char* label)
+{
+    return (uint32_t*)mX86->pcForLabel(label);
+}
+
+// GGLAssembler can use a register it failed to allocate in a pass it will
+// retry at a lower optimization level, so this isn't fatal here; the code
+// is refused in generate() if such a register is still used.
+int ArmToX86_64Assembler::xreg(int reg)
+{
+    if (reg < 0 || reg > 15 || gArmToX86[reg] < 0) {
+        mBadRegister = reg;
+        return TMP0;
+    }
+    return gArmToX86[reg];
+}
+
+void ArmToX86_64Assembler::prolog()
+{
+    // the callee-saved registers are only known in epilog()
+    mPrologPC = mX86->pc();
+    mX86->NOP(PROLOG_SIZE);
+}
+
+void ArmToX86_64Assembler::epilog(uint32_t touched)
+{
+    LOG_ALWAYS_FATAL_IF(mStackDepth, "unbalanced stack in epilog");
+    const int count = sizeof(gCalleeSaved) / sizeof(gCalleeSaved[0]);
+
+    // write prolog code
+    uint8_t* pc = mX86->mPC;
+    mX86->mPC = mPrologPC;
+    for (int i = 0; i < count; i++) {
+        if (touched & (1 << gCalleeSaved[i]))
+            mX86->PUSH(xreg(gCalleeSaved[i]));
+    }
+    mX86->PUSH(X86::RAX);   // flags slot
+    mX86->NOP(PROLOG_SIZE - int(mX86->mPC - mPrologPC));
+    mX86->mPC = pc;
+
+    // write epilog code
+    mX86->POP(TMP1);
+    for (int i = count - 1; i >= 0; i--) {
+        if (touched & (1 << gCalleeSaved[i]))
+            mX86->POP(xreg(gCalleeSaved[i]));
+    }
+    mX86->RET();
+}
+
+
+// ----------------------------------------------------------------------------
+#if 0
+#pragma mark -
+#pragma mark Condition flags...
+#endif
+
+void ArmToX86_64Assembler::clobberFlags()
+{
+    if (mFlags.setting)
+        return;
+    if (mFlags.live && mFlags.inCpu && !mFlags.saved) {
+        LOG_ALWAYS_FATAL_IF(mFlags.conditional,
+                            "flags saved inside a conditional instruction");
+        mX86->PUSHF();
+        mX86->POP(X86::mem_t(X86::RSP, mStackDepth));
+        mFlags.saved = true;
+    }
+    mFlags.inCpu = false;
+}
+
+void ArmToX86_64Assembler::restoreFlags()
+{
+    LOG_ALWAYS_FATAL_IF(!mFlags.live, "condition tested before flags are set");
+    if (!mFlags.inCpu) {
+        mX86->PUSH(X86::mem_t(X86::RSP, mStackDepth));
+        mX86->POPF();
+        mFlags.inCpu = true;
+    }
+}
+
+void ArmToX86_64Assembler::setFlags(int kind)
+{
+    mFlags.live = true;
+    mFlags.inCpu = true;
+    mFlags.saved = false;
+    mFlags.kind = kind;
+}
+
+int ArmToX86_64Assembler::condition(int cc) const
+{
+    switch (cc) {
+    case EQ:    return X86::CC_E;
+    case NE:    return X86::CC_NE;
+    case MI:    return X86::CC_S;
+    case PL:    return X86::CC_NS;
+    case VS:    return X86::CC_O;
+    case VC:    return X86::CC_NO;
+    case GE:    return X86::CC_GE;
+    case LT:    return X86::CC_L;
+    case GT:    return X86::CC_G;
+    case LE:    return X86::CC_LE;
+    case HS:
+        if (mFlags.kind == FLAGS_SUB)   return X86::CC_AE;
+        if (mFlags.kind == FLAGS_ADD)   return X86::CC_B;
+        break;
+    case LO:
+        if (mFlags.kind == FLAGS_SUB)   return X86::CC_B;
+        if (mFlags.kind == FLAGS_ADD)   return X86::CC_AE;
+        break;
+    case HI:
+        if (mFlags.kind == FLAGS_SUB)   return X86::CC_A;
+        break;
+    case LS:
+        if (mFlags.kind == FLAGS_SUB)   return X86::CC_BE;
+        break;
+    }
+    LOG_ALWAYS_FATAL("condition %d cannot be translated here", cc);
+    return X86::CC_O;
+}
+
+void ArmToX86_64Assembler::beginConditional(int cc, bool clobbers)
+{
+    restoreFlags();
+    if (clobbers && mFlags.live && !mFlags.saved) {
+        // save on both paths, the instruction may be skipped
+        mX86->PUSHF();
+        mX86->POP(X86::mem_t(X86::RSP, mStackDepth));
+        mFlags.saved = true;
+    }
+    mFlags.conditional = true;
+    mFlags.skip = mX86->JCC8(condition(cc) ^ 1);
+}
+
+void ArmToX86_64Assembler::endConditional()
+{
+    mX86->bind(mFlags.skip);
+    mFlags.conditional = false;
+}
+
+void ArmToX86_64Assembler::begin(int cc, int s, bool clobbers)
+{
+    LOG_ALWAYS_FATAL_IF(s && cc != AL,
+                        "conditional flag-setting instructions not supported");
+    if (cc != AL) {
+        beginConditional(cc, clobbers);
+    } else if (clobbers && !s) {
+        clobberFlags();
+    }
+    mFlags.setting = s;
+}
+
+void ArmToX86_64Assembler::end(int cc, int s, int kind)
+{
+    mFlags.setting = false;
+    if (s)
+        setFlags(kind);
+    if (cc != AL)
+        endConditional();
+}
+
+
+// ----------------------------------------------------------------------------
+#if 0
+#pragma mark -
+#pragma mark Addressing modes & shifters...
+#endif
+
+int ArmToX86_64Assembler::buildImmediate(
+        uint32_t immediate, uint32_t& rot, uint32_t& imm)
+{
+    // for x86-64, any 32-bit immediate is OK
+    rot = 0;
+    imm = immediate;
+    return 0;
+}
+
+bool ArmToX86_64Assembler::isValidImmediate(uint32_t immediate)
+{
+    // for x86-64, any 32-bit immediate is OK
+    return true;
+}
+
+uint32_t ArmToX86_64Assembler::imm(uint32_t immediate)
+{
+    amode.value = immediate;
+    return AMODE_IMM;
+}
+
+uint32_t ArmToX86_64Assembler::reg_imm(int Rm, int type, uint32_t shift)
+{
+    amode.reg = Rm;
+    amode.stype = type;
+    amode.value = shift;
+    return AMODE_REG_IMM;
+}
+
+uint32_t ArmToX86_64Assembler::reg_rrx(int Rm)
+{
+    // reg_rrx mode is not used in the GLLAssember code at this time
+    return AMODE_UNSUPPORTED;
+}
+
+uint32_t ArmToX86_64Assembler::reg_reg(int Rm, int type, int Rs)
+{
+    // reg_reg mode is not used in the GLLAssember code at this time
+    return AMODE_UNSUPPORTED;
+}
+
+// Unlike Arm, the offsets are not limited to 12 or 8 bits; the context
+// of a 64-bit process is larger than one of a 32-bit process.
+
+uint32_t ArmToX86_64Assembler::immed12_pre(int32_t immed12, int W)
+{
+    amode.value = immed12;
+    amode.writeback = W;
+    return AMODE_IMM_12_PRE;
+}
+
+uint32_t ArmToX86_64Assembler::immed12_post(int32_t immed12)
+{
+    amode.value = immed12;
+    return AMODE_IMM_12_POST;
+}
+
+uint32_t ArmToX86_64Assembler::reg_scale_pre(int Rm, int type,
+        uint32_t shift, int W)
+{
+    amode.reg = abs(Rm);
+    amode.negative = Rm < 0;
+    amode.stype = type;
+    amode.value = shift;
+    amode.writeback = W;
+    return AMODE_REG_SCALE_PRE;
+}
+
+uint32_t ArmToX86_64Assembler::reg_scale_post(int Rm, int type, uint32_t shift)
+{
+    amode.reg = abs(Rm);
+    amode.negative = Rm < 0;
+    amode.stype = type;
+    amode.value = shift;
+    return AMODE_REG_SCALE_POST;
+}
+
+uint32_t ArmToX86_64Assembler::immed8_pre(int32_t immed8, int W)
+{
+    amode.value = immed8;
+    amode.writeback = W;
+    return AMODE_IMM_8_PRE;
+}
+
+uint32_t ArmToX86_64Assembler::immed8_post(int32_t immed8)
+{
+    amode.value = immed8;
+    return AMODE_IMM_8_POST;
+}
+
+uint32_t ArmToX86_64Assembler::reg_pre(int Rm, int W)
+{
+    amode.reg = abs(Rm);
+    amode.negative = Rm < 0;
+    amode.stype = LSL;
+    amode.value = 0;
+    amode.writeback = W;
+    return AMODE_REG_PRE;
+}
+
+uint32_t ArmToX86_64Assembler::reg_post(int Rm)
+{
+    amode.reg = abs(Rm);
+    amode.negative = Rm < 0;
+    amode.stype = LSL;
+    amode.value = 0;
+    return AMODE_REG_POST;
+}
+
+int ArmToX86_64Assembler::dataOperand(uint32_t op2, int tmp, uint32_t& immediate)
+{
+    if (op2 < AMODE_REG)
+        return xreg(op2);
+
+    if (op2 == AMODE_IMM) {
+        immediate = amode.value;
+        return -1;
+    }
+
+    LOG_ALWAYS_FATAL_IF(op2 != AMODE_REG_IMM, "unsupported operand %d", op2);
+    const int rm = xreg(amode.reg);
+    const uint32_t shift = amode.value & 0x1F;
+    if (shift == 0) {
+        // same meaning as the Arm encoding of a zero shift
+        switch (amode.stype) {
+        case LSL:
+            return rm;
+        case LSR:
+            immediate = 0;
+            return -1;
+        case ASR:
+            clobberFlags();
+            mX86->MOV(false, tmp, rm);
+            mX86->SHIFT(X86::opSAR, false, tmp, 31);
+            return tmp;
+        }
+        LOG_ALWAYS_FATAL("RRX operand not supported");
+    }
+
+    static const int ops[] = { X86::opSHL, X86::opSHR, X86::opSAR, X86::opROR };
+    clobberFlags();
+    mX86->MOV(false, tmp, rm);
+    mX86->SHIFT(ops[amode.stype], false, tmp, shift);
+    return tmp;
+}
+
+// LSL by 0 to 3 is folded into an address computation
+bool ArmToX86_64Assembler::isScaled(uint32_t op2) const
+{
+    return op2 == AMODE_REG_IMM && amode.stype == LSL && (amode.value & 0x1F) <= 3;
+}
+
+bool ArmToX86_64Assembler::isFlagFree(int opcode, uint32_t op2) const
+{
+    const bool plain = op2 < AMODE_REG || op2 == AMODE_IMM ||
+            (op2 == AMODE_REG_IMM && amode.stype == LSL && !(amode.value & 0x1F));
+    switch (opcode) {
+    case opMOV:
+    case opADD:
+        return plain || isScaled(op2);
+    case opMVN:
+        return plain;
+    case opSUB:
+        return op2 == AMODE_IMM;
+    }
+    return false;
+}
+
+
+// ----------------------------------------------------------------------------
+#if 0
+#pragma mark -
+#pragma mark Data Processing...
+#endif
+
+void ArmToX86_64Assembler::arithmetic(int op, bool commutative,
+        int d, int n, int src, uint32_t immediate)
+{
+    if (src < 0) {
+        if (d != n)
+            mX86->MOV(false, d, n);
+        mX86->ALUI(op, false, d, immediate);
+    } else if (src == d && d != n) {
+        if (commutative) {
+            mX86->ALU(op, false, d, n);
+        } else {
+            mX86->MOV(false, TMP1, n);
+            mX86->ALU(op, false, TMP1, src);
+            mX86->MOV(false, d, TMP1);
+        }
+    } else {
+        if (d != n)
+            mX86->MOV(false, d, n);
+        mX86->ALU(op, false, d, src);
+    }
+}
+
+void ArmToX86_64Assembler::dataProcessing(int opcode, int cc,
+        int s, int Rd, int Rn, uint32_t Op2)
+{
+    const bool test = opcode >= opTST && opcode <= opCMN;
+    s = s || test;
+    begin(cc, s, !isFlagFree(opcode, Op2));
+
+    const int d = test ? -1 : xreg(Rd);
+    const int n = (opcode == opMOV || opcode == opMVN) ? -1 : xreg(Rn);
+    int kind = FLAGS_LOGIC;
+
+    if (!s && (opcode == opMOV || opcode == opADD) &&
+            isScaled(Op2) && (amode.value & 0x1F)) {
+        // d = n + (m << shift) with lea, this leaves the flags alone
+        const int rm = xreg(amode.reg);
+        const int scale = 1 << (amode.value & 0x1F);
+        if (opcode == opADD) {
+            mX86->LEA(false, d, X86::mem_t(n, rm, scale));
+        } else if (scale == 2) {
+            mX86->LEA(false, d, X86::mem_t(rm, rm, 1));
+        } else {
+            mX86->LEA(false, d, X86::mem_t(X86::NO_REG, rm, scale));
+        }
+        end(cc, s, kind);
+        return;
+    }
+
+    uint32_t immediate = 0;
+    int src = dataOperand(Op2, TMP0, immediate);
+
+    switch (opcode) {
+    case opMOV:
+        if (src < 0) {
+            mX86->MOVI(d, immediate);
+        } else if (src != d) {
+            // copy the whole register, it may hold a pointer
+            mX86->MOV(Op2 < AMODE_REG, d, src);
+        }
+        if (s)
+            mX86->TEST(false, d, d);
+        break;
+    case opMVN:
+        if (src < 0) {
+            mX86->MOVI(d, ~immediate);
+        } else {
+            if (src != d)
+                mX86->MOV(false, d, src);
+            mX86->NOT(false, d);
+        }
+        if (s)
+            mX86->TEST(false, d, d);
+        break;
+    case opADD:
+        if (!s) {
+            if (src < 0)
+                mX86->LEA(false, d, X86::mem_t(n, int32_t(immediate)));
+            else
+                mX86->LEA(false, d, X86::mem_t(n, src, 1));
+            break;
+        }
+        arithmetic(X86::opADD, true, d, n, src, immediate);
+        kind = FLAGS_ADD;
+        break;
+    case opSUB:
+        if (!s && src < 0) {
+            mX86->LEA(false, d, X86::mem_t(n, int32_t(0u - immediate)));
+            break;
+        }
+        arithmetic(X86::opSUB, false, d, n, src, immediate);
+        kind = FLAGS_SUB;
+        break;
+    case opRSB:
+        if (src < 0 && immediate == 0) {
+            if (d != n)
+                mX86->MOV(false, d, n);
+            mX86->NEG(false, d);
+        } else if (d != n) {
+            if (src < 0)
+                mX86->MOVI(d, immediate);
+            else if (src != d)
+                mX86->MOV(false, d, src);
+            mX86->ALU(X86::opSUB, false, d, n);
+        } else {
+            if (src < 0)
+                mX86->MOVI(TMP1, immediate);
+            else
+                mX86->MOV(false, TMP1, src);
+            mX86->ALU(X86::opSUB, false, TMP1, n);
+            mX86->MOV(false, d, TMP1);
+        }
+        kind = FLAGS_SUB;
+        break;
+    case opAND:
+        arithmetic(X86::opAND, true, d, n, src, immediate);
+        break;
+    case opORR:
+        arithmetic(X86::opOR, true, d, n, src, immediate);
+        break;
+    case opEOR:
+        arithmetic(X86::opXOR, true, d, n, src, immediate);
+        break;
+    case opBIC:
+        if (src < 0) {
+            immediate = ~immediate;
+        } else {
+            mX86->MOV(false, TMP1, src);
+            mX86->NOT(false, TMP1);
+            src = TMP1;
+        }
+        arithmetic(X86::opAND, true, d, n, src, immediate);
+        break;
+    case opTST:
+        if (src < 0)
+            mX86->TESTI(n, immediate);
+        else
+            mX86->TEST(false, n, src);
+        break;
+    case opTEQ:
+        mX86->MOV(false, TMP1, n);
+        if (src < 0)
+            mX86->ALUI(X86::opXOR, false, TMP1, immediate);
+        else
+            mX86->ALU(X86::opXOR, false, TMP1, src);
+        break;
+    case opCMP:
+        if (src < 0)
+            mX86->ALUI(X86::opCMP, false, n, immediate);
+        else
+            mX86->ALU(X86::opCMP, false, n, src);
+        kind = FLAGS_SUB;
+        break;
+    case opCMN:
+        mX86->MOV(false, TMP1, n);
+        if (src < 0)
+            mX86->ALUI(X86::opADD, false, TMP1, immediate);
+        else
+            mX86->ALU(X86::opADD, false, TMP1, src);
+        kind = FLAGS_ADD;
+        break;
+    case opADC:
+    case opSBC:
+    case opRSC:
+        // the carry is not tracked across instructions
+        LOG_ALWAYS_FATAL("Arm opcode %d not yet implemented\n", opcode);
+        break;
+    }
+
+    end(cc, s, kind);
+}
+
+
+// ----------------------------------------------------------------------------
+#if 0
+#pragma mark -
+#pragma mark Multiply...
+#endif
+
+void ArmToX86_64Assembler::MLA(int cc, int s,
+        int Rd, int Rm, int Rs, int Rn)
+{
+    begin(cc, s, true);
+    mX86->MOV(false, TMP0, xreg(Rm));
+    mX86->IMUL(false, TMP0, xreg(Rs));
+    if (s) {
+        mX86->ALU(X86::opADD, false, TMP0, xreg(Rn));
+        mX86->MOV(false, xreg(Rd), TMP0);
+    } else {
+        mX86->LEA(false, xreg(Rd), X86::mem_t(TMP0, xreg(Rn), 1));
+    }
+    end(cc, s, FLAGS_LOGIC);
+}
+
+void ArmToX86_64Assembler::MUL(int cc, int s,
+        int Rd, int Rm, int Rs)
+{
+    begin(cc, s, true);
+    const int d = xreg(Rd);
+    if (d == xreg(Rm)) {
+        mX86->IMUL(false, d, xreg(Rs));
+    } else if (d == xreg(Rs)) {
+        mX86->IMUL(false, d, xreg(Rm));
+    } else {
+        mX86->MOV(false, d, xreg(Rm));
+        mX86->IMUL(false, d, xreg(Rs));
+    }
+    if (s)
+        mX86->TEST(false, d, d);
+    end(cc, s, FLAGS_LOGIC);
+}
+
+// TMP0 holds a 64-bit product, RdHi:RdLo += TMP0 when 'add'
+void ArmToX86_64Assembler::split64(int RdLo, int RdHi, int s, bool add)
+{
+    if (add) {
+        mX86->MOV(false, TMP1, xreg(RdHi));
+        mX86->SHIFT(X86::opSHL, true, TMP1, 32);
+        mX86->ALU(X86::opADD, true, TMP0, TMP1);
+        mX86->MOV(false, TMP1, xreg(RdLo));
+        mX86->ALU(X86::opADD, true, TMP0, TMP1);
+    }
+    mX86->MOV(false, xreg(RdLo), TMP0);
+    mX86->MOV(true, TMP1, TMP0);
+    mX86->SHIFT(X86::opSHR, true, TMP1, 32);
+    mX86->MOV(false, xreg(RdHi), TMP1);
+    if (s)
+        mX86->TEST(true, TMP0, TMP0);
+}
+
+void ArmToX86_64Assembler::UMULL(int cc, int s,
+        int RdLo, int RdHi, int Rm, int Rs)
+{
+    begin(cc, s, true);
+    mX86->MOV(false, TMP0, xreg(Rm));
+    mX86->MOV(false, TMP1, xreg(Rs));
+    mX86->IMUL(true, TMP0, TMP1);
+    split64(RdLo, RdHi, s, false);
+    end(cc, s, FLAGS_LOGIC);
+}
+
+void ArmToX86_64Assembler::UMUAL(int cc, int s,
+        int RdLo, int RdHi, int Rm, int Rs)
+{
+    begin(cc, s, true);
+    mX86->MOV(false, TMP0, xreg(Rm));
+    mX86->MOV(false, TMP1, xreg(Rs));
+    mX86->IMUL(true, TMP0, TMP1);
+    split64(RdLo, RdHi, s, true);
+    end(cc, s, FLAGS_LOGIC);
+}
+
+void ArmToX86_64Assembler::SMULL(int cc, int s,
+        int RdLo, int RdHi, int Rm, int Rs)
+{
+    begin(cc, s, true);
+    mX86->MOVSXD(TMP0, xreg(Rm));
+    mX86->MOVSXD(TMP1, xreg(Rs));
+    mX86->IMUL(true, TMP0, TMP1);
+    split64(RdLo, RdHi, s, false);
+    end(cc, s, FLAGS_LOGIC);
+}
+
+void ArmToX86_64Assembler::SMUAL(int cc, int s,
+        int RdLo, int RdHi, int Rm, int Rs)
+{
+    begin(cc, s, true);
+    mX86->MOVSXD(TMP0, xreg(Rm));
+    mX86->MOVSXD(TMP1, xreg(Rs));
+    mX86->IMUL(true, TMP0, TMP1);
+    split64(RdLo, RdHi, s, true);
+    end(cc, s, FLAGS_LOGIC);
+}
+
+
+// ----------------------------------------------------------------------------
+#if 0
+#pragma mark -
+#pragma mark Branches...
+#endif
+
+void ArmToX86_64Assembler::B(int cc, uint32_t* pc)
+{
+    NOT_IMPLEMENTED();
+}
+
+void ArmToX86_64Assembler::BL(int cc, uint32_t* pc)
+{
+    NOT_IMPLEMENTED();
+}
+
+void ArmToX86_64Assembler::BX(int cc, int Rn)
+{
+    NOT_IMPLEMENTED();
+}
+
+void ArmToX86_64Assembler::B(int cc, const char* label)
+{
+    if (cc == AL) {
+        mX86->JMP(label);
+        return;
+    }
+    restoreFlags();
+    mX86->JCC(condition(cc), label);
+}
+
+void ArmToX86_64Assembler::BL(int cc, const char* label)
+{
+    NOT_IMPLEMENTED();
+}
+
+
+// ----------------------------------------------------------------------------
+#if 0
+#pragma mark -
+#pragma mark Data Transfer...
+#endif
+
+void ArmToX86_64Assembler::dataTransfer(int size, bool sign, bool store,
+        int cc, int Rd, int Rn, uint32_t offset)
+{
+    if (offset > AMODE_UNSUPPORTED) {
+        // Arm encoding from the default argument, __immed12_pre(0)
+        offset = immed12_pre(0);
+    }
+
+    if (Rn == SP) {
+        // GGLAssembler only uses the stack to spill registers, other
+        // accesses come from SP used as a data register
+        if (cc == AL && store && offset == AMODE_IMM_12_PRE &&
+                int32_t(amode.value) == -4 && amode.writeback) {
+            mX86->PUSH(xreg(Rd));
+            mStackDepth += 8;
+        } else if (cc == AL && !store && offset == AMODE_IMM_12_POST &&
+                int32_t(amode.value) == 4) {
+            mX86->POP(xreg(Rd));
+            mStackDepth -= 8;
+        } else {
+            xreg(SP);
+        }
+        return;
+    }
+
+    bool pre = true;
+    bool writeback = false;
+    bool indexed = false;
+    switch (offset) {
+    case AMODE_IMM_12_POST:
+    case AMODE_IMM_8_POST:
+        pre = false;
+        break;
+    case AMODE_IMM_12_PRE:
+    case AMODE_IMM_8_PRE:
+        writeback = amode.writeback;
+        break;
+    case AMODE_REG_SCALE_POST:
+    case AMODE_REG_POST:
+        pre = false;
+        indexed = true;
+        break;
+    case AMODE_REG_SCALE_PRE:
+    case AMODE_REG_PRE:
+        writeback = amode.writeback;
+        indexed = true;
+        break;
+    default:
+        LOG_ALWAYS_FATAL("unsupported addressing mode %d", offset);
+    }
+
+    const bool simple = !indexed ||
+            (!amode.negative && amode.stype == LSL && amode.value <= 3);
+    begin(cc, 0, !simple);
+
+    const int base = xreg(Rn);
+    X86::mem_t m(base, int32_t(amode.value));
+    if (indexed) {
+        // the index is signed, and added to a 64-bit base
+        const int rm = xreg(amode.reg);
+        if (simple) {
+            mX86->MOVSXD(TMP0, rm);
+            m = X86::mem_t(base, TMP0, 1 << amode.value);
+        } else {
+            static const int ops[] = { X86::opSHL, X86::opSHR, X86::opSAR, X86::opROR };
+            mX86->MOV(false, TMP0, rm);
+            if (amode.value & 0x1F)
+                mX86->SHIFT(ops[amode.stype], false, TMP0, amode.value & 0x1F);
+            mX86->MOVSXD(TMP0, TMP0);
+            if (amode.negative)
+                mX86->NEG(true, TMP0);
+            m = X86::mem_t(base, TMP0, 1);
+        }
+    }
+
+    X86::mem_t access(base);
+    if (pre && !writeback) {
+        access = m;
+    } else if (pre) {
+        mX86->LEA(true, base, m);
+    }
+
+    if (store)
+        mX86->STORE(size, xreg(Rd), access);
+    else
+        mX86->LOAD(size, sign, xreg(Rd), access);
+
+    if (!pre && (indexed || m.disp))
+        mX86->LEA(true, base, m);
+
+    end(cc, 0, FLAGS_LOGIC);
+}
+
+void ArmToX86_64Assembler::LDR(int cc, int Rd, int Rn, uint32_t offset)
+{
+    dataTransfer(4, false, false, cc, Rd, Rn, offset);
+}
+
+void ArmToX86_64Assembler::LDRB(int cc, int Rd, int Rn, uint32_t offset)
+{
+    dataTransfer(1, false, false, cc, Rd, Rn, offset);
+}
+
+void ArmToX86_64Assembler::STR(int cc, int Rd, int Rn, uint32_t offset)
+{
+    dataTransfer(4, false, true, cc, Rd, Rn, offset);
+}
+
+void ArmToX86_64Assembler::STRB(int cc, int Rd, int Rn, uint32_t offset)
+{
+    dataTransfer(1, false, true, cc, Rd, Rn, offset);
+}
+
+void ArmToX86_64Assembler::LDRH(int cc, int Rd, int Rn, uint32_t offset)
+{
+    dataTransfer(2, false, false, cc, Rd, Rn, offset);
+}
+
+void ArmToX86_64Assembler::LDRSB(int cc, int Rd, int Rn, uint32_t offset)
+{
+    dataTransfer(1, true, false, cc, Rd, Rn, offset);
+}
+
+void ArmToX86_64Assembler::LDRSH(int cc, int Rd, int Rn, uint32_t offset)
+{
+    dataTransfer(2, true, false, cc, Rd, Rn, offset);
+}
+
+void ArmToX86_64Assembler::STRH(int cc, int Rd, int Rn, uint32_t offset)
+{
+    dataTransfer(2, false, true, cc, Rd, Rn, offset);
+}
+
+void ArmToX86_64Assembler::ADDR_LDR(int cc, int Rd, int Rn, uint32_t offset)
+{
+    dataTransfer(8, false, false, cc, Rd, Rn, offset);
+}
+
+void ArmToX86_64Assembler::ADDR_STR(int cc, int Rd, int Rn, uint32_t offset)
+{
+    dataTransfer(8, false, true, cc, Rd, Rn, offset);
+}
+
+// block data transfer...
+void ArmToX86_64Assembler::LDM(int cc, int dir,
+        int Rn, int W, uint32_t reg_list)
+{
+    // GGLAssembler only uses LDM to reload spilled registers
+    LOG_ALWAYS_FATAL_IF(cc != AL || Rn != SP || !W || (dir != IA && dir != FD),
+                        "LDM mode not supported");
+    for (int i = 0; i < 16; i++) {
+        if (reg_list & (1 << i)) {
+            mX86->POP(xreg(i));
+            mStackDepth -= 8;
+        }
+    }
+}
+
+void ArmToX86_64Assembler::STM(int cc, int dir,
+        int Rn, int W, uint32_t reg_list)
+{
+    // GGLAssembler only uses STM to spill registers
+    LOG_ALWAYS_FATAL_IF(cc != AL || Rn != SP || !W || (dir != DB && dir != FD),
+                        "STM mode not supported");
+    for (int i = 15; i >= 0; i--) {
+        if (reg_list & (1 << i)) {
+            mX86->PUSH(xreg(i));
+            mStackDepth += 8;
+        }
+    }
+}
+
+
+// ----------------------------------------------------------------------------
+#if 0
+#pragma mark -
+#pragma mark Special...
+#endif
+
+void ArmToX86_64Assembler::SWP(int cc, int Rn, int Rd, int Rm)
+{
+    NOT_IMPLEMENTED();
+}
+
+void ArmToX86_64Assembler::SWPB(int cc, int Rn, int Rd, int Rm)
+{
+    NOT_IMPLEMENTED();
+}
+
+void ArmToX86_64Assembler::SWI(int cc, uint32_t comment)
+{
+    NOT_IMPLEMENTED();
+}
+
+
+// ----------------------------------------------------------------------------
+#if 0
+#pragma mark -
+#pragma mark DSP instructions...
+#endif
+
+void ArmToX86_64Assembler::PLD(int Rn, uint32_t offset)
+{
+    // only a hint, other addressing modes are dropped
+    if (offset == AMODE_IMM_12_PRE) {
+        mX86->PREFETCH(X86::mem_t(xreg(Rn), int32_t(amode.value)));
+    }
+}
+
+void ArmToX86_64Assembler::CLZ(int cc, int Rd, int Rm)
+{
+    begin(cc, 0, true);
+    // bsr leaves the destination undefined when the source is 0
+    mX86->BSR(TMP0, xreg(Rm));
+    uint8_t* nonzero = mX86->JCC8(X86::CC_NE);
+    mX86->MOVI(TMP0, 0xFFFFFFFF);
+    mX86->bind(nonzero);
+    mX86->MOVI(xreg(Rd), 31);
+    mX86->ALU(X86::opSUB, false, xreg(Rd), TMP0);
+    end(cc, 0, FLAGS_LOGIC);
+}
+
+void ArmToX86_64Assembler::QADD(int cc, int Rd, int Rm, int Rn)
+{
+    NOT_IMPLEMENTED();
+}
+
+void ArmToX86_64Assembler::QDADD(int cc, int Rd, int Rm, int Rn)
+{
+    NOT_IMPLEMENTED();
+}
+
+void ArmToX86_64Assembler::QSUB(int cc, int Rd, int Rm, int Rn)
+{
+    NOT_IMPLEMENTED();
+}
+
+void ArmToX86_64Assembler::QDSUB(int cc, int Rd, int Rm, int Rn)
+{
+    NOT_IMPLEMENTED();
+}
+
+// sign-extended bottom or top half of 'reg', to 32 or 64 bits
+void ArmToX86_64Assembler::signedHalf(int tmp, int reg, bool top, bool wide)
+{
+    if (top) {
+        mX86->MOV(false, tmp, xreg(reg));
+        mX86->SHIFT(X86::opSAR, false, tmp, 16);
+        if (wide)
+            mX86->MOVSXD(tmp, tmp);
+    } else {
+        mX86->MOVSX16(wide, tmp, xreg(reg));
+    }
+}
+
+// TMP0 = Rm.x * Rs.y
+void ArmToX86_64Assembler::signedMultiply(int xy, int Rm, int Rs)
+{
+    signedHalf(TMP0, Rm, xy & xyTB, false);
+    signedHalf(TMP1, Rs, xy & xyBT, false);
+    mX86->IMUL(false, TMP0, TMP1);
+}
+
+// TMP0 = (Rm * Rs.y) >> 16
+void ArmToX86_64Assembler::signedMultiplyWide(int y, int Rm, int Rs)
+{
+    mX86->MOVSXD(TMP0, xreg(Rm));
+    signedHalf(TMP1, Rs, y & yT, true);
+    mX86->IMUL(true, TMP0, TMP1);
+    mX86->SHIFT(X86::opSAR, true, TMP0, 16);
+}
+
+void ArmToX86_64Assembler::SMUL(int cc, int xy,
+        int Rd, int Rm, int Rs)
+{
+    begin(cc, 0, true);
+    signedMultiply(xy, Rm, Rs);
+    mX86->MOV(false, xreg(Rd), TMP0);
+    end(cc, 0, FLAGS_LOGIC);
+}
+
+void ArmToX86_64Assembler::SMULW(int cc, int y,
+        int Rd, int Rm, int Rs)
+{
+    begin(cc, 0, true);
+    signedMultiplyWide(y, Rm, Rs);
+    mX86->MOV(false, xreg(Rd), TMP0);
+    end(cc, 0, FLAGS_LOGIC);
+}
+
+void ArmToX86_64Assembler::SMLA(int cc, int xy,
+        int Rd, int Rm, int Rs, int Rn)
+{
+    begin(cc, 0, true);
+    signedMultiply(xy, Rm, Rs);
+    mX86->LEA(false, xreg(Rd), X86::mem_t(TMP0, xreg(Rn), 1));
+    end(cc, 0, FLAGS_LOGIC);
+}
+
+void ArmToX86_64Assembler::SMLAL(int cc, int xy,
+        int RdHi, int RdLo, int Rs, int Rm)
+{
+    begin(cc, 0, true);
+    signedMultiply(xy, Rm, Rs);
+    mX86->MOVSXD(TMP0, TMP0);
+    split64(RdLo, RdHi, 0, true);
+    end(cc, 0, FLAGS_LOGIC);
+}
+
+void ArmToX86_64Assembler::SMLAW(int cc, int y,
+        int Rd, int Rm, int Rs, int Rn)
+{
+    begin(cc, 0, true);
+    signedMultiplyWide(y, Rm, Rs);
+    mX86->LEA(false, xreg(Rd), X86::mem_t(TMP0, xreg(Rn), 1));
+    end(cc, 0, FLAGS_LOGIC);
+}
+
+
+// ----------------------------------------------------------------------------
+#if 0
+#pragma mark -
+#pragma mark Byte/half word extract, bit manipulation...
+#endif
+
+void ArmToX86_64Assembler::UXTB16(int cc, int Rd, int Rm, int rotate)
+{
+    begin(cc, 0, true);
+    const int d = xreg(Rd);
+    if (d != xreg(Rm))
+        mX86->MOV(false, d, xreg(Rm));
+    if (rotate)
+        mX86->SHIFT(X86::opROR, false, d, rotate);
+    mX86->ALUI(X86::opAND, false, d, 0x00FF00FF);
+    end(cc, 0, FLAGS_LOGIC);
+}
+
+void ArmToX86_64Assembler::UBFX(int cc, int Rd, int Rn, int lsb, int width)
+{
+    begin(cc, 0, true);
+    const int d = xreg(Rd);
+    if (d != xreg(Rn))
+        mX86->MOV(false, d, xreg(Rn));
+    if (lsb)
+        mX86->SHIFT(X86::opSHR, false, d, lsb);
+    if (lsb + width < 32)
+        mX86->ALUI(X86::opAND, false, d, (1 << width) - 1);
+    end(cc, 0, FLAGS_LOGIC);
+}
+
+
+// ----------------------------------------------------------------------------
+#if 0
+#pragma mark -
+#pragma mark Pointers...
+#endif
+
+void ArmToX86_64Assembler::ADDR_ADD(int cc, int s,
+        int Rd, int Rn, uint32_t Op2)
+{
+    LOG_ALWAYS_FATAL_IF(s, "ADDR_ADD does not set the flags");
+    const bool scaled = Op2 < AMODE_REG || isScaled(Op2);
+    begin(cc, 0, !scaled && Op2 != AMODE_IMM);
+
+    const int d = xreg(Rd);
+    const int n = xreg(Rn);
+    if (Op2 == AMODE_IMM) {
+        mX86->LEA(true, d, X86::mem_t(n, int32_t(amode.value)));
+    } else if (scaled) {
+        const int rm = xreg(Op2 < AMODE_REG ? Op2 : amode.reg);
+        const int shift = Op2 < AMODE_REG ? 0 : (amode.value & 0x1F);
+        mX86->MOVSXD(TMP0, rm);
+        mX86->LEA(true, d, X86::mem_t(n, TMP0, 1 << shift));
+    } else {
+        uint32_t immediate = 0;
+        const int src = dataOperand(Op2, TMP0, immediate);
+        if (src < 0) {
+            mX86->LEA(true, d, X86::mem_t(n, int32_t(immediate)));
+        } else {
+            mX86->MOVSXD(TMP0, src);
+            mX86->LEA(true, d, X86::mem_t(n, TMP0, 1));
+        }
+    }
+    end(cc, 0, FLAGS_LOGIC);
+}
+
+void ArmToX86_64Assembler::ADDR_SUB(int cc, int s,
+        int Rd, int Rn, uint32_t Op2)
+{
+    LOG_ALWAYS_FATAL_IF(s, "ADDR_SUB does not set the flags");
+    begin(cc, 0, Op2 != AMODE_IMM);
+
+    const int d = xreg(Rd);
+    const int n = xreg(Rn);
+    uint32_t immediate = 0;
+    const int src = dataOperand(Op2, TMP0, immediate);
+    if (src < 0) {
+        mX86->LEA(true, d, X86::mem_t(n, int32_t(0u - immediate)));
+    } else {
+        mX86->MOVSXD(TMP0, src);
+        mX86->NEG(true, TMP0);
+        mX86->LEA(true, d, X86::mem_t(n, TMP0, 1));
+    }
+    end(cc, 0, FLAGS_LOGIC);
+}
+
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+#if 0
+#pragma mark -
+#pragma mark X86_64Assembler...
+#endif
+
+X86_64Assembler::X86_64Assembler(const sp<Assembly>& assembly)
+    :   mAssembly(assembly)
+{
+    reset();
+}
+
+X86_64Assembler::~X86_64Assembler()
+{
+}
+
+uint8_t* X86_64Assembler::pc() const
+{
+    return mPC;
+}
+
+uint8_t* X86_64Assembler::base() const
+{
+    return mBase;
+}
+
+void X86_64Assembler::reset()
+{
+    mBase = mPC = (uint8_t*)mAssembly->base();
+    mEnd = mBase + mAssembly->size();
+    mOverflow = false;
+    mBranchTargets.clear();
+    mLabels.clear();
+    mLabelsInverseMapping.clear();
+    mComments.clear();
+    mDuration = ggl_system_time();
+}
+
+// There is no x86-64 disassembler in the tree, the bytes are dumped
+// between labels and comments.
+void X86_64Assembler::disassemble(const char* name)
+{
+    if (name) {
+        printf("%s:\n", name);
+    }
+    uint8_t* i = base();
+    while (i < pc()) {
+        ssize_t label = mLabelsInverseMapping.indexOfKey(i);
+        if (label >= 0) {
+            printf("%s:\n", mLabelsInverseMapping.valueAt(label));
+        }
+        ssize_t comment = mComments.indexOfKey(i);
+        if (comment >= 0) {
+            printf("; %s\n", mComments.valueAt(comment));
+        }
+        printf("%p:   ", i);
+        int count = 0;
+        do {
+            printf(" %02x", *i++);
+            count++;
+        } while (i < pc() && count < 16 &&
+                mLabelsInverseMapping.indexOfKey(i) < 0 &&
+                mComments.indexOfKey(i) < 0);
+        printf("\n");
+    }
+}
+
+void X86_64Assembler::comment(const char* string)
+{
+    mComments.add(mPC, string);
+}
+
+void X86_64Assembler::label(const char* theLabel)
+{
+    mLabels.add(theLabel, mPC);
+    mLabelsInverseMapping.add(mPC, theLabel);
+}
+
+int X86_64Assembler::generate(const char* name)
+{
+    if (mOverflow) {
+        ALOGE("%s does not fit in %d bytes\n", name, int(mEnd - mBase));
+        return NO_MEMORY;
+    }
+
+    // fixup all the branches
+    size_t count = mBranchTargets.size();
+    while (count--) {
+        const branch_target_t& bt = mBranchTargets[count];
+        uint8_t* target_pc = mLabels.valueFor(bt.label);
+        LOG_ALWAYS_FATAL_IF(!target_pc,
+                "error resolving branch targets, target_pc is null");
+        int32_t offset = int32_t(target_pc - (bt.pc + 4));
+        memcpy(bt.pc, &offset, sizeof(offset));
+    }
+
+    mAssembly->resize(int(pc() - base()));
+
+    // x86-64 keeps the instruction cache coherent
+    const int64_t duration = ggl_system_time() - mDuration;
+    const char * const format = "generated %s (%d bytes) at [%p:%p] in %lld ns\n";
+    ALOGI(format, name, int(pc()-base()), base(), pc(), (long long)duration);
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("debug.pf.disasm", value, "0");
+    if (atoi(value) != 0) {
+        printf(format, name, int(pc()-base()), base(), pc(), (long long)duration);
+        disassemble(name);
+    }
+
+    return NO_ERROR;
+}
+
+uint8_t* X86_64Assembler::pcForLabel(const char* label)
+{
+    return mLabels.valueFor(label);
+}
+
+// ----------------------------------------------------------------------------
+#if 0
+#pragma mark -
+#pragma mark Encoding...
+#endif
+
+void X86_64Assembler::emit8(uint32_t byte)
+{
+    if (mPC < mEnd) {
+        *mPC++ = uint8_t(byte);
+    } else {
+        mOverflow = true;
+    }
+}
+
+void X86_64Assembler::emit32(uint32_t word)
+{
+    for (int i = 0; i < 4; i++) {
+        emit8(word >> (i * 8));
+    }
+}
+
+// 'byteReg' forces a prefix, so that registers 4-7 are spl..dil and
+// not ah..bh in byte instructions
+void X86_64Assembler::rex(bool wide, int reg, int index, int base, bool byteReg)
+{
+    uint32_t prefix = 0x40;
+    if (wide)       prefix |= 8;
+    if (reg >= 8)   prefix |= 4;
+    if (index >= 8) prefix |= 2;
+    if (base >= 8)  prefix |= 1;
+    if (prefix != 0x40 || byteReg) {
+        emit8(prefix);
+    }
+}
+
+void X86_64Assembler::modrm(int reg, int rm)
+{
+    emit8(0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+void X86_64Assembler::modrm(int reg, const mem_t& m)
+{
+    const uint32_t r = (reg & 7) << 3;
+    uint32_t scale = 0;
+    while ((1 << scale) < m.scale) {
+        scale++;
+    }
+    LOG_ALWAYS_FATAL_IF(m.index == RSP, "rsp cannot be an index");
+
+    if (m.base == NO_REG) {
+        // [index*scale + disp32]
+        emit8(0x04 | r);
+        emit8((scale << 6) | ((m.index & 7) << 3) | 5);
+        emit32(m.disp);
+        return;
+    }
+
+    uint32_t mod;
+    if (m.disp == 0 && (m.base & 7) != RBP) {
+        mod = 0;    // rbp and r13 need a displacement
+    } else if (m.disp >= -128 && m.disp <= 127) {
+        mod = 1;
+    } else {
+        mod = 2;
+    }
+
+    if (m.index == NO_REG && (m.base & 7) != RSP) {
+        emit8((mod << 6) | r | (m.base & 7));
+    } else {
+        // rsp and r12 need a SIB byte, index 4 means none
+        const int index = (m.index == NO_REG) ? RSP : m.index;
+        emit8((mod << 6) | r | 4);
+        emit8((scale << 6) | ((index & 7) << 3) | (m.base & 7));
+    }
+
+    if (mod == 1) {
+        emit8(m.disp);
+    } else if (mod == 2) {
+        emit32(m.disp);
+    }
+}
+
+void X86_64Assembler::ALU(int op, bool wide, int Rd, int Rs)
+{
+    rex(wide, Rs, NO_REG, Rd);
+    emit8((op << 3) | 1);
+    modrm(Rs, Rd);
+}
+
+void X86_64Assembler::ALUI(int op, bool wide, int Rd, int32_t imm)
+{
+    rex(wide, 0, NO_REG, Rd);
+    if (imm >= -128 && imm <= 127) {
+        emit8(0x83);
+        modrm(op, Rd);
+        emit8(imm);
+    } else {
+        emit8(0x81);
+        modrm(op, Rd);
+        emit32(imm);
+    }
+}
+
+void X86_64Assembler::TEST(bool wide, int Ra, int Rb)
+{
+    rex(wide, Rb, NO_REG, Ra);
+    emit8(0x85);
+    modrm(Rb, Ra);
+}
+
+void X86_64Assembler::TESTI(int Ra, uint32_t imm)
+{
+    rex(false, 0, NO_REG, Ra);
+    emit8(0xF7);
+    modrm(0, Ra);
+    emit32(imm);
+}
+
+void X86_64Assembler::MOV(bool wide, int Rd, int Rs)
+{
+    rex(wide, Rs, NO_REG, Rd);
+    emit8(0x89);
+    modrm(Rs, Rd);
+}
+
+void X86_64Assembler::MOVI(int Rd, uint32_t imm)
+{
+    rex(false, 0, NO_REG, Rd);
+    emit8(0xB8 | (Rd & 7));
+    emit32(imm);
+}
+
+void X86_64Assembler::LEA(bool wide, int Rd, const mem_t& m)
+{
+    rex(wide, Rd, m.index, m.base);
+    emit8(0x8D);
+    modrm(Rd, m);
+}
+
+void X86_64Assembler::LOAD(int size, bool sign, int Rd, const mem_t& m)
+{
+    rex(size == 8, Rd, m.index, m.base);
+    switch (size) {
+    case 1:
+        emit8(0x0F);
+        emit8(sign ? 0xBE : 0xB6);
+        break;
+    case 2:
+        emit8(0x0F);
+        emit8(sign ? 0xBF : 0xB7);
+        break;
+    default:
+        emit8(0x8B);
+        break;
+    }
+    modrm(Rd, m);
+}
+
+void X86_64Assembler::STORE(int size, int Rs, const mem_t& m)
+{
+    if (size == 2) {
+        emit8(0x66);
+    }
+    rex(size == 8, Rs, m.index, m.base, size == 1 && Rs >= RSP && Rs <= RDI);
+    emit8(size == 1 ? 0x88 : 0x89);
+    modrm(Rs, m);
+}
+
+void X86_64Assembler::SHIFT(int op, bool wide, int Rd, int count)
+{
+    rex(wide, 0, NO_REG, Rd);
+    if (count == 1) {
+        emit8(0xD1);
+        modrm(op, Rd);
+    } else {
+        emit8(0xC1);
+        modrm(op, Rd);
+        emit8(count);
+    }
+}
+
+void X86_64Assembler::NOT(bool wide, int Rd)
+{
+    rex(wide, 0, NO_REG, Rd);
+    emit8(0xF7);
+    modrm(2, Rd);
+}
+
+void X86_64Assembler::NEG(bool wide, int Rd)
+{
+    rex(wide, 0, NO_REG, Rd);
+    emit8(0xF7);
+    modrm(3, Rd);
+}
+
+void X86_64Assembler::IMUL(bool wide, int Rd, int Rs)
+{
+    rex(wide, Rd, NO_REG, Rs);
+    emit8(0x0F);
+    emit8(0xAF);
+    modrm(Rd, Rs);
+}
+
+void X86_64Assembler::MOVSX16(bool wide, int Rd, int Rs)
+{
+    rex(wide, Rd, NO_REG, Rs);
+    emit8(0x0F);
+    emit8(0xBF);
+    modrm(Rd, Rs);
+}
+
+void X86_64Assembler::MOVSXD(int Rd, int Rs)
+{
+    rex(true, Rd, NO_REG, Rs);
+    emit8(0x63);
+    modrm(Rd, Rs);
+}
+
+void X86_64Assembler::BSR(int Rd, int Rs)
+{
+    rex(false, Rd, NO_REG, Rs);
+    emit8(0x0F);
+    emit8(0xBD);
+    modrm(Rd, Rs);
+}
+
+void X86_64Assembler::PUSH(int Rs)
+{
+    rex(false, 0, NO_REG, Rs);
+    emit8(0x50 | (Rs & 7));
+}
+
+void X86_64Assembler::POP(int Rd)
+{
+    rex(false, 0, NO_REG, Rd);
+    emit8(0x58 | (Rd & 7));
+}
+
+// the address of a push is computed before rsp is decremented
+void X86_64Assembler::PUSH(const mem_t& m)
+{
+    rex(false, 0, m.index, m.base);
+    emit8(0xFF);
+    modrm(6, m);
+}
+
+// the address of a pop is computed after rsp is incremented
+void X86_64Assembler::POP(const mem_t& m)
+{
+    rex(false, 0, m.index, m.base);
+    emit8(0x8F);
+    modrm(0, m);
+}
+
+void X86_64Assembler::PUSHF()
+{
+    emit8(0x9C);
+}
+
+void X86_64Assembler::POPF()
+{
+    emit8(0x9D);
+}
+
+void X86_64Assembler::PREFETCH(const mem_t& m)
+{
+    rex(false, 0, m.index, m.base);
+    emit8(0x0F);
+    emit8(0x18);
+    modrm(1, m);    // prefetcht0
+}
+
+void X86_64Assembler::RET()
+{
+    emit8(0xC3);
+}
+
+void X86_64Assembler::NOP(int size)
+{
+    // recommended multi-byte nops
+    static const uint8_t nops[][9] = {
+        { 0x90 },
+        { 0x66, 0x90 },
+        { 0x0F, 0x1F, 0x00 },
+        { 0x0F, 0x1F, 0x40, 0x00 },
+        { 0x0F, 0x1F, 0x44, 0x00, 0x00 },
+        { 0x66, 0x0F, 0x1F, 0x44, 0x00, 0x00 },
+        { 0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00 },
+        { 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x66, 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 },
+    };
+    while (size > 0) {
+        const int n = size > 9 ? 9 : size;
+        for (int i = 0; i < n; i++) {
+            emit8(nops[n - 1][i]);
+        }
+        size -= n;
+    }
+}
+
+void X86_64Assembler::JCC(int cc, const char* label)
+{
+    emit8(0x0F);
+    emit8(0x80 | cc);
+    mBranchTargets.add(branch_target_t(label, mPC));
+    emit32(0);
+}
+
+void X86_64Assembler::JMP(const char* label)
+{
+    emit8(0xE9);
+    mBranchTargets.add(branch_target_t(label, mPC));
+    emit32(0);
+}
+
+uint8_t* X86_64Assembler::JCC8(int cc)
+{
+    emit8(0x70 | cc);
+    uint8_t* branch = mPC;
+    emit8(0);
+    return branch;
+}
+
+void X86_64Assembler::bind(uint8_t* branch)
+{
+    if (mOverflow)
+        return;
+    const int offset = int(mPC - (branch + 1));
+    LOG_ALWAYS_FATAL_IF(offset > 127, "short branch out of range (%d)", offset);
+    *branch = uint8_t(offset);
+}
+
+}; // namespace android
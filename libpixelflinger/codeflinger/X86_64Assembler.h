@@ -0,0 +1,388 @@
+/* libs/pixelflinger/codeflinger/X86_64Assembler.h
+**
+** Copyright 2013, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_X86_64ASSEMBLER_H
+#define ANDROID_X86_64ASSEMBLER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "tinyutils/KeyedVector.h"
+#include "tinyutils/Vector.h"
+#include "tinyutils/smartpointer.h"
+
+#include "ARMAssemblerInterface.h"
+#include "CodeCache.h"
+
+namespace android {
+
+class X86_64Assembler;  // forward reference
+
+// this class mimics ARMAssembler interface
+//  intent is to translate each ARM instruction to 1 or more x86-64 instr
+//  implementation calls X86_64Assembler class to generate x86-64 code
+class ArmToX86_64Assembler : public ARMAssemblerInterface
+{
+public:
+                ArmToX86_64Assembler(const sp<Assembly>& assembly);
+    virtual     ~ArmToX86_64Assembler();
+
+    uint32_t*   base() const;
+    uint32_t*   pc() const;
+    void        disassemble(const char* name);
+
+    virtual void    reset();
+
+    virtual int     generate(const char* name);
+    virtual int     getCodegenArch();
+
+    virtual void    prolog();
+    virtual void    epilog(uint32_t touched);
+    virtual void    comment(const char* string);
+
+
+    // -----------------------------------------------------------------------
+    // shifters and addressing modes
+    // -----------------------------------------------------------------------
+
+    // shifters...
+    virtual bool        isValidImmediate(uint32_t immed);
+    virtual int         buildImmediate(uint32_t i, uint32_t& rot, uint32_t& imm);
+
+    virtual uint32_t    imm(uint32_t immediate);
+    virtual uint32_t    reg_imm(int Rm, int type, uint32_t shift);
+    virtual uint32_t    reg_rrx(int Rm);
+    virtual uint32_t    reg_reg(int Rm, int type, int Rs);
+
+    // addressing modes...
+    // LDR(B)/STR(B)/PLD
+    // (immediate and Rm can be negative, which indicates U=0)
+    virtual uint32_t    immed12_pre(int32_t immed12, int W=0);
+    virtual uint32_t    immed12_post(int32_t immed12);
+    virtual uint32_t    reg_scale_pre(int Rm, int type=0, uint32_t shift=0, int W=0);
+    virtual uint32_t    reg_scale_post(int Rm, int type=0, uint32_t shift=0);
+
+    // LDRH/LDRSB/LDRSH/STRH
+    // (immediate and Rm can be negative, which indicates U=0)
+    virtual uint32_t    immed8_pre(int32_t immed8, int W=0);
+    virtual uint32_t    immed8_post(int32_t immed8);
+    virtual uint32_t    reg_pre(int Rm, int W=0);
+    virtual uint32_t    reg_post(int Rm);
+
+
+    virtual void    dataProcessing(int opcode, int cc, int s,
+                                int Rd, int Rn,
+                                uint32_t Op2);
+    virtual void MLA(int cc, int s,
+                int Rd, int Rm, int Rs, int Rn);
+    virtual void MUL(int cc, int s,
+                int Rd, int Rm, int Rs);
+    virtual void UMULL(int cc, int s,
+                int RdLo, int RdHi, int Rm, int Rs);
+    virtual void UMUAL(int cc, int s,
+                int RdLo, int RdHi, int Rm, int Rs);
+    virtual void SMULL(int cc, int s,
+                int RdLo, int RdHi, int Rm, int Rs);
+    virtual void SMUAL(int cc, int s,
+                int RdLo, int RdHi, int Rm, int Rs);
+
+    virtual void B(int cc, uint32_t* pc);
+    virtual void BL(int cc, uint32_t* pc);
+    virtual void BX(int cc, int Rn);
+    virtual void label(const char* theLabel);
+    virtual void B(int cc, const char* label);
+    virtual void BL(int cc, const char* label);
+
+    virtual uint32_t* pcForLabel(const char* label);
+
+    virtual void LDR (int cc, int Rd,
+                int Rn, uint32_t offset = __immed12_pre(0));
+    virtual void LDRB(int cc, int Rd,
+                int Rn, uint32_t offset = __immed12_pre(0));
+    virtual void STR (int cc, int Rd,
+                int Rn, uint32_t offset = __immed12_pre(0));
+    virtual void STRB(int cc, int Rd,
+                int Rn, uint32_t offset = __immed12_pre(0));
+    virtual void LDRH (int cc, int Rd,
+                int Rn, uint32_t offset = __immed8_pre(0));
+    virtual void LDRSB(int cc, int Rd,
+                int Rn, uint32_t offset = __immed8_pre(0));
+    virtual void LDRSH(int cc, int Rd,
+                int Rn, uint32_t offset = __immed8_pre(0));
+    virtual void STRH (int cc, int Rd,
+                int Rn, uint32_t offset = __immed8_pre(0));
+
+    virtual void LDM(int cc, int dir,
+                int Rn, int W, uint32_t reg_list);
+    virtual void STM(int cc, int dir,
+                int Rn, int W, uint32_t reg_list);
+
+    virtual void SWP(int cc, int Rn, int Rd, int Rm);
+    virtual void SWPB(int cc, int Rn, int Rd, int Rm);
+    virtual void SWI(int cc, uint32_t comment);
+
+    virtual void PLD(int Rn, uint32_t offset);
+    virtual void CLZ(int cc, int Rd, int Rm);
+    virtual void QADD(int cc, int Rd, int Rm, int Rn);
+    virtual void QDADD(int cc, int Rd, int Rm, int Rn);
+    virtual void QSUB(int cc, int Rd, int Rm, int Rn);
+    virtual void QDSUB(int cc, int Rd, int Rm, int Rn);
+    virtual void SMUL(int cc, int xy,
+                int Rd, int Rm, int Rs);
+    virtual void SMULW(int cc, int y,
+                int Rd, int Rm, int Rs);
+    virtual void SMLA(int cc, int xy,
+                int Rd, int Rm, int Rs, int Rn);
+    virtual void SMLAL(int cc, int xy,
+                int RdHi, int RdLo, int Rs, int Rm);
+    virtual void SMLAW(int cc, int y,
+                int Rd, int Rm, int Rs, int Rn);
+
+    // byte/half word extract...
+    virtual void UXTB16(int cc, int Rd, int Rm, int rotate);
+
+    // bit manipulation...
+    virtual void UBFX(int cc, int Rd, int Rn, int lsb, int width);
+
+    // pointers...
+    virtual void ADDR_LDR(int cc, int Rd,
+                int Rn, uint32_t offset = __immed12_pre(0));
+    virtual void ADDR_STR(int cc, int Rd,
+                int Rn, uint32_t offset = __immed12_pre(0));
+    virtual void ADDR_ADD(int cc, int s, int Rd,
+                int Rn, uint32_t Op2);
+    virtual void ADDR_SUB(int cc, int s, int Rd,
+                int Rn, uint32_t Op2);
+
+private:
+    ArmToX86_64Assembler(const ArmToX86_64Assembler& rhs);
+    ArmToX86_64Assembler& operator = (const ArmToX86_64Assembler& rhs);
+
+    // x86-64 register holding Arm register 'reg'
+    int     xreg(int reg);
+
+    // computes a data-processing operand. Returns the x86-64 register
+    // holding it, or -1 and the value in 'immediate'. Shifted registers
+    // are computed into 'tmp'.
+    int     dataOperand(uint32_t op2, int tmp, uint32_t& immediate);
+    // register shifted left by 0 to 3, which fits an address computation
+    bool    isScaled(uint32_t op2) const;
+    // true if op2 can be computed without destroying the flags
+    bool    isFlagFree(int opcode, uint32_t op2) const;
+    void    arithmetic(int op, bool commutative,
+                    int d, int n, int src, uint32_t immediate);
+
+    void    dataTransfer(int size, bool sign, bool store, int cc,
+                    int Rd, int Rn, uint32_t offset);
+
+    // 16-bit signed half of Arm register 'reg' into x86-64 register 'tmp'
+    void    signedHalf(int tmp, int reg, bool top, bool wide);
+    void    signedMultiply(int xy, int Rm, int Rs);
+    void    signedMultiplyWide(int y, int Rm, int Rs);
+    void    split64(int RdLo, int RdHi, int s, bool add);
+
+    // condition flags...
+    void    clobberFlags();
+    void    restoreFlags();
+    void    setFlags(int kind);
+    int     condition(int cc) const;
+    void    beginConditional(int cc, bool clobbers);
+    void    endConditional();
+    // bracket the translation of one Arm instruction
+    void    begin(int cc, int s, bool clobbers);
+    void    end(int cc, int s, int kind);
+
+    sp<Assembly>        mAssembly;
+    X86_64Assembler*    mX86;
+
+    enum {
+        // x86-64 scratch registers, not visible to GGLAssembler
+        TMP0 = 11,      // r11
+        TMP1 = 1        // rcx
+    };
+
+    enum addr_modes {
+        // start above the range of legal arm reg #'s (0-15)
+        AMODE_REG = 0x20,
+        AMODE_IMM, AMODE_REG_IMM, AMODE_REG_REG,        // for data processing
+        AMODE_IMM_12_PRE, AMODE_IMM_12_POST,            // for load/store
+        AMODE_REG_SCALE_PRE, AMODE_REG_SCALE_POST,
+        AMODE_IMM_8_PRE, AMODE_IMM_8_POST,
+        AMODE_REG_PRE, AMODE_REG_POST,
+        AMODE_UNSUPPORTED
+    };
+
+    struct addr_mode_t {    // address modes for current ARM instruction
+        int         reg;
+        int         stype;
+        uint32_t    value;
+        bool        writeback;  // writeback the adr reg after modification
+        bool        negative;   // index register is subtracted
+    } amode;
+
+    // x86-64 has no conditional execution and most of its arithmetic
+    // writes the flags, so the flags of the last Arm S-instruction are
+    // tracked and saved to the stack when a later instruction would
+    // destroy them before they are used.
+    enum flags_kind_t {
+        FLAGS_LOGIC,    // C is meaningless
+        FLAGS_ADD,      // x86-64 CF is the Arm carry
+        FLAGS_SUB       // x86-64 CF is the inverted Arm carry (borrow)
+    };
+
+    struct flags_state_t {
+        bool        live;       // set by an S-instruction since the last label
+        bool        inCpu;      // still in the x86-64 flags register
+        bool        saved;      // copied to the flags slot on the stack
+        int         kind;
+        bool        setting;    // translating an S-instruction
+        bool        conditional;
+        uint8_t*    skip;       // branch over the current conditional instruction
+    } mFlags;
+
+    int         mStackDepth;    // bytes pushed below the flags slot
+    uint8_t*    mPrologPC;
+    int         mBadRegister;   // unmapped register used, 0 if none
+};
+
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+// This is the basic x86-64 assembler, which just creates the opcodes in memory.
+// All the more complicated work is done in ArmToX86_64Assembler above.
+
+class X86_64Assembler
+{
+public:
+                X86_64Assembler(const sp<Assembly>& assembly);
+    virtual     ~X86_64Assembler();
+
+    uint8_t*    base() const;
+    uint8_t*    pc() const;
+    void        reset();
+
+    void        disassemble(const char* name);
+
+    int         generate(const char* name);
+    void        comment(const char* string);
+    void        label(const char* string);
+
+    // valid only after generate() has been called
+    uint8_t*    pcForLabel(const char* label);
+
+    enum {
+        RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+        R8, R9, R10, R11, R12, R13, R14, R15,
+        NO_REG = -1
+    };
+
+    // condition codes, the low bit inverts the condition
+    enum {
+        CC_O, CC_NO, CC_B, CC_AE, CC_E, CC_NE, CC_BE, CC_A,
+        CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G
+    };
+
+    // group 1 arithmetic
+    enum {
+        opADD, opOR, opADC, opSBB, opAND, opSUB, opXOR, opCMP
+    };
+
+    // group 2 shifts
+    enum {
+        opROL = 0, opROR = 1, opSHL = 4, opSHR = 5, opSAR = 7
+    };
+
+    // [base + index*scale + disp], base may be NO_REG
+    struct mem_t {
+        mem_t(int b, int32_t d = 0)
+            : base(b), index(NO_REG), scale(1), disp(d) { }
+        mem_t(int b, int i, int s, int32_t d = 0)
+            : base(b), index(i), scale(s), disp(d) { }
+        int     base;
+        int     index;
+        int     scale;
+        int32_t disp;
+    };
+
+    // 'wide' selects 64-bit operands. 32-bit results are zero-extended.
+    void ALU(int op, bool wide, int Rd, int Rs);            // Rd op= Rs
+    void ALUI(int op, bool wide, int Rd, int32_t imm);      // Rd op= imm
+    void TEST(bool wide, int Ra, int Rb);
+    void TESTI(int Ra, uint32_t imm);
+    void MOV(bool wide, int Rd, int Rs);
+    void MOVI(int Rd, uint32_t imm);
+    void LEA(bool wide, int Rd, const mem_t& m);
+    void LOAD(int size, bool sign, int Rd, const mem_t& m);
+    void STORE(int size, int Rs, const mem_t& m);
+    void SHIFT(int op, bool wide, int Rd, int count);
+    void NOT(bool wide, int Rd);
+    void NEG(bool wide, int Rd);
+    void IMUL(bool wide, int Rd, int Rs);
+    void MOVSX16(bool wide, int Rd, int Rs);
+    void MOVSXD(int Rd, int Rs);
+    void BSR(int Rd, int Rs);
+    void PUSH(int Rs);
+    void POP(int Rd);
+    void PUSH(const mem_t& m);
+    void POP(const mem_t& m);
+    void PUSHF();
+    void POPF();
+    void PREFETCH(const mem_t& m);
+    void RET();
+    void NOP(int size);
+
+    void JCC(int cc, const char* label);
+    void JMP(const char* label);
+    // short forward branch, returns the location to give to bind()
+    uint8_t* JCC8(int cc);
+    void bind(uint8_t* branch);
+
+protected:
+    void emit8(uint32_t byte);
+    void emit32(uint32_t word);
+    void rex(bool wide, int reg, int index, int base, bool byteReg = false);
+    void modrm(int reg, int rm);
+    void modrm(int reg, const mem_t& m);
+
+    sp<Assembly>    mAssembly;
+    uint8_t*        mBase;
+    uint8_t*        mPC;
+    uint8_t*        mEnd;
+    bool            mOverflow;
+    int64_t         mDuration;
+
+    struct branch_target_t {
+        inline branch_target_t() : label(0), pc(0) { }
+        inline branch_target_t(const char* l, uint8_t* p)
+            : label(l), pc(p) { }
+        const char* label;
+        uint8_t*    pc;
+    };
+
+    Vector<branch_target_t>                 mBranchTargets;
+    KeyedVector< const char*, uint8_t* >    mLabels;
+    KeyedVector< uint8_t*, const char* >    mLabelsInverseMapping;
+    KeyedVector< uint8_t*, const char* >    mComments;
+
+    friend class ArmToX86_64Assembler;
+};
+
+}; // namespace android
+
+#endif //ANDROID_X86_64ASSEMBLER_H
@@ -267,9 +267,11 @@ void GGLAssembler::build_blend_factor(
     switch(f) {
     case GGL_ONE_MINUS_SRC_ALPHA:
     case GGL_SRC_ALPHA:
-        if (component==GGLFormat::ALPHA && !isAlphaSourceNeeded()) {
+        if (component==GGLFormat::ALPHA) {
             // we're processing alpha, so we already have
-            // src-alpha in fragment, and we need src-alpha just this time.
+            // src-alpha in fragment. Don't compute the cached factor now:
+            // that happens in place, in mAlphaSource, which may well be
+            // the fragment register that we're about to blend.
         } else {
            // alpha-src will be needed for other components
             if (!mBlendFactorCached || mBlendFactorCached==f) {
@@ -30,6 +30,7 @@
 #include "picker.h"
 #include "raster.h"
 #include "scanline.h"
+#include "tiler.h"
 #include "trap.h"
 
 #include "codeflinger/GGLAssembler.h"
@@ -790,6 +791,7 @@ void ggl_init_context(context_t* c)
     ggl_init_texture(c);
     ggl_init_picker(c);
     ggl_init_raster(c);
+    ggl_init_tiler(c);
     c->formats = gglGetPixelFormatTable();
     c->state.blend.src = GGL_ONE;
     c->state.blend.dst = GGL_ZERO;
@@ -808,6 +810,7 @@ void ggl_init_context(context_t* c)
 
 void ggl_uninit_context(context_t* c)
 {
+    ggl_uninit_tiler(c);
     ggl_uninit_scanline(c);
 }
 
@@ -19,22 +19,34 @@
 #define LOG_TAG "pixelflinger"
 
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
 
 #include <cutils/memory.h>
 #include <cutils/log.h>
+#include <cutils/properties.h>
 
 #include "buffer.h"
 #include "scanline.h"
+#include "scanline_simd.h"
 
 #include "codeflinger/CodeCache.h"
+#include "codeflinger/tinyutils/SortedVector.h"
 #include "codeflinger/GGLAssembler.h"
 #include "codeflinger/ARMAssembler.h"
 #if defined(__mips__)
 #include "codeflinger/MIPSAssembler.h"
 #endif
+#if defined(__x86_64__)
+#include "codeflinger/X86_64Assembler.h"
+#endif
 //#include "codeflinger/ARMAssemblerOptimizer.h"
 
 // ----------------------------------------------------------------------------
@@ -52,7 +64,7 @@
 #   define ANDROID_CODEGEN      ANDROID_CODEGEN_GENERATED
 #endif
 
-#if defined(__arm__) || defined(__mips__)
+#if defined(__arm__) || defined(__mips__) || defined(__x86_64__)
 #   define ANDROID_ARM_CODEGEN  1
 #else
 #   define ANDROID_ARM_CODEGEN  0
@@ -66,8 +78,15 @@
  */
 #define DEBUG_NEEDS  0
 
+/* Set to 1 to dump the code cache counters to the log every time
+ * a new scanline is generated.
+ */
+#define DEBUG_CODECACHE  0
+
 #ifdef __mips__
 #define ASSEMBLY_SCRATCH_SIZE   4096
+#elif defined(__x86_64__)
+#define ASSEMBLY_SCRATCH_SIZE   8192
 #else
 #define ASSEMBLY_SCRATCH_SIZE   2048
 #endif
@@ -91,6 +110,9 @@ static void scanline(context_t* c);
 static void scanline_perspective(context_t* c);
 static void scanline_perspective_single(context_t* c);
 static void scanline_t32cb16blend(context_t* c);
+#if ANDROID_SIMD_SCANLINE
+static void scanline_t32cb32blend(context_t* c);
+#endif
 static void scanline_t32cb16blend_dither(context_t* c);
 static void scanline_t32cb16blend_srca(context_t* c);
 static void scanline_t32cb16blend_clamp(context_t* c);
@@ -178,6 +200,12 @@ static shortcut_t shortcuts[] = {
     { { { 0x03515104, 0x00000077, { 0x00000A01, 0x00000000 } },
         { 0xFFFFFFFF, 0xFFFFFFFF, { 0xFFFFFFFF, 0x0000003F } } },
         "565 fb, 8888 tx, blend SRC_OVER", scanline_t32cb16blend, init_y_noop },
+#if ANDROID_SIMD_SCANLINE
+    /* without SIMD, the generated code is faster */
+    { { { 0x03515101, 0x00000077, { 0x00000A01, 0x00000000 } },
+        { 0xFFFFFFFF, 0xFFFFFFFF, { 0xFFFFFFFF, 0x0000003F } } },
+        "8888 fb, 8888 tx, blend SRC_OVER", scanline_t32cb32blend, init_y_noop },
+#endif
     { { { 0x03010104, 0x00000077, { 0x00000A01, 0x00000000 } },
         { 0xFFFFFFFF, 0xFFFFFFFF, { 0xFFFFFFFF, 0x0000003F } } },
         "565 fb, 8888 tx, SRC", scanline_t32cb16, init_y_noop  },
@@ -274,12 +302,14 @@ static  const needs_filter_t fill16noblend = {
 
 #if ANDROID_ARM_CODEGEN
 
-#if defined(__mips__)
-static CodeCache gCodeCache(32 * 1024);
+#if defined(__mips__) || defined(__x86_64__)
+#define CODE_CACHE_SIZE     (32 * 1024)
 #else
-static CodeCache gCodeCache(12 * 1024);
+#define CODE_CACHE_SIZE     (12 * 1024)
 #endif
 
+static CodeCache gCodeCache(CODE_CACHE_SIZE);
+
 class ScanlineAssembly : public Assembly {
     AssemblyKey<needs_t> mKey;
 public:
@@ -287,6 +317,279 @@ public:
         : Assembly(size), mKey(needs) { }
     const AssemblyKey<needs_t>& key() const { return mKey; }
 };
+
+#if defined(__x86_64__)
+// states the x86-64 backend couldn't generate code for (e.g. it ran out of
+// registers), they get the generic pipeline right away next time instead
+// of failing again on every pick
+static pthread_mutex_t gFailedNeedsLock = PTHREAD_MUTEX_INITIALIZER;
+static SortedVector<needs_t> gFailedNeeds;
+
+static bool codegen_failed(const needs_t& needs)
+{
+    pthread_mutex_lock(&gFailedNeedsLock);
+    const bool failed = gFailedNeeds.indexOf(needs) >= 0;
+    pthread_mutex_unlock(&gFailedNeedsLock);
+    return failed;
+}
+
+static void set_codegen_failed(const needs_t& needs)
+{
+    pthread_mutex_lock(&gFailedNeedsLock);
+    gFailedNeeds.add(needs);
+    pthread_mutex_unlock(&gFailedNeedsLock);
+}
+#endif
+
+// ----------------------------------------------------------------------------
+
+/*
+ * Persistent scanline cache.
+ *
+ * When ro.pf.cache names a file, every scanline generated by this process
+ * is appended to it, and the first context created by the next process
+ * loads them back into gCodeCache, so short-lived processes (recovery,
+ * charger) don't pay for code generation on their first frames.
+ *
+ * Generated code only depends on the needs_t it was built for, on the
+ * context_t layout and on the build, which the file header records; a
+ * header that doesn't match ours empties the file. The file holds about
+ * as much code as gCodeCache; once it is full, it is rewritten with what
+ * gCodeCache holds at that point. Since the file holds executable code,
+ * it is ignored unless it is a regular file owned by us and not writable
+ * by anybody else, and a file that doesn't start with our magic is never
+ * emptied.
+ */
+
+static const uint32_t CACHE_FILE_MAGIC     = 0x43434650;   // 'PFCC'
+static const uint32_t CACHE_RECORD_MAGIC   = 0x52434650;   // 'PFCR'
+static const uint32_t CACHE_FILE_VERSION   = 1;
+// what gCodeCache holds, plus room for the record headers
+static const off_t    CACHE_FILE_MAX_SIZE  = CODE_CACHE_SIZE + CODE_CACHE_SIZE / 8;
+
+struct cache_file_header_t {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    fingerprint;
+};
+
+struct cache_file_record_t {
+    uint32_t    magic;
+    needs_t     needs;
+    uint32_t    size;       // bytes of code following the record
+    uint32_t    checksum;
+};
+
+static pthread_once_t gCacheFileOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t gCacheFileLock = PTHREAD_MUTEX_INITIALIZER;
+static char gCacheFilePath[PROPERTY_VALUE_MAX];
+// states already in the file, they may have been evicted from gCodeCache
+static SortedVector<needs_t> gCacheFileNeeds;
+
+static uint32_t cache_file_hash(uint32_t h, const void* data, size_t size)
+{
+    // FNV-1a
+    const uint8_t* p = (const uint8_t*)data;
+    while (size--) {
+        h = (h ^ *p++) * 16777619;
+    }
+    return h;
+}
+
+static void cache_file_header(cache_file_header_t* header)
+{
+    char build[PROPERTY_VALUE_MAX];
+    property_get("ro.build.fingerprint", build, "");
+    const uint32_t layout[] = {
+        sizeof(void*), sizeof(context_t),
+        uint32_t(GGL_OFFSETOF(generated_vars)),
+        uint32_t(GGL_OFFSETOF(iterators)),
+        uint32_t(GGL_OFFSETOF(state.buffers)),
+        uint32_t(GGL_OFFSETOF(state.texture))
+    };
+    uint32_t h = cache_file_hash(2166136261U, build, strlen(build));
+    header->magic = CACHE_FILE_MAGIC;
+    header->version = CACHE_FILE_VERSION;
+    header->fingerprint = cache_file_hash(h, layout, sizeof(layout));
+}
+
+static uint32_t cache_record_checksum(const cache_file_record_t& record,
+        const void* code)
+{
+    uint32_t h = cache_file_hash(2166136261U, &record.needs, sizeof(needs_t));
+    h = cache_file_hash(h, &record.size, sizeof(record.size));
+    return cache_file_hash(h, code, record.size);
+}
+
+static int open_cache_file(int flags)
+{
+    int fd = open(gCacheFilePath, flags | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode) ||
+            st.st_uid != geteuid() || (st.st_mode & 022)) {
+        ALOGW("ignoring scanline cache %s, unsafe ownership or mode",
+                gCacheFilePath);
+        gCacheFilePath[0] = 0;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void load_cache_file()
+{
+    property_get("ro.pf.cache", gCacheFilePath, "");
+    if (gCacheFilePath[0] == 0)
+        return;
+
+    int fd = open_cache_file(O_RDONLY);
+    if (fd < 0)
+        return;
+    flock(fd, LOCK_SH);
+
+    cache_file_header_t expected, header;
+    cache_file_header(&expected);
+    int count = 0;
+    if (read(fd, &header, sizeof(header)) == sizeof(header) &&
+            !memcmp(&header, &expected, sizeof(header))) {
+        cache_file_record_t record;
+        while (read(fd, &record, sizeof(record)) == sizeof(record)) {
+            if (record.magic != CACHE_RECORD_MAGIC ||
+                    record.size == 0 || record.size > ASSEMBLY_SCRATCH_SIZE) {
+                break;
+            }
+            sp<ScanlineAssembly> a = new ScanlineAssembly(record.needs,
+                    record.size);
+            if (read(fd, a->base(), record.size) != ssize_t(record.size) ||
+                    cache_record_checksum(record, a->base()) != record.checksum) {
+                break;
+            }
+            gCacheFileNeeds.add(record.needs);
+            if (gCodeCache.cache(a->key(), a) != NO_ERROR) {
+                break;
+            }
+            count++;
+        }
+    }
+    ALOGD_IF(count, "loaded %d scanlines from %s", count, gCacheFilePath);
+
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+static bool append_cache_record(int fd, const ScanlineAssembly& a)
+{
+    cache_file_record_t record;
+    record.magic = CACHE_RECORD_MAGIC;
+    record.needs = a.key().value();
+    record.size = a.size();
+    record.checksum = cache_record_checksum(record, a.base());
+    return write(fd, &record, sizeof(record)) == sizeof(record) &&
+            write(fd, a.base(), record.size) == ssize_t(record.size);
+}
+
+// Empties the file down to our header, and refills it with the content of
+// gCodeCache if asked to. Called with gCacheFileLock and the flock held.
+static bool rewrite_cache_file(int fd, const cache_file_header_t& header,
+        bool refill)
+{
+    gCacheFileNeeds.clear();
+    if (ftruncate(fd, 0) ||
+            pwrite(fd, &header, sizeof(header), 0) != sizeof(header) ||
+            lseek(fd, sizeof(header), SEEK_SET) < 0) {
+        ALOGW("cannot rewrite scanline cache %s (%s)",
+                gCacheFilePath, strerror(errno));
+        return false;
+    }
+    if (!refill)
+        return true;
+
+    // keep the most recently inserted states that fit, in the order
+    // they were inserted, so that they are also the last ones loaded
+    Vector< sp<Assembly> > assemblies;
+    gCodeCache.getAssemblies(&assemblies);
+    off_t end = sizeof(header);
+    size_t first = assemblies.size();
+    while (first > 0) {
+        const off_t size = sizeof(cache_file_record_t) +
+                assemblies[first - 1]->size();
+        if (end + size > CACHE_FILE_MAX_SIZE)
+            break;
+        end += size;
+        first--;
+    }
+    end = sizeof(header);
+    for (size_t i = first ; i < assemblies.size() ; i++) {
+        const ScanlineAssembly& a =
+                *static_cast<ScanlineAssembly*>(assemblies[i].get());
+        if (!append_cache_record(fd, a)) {
+            // don't leave a torn record behind
+            ftruncate(fd, end);
+            return false;
+        }
+        end += sizeof(cache_file_record_t) + a.size();
+        gCacheFileNeeds.add(a.key().value());
+    }
+    return true;
+}
+
+static void save_to_cache_file(const sp<ScanlineAssembly>& a)
+{
+    if (gCacheFilePath[0] == 0)
+        return;
+
+    pthread_mutex_lock(&gCacheFileLock);
+    const needs_t& needs = a->key().value();
+    int fd = -1;
+    if (gCacheFileNeeds.indexOf(needs) < 0) {
+        fd = open_cache_file(O_RDWR | O_CREAT);
+    }
+    if (fd < 0) {
+        pthread_mutex_unlock(&gCacheFileLock);
+        return;
+    }
+    flock(fd, LOCK_EX);
+
+    // start over if the file is new or was written by another build,
+    // but leave alone anything that isn't a scanline cache
+    cache_file_header_t expected, header;
+    cache_file_header(&expected);
+    const ssize_t n = pread(fd, &header, sizeof(header), 0);
+    bool ok = true;
+    if (n != sizeof(header) || memcmp(&header, &expected, sizeof(header))) {
+        if (n == 0 || (n >= ssize_t(sizeof(header.magic)) &&
+                header.magic == CACHE_FILE_MAGIC)) {
+            ok = rewrite_cache_file(fd, expected, false);
+        } else {
+            ALOGW("ignoring scanline cache %s, not a scanline cache",
+                    gCacheFilePath);
+            gCacheFilePath[0] = 0;
+            ok = false;
+        }
+    }
+
+    const off_t end = ok ? lseek(fd, 0, SEEK_END) : -1;
+    if (end >= 0) {
+        if (end + off_t(sizeof(cache_file_record_t) + a->size()) >
+                CACHE_FILE_MAX_SIZE) {
+            // full, replace it with the current working set, which
+            // includes this state since gCodeCache already has it
+            rewrite_cache_file(fd, expected, true);
+        } else if (append_cache_record(fd, *a)) {
+            gCacheFileNeeds.add(needs);
+        } else if (ftruncate(fd, end)) {
+            // a torn record stops the loading there, nothing more to do
+            ALOGW("cannot truncate scanline cache %s (%s)",
+                    gCacheFilePath, strerror(errno));
+        }
+    }
+
+    flock(fd, LOCK_UN);
+    close(fd);
+    pthread_mutex_unlock(&gCacheFileLock);
+}
 #endif
 
 // ----------------------------------------------------------------------------
@@ -296,6 +599,9 @@ void ggl_init_scanline(context_t* c)
     c->init_y = init_y;
     c->step_y = step_y__generic;
     c->scanline = scanline;
+#if ANDROID_ARM_CODEGEN
+    pthread_once(&gCacheFileOnce, load_cache_file);
+#endif
 }
 
 void ggl_uninit_scanline(context_t* c)
@@ -377,10 +683,21 @@ static void pick_scanline(context_t* c)
     c->init_y = init_y;
     c->step_y = step_y__generic;
 
+    if (c->generic_pipeline) {
+        c->scanline = scanline;
+        return;
+    }
+
 #if ANDROID_ARM_CODEGEN
     // we're going to have to generate some code...
     // here, generate code for our pixel pipeline
     const AssemblyKey<needs_t> key(c->state.needs);
+#if defined(__x86_64__)
+    if (codegen_failed(c->state.needs)) {
+        c->scanline = scanline;
+        return;
+    }
+#endif
     sp<Assembly> assembly = gCodeCache.lookup(key);
     if (assembly == 0) {
         // create a new assembly region
@@ -394,14 +711,41 @@ static void pick_scanline(context_t* c)
 #endif
 #if defined(__mips__)
         GGLAssembler assembler( new ArmToMipsAssembler(a) );
+#endif
+#if defined(__x86_64__)
+        GGLAssembler assembler( new ArmToX86_64Assembler(a) );
 #endif
         // generate the scanline code for the given needs
+        const int64_t jitTime = ggl_system_time();
         int err = assembler.scanline(c->state.needs, c);
         if (ggl_likely(!err)) {
             // finally, cache this assembly
-            err = gCodeCache.cache(a->key(), a);
+            err = gCodeCache.cache(a->key(), a, ggl_system_time() - jitTime);
+            if (ggl_likely(!err)) {
+                save_to_cache_file(a);
+            }
+        }
+#if defined(__x86_64__)
+        else {
+            set_codegen_failed(c->state.needs);
         }
+#endif
+#if DEBUG_CODECACHE
+        CodeCache::stats_t stats;
+        gCodeCache.getStats(&stats);
+        ALOGD("CodeCache: %u hits, %u misses, %zu entries (%zu bytes), "
+             "%u evictions (%zu bytes), %lld us generating",
+             stats.hits, stats.misses, stats.entries, stats.bytesInUse,
+             stats.evictions, stats.bytesEvicted,
+             (long long)(stats.jitTime / 1000));
+#endif
         if (ggl_unlikely(err)) {
+#if defined(__x86_64__)
+            // not every pipeline fits the x86-64 registers
+            ALOGW("error generating or caching assembly. Using generic pipeline.");
+            c->scanline = scanline;
+            return;
+#endif
             ALOGE("error generating or caching assembly. Reverting to NOP.");
             c->scanline = scanline_noop;
             c->init_y = init_y_noop;
@@ -426,6 +770,15 @@ static void pick_scanline(context_t* c)
 #endif
 }
 
+void ggl_set_codegen(context_t* c, int enable)
+{
+    c->generic_pipeline = !enable;
+    // the picker only runs again when the needs change
+    if (c->state.needs.n) {
+        ggl_pick_scanline(c);
+    }
+}
+
 void ggl_pick_scanline(context_t* c)
 {
     pick_scanline(c);
@@ -448,15 +801,6 @@ static void blend_factor(context_t* c, pixel_t* r, uint32_t factor,
         const pixel_t* src, const pixel_t* dst);
 static void rescale(uint32_t& u, uint8_t& su, uint32_t& v, uint8_t& sv);
 
-#if ANDROID_ARM_CODEGEN && (ANDROID_CODEGEN == ANDROID_CODEGEN_GENERATED)
-
-// no need to compile the generic-pipeline, it can't be reached
-void scanline(context_t*)
-{
-}
-
-#else
-
 void rescale(uint32_t& u, uint8_t& su, uint32_t& v, uint8_t& sv)
 {
     if (su && sv) {
@@ -923,8 +1267,6 @@ discard:
 	}
 }
 
-#endif // ANDROID_ARM_CODEGEN && (ANDROID_CODEGEN == ANDROID_CODEGEN_GENERATED)
-
 // ----------------------------------------------------------------------------
 #if 0
 #pragma mark -
@@ -1241,6 +1583,18 @@ struct blender_modulate {
         m_b = b + (b >> 7);
         m_a = a + (a >> 7);
     }
+    void init(const int32_t* m) {
+        m_r = m[0];
+        m_g = m[1];
+        m_b = m[2];
+        m_a = m[3];
+    }
+    void factors(int32_t* m) const {
+        m[0] = m_r;
+        m[1] = m_g;
+        m[2] = m_b;
+        m[3] = m_a;
+    }
 protected:
     int m_r, m_g, m_b, m_a;
 };
@@ -1251,6 +1605,9 @@ struct blender_32to16_modulate : blender_modulate {
     blender_32to16_modulate(const context_t* c) {
         init(c);
     }
+    blender_32to16_modulate(const int32_t* m) {
+        init(m);
+    }
     void write(uint32_t s, uint16_t* dst) {
         // blend source and destination
         if (!s) {
@@ -1423,6 +1780,48 @@ struct dst_iterator16 {
     uint16_t*  dst;
 };
 
+void ggl_blend32to16_reference(uint16_t* dst, const uint32_t* src,
+        size_t ct, const int32_t* modulate)
+{
+    if (modulate) {
+        blender_32to16_modulate bl(modulate);
+        for (size_t i=0 ; i<ct ; i++) {
+            bl.write(src[i], dst + i);
+        }
+    } else {
+        blender_32to16 bl(0);
+        for (size_t i=0 ; i<ct ; i++) {
+            bl.write(src[i], dst + i);
+        }
+    }
+}
+
+#if ANDROID_SIMD_SCANLINE
+/* Blends the pixels returned by a texture iterator in chunks, so that
+ * the fetches stay scalar but the blending itself is vectorized.
+ * modulate is NULL for a plain SRC_OVER.
+ */
+template <typename I>
+static void blend_chunks32to16(I& ci, dst_iterator16& di,
+        const int32_t* modulate)
+{
+    uint32_t buf[64];
+    while (di.count > 0) {
+        const int n = di.count < 64 ? di.count : 64;
+        for (int i=0 ; i<n ; i++) {
+            buf[i] = ci.get_pixel32();
+        }
+        if (modulate) {
+            scanline_t32cb16blend_mod_simd(di.dst, buf, n, modulate);
+        } else {
+            scanline_t32cb16blend_simd(di.dst, buf, n);
+        }
+        di.dst += n;
+        di.count -= n;
+    }
+}
+#endif
+
 
 static void scanline_t32cb16_clamp(context_t* c)
 {
@@ -1495,6 +1894,15 @@ static void scanline_t32cb16blend_dither(context_t* c)
 static void scanline_t32cb16blend_clamp(context_t* c)
 {
     dst_iterator16  di(c);
+#if ANDROID_SIMD_SCANLINE
+    if (is_context_horizontal(c)) {
+        horz_clamp_iterator32 ci(c);
+        blend_chunks32to16(ci, di, NULL);
+    } else {
+        clamp_iterator ci(c);
+        blend_chunks32to16(ci, di, NULL);
+    }
+#else
     blender_32to16  bl(c);
 
     if (is_context_horizontal(c)) {
@@ -1512,6 +1920,7 @@ static void scanline_t32cb16blend_clamp(context_t* c)
             di.dst++;
         }
     }
+#endif
 }
 
 static void scanline_t32cb16blend_clamp_dither(context_t* c)
@@ -1534,11 +1943,17 @@ void scanline_t32cb16blend_clamp_mod(context_t* c)
     blender_32to16_modulate bl(c);
 
     clamp_iterator ci(c);
+#if ANDROID_SIMD_SCANLINE
+    int32_t modulate[4];
+    bl.factors(modulate);
+    blend_chunks32to16(ci, di, modulate);
+#else
     while (di.count--) {
         uint32_t s = ci.get_pixel32();
         bl.write(s, di.dst);
         di.dst++;
     }
+#endif
 }
 
 void scanline_t32cb16blend_clamp_mod_dither(context_t* c)
@@ -1717,7 +2132,7 @@ void init_y(context_t* c, int32_t ys)
             gen.width   = t.surface.width;
             gen.height  = t.surface.height;
             gen.stride  = t.surface.stride;
-            gen.data    = int32_t(t.surface.data);
+            gen.data    = uintptr_t(t.surface.data);
             gen.dsdx = ti.dsdx;
             gen.dtdx = ti.dtdx;
         }
@@ -2125,7 +2540,7 @@ void scanline_t32cb16(context_t* c)
     int sR, sG, sB;
     uint32_t s, d;
 
-    if (ct==1 || uint32_t(dst)&2) {
+    if (ct==1 || uintptr_t(dst)&2) {
 last_one:
         s = GGL_RGBA_TO_HOST( *src++ );
         *dst++ = convertAbgr8888ToRgb565(s);
@@ -2157,7 +2572,8 @@ last_one:
 
 void scanline_t32cb16blend(context_t* c)
 {
-#if ((ANDROID_CODEGEN >= ANDROID_CODEGEN_ASM) && (defined(__arm__) || defined(__mips)))
+#if ANDROID_SIMD_SCANLINE || \
+    ((ANDROID_CODEGEN >= ANDROID_CODEGEN_ASM) && (defined(__arm__) || defined(__mips)))
     int32_t x = c->iterators.xl;
     size_t ct = c->iterators.xr - x;
     int32_t y = c->iterators.y;
@@ -2169,7 +2585,9 @@ void scanline_t32cb16blend(context_t* c)
     const int32_t v = (c->state.texture[0].shade.it0>>16) + y;
     uint32_t *src = reinterpret_cast<uint32_t*>(tex->data)+(u+(tex->stride*v));
 
-#ifdef __arm__
+#if ANDROID_SIMD_SCANLINE
+    scanline_t32cb16blend_simd(dst, src, ct);
+#elif defined(__arm__)
     scanline_t32cb16blend_arm(dst, src, ct);
 #else
     scanline_t32cb16blend_mips(dst, src, ct);
@@ -2186,6 +2604,24 @@ void scanline_t32cb16blend(context_t* c)
 #endif
 }
 
+#if ANDROID_SIMD_SCANLINE
+void scanline_t32cb32blend(context_t* c)
+{
+    int32_t x = c->iterators.xl;
+    size_t ct = c->iterators.xr - x;
+    int32_t y = c->iterators.y;
+    surface_t* cb = &(c->state.buffers.color);
+    uint32_t* dst = reinterpret_cast<uint32_t*>(cb->data) + (x+(cb->stride*y));
+
+    surface_t* tex = &(c->state.texture[0].surface);
+    const int32_t u = (c->state.texture[0].shade.is0>>16) + x;
+    const int32_t v = (c->state.texture[0].shade.it0>>16) + y;
+    uint32_t *src = reinterpret_cast<uint32_t*>(tex->data)+(u+(tex->stride*v));
+
+    scanline_t32cb32blend_simd(dst, src, ct);
+}
+#endif
+
 void scanline_t32cb16blend_srca(context_t* c)
 {
     dst_iterator16  di(c);
@@ -27,6 +27,17 @@ void ggl_init_scanline(context_t* c);
 void ggl_uninit_scanline(context_t* c);
 void ggl_pick_scanline(context_t* c);
 
+// With enable set to 0, c runs the generic pixel pipeline wherever it would
+// otherwise generate code (the hand-written shortcuts are still used), so
+// that the code generator can be checked against it.
+void ggl_set_codegen(context_t* c, int enable);
+
+// Blends ct premultiplied 8888 pixels over 565 ones with the scalar blenders
+// that the SIMD kernels in scanline_simd.h replace, so that they can be
+// checked against each other. modulate is NULL for a plain SRC_OVER.
+void ggl_blend32to16_reference(uint16_t* dst, const uint32_t* src,
+        size_t ct, const int32_t* modulate);
+
 }; // namespace android
 
 #endif
@@ -0,0 +1,309 @@
+/* libs/pixelflinger/scanline_simd.cpp
+**
+** Copyright 2013, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include <private/pixelflinger/ggl_context.h>
+
+#include "scanline_simd.h"
+
+#if ANDROID_SIMD_SCANLINE
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace android {
+
+// ----------------------------------------------------------------------------
+
+/*
+ * The vector loops handle 8 pixels at a time with 16-bit lanes, which is
+ * enough for every intermediate value: f*d is at most 256*255, and the
+ * modulated 6.8 green plus f*dG stays below 32768. What's left of the
+ * span goes through the scalar versions, which are also what the other
+ * architectures run.
+ */
+
+static inline uint16_t blend565(uint32_t s, uint16_t d)
+{
+    s = GGL_RGBA_TO_HOST(s);
+    const int sA = (s>>24);
+    const int f = 0x100 - (sA + (sA>>7));
+    int sR = (s >> (   3))&0x1F;
+    int sG = (s >> ( 8+2))&0x3F;
+    int sB = (s >> (16+3))&0x1F;
+    sR += (f*((d>>11)&0x1f))>>8;
+    sG += (f*((d>>5)&0x3f))>>8;
+    sB += (f*((d)&0x1f))>>8;
+    return uint16_t((sR<<11)|(sG<<5)|sB);
+}
+
+static inline uint16_t blend565_mod(uint32_t s, uint16_t d, const int32_t* m)
+{
+    s = GGL_RGBA_TO_HOST(s);
+    uint32_t sA = (((s >> 24)       )*m[3]) >> 8;
+    uint32_t sR = (((s      ) & 0xff)*m[0]) >> (8 - 5);
+    uint32_t sG = (((s >>  8) & 0xff)*m[1]) >> (8 - 6);
+    uint32_t sB = (((s >> 16) & 0xff)*m[2]) >> (8 - 5);
+    const int f = 0x100 - (sA + (sA>>7));
+    sR = (sR + f*((d>>11)&0x1f))>>8;
+    sG = (sG + f*((d>>5)&0x3f))>>8;
+    sB = (sB + f*((d)&0x1f))>>8;
+    return uint16_t((sR<<11)|(sG<<5)|sB);
+}
+
+static inline void blend8888(const uint8_t* s, uint8_t* d)
+{
+    // GGL_PIXEL_FORMAT_RGBA_8888 is stored r, g, b, a in memory
+    const int f = 0x100 - (s[3] + (s[3]>>7));
+    for (int i=0 ; i<4 ; i++) {
+        const int c = s[i] + ((f*d[i])>>8);
+        d[i] = uint8_t(c > 0xff ? 0xff : c);
+    }
+}
+
+// ----------------------------------------------------------------------------
+#if ANDROID_SIMD_SCANLINE && defined(__SSE2__)
+
+// splits 8 8888 pixels into 16-bit r, g, b and a lanes
+static inline void unpack8888(const uint32_t* src,
+        __m128i& r, __m128i& g, __m128i& b, __m128i& a)
+{
+    const __m128i mask = _mm_set1_epi32(0xff);
+    const __m128i s0 = _mm_loadu_si128((const __m128i*)src);
+    const __m128i s1 = _mm_loadu_si128((const __m128i*)(src + 4));
+    r = _mm_packs_epi32(_mm_and_si128(s0, mask), _mm_and_si128(s1, mask));
+    g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(s0, 8), mask),
+                        _mm_and_si128(_mm_srli_epi32(s1, 8), mask));
+    b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(s0, 16), mask),
+                        _mm_and_si128(_mm_srli_epi32(s1, 16), mask));
+    a = _mm_packs_epi32(_mm_srli_epi32(s0, 24), _mm_srli_epi32(s1, 24));
+}
+
+// f = 0x100 - (a + (a>>7))
+static inline __m128i one_minus(__m128i a)
+{
+    return _mm_sub_epi16(_mm_set1_epi16(0x100),
+                         _mm_add_epi16(a, _mm_srli_epi16(a, 7)));
+}
+
+static inline __m128i pack565(__m128i r, __m128i g, __m128i b)
+{
+    return _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11),
+                                     _mm_slli_epi16(g, 5)), b);
+}
+
+static size_t t32cb16blend(uint16_t* dst, const uint32_t* src, size_t ct)
+{
+    const __m128i mask5 = _mm_set1_epi16(0x1f);
+    const __m128i mask6 = _mm_set1_epi16(0x3f);
+    size_t i = 0;
+    for ( ; i+8 <= ct ; i += 8) {
+        __m128i r, g, b, a;
+        unpack8888(src + i, r, g, b, a);
+        const __m128i f = one_minus(a);
+        const __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        const __m128i dR = _mm_srli_epi16(d, 11);
+        const __m128i dG = _mm_and_si128(_mm_srli_epi16(d, 5), mask6);
+        const __m128i dB = _mm_and_si128(d, mask5);
+        r = _mm_add_epi16(_mm_srli_epi16(r, 3),
+                          _mm_srli_epi16(_mm_mullo_epi16(f, dR), 8));
+        g = _mm_add_epi16(_mm_srli_epi16(g, 2),
+                          _mm_srli_epi16(_mm_mullo_epi16(f, dG), 8));
+        b = _mm_add_epi16(_mm_srli_epi16(b, 3),
+                          _mm_srli_epi16(_mm_mullo_epi16(f, dB), 8));
+        _mm_storeu_si128((__m128i*)(dst + i), pack565(r, g, b));
+    }
+    return i;
+}
+
+static size_t t32cb16blend_mod(uint16_t* dst, const uint32_t* src,
+        size_t ct, const int32_t* m)
+{
+    const __m128i mask5 = _mm_set1_epi16(0x1f);
+    const __m128i mask6 = _mm_set1_epi16(0x3f);
+    const __m128i mR = _mm_set1_epi16(m[0]);
+    const __m128i mG = _mm_set1_epi16(m[1]);
+    const __m128i mB = _mm_set1_epi16(m[2]);
+    const __m128i mA = _mm_set1_epi16(m[3]);
+    size_t i = 0;
+    for ( ; i+8 <= ct ; i += 8) {
+        __m128i r, g, b, a;
+        unpack8888(src + i, r, g, b, a);
+        a = _mm_srli_epi16(_mm_mullo_epi16(a, mA), 8);
+        r = _mm_srli_epi16(_mm_mullo_epi16(r, mR), 8 - 5);
+        g = _mm_srli_epi16(_mm_mullo_epi16(g, mG), 8 - 6);
+        b = _mm_srli_epi16(_mm_mullo_epi16(b, mB), 8 - 5);
+        const __m128i f = one_minus(a);
+        const __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        const __m128i dR = _mm_srli_epi16(d, 11);
+        const __m128i dG = _mm_and_si128(_mm_srli_epi16(d, 5), mask6);
+        const __m128i dB = _mm_and_si128(d, mask5);
+        r = _mm_srli_epi16(_mm_add_epi16(r, _mm_mullo_epi16(f, dR)), 8);
+        g = _mm_srli_epi16(_mm_add_epi16(g, _mm_mullo_epi16(f, dG)), 8);
+        b = _mm_srli_epi16(_mm_add_epi16(b, _mm_mullo_epi16(f, dB)), 8);
+        _mm_storeu_si128((__m128i*)(dst + i), pack565(r, g, b));
+    }
+    return i;
+}
+
+static size_t t32cb32blend(uint32_t* dst, const uint32_t* src, size_t ct)
+{
+    const __m128i max = _mm_set1_epi16(0xff);
+    size_t i = 0;
+    for ( ; i+8 <= ct ; i += 8) {
+        __m128i r, g, b, a, dR, dG, dB, dA;
+        unpack8888(src + i, r, g, b, a);
+        unpack8888(dst + i, dR, dG, dB, dA);
+        const __m128i f = one_minus(a);
+        r = _mm_add_epi16(r, _mm_srli_epi16(_mm_mullo_epi16(f, dR), 8));
+        g = _mm_add_epi16(g, _mm_srli_epi16(_mm_mullo_epi16(f, dG), 8));
+        b = _mm_add_epi16(b, _mm_srli_epi16(_mm_mullo_epi16(f, dB), 8));
+        a = _mm_add_epi16(a, _mm_srli_epi16(_mm_mullo_epi16(f, dA), 8));
+        const __m128i rg = _mm_or_si128(_mm_min_epi16(r, max),
+                _mm_slli_epi16(_mm_min_epi16(g, max), 8));
+        const __m128i ba = _mm_or_si128(_mm_min_epi16(b, max),
+                _mm_slli_epi16(_mm_min_epi16(a, max), 8));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(rg, ba));
+    }
+    return i;
+}
+
+// ----------------------------------------------------------------------------
+#elif ANDROID_SIMD_SCANLINE
+
+static inline uint16x8_t one_minus(uint16x8_t a)
+{
+    return vsubq_u16(vdupq_n_u16(0x100), vsraq_n_u16(a, a, 7));
+}
+
+static inline uint16x8_t pack565(uint16x8_t r, uint16x8_t g, uint16x8_t b)
+{
+    return vorrq_u16(vorrq_u16(vshlq_n_u16(r, 11), vshlq_n_u16(g, 5)), b);
+}
+
+static size_t t32cb16blend(uint16_t* dst, const uint32_t* src, size_t ct)
+{
+    const uint16x8_t mask5 = vdupq_n_u16(0x1f);
+    const uint16x8_t mask6 = vdupq_n_u16(0x3f);
+    size_t i = 0;
+    for ( ; i+8 <= ct ; i += 8) {
+        const uint8x8x4_t s = vld4_u8((const uint8_t*)(src + i));
+        const uint16x8_t f = one_minus(vmovl_u8(s.val[3]));
+        const uint16x8_t d = vld1q_u16(dst + i);
+        const uint16x8_t dR = vshrq_n_u16(d, 11);
+        const uint16x8_t dG = vandq_u16(vshrq_n_u16(d, 5), mask6);
+        const uint16x8_t dB = vandq_u16(d, mask5);
+        uint16x8_t r = vmovl_u8(vshr_n_u8(s.val[0], 3));
+        uint16x8_t g = vmovl_u8(vshr_n_u8(s.val[1], 2));
+        uint16x8_t b = vmovl_u8(vshr_n_u8(s.val[2], 3));
+        r = vsraq_n_u16(r, vmulq_u16(f, dR), 8);
+        g = vsraq_n_u16(g, vmulq_u16(f, dG), 8);
+        b = vsraq_n_u16(b, vmulq_u16(f, dB), 8);
+        vst1q_u16(dst + i, pack565(r, g, b));
+    }
+    return i;
+}
+
+static size_t t32cb16blend_mod(uint16_t* dst, const uint32_t* src,
+        size_t ct, const int32_t* m)
+{
+    const uint16x8_t mask5 = vdupq_n_u16(0x1f);
+    const uint16x8_t mask6 = vdupq_n_u16(0x3f);
+    const uint16x8_t mR = vdupq_n_u16(m[0]);
+    const uint16x8_t mG = vdupq_n_u16(m[1]);
+    const uint16x8_t mB = vdupq_n_u16(m[2]);
+    const uint16x8_t mA = vdupq_n_u16(m[3]);
+    size_t i = 0;
+    for ( ; i+8 <= ct ; i += 8) {
+        const uint8x8x4_t s = vld4_u8((const uint8_t*)(src + i));
+        const uint16x8_t a = vshrq_n_u16(vmulq_u16(vmovl_u8(s.val[3]), mA), 8);
+        uint16x8_t r = vshrq_n_u16(vmulq_u16(vmovl_u8(s.val[0]), mR), 8 - 5);
+        uint16x8_t g = vshrq_n_u16(vmulq_u16(vmovl_u8(s.val[1]), mG), 8 - 6);
+        uint16x8_t b = vshrq_n_u16(vmulq_u16(vmovl_u8(s.val[2]), mB), 8 - 5);
+        const uint16x8_t f = one_minus(a);
+        const uint16x8_t d = vld1q_u16(dst + i);
+        const uint16x8_t dR = vshrq_n_u16(d, 11);
+        const uint16x8_t dG = vandq_u16(vshrq_n_u16(d, 5), mask6);
+        const uint16x8_t dB = vandq_u16(d, mask5);
+        r = vshrq_n_u16(vmlaq_u16(r, f, dR), 8);
+        g = vshrq_n_u16(vmlaq_u16(g, f, dG), 8);
+        b = vshrq_n_u16(vmlaq_u16(b, f, dB), 8);
+        vst1q_u16(dst + i, pack565(r, g, b));
+    }
+    return i;
+}
+
+static size_t t32cb32blend(uint32_t* dst, const uint32_t* src, size_t ct)
+{
+    size_t i = 0;
+    for ( ; i+8 <= ct ; i += 8) {
+        const uint8x8x4_t s = vld4_u8((const uint8_t*)(src + i));
+        uint8x8x4_t d = vld4_u8((const uint8_t*)(dst + i));
+        const uint16x8_t f = one_minus(vmovl_u8(s.val[3]));
+        for (int j=0 ; j<4 ; j++) {
+            const uint16x8_t c = vsraq_n_u16(vmovl_u8(s.val[j]),
+                    vmulq_u16(f, vmovl_u8(d.val[j])), 8);
+            d.val[j] = vqmovn_u16(c);
+        }
+        vst4_u8((uint8_t*)(dst + i), d);
+    }
+    return i;
+}
+
+// ----------------------------------------------------------------------------
+#else
+
+static size_t t32cb16blend(uint16_t*, const uint32_t*, size_t) {
+    return 0;
+}
+static size_t t32cb16blend_mod(uint16_t*, const uint32_t*, size_t,
+        const int32_t*) {
+    return 0;
+}
+static size_t t32cb32blend(uint32_t*, const uint32_t*, size_t) {
+    return 0;
+}
+
+#endif
+// ----------------------------------------------------------------------------
+
+void scanline_t32cb16blend_simd(uint16_t* dst, const uint32_t* src, size_t ct)
+{
+    for (size_t i = t32cb16blend(dst, src, ct) ; i<ct ; i++) {
+        dst[i] = blend565(src[i], dst[i]);
+    }
+}
+
+void scanline_t32cb16blend_mod_simd(uint16_t* dst, const uint32_t* src,
+        size_t ct, const int32_t* modulate)
+{
+    for (size_t i = t32cb16blend_mod(dst, src, ct, modulate) ; i<ct ; i++) {
+        dst[i] = blend565_mod(src[i], dst[i], modulate);
+    }
+}
+
+void scanline_t32cb32blend_simd(uint32_t* dst, const uint32_t* src, size_t ct)
+{
+    for (size_t i = t32cb32blend(dst, src, ct) ; i<ct ; i++) {
+        blend8888((const uint8_t*)(src + i), (uint8_t*)(dst + i));
+    }
+}
+
+}; // namespace android
@@ -0,0 +1,54 @@
+/* libs/pixelflinger/scanline_simd.h
+**
+** Copyright 2013, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+
+#ifndef ANDROID_SCANLINE_SIMD_H
+#define ANDROID_SCANLINE_SIMD_H
+
+#include <endian.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Set when the kernels below are vectorized, that is when building for
+// a little-endian target with SSE2 or NEON. Otherwise they are plain
+// loops, which the scanlines only use where they have no better option.
+#if (defined(__SSE2__) || defined(__ARM_HAVE_NEON)) && \
+        BYTE_ORDER == LITTLE_ENDIAN
+#define ANDROID_SIMD_SCANLINE   1
+#else
+#define ANDROID_SIMD_SCANLINE   0
+#endif
+
+namespace android {
+
+/*
+ * SRC_OVER blending of premultiplied 8888 source pixels, that is
+ * d = s + d * (1 - sA). The 16-bit destination variants produce the
+ * same pixels as blender_32to16 and blender_32to16_modulate in
+ * scanline.cpp; modulate holds the red, green, blue and alpha factors
+ * from blender_modulate, each in 0..256.
+ */
+extern "C" void scanline_t32cb16blend_simd(uint16_t* dst,
+        const uint32_t* src, size_t ct);
+extern "C" void scanline_t32cb16blend_mod_simd(uint16_t* dst,
+        const uint32_t* src, size_t ct, const int32_t* modulate);
+extern "C" void scanline_t32cb32blend_simd(uint32_t* dst,
+        const uint32_t* src, size_t ct);
+
+}; // namespace android
+
+#endif // ANDROID_SCANLINE_SIMD_H
@@ -0,0 +1,155 @@
+/*
+ * Fill-rate benchmark for the textured SRC_OVER scanlines, i.e. what
+ * gets used to compose premultiplied 8888 layers. Each case draws
+ * full-screen rectangles through the public GGL API and reports the
+ * number of pixels blended per second.
+ *
+ * usage: test-pixelflinger-blend [width height [frames]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <pixelflinger/pixelflinger.h>
+
+enum {
+    ONE_TO_ONE  = 0x1,
+    SCALED      = 0x2,
+    MODULATE    = 0x4
+};
+
+struct blend_test_t {
+    const char* name;
+    int32_t     cbFormat;
+    int32_t     txFormat;
+    uint32_t    flags;
+};
+
+static const blend_test_t gTests[] = {
+    { "565 fb, 8888 tx, SRC_OVER",
+            GGL_PIXEL_FORMAT_RGB_565,   GGL_PIXEL_FORMAT_RGBA_8888, ONE_TO_ONE },
+    { "8888 fb, 8888 tx, SRC_OVER",
+            GGL_PIXEL_FORMAT_RGBA_8888, GGL_PIXEL_FORMAT_RGBA_8888, ONE_TO_ONE },
+    { "565 fb, 8888 tx, SRC_OVER clamp",
+            GGL_PIXEL_FORMAT_RGB_565,   GGL_PIXEL_FORMAT_RGBA_8888, SCALED },
+    { "565 fb, 8888 tx, SRC_OVER clamp modulate",
+            GGL_PIXEL_FORMAT_RGB_565,   GGL_PIXEL_FORMAT_RGBA_8888, SCALED|MODULATE },
+};
+
+static int64_t now_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return int64_t(t.tv_sec)*1000000000LL + t.tv_nsec;
+}
+
+static void run(const blend_test_t& test, int w, int h, int frames)
+{
+    const size_t cbSize = w * h * (test.cbFormat == GGL_PIXEL_FORMAT_RGB_565 ? 2 : 4);
+    uint8_t* cb = (uint8_t*)malloc(cbSize);
+    uint8_t* tx = (uint8_t*)malloc(w * h * 4);
+    if (!cb || !tx) {
+        printf("out of memory\n");
+        free(cb);
+        free(tx);
+        return;
+    }
+
+    // a mix of opaque, transparent and translucent premultiplied pixels
+    memset(cb, 0x5a, cbSize);
+    for (int i=0 ; i<w*h ; i++) {
+        const uint8_t a = (i & 3) == 0 ? 0xff : (i & 3) == 1 ? 0 : uint8_t(i*7);
+        tx[i*4 + 0] = uint8_t((i*13 & 0xff) * a / 255);
+        tx[i*4 + 1] = uint8_t((i*29 & 0xff) * a / 255);
+        tx[i*4 + 2] = uint8_t((i*47 & 0xff) * a / 255);
+        tx[i*4 + 3] = a;
+    }
+
+    GGLContext* c;
+    gglInit(&c);
+
+    GGLSurface s;
+    memset(&s, 0, sizeof(s));
+    s.version = sizeof(s);
+    s.width = w;
+    s.height = h;
+    s.stride = w;
+    s.data = cb;
+    s.format = test.cbFormat;
+    c->colorBuffer(c, &s);
+
+    GGLSurface t = s;
+    t.data = tx;
+    t.format = test.txFormat;
+    if (test.flags & SCALED) {
+        // sample a slightly smaller texture, so that it gets stretched
+        t.width = w - w/8;
+        t.height = h - h/8;
+    }
+    c->activeTexture(c, 0);
+    c->bindTexture(c, &t);
+    c->texEnvi(c, GGL_TEXTURE_ENV, GGL_TEXTURE_ENV_MODE,
+            (test.flags & MODULATE) ? GGL_MODULATE : GGL_REPLACE);
+    c->texParameteri(c, GGL_TEXTURE_2D, GGL_TEXTURE_MIN_FILTER, GGL_NEAREST);
+    c->texParameteri(c, GGL_TEXTURE_2D, GGL_TEXTURE_MAG_FILTER, GGL_NEAREST);
+    c->texParameteri(c, GGL_TEXTURE_2D, GGL_TEXTURE_WRAP_S, GGL_CLAMP_TO_EDGE);
+    c->texParameteri(c, GGL_TEXTURE_2D, GGL_TEXTURE_WRAP_T, GGL_CLAMP_TO_EDGE);
+    c->enable(c, GGL_TEXTURE_2D);
+    if (test.flags & SCALED) {
+        const int32_t scale = (t.width << 16) / w;
+        const int32_t grad[8] = { 0, scale, 0, 0, 0, 0, scale, 0 };
+        c->texCoordGradScale8xv(c, 0, grad);
+        c->texGeni(c, GGL_S, GGL_TEXTURE_GEN_MODE, GGL_AUTOMATIC);
+        c->texGeni(c, GGL_T, GGL_TEXTURE_GEN_MODE, GGL_AUTOMATIC);
+    } else {
+        const int32_t grad[8] = { 0, 0x10000, 0, 0, 0, 0, 0x10000, 0 };
+        c->texCoordGradScale8xv(c, 0, grad);
+    }
+    c->enable(c, GGL_BLEND);
+    c->blendFunc(c, GGL_ONE, GGL_ONE_MINUS_SRC_ALPHA);
+    c->disable(c, GGL_DITHER);
+    c->shadeModel(c, GGL_FLAT);
+    const GGLclampx color[4] = { 0xC000, 0xE000, 0xFFFF, 0xC000 };
+    c->color4xv(c, color);
+
+    // the first frame picks (or generates) the scanline
+    c->recti(c, 0, 0, w, h);
+
+    const int64_t start = now_ns();
+    for (int i=0 ; i<frames ; i++) {
+        c->recti(c, 0, 0, w, h);
+    }
+    const int64_t elapsed = now_ns() - start;
+
+    printf("%-44s %8.2f ms/frame %8.1f Mpix/s\n", test.name,
+            elapsed / (1e6 * frames),
+            (double(w) * h * frames * 1e3) / elapsed);
+
+    gglUninit(c);
+    free(cb);
+    free(tx);
+}
+
+int main(int argc, char** argv)
+{
+    int w = 1280, h = 720, frames = 50;
+    if (argc >= 3) {
+        w = atoi(argv[1]);
+        h = atoi(argv[2]);
+    }
+    if (argc >= 4) {
+        frames = atoi(argv[3]);
+    }
+    if (w <= 0 || h <= 0 || frames <= 0) {
+        printf("usage: %s [width height [frames]]\n", argv[0]);
+        return 1;
+    }
+
+    for (size_t i=0 ; i<sizeof(gTests)/sizeof(gTests[0]) ; i++) {
+        run(gTests[i], w, h, frames);
+    }
+    return 0;
+}
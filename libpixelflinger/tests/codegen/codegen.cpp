@@ -1,6 +1,18 @@
+/*
+ * Without arguments, renders a set of pixel pipeline configurations with
+ * generated code and with the generic pipeline, and compares the results.
+ * With a needs string (as printed in the log when code generation fails),
+ * only generates the code for those needs.
+ *
+ * usage: test-opengl-codegen [00000117:03454504_00001501_00000000]
+ */
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
+#include <pixelflinger/pixelflinger.h>
 #include "private/pixelflinger/ggl_context.h"
 
 #include "buffer.h"
@@ -10,8 +22,9 @@
 #include "codeflinger/GGLAssembler.h"
 #include "codeflinger/ARMAssembler.h"
 #include "codeflinger/MIPSAssembler.h"
+#include "codeflinger/X86_64Assembler.h"
 
-#if defined(__arm__) || defined(__mips__)
+#if defined(__arm__) || defined(__mips__) || defined(__x86_64__)
 #   define ANDROID_ARM_CODEGEN  1
 #else
 #   define ANDROID_ARM_CODEGEN  0
@@ -19,6 +32,8 @@
 
 #if defined (__mips__)
 #define ASSEMBLY_SCRATCH_SIZE   4096
+#elif defined(__x86_64__)
+#define ASSEMBLY_SCRATCH_SIZE   8192
 #else
 #define ASSEMBLY_SCRATCH_SIZE   2048
 #endif
@@ -53,20 +68,246 @@ static void ggl_test_codegen(uint32_t n, uint32_t p, uint32_t t0, uint32_t t1)
     GGLAssembler assembler( new ArmToMipsAssembler(a) );
 #endif
 
+#if defined(__x86_64__)
+    GGLAssembler assembler( new ArmToX86_64Assembler(a) );
+#endif
+
     int err = assembler.scanline(needs, (context_t*)c);
     if (err != 0) {
         printf("error %08x (%s)\n", err, strerror(-err));
     }
     gglUninit(c);
 #else
-    printf("This test runs only on ARM or MIPS\n");
+    printf("This test runs only on ARM, MIPS or x86-64\n");
+#endif
+}
+
+// ----------------------------------------------------------------------------
+
+static const int W = 61;
+static const int H = 37;
+static const int S = 64;    // stride, in pixels
+static const int TW = 32;
+static const int TH = 16;
+
+// per component difference allowed between the two pipelines, in units of
+// the color buffer's precision: the generated code uses 8-bit blend factors
+// and filters with fewer bits, so they don't round everything the same way
+static const int TOLERANCE = 2;
+// the generated linear filters also quantize their weights (filter16() to
+// 4 bits, filter32() to 8), which our noisy texels turn into larger
+// differences
+static const int LINEAR_TOLERANCE = 4;
+
+struct texture_config_t {
+    int         format;     // 0 when the unit is off
+    GGLenum     env;
+    GGLenum     filter;
+};
+
+struct config_t {
+    const char*         name;
+    int                 format;
+    int                 smooth;
+    GGLenum             src;    // GGL_ONE, GGL_ZERO disables blending
+    GGLenum             dst;
+    texture_config_t    tex[2];
+};
+
+static const config_t gConfigs[] = {
+    { "smooth 565", GGL_PIXEL_FORMAT_RGB_565, 1, GGL_ONE, GGL_ZERO,
+        { { 0, 0, 0 }, { 0, 0, 0 } } },
+    { "smooth blend 8888", GGL_PIXEL_FORMAT_RGBA_8888, 1,
+        GGL_SRC_ALPHA, GGL_ONE_MINUS_SRC_ALPHA,
+        { { 0, 0, 0 }, { 0, 0, 0 } } },
+    { "flat blend 8888", GGL_PIXEL_FORMAT_RGBA_8888, 0,
+        GGL_ONE, GGL_ONE_MINUS_SRC_ALPHA,
+        { { 0, 0, 0 }, { 0, 0, 0 } } },
+    { "flat blend 565", GGL_PIXEL_FORMAT_RGB_565, 0,
+        GGL_DST_COLOR, GGL_ZERO,
+        { { 0, 0, 0 }, { 0, 0, 0 } } },
+    { "texture modulate 8888", GGL_PIXEL_FORMAT_RGBA_8888, 1,
+        GGL_ONE, GGL_ZERO,
+        { { GGL_PIXEL_FORMAT_RGB_565, GGL_MODULATE, GGL_NEAREST },
+          { 0, 0, 0 } } },
+    { "linear texture blend 565", GGL_PIXEL_FORMAT_RGB_565, 0,
+        GGL_ONE, GGL_ONE_MINUS_SRC_ALPHA,
+        { { GGL_PIXEL_FORMAT_RGBA_8888, GGL_MODULATE, GGL_LINEAR },
+          { 0, 0, 0 } } },
+    { "two textures 565", GGL_PIXEL_FORMAT_RGB_565, 1, GGL_ONE, GGL_ZERO,
+        { { GGL_PIXEL_FORMAT_RGBA_8888, GGL_MODULATE, GGL_NEAREST },
+          { GGL_PIXEL_FORMAT_L_8, GGL_MODULATE, GGL_NEAREST } } },
+    { "two textures blend 8888", GGL_PIXEL_FORMAT_RGBA_8888, 1,
+        GGL_SRC_ALPHA, GGL_ONE_MINUS_SRC_ALPHA,
+        { { GGL_PIXEL_FORMAT_RGBA_8888, GGL_MODULATE, GGL_NEAREST },
+          { GGL_PIXEL_FORMAT_LA_88, GGL_MODULATE, GGL_NEAREST } } },
+    { "two linear textures blend 565", GGL_PIXEL_FORMAT_RGB_565, 0,
+        GGL_ONE, GGL_ONE_MINUS_SRC_ALPHA,
+        { { GGL_PIXEL_FORMAT_RGB_565, GGL_DECAL, GGL_LINEAR },
+          { GGL_PIXEL_FORMAT_A_8, GGL_MODULATE, GGL_LINEAR } } },
+};
+
+static uint8_t gTexels[2][TW*TH*4];
+
+// returns whether the pixels came out of generated code
+static bool render(const config_t& cfg, int codegen, uint8_t* cb)
+{
+    GGLContext* c;
+    gglInit(&c);
+    context_t* const cc = static_cast<context_t*>((void*)c);
+    ggl_set_codegen(cc, codegen);
+
+    GGLSurface s;
+    memset(&s, 0, sizeof(s));
+    s.version = sizeof(s);
+    s.width = W;
+    s.height = H;
+    s.stride = S;
+    s.data = cb;
+    s.format = cfg.format;
+    c->colorBuffer(c, &s);
+    c->disable(c, GGL_DITHER);
+
+    for (int i=0 ; i<2 ; i++) {
+        const texture_config_t& tc = cfg.tex[i];
+        if (!tc.format)
+            continue;
+        GGLSurface t;
+        memset(&t, 0, sizeof(t));
+        t.version = sizeof(t);
+        t.width = TW;
+        t.height = TH;
+        t.stride = TW;
+        t.data = gTexels[i];
+        t.format = tc.format;
+        c->activeTexture(c, i);
+        c->bindTexture(c, &t);
+        c->texEnvi(c, GGL_TEXTURE_ENV, GGL_TEXTURE_ENV_MODE, tc.env);
+        c->texParameteri(c, GGL_TEXTURE_2D, GGL_TEXTURE_MIN_FILTER, tc.filter);
+        c->texParameteri(c, GGL_TEXTURE_2D, GGL_TEXTURE_MAG_FILTER, tc.filter);
+        c->texParameteri(c, GGL_TEXTURE_2D, GGL_TEXTURE_WRAP_S, GGL_REPEAT);
+        c->texParameteri(c, GGL_TEXTURE_2D, GGL_TEXTURE_WRAP_T, GGL_REPEAT);
+        c->enable(c, GGL_TEXTURE_2D);
+        const int32_t scale[8] = {
+            0x1000*i, 0x9000, 0x2800, 0, 0x800, -0x2000, 0x7000, 0 };
+        c->texCoordGradScale8xv(c, i, scale);
+        c->texGeni(c, GGL_S, GGL_TEXTURE_GEN_MODE, GGL_AUTOMATIC);
+        c->texGeni(c, GGL_T, GGL_TEXTURE_GEN_MODE, GGL_AUTOMATIC);
+    }
+
+    if (cfg.src != GGL_ONE || cfg.dst != GGL_ZERO) {
+        c->enable(c, GGL_BLEND);
+        c->blendFunc(c, cfg.src, cfg.dst);
+    }
+
+    if (cfg.smooth) {
+        static const GGLcolor grad[12] = {
+            0x2000, 0x300, 0x120,   0xF000, -0x200, 0x100,
+            0x8000, 0x180, -0x280,  0x4000, 0x100, 0x300
+        };
+        c->shadeModel(c, GGL_SMOOTH);
+        c->colorGrad12xv(c, grad);
+    } else {
+        const GGLclampx color[4] = { 0xC000, 0x6000, 0x9000, 0xA000 };
+        c->color4xv(c, color);
+    }
+
+    // a rectangle, and a triangle on top of it (vertices in 28.4)
+    const GGLcoord v0[2] = { 3*16 + 5, 2*16 + 9 };
+    const GGLcoord v1[2] = { (W-2)*16 + 3, H*8 + 1 };
+    const GGLcoord v2[2] = { W*5 + 7, (H-1)*16 + 13 };
+    c->recti(c, 1, 1, W-1, H-1);
+    c->trianglex(c, v0, v1, v2);
+
+    const bool generated = cc->scanline_as &&
+            (void*)cc->scanline == (void*)cc->scanline_as->base();
+    gglUninit(c);
+    return generated;
+}
+
+// returns the number of pixels that differ by more than tolerance
+static int compare(int format, int tolerance,
+        const uint8_t* a, const uint8_t* b)
+{
+    const GGLFormat& f = gglGetPixelFormatTable()[format];
+    int errors = 0;
+    for (int y=0 ; y<H ; y++) {
+        for (int x=0 ; x<W ; x++) {
+            const size_t offset = (y*S + x) * f.size;
+            uint32_t pa = 0, pb = 0;
+            memcpy(&pa, a + offset, f.size);
+            memcpy(&pb, b + offset, f.size);
+            for (int i=0 ; i<4 ; i++) {
+                if (!f.c[i].h)
+                    continue;
+                const int ca = (pa & f.mask(i)) >> f.c[i].l;
+                const int cb = (pb & f.mask(i)) >> f.c[i].l;
+                if (abs(ca - cb) > tolerance) {
+                    if (!errors) {
+                        printf("    first at (%d, %d) component %d: "
+                                "%d (codegen) vs. %d (generic)\n",
+                                x, y, i, ca, cb);
+                    }
+                    errors++;
+                    break;
+                }
+            }
+        }
+    }
+    return errors;
+}
+
+static int ggl_compare_pipelines()
+{
+#if ANDROID_ARM_CODEGEN
+    for (int i=0 ; i<2 ; i++) {
+        for (size_t j=0 ; j<sizeof(gTexels[i]) ; j++) {
+            gTexels[i][j] = uint8_t(((j * 2654435761u) >> 11) ^ (i * 0x5A));
+        }
+    }
+
+    static uint8_t generated[S*H*4];
+    static uint8_t generic[S*H*4];
+    int failures = 0;
+    const int count = sizeof(gConfigs)/sizeof(gConfigs[0]);
+    for (int i=0 ; i<count ; i++) {
+        const config_t& cfg = gConfigs[i];
+        for (size_t j=0 ; j<sizeof(generated) ; j++) {
+            generated[j] = generic[j] = uint8_t(j * 7 + (j >> 5));
+        }
+        if (!render(cfg, 1, generated)) {
+            // the backend ran out of registers for this pipeline, which
+            // is the case of linear filtering on x86-64
+            printf("%-32s skipped, no code generated\n", cfg.name);
+            continue;
+        }
+        render(cfg, 0, generic);
+        const bool linear =
+                (cfg.tex[0].format && cfg.tex[0].filter == GGL_LINEAR) ||
+                (cfg.tex[1].format && cfg.tex[1].filter == GGL_LINEAR);
+        const int errors = compare(cfg.format,
+                linear ? LINEAR_TOLERANCE : TOLERANCE, generated, generic);
+        printf("%-32s %s", cfg.name, errors ? "FAILED" : "ok");
+        if (errors) {
+            printf(" (%d pixels differ)", errors);
+            failures++;
+        }
+        printf("\n");
+    }
+    return failures ? 1 : 0;
+#else
+    printf("This test runs only on ARM, MIPS or x86-64\n");
+    return 0;
 #endif
 }
 
 int main(int argc, char** argv)
 {
+    if (argc == 1) {
+        return ggl_compare_pipelines();
+    }
     if (argc != 2) {
-        printf("usage: %s 00000117:03454504_00001501_00000000\n", argv[0]);
+        printf("usage: %s [00000117:03454504_00001501_00000000]\n", argv[0]);
         return 0;
     }
     uint32_t n;
@@ -0,0 +1,240 @@
+/*
+ * Fill-rate benchmark for the tiled rasterizer: draws full-screen
+ * primitives on a 1080p surface with an increasing number of rasterizer
+ * threads, and checks that the result doesn't depend on it.
+ *
+ * max-threads defaults to the number of CPUs, but at least 4 so that the
+ * comparison also runs on single and dual core devices; the threads are
+ * then only interleaved, which still exercises the tiling.
+ *
+ * usage: test-pixelflinger-fillrate [max-threads [frames]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <pixelflinger/pixelflinger.h>
+#include <private/pixelflinger/ggl_context.h>
+
+#include "tiler.h"
+
+using namespace android;
+
+static const int W = 1920;
+static const int H = 1080;
+static const int TW = 256;
+static const int TH = 256;
+
+enum {
+    CLEAR,
+    FLAT_RECT,
+    SMOOTH_TRIANGLES,
+    TEXTURED_BLEND,
+    AA_TRIANGLE,
+    TEST_COUNT
+};
+
+static const char* const gTestNames[TEST_COUNT] = {
+    "clear",
+    "flat rect",
+    "smooth triangles",
+    "textured blend",
+    "antialiased triangle",
+};
+
+static int64_t now_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return int64_t(t.tv_sec)*1000000000LL + t.tv_nsec;
+}
+
+static void setup(GGLContext* c, int test, const uint32_t* texels)
+{
+    static const GGLcolor grad[12] = {
+        0x10000, -0x20, 0x10,   0x8000, 0x10, 0x20,
+        0x4000, 0x20, -0x10,    0xC000, 0, -0x20
+    };
+    const GGLclampx color[4] = { 0x8000, 0x4000, 0xC000, 0xC000 };
+
+    switch (test) {
+    case CLEAR:
+        c->clearColorx(c, 0x4000, 0x8000, 0xC000, 0x10000);
+        break;
+    case FLAT_RECT:
+        c->color4xv(c, color);
+        break;
+    case SMOOTH_TRIANGLES:
+        c->shadeModel(c, GGL_SMOOTH);
+        c->colorGrad12xv(c, grad);
+        break;
+    case TEXTURED_BLEND: {
+        GGLSurface t;
+        memset(&t, 0, sizeof(t));
+        t.version = sizeof(t);
+        t.width = TW;
+        t.height = TH;
+        t.stride = TW;
+        t.data = (GGLubyte*)texels;
+        t.format = GGL_PIXEL_FORMAT_RGBA_8888;
+        c->activeTexture(c, 0);
+        c->bindTexture(c, &t);
+        c->texEnvi(c, GGL_TEXTURE_ENV, GGL_TEXTURE_ENV_MODE, GGL_MODULATE);
+        c->texParameteri(c, GGL_TEXTURE_2D, GGL_TEXTURE_MIN_FILTER, GGL_LINEAR);
+        c->texParameteri(c, GGL_TEXTURE_2D, GGL_TEXTURE_MAG_FILTER, GGL_LINEAR);
+        c->texParameteri(c, GGL_TEXTURE_2D, GGL_TEXTURE_WRAP_S, GGL_REPEAT);
+        c->texParameteri(c, GGL_TEXTURE_2D, GGL_TEXTURE_WRAP_T, GGL_REPEAT);
+        c->enable(c, GGL_TEXTURE_2D);
+        const int32_t scale[8] = { 0, 0xC000, 0x2000, 0, 0, -0x2000, 0xC000, 0 };
+        c->texCoordGradScale8xv(c, 0, scale);
+        c->texGeni(c, GGL_S, GGL_TEXTURE_GEN_MODE, GGL_AUTOMATIC);
+        c->texGeni(c, GGL_T, GGL_TEXTURE_GEN_MODE, GGL_AUTOMATIC);
+        c->enable(c, GGL_BLEND);
+        c->blendFunc(c, GGL_ONE, GGL_ONE_MINUS_SRC_ALPHA);
+        c->color4xv(c, color);
+        break;
+    }
+    case AA_TRIANGLE:
+        c->enable(c, GGL_AA);
+        c->color4xv(c, color);
+        break;
+    }
+}
+
+static void draw(GGLContext* c, int test)
+{
+    // vertices are in 28.4 fixed point
+    const GGLcoord tl[2] = { 0, 0 };
+    const GGLcoord tr[2] = { W*16, 0 };
+    const GGLcoord bl[2] = { 0, H*16 };
+    const GGLcoord br[2] = { W*16, H*16 };
+    const GGLcoord a0[2] = { 8*16 + 5, 4*16 + 3 };
+    const GGLcoord a1[2] = { (W-5)*16 + 9, H*8 + 7 };
+    const GGLcoord a2[2] = { W*4 + 1, (H-3)*16 + 11 };
+
+    switch (test) {
+    case CLEAR:
+        c->clear(c, GGL_COLOR_BUFFER_BIT);
+        break;
+    case FLAT_RECT:
+    case TEXTURED_BLEND:
+        c->recti(c, 0, 0, W, H);
+        break;
+    case SMOOTH_TRIANGLES:
+        c->trianglex(c, tl, tr, bl);
+        c->trianglex(c, tr, br, bl);
+        break;
+    case AA_TRIANGLE:
+        c->trianglex(c, a0, a1, a2);
+        break;
+    }
+}
+
+// returns the time per frame in ns, the last frame in cb, and the number
+// of rasterizer threads that actually ran in *running
+static int64_t run(int test, int threads, int frames,
+        uint16_t* cb, const uint32_t* texels, int* running)
+{
+    GGLContext* c;
+    gglInit(&c);
+    context_t* const ctx = static_cast<context_t*>((void*)c);
+    ggl_set_tiler_threads(ctx, threads);
+    *running = ggl_get_tiler_threads(ctx);
+
+    GGLSurface s;
+    memset(&s, 0, sizeof(s));
+    s.version = sizeof(s);
+    s.width = W;
+    s.height = H;
+    s.stride = W;
+    s.data = (GGLubyte*)cb;
+    s.format = GGL_PIXEL_FORMAT_RGB_565;
+    c->colorBuffer(c, &s);
+    c->disable(c, GGL_DITHER);
+    setup(c, test, texels);
+
+    memset(cb, 0, W*H*2);
+    draw(c, test);
+
+    const int64_t start = now_ns();
+    for (int i=0 ; i<frames ; i++) {
+        draw(c, test);
+    }
+    const int64_t elapsed = now_ns() - start;
+
+    // redraw over a known background, for the comparison
+    memset(cb, 0, W*H*2);
+    draw(c, test);
+
+    gglUninit(c);
+    return elapsed / frames;
+}
+
+int main(int argc, char** argv)
+{
+    int maxThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (maxThreads < 4) {
+        maxThreads = 4;
+    }
+    int frames = 20;
+    if (argc >= 2) {
+        maxThreads = atoi(argv[1]);
+    }
+    if (argc >= 3) {
+        frames = atoi(argv[2]);
+    }
+    if (maxThreads <= 0 || frames <= 0) {
+        printf("usage: %s [max-threads [frames]]\n", argv[0]);
+        return 1;
+    }
+
+    uint16_t* ref = (uint16_t*)malloc(W*H*2);
+    uint16_t* cb = (uint16_t*)malloc(W*H*2);
+    uint32_t* texels = (uint32_t*)malloc(TW*TH*4);
+    if (!ref || !cb || !texels) {
+        printf("out of memory\n");
+        return 1;
+    }
+    for (int i=0 ; i<TW*TH ; i++) {
+        const uint32_t a = (i >> 4) & 0xff;
+        const uint32_t r = ((i * 7) & 0xff) * a / 255;
+        const uint32_t g = ((i >> 8) & 0xff) * a / 255;
+        texels[i] = (a << 24) | (g << 8) | r;
+    }
+
+    int errors = 0;
+    int compared = 0;
+    printf("%dx%d RGB 565, %d frames, %ld CPUs\n", W, H, frames,
+            sysconf(_SC_NPROCESSORS_ONLN));
+    for (int test=0 ; test<TEST_COUNT ; test++) {
+        int running;
+        const int64_t base = run(test, 1, frames, ref, texels, &running);
+        printf("%-22s 1 thread  %8.2f ms %8.1f Mpix/s\n", gTestNames[test],
+                base / 1e6, (double(W) * H * 1e3) / base);
+        for (int threads=2 ; threads<=maxThreads ; threads*=2) {
+            const int64_t t = run(test, threads, frames, cb, texels, &running);
+            const bool same = !memcmp(cb, ref, W*H*2);
+            printf("%-22s %d threads %8.2f ms %8.1f Mpix/s  x%.2f%s%s\n", "",
+                    running, t / 1e6, (double(W) * H * 1e3) / t,
+                    double(base) / t, running > 1 ? "" : "  (not tiled)",
+                    same ? "" : "  MISMATCH");
+            if (running > 1)
+                compared++;
+            if (!same)
+                errors++;
+        }
+    }
+    if (!compared) {
+        printf("tiling never ran, nothing was compared\n");
+        errors++;
+    }
+
+    free(texels);
+    free(cb);
+    free(ref);
+    return errors ? 1 : 0;
+}
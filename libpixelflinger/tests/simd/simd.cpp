@@ -0,0 +1,136 @@
+/*
+ * Checks the SRC_OVER kernels in scanline_simd.cpp against the scalar
+ * blenders they replace, for spans of every length up to a few vectors
+ * and a few longer odd ones, starting at every alignment, so that both
+ * the vector loops and the scalar tails are exercised.
+ *
+ * usage: test-pixelflinger-simd
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "scanline.h"
+#include "scanline_simd.h"
+
+using namespace android;
+
+#define MAX_LENGTH  1031
+#define MAX_OFFSET  8
+
+static uint32_t random_pixel()
+{
+    // mostly translucent pixels, with the transparent and opaque ones
+    // that the blenders special-case
+    const int a = (rand() % 4 == 0) ? ((rand() & 1) ? 0xff : 0) : rand() & 0xff;
+    const int r = a ? rand() % (a + 1) : 0;
+    const int g = a ? rand() % (a + 1) : 0;
+    const int b = a ? rand() % (a + 1) : 0;
+    // GGL_PIXEL_FORMAT_RGBA_8888 is stored r, g, b, a in memory
+    uint8_t p[4] = { uint8_t(r), uint8_t(g), uint8_t(b), uint8_t(a) };
+    uint32_t s;
+    memcpy(&s, p, sizeof(s));
+    return s;
+}
+
+static int check_16(const char* name, const int32_t* modulate)
+{
+    static uint32_t src[MAX_LENGTH + MAX_OFFSET];
+    static uint16_t dst[MAX_LENGTH + MAX_OFFSET];
+    static uint16_t ref[MAX_LENGTH + MAX_OFFSET];
+    int failures = 0;
+    for (size_t ct=1 ; ct<=MAX_LENGTH ; ct = (ct < 40) ? ct+1 : ct*2+1) {
+        for (size_t offset=0 ; offset<MAX_OFFSET ; offset++) {
+            for (size_t i=0 ; i<ct+offset ; i++) {
+                src[i] = random_pixel();
+                dst[i] = ref[i] = uint16_t(rand());
+            }
+            if (modulate) {
+                scanline_t32cb16blend_mod_simd(dst + offset, src + offset,
+                        ct, modulate);
+            } else {
+                scanline_t32cb16blend_simd(dst + offset, src + offset, ct);
+            }
+            ggl_blend32to16_reference(ref + offset, src + offset,
+                    ct, modulate);
+            for (size_t i=0 ; i<ct+offset ; i++) {
+                if (dst[i] != ref[i]) {
+                    if (failures++ < 10) {
+                        printf("%s: length %zu, offset %zu, pixel %zu: "
+                                "%04x instead of %04x (src %08x)\n",
+                                name, ct, offset, i, dst[i], ref[i], src[i]);
+                    }
+                }
+            }
+        }
+    }
+    return failures;
+}
+
+static int check_32()
+{
+    static uint32_t src[MAX_LENGTH + MAX_OFFSET];
+    static uint32_t dst[MAX_LENGTH + MAX_OFFSET];
+    static uint32_t ref[MAX_LENGTH + MAX_OFFSET];
+    int failures = 0;
+    for (size_t ct=1 ; ct<=MAX_LENGTH ; ct = (ct < 40) ? ct+1 : ct*2+1) {
+        for (size_t offset=0 ; offset<MAX_OFFSET ; offset++) {
+            for (size_t i=0 ; i<ct+offset ; i++) {
+                src[i] = random_pixel();
+                dst[i] = ref[i] = random_pixel();
+            }
+            scanline_t32cb32blend_simd(dst + offset, src + offset, ct);
+            // one pixel at a time only runs the scalar code
+            for (size_t i=offset ; i<ct+offset ; i++) {
+                scanline_t32cb32blend_simd(ref + i, src + i, 1);
+            }
+            for (size_t i=0 ; i<ct+offset ; i++) {
+                if (dst[i] != ref[i]) {
+                    if (failures++ < 10) {
+                        printf("8888: length %zu, offset %zu, pixel %zu: "
+                                "%08x instead of %08x (src %08x)\n",
+                                ct, offset, i, dst[i], ref[i], src[i]);
+                    }
+                }
+            }
+        }
+    }
+    return failures;
+}
+
+static int report(const char* name, int failures)
+{
+    printf("%-20s %s", name, failures ? "FAILED" : "ok");
+    if (failures)
+        printf(" (%d pixels)", failures);
+    printf("\n");
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    printf("SIMD kernels are %s\n",
+            ANDROID_SIMD_SCANLINE ? "vectorized" : "plain loops");
+
+    int failed = 0;
+    failed += report("565 SRC_OVER", check_16("565", 0));
+
+    static const int32_t modulates[][4] = {
+        { 256, 256, 256, 256 },
+        { 0, 0, 0, 0 },
+        { 128, 64, 200, 256 },
+        { 256, 256, 256, 97 },
+    };
+    for (size_t i=0 ; i<sizeof(modulates)/sizeof(*modulates) ; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "565 modulate %d,%d,%d,%d",
+                modulates[i][0], modulates[i][1],
+                modulates[i][2], modulates[i][3]);
+        failed += report(name, check_16(name, modulates[i]));
+    }
+
+    failed += report("8888 SRC_OVER", check_32());
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,278 @@
+/* libs/pixelflinger/tiler.cpp
+**
+** Copyright 2013, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#define LOG_TAG "pixelflinger"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+
+#include "tiler.h"
+
+namespace android {
+
+// ----------------------------------------------------------------------------
+
+// primitives smaller than this are not worth waking up the threads
+#define TILER_MIN_PIXELS    (256*256)
+
+// tiles are at least that many rows tall
+#define TILER_MIN_ROWS      16
+
+// number of tiles per thread, for load balancing
+#define TILER_TILES         4
+
+#define TILER_MAX_THREADS   8
+
+struct tiler_worker_t {
+    tiler_t*        tiler;
+    pthread_t       thread;
+    context_t*      context;
+    void*           base;
+    int16_t*        coverage;
+    size_t          coverageSize;
+};
+
+struct tiler_t {
+    pthread_mutex_t lock;
+    pthread_cond_t  work;
+    pthread_cond_t  idle;
+    int             count;
+    tiler_worker_t* workers;
+    uint32_t        generation;
+    int             pending;
+    bool            exiting;
+
+    // the current job
+    tile_proc_t     proc;
+    const void*     args;
+    int32_t         next;
+    int32_t         bottom;
+    int32_t         height;
+};
+
+// ----------------------------------------------------------------------------
+
+static void run_tiles(tiler_t* t, context_t* c)
+{
+    while (true) {
+        pthread_mutex_lock(&t->lock);
+        const int32_t y = t->next;
+        t->next += t->height;
+        pthread_mutex_unlock(&t->lock);
+        if (y >= t->bottom)
+            break;
+        c->band.top = y;
+        c->band.bottom = y + t->height < t->bottom ? y + t->height : t->bottom;
+        t->proc(c, t->args);
+    }
+}
+
+static void* worker_loop(void* arg)
+{
+    tiler_worker_t* w = static_cast<tiler_worker_t*>(arg);
+    tiler_t* t = w->tiler;
+    uint32_t generation = 0;
+    pthread_mutex_lock(&t->lock);
+    while (true) {
+        while (!t->exiting && t->generation == generation)
+            pthread_cond_wait(&t->work, &t->lock);
+        if (t->exiting)
+            break;
+        generation = t->generation;
+        pthread_mutex_unlock(&t->lock);
+
+        run_tiles(t, w->context);
+
+        pthread_mutex_lock(&t->lock);
+        if (--t->pending == 0)
+            pthread_cond_signal(&t->idle);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return 0;
+}
+
+// gives the worker a private copy of the context, including the
+// coverage buffer which aapolyx() writes to
+static bool copy_context(tiler_worker_t* w, const context_t* c)
+{
+    const size_t size = c->state.buffers.coverageBufferSize;
+    if (size > w->coverageSize) {
+        int16_t* coverage = (int16_t*)realloc(w->coverage, size * 2);
+        if (!coverage)
+            return false;
+        w->coverage = coverage;
+        w->coverageSize = size;
+    }
+    memcpy(w->context, c, sizeof(context_t));
+    w->context->state.buffers.coverage = w->coverage;
+    w->context->tiler = 0;
+    return true;
+}
+
+static void destroy_tiler(tiler_t* t)
+{
+    pthread_mutex_lock(&t->lock);
+    t->exiting = true;
+    pthread_cond_broadcast(&t->work);
+    pthread_mutex_unlock(&t->lock);
+    for (int i=0 ; i<t->count ; i++) {
+        pthread_join(t->workers[i].thread, 0);
+    }
+    for (int i=0 ; i<t->count ; i++) {
+        free(t->workers[i].coverage);
+        free(t->workers[i].base);
+    }
+    pthread_cond_destroy(&t->idle);
+    pthread_cond_destroy(&t->work);
+    pthread_mutex_destroy(&t->lock);
+    free(t->workers);
+    delete t;
+}
+
+static tiler_t* create_tiler(int count)
+{
+    tiler_t* t = new tiler_t;
+    memset(t, 0, sizeof(tiler_t));
+    t->workers = (tiler_worker_t*)calloc(count, sizeof(tiler_worker_t));
+    if (!t->workers) {
+        delete t;
+        return 0;
+    }
+    pthread_mutex_init(&t->lock, 0);
+    pthread_cond_init(&t->work, 0);
+    pthread_cond_init(&t->idle, 0);
+    while (t->count < count) {
+        tiler_worker_t* w = &t->workers[t->count];
+        // contexts are aligned on cache lines, see gglInit()
+        w->base = malloc(sizeof(context_t) + 32);
+        if (!w->base)
+            break;
+        w->context = (context_t *)((ptrdiff_t(w->base)+31) & ~0x1FL);
+        w->tiler = t;
+        if (pthread_create(&w->thread, 0, worker_loop, w)) {
+            free(w->base);
+            break;
+        }
+        t->count++;
+    }
+    if (t->count < count) {
+        ALOGW("tiler: only %d of %d rasterizer threads started",
+                t->count + 1, count + 1);
+        if (!t->count) {
+            destroy_tiler(t);
+            return 0;
+        }
+    }
+    return t;
+}
+
+// ----------------------------------------------------------------------------
+
+void ggl_init_tiler(context_t* c)
+{
+    c->band.top = 0;
+    c->band.bottom = 0x7FFFFFFF;
+    c->tiler = 0;
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("debug.pixelflinger.threads", value, "0");
+    int count = atoi(value);
+    // more rasterizer threads than CPUs only adds contention
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0 && count > cpus)
+        count = cpus;
+    ggl_set_tiler_threads(c, count);
+}
+
+void ggl_uninit_tiler(context_t* c)
+{
+    ggl_set_tiler_threads(c, 0);
+}
+
+void ggl_set_tiler_threads(context_t* c, int count)
+{
+    if (count > TILER_MAX_THREADS)
+        count = TILER_MAX_THREADS;
+
+    // the calling thread is one of the rasterizer threads
+    const int workers = count > 1 ? count - 1 : 0;
+    if (c->tiler) {
+        if (c->tiler->count == workers)
+            return;
+        destroy_tiler(c->tiler);
+        c->tiler = 0;
+    }
+    if (workers) {
+        c->tiler = create_tiler(workers);
+    }
+}
+
+int ggl_get_tiler_threads(const context_t* c)
+{
+    return c->tiler ? c->tiler->count + 1 : 1;
+}
+
+void ggl_rasterize(context_t* c, int32_t top, int32_t bottom,
+        size_t pixels, tile_proc_t proc, const void* args)
+{
+    tiler_t* t = c->tiler;
+    if (!t || pixels < TILER_MIN_PIXELS ||
+            bottom - top < 2*TILER_MIN_ROWS) {
+        proc(c, args);
+        return;
+    }
+
+    for (int i=0 ; i<t->count ; i++) {
+        if (ggl_unlikely(!copy_context(&t->workers[i], c))) {
+            proc(c, args);
+            return;
+        }
+    }
+
+    const int tiles = (t->count + 1) * TILER_TILES;
+    int32_t height = (bottom - top + tiles - 1) / tiles;
+    if (height < TILER_MIN_ROWS)
+        height = TILER_MIN_ROWS;
+
+    pthread_mutex_lock(&t->lock);
+    t->proc = proc;
+    t->args = args;
+    t->next = top;
+    t->bottom = bottom;
+    t->height = height;
+    t->pending = t->count;
+    t->generation++;
+    pthread_cond_broadcast(&t->work);
+    pthread_mutex_unlock(&t->lock);
+
+    const band_t band = c->band;
+    run_tiles(t, c);
+    c->band = band;
+
+    pthread_mutex_lock(&t->lock);
+    while (t->pending)
+        pthread_cond_wait(&t->idle, &t->lock);
+    pthread_mutex_unlock(&t->lock);
+}
+
+// ----------------------------------------------------------------------------
+}; // namespace android
@@ -0,0 +1,64 @@
+/* libs/pixelflinger/tiler.h
+**
+** Copyright 2013, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_GGL_TILER_H
+#define ANDROID_GGL_TILER_H
+
+#include <private/pixelflinger/ggl_context.h>
+
+namespace android {
+
+/*
+ * The tiler splits large primitives in horizontal tiles, which are
+ * rasterized concurrently by a pool of threads owned by the context.
+ *
+ * Each thread works on its own copy of the context, and runs the whole
+ * primitive for every tile it picks, only writing the rows that fall
+ * in context_t::band. Edges and iterators are therefore stepped exactly
+ * like in the single threaded case, and the pixels produced are the same.
+ *
+ * It is off by default, debug.pixelflinger.threads sets the number of
+ * rasterizer threads new contexts use.
+ */
+
+typedef void (*tile_proc_t)(context_t* c, const void* args);
+
+void ggl_init_tiler(context_t* c);
+void ggl_uninit_tiler(context_t* c);
+
+// 0 or 1 means rasterizing everything on the calling thread. Unlike the
+// property, count isn't capped at the number of CPUs, so that the tiler
+// can be tested on any device.
+void ggl_set_tiler_threads(context_t* c, int count);
+
+// the number of rasterizer threads actually running, including the
+// calling thread; 1 when tiling is off
+int ggl_get_tiler_threads(const context_t* c);
+
+// runs proc over rows [top, bottom), tiled if it's worth it.
+// pixels is an estimate of the number of pixels written.
+void ggl_rasterize(context_t* c, int32_t top, int32_t bottom,
+        size_t pixels, tile_proc_t proc, const void* args);
+
+inline bool ggl_in_band(const context_t* c, int32_t y) {
+    return uint32_t(y - c->band.top) <
+            uint32_t(c->band.bottom - c->band.top);
+}
+
+}; // namespace android
+
+#endif // ANDROID_GGL_TILER_H
@@ -21,6 +21,7 @@
 
 #include "trap.h"
 #include "picker.h"
+#include "tiler.h"
 
 #include <cutils/log.h>
 #include <cutils/memory.h>
@@ -45,6 +46,7 @@ static void aa_linex(void *con, const GGLcoord* v0, const GGLcoord* v1, GGLcoord
 
 static void recti_validate(void* c, GGLint l, GGLint t, GGLint r, GGLint b); 
 static void recti(void* c, GGLint l, GGLint t, GGLint r, GGLint b); 
+static void recti_tile(context_t* c, const void* args);
 
 static void trianglex_validate(void*,
         const GGLcoord*, const GGLcoord*, const GGLcoord*);
@@ -52,6 +54,7 @@ static void trianglex_small(void*,
         const GGLcoord*, const GGLcoord*, const GGLcoord*);
 static void trianglex_big(void*,
         const GGLcoord*, const GGLcoord*, const GGLcoord*);
+static void trianglex_tile(context_t* c, const void* args);
 static void aa_trianglex(void*,
         const GGLcoord*, const GGLcoord*, const GGLcoord*);
 static void trianglex_debug(void* con,
@@ -59,6 +62,7 @@ static void trianglex_debug(void* con,
 
 static void aapolyx(void* con,
         const GGLcoord* pts, int count);
+static void aapolyx_tile(context_t* c, const void* args);
 
 static inline int min(int a, int b) CONST;
 static inline int max(int a, int b) CONST;
@@ -433,11 +437,28 @@ void recti(void* con, GGLint l, GGLint t, GGLint r, GGLint b)
     int xc = r - l;
     int yc = b - t;
     if (xc>0 && yc>0) {
-        c->iterators.xl = l;
-        c->iterators.xr = r;
-        c->init_y(c, t);
-        c->rect(c, yc);
+        const GGLint rect[4] = { l, t, r, b };
+        ggl_rasterize(c, t, b, xc*yc, recti_tile, rect);
+    }
+}
+
+void recti_tile(context_t* c, const void* args)
+{
+    const GGLint* rect = static_cast<const GGLint*>(args);
+    const GGLint t = rect[1];
+    const GGLint top = max(t, c->band.top);
+    const GGLint bottom = min(rect[3], c->band.bottom);
+    if (top >= bottom)
+        return;
+
+    c->iterators.xl = rect[0];
+    c->iterators.xr = rect[2];
+    c->init_y(c, t);
+    // the iterators are stepped, not recomputed, to the top of our band
+    for (GGLint y=t ; y<top ; y++) {
+        c->step_y(c);
     }
+    c->rect(c, bottom - top);
 }
 
 // ----------------------------------------------------------------------------
@@ -747,12 +768,14 @@ triangle_sweep_edges( Edge*  left,
         left_x  += left_xi;
         right_x += right_xi;
         // invoke the scanline rasterizer
-        if (ggl_likely(xl < xr)) {
+        if (ggl_likely(xl < xr) && ggl_in_band(c, c->iterators.y)) {
             c->iterators.xl = xl;
             c->iterators.xr = xr;
             c->scanline(c);
         }
 		c->step_y(c);
+        if (ggl_unlikely(c->iterators.y >= c->band.bottom))
+            break;
 	} while (--count);
 }
 
@@ -762,6 +785,28 @@ void trianglex_big(void* con,
 {
     GGL_CONTEXT(c, con);
 
+    // the scanlines the triangle may cover, and a rough pixel count
+    const GGLint top = max(min(v0[1], v1[1], v2[1]) >> TRI_FRACTION_BITS,
+            GGLint(c->state.scissor.top));
+    const GGLint bottom = min((max(v0[1], v1[1], v2[1]) >> TRI_FRACTION_BITS) + 1,
+            GGLint(c->state.scissor.bottom));
+    const GGLint width = (max(v0[0], v1[0], v2[0]) -
+            min(v0[0], v1[0], v2[0])) >> TRI_FRACTION_BITS;
+    if (top >= bottom)
+        return;
+
+    const GGLcoord* v[3] = { v0, v1, v2 };
+    ggl_rasterize(c, top, bottom, size_t(width) * (bottom - top) / 2,
+            trianglex_tile, v);
+}
+
+void trianglex_tile(context_t* c, const void* args)
+{
+    const GGLcoord* const* v = static_cast<const GGLcoord* const*>(args);
+    const GGLcoord* v0 = v[0];
+    const GGLcoord* v1 = v[1];
+    const GGLcoord* v2 = v[2];
+
     Edge edges[3];
 	int num_edges = 0;
 	int32_t ymin = TRI_FROM_INT(c->state.scissor.top)    + TRI_HALF;
@@ -939,8 +984,41 @@ void SUB_COVERAGE(int16_t*& p, int32_t value)
     *p++ = value;
 }
 
+struct polygon_t {
+    const GGLcoord* pts;
+    int count;
+};
+
 void aapolyx(void* con,
         const GGLcoord* pts, int count)
+{
+    GGL_CONTEXT(c, con);
+
+    // we do only quads for now (it's used for thick lines)
+    if ((count>4) || (count<2)) return;
+
+    GGLcoord xmin = pts[0], xmax = pts[0];
+    GGLcoord ymin = pts[1], ymax = pts[1];
+    for (int i=1 ; i<count ; i++) {
+        xmin = min(xmin, pts[i*2]);
+        xmax = max(xmax, pts[i*2]);
+        ymin = min(ymin, pts[i*2+1]);
+        ymax = max(ymax, pts[i*2+1]);
+    }
+    const GGLint top = max(ymin >> TRI_FRACTION_BITS,
+            GGLint(c->state.scissor.top));
+    const GGLint bottom = min((ymax >> TRI_FRACTION_BITS) + 1,
+            GGLint(c->state.scissor.bottom));
+    if (top >= bottom)
+        return;
+
+    const polygon_t polygon = { pts, count };
+    ggl_rasterize(c, top, bottom,
+            size_t((xmax - xmin) >> TRI_FRACTION_BITS) * (bottom - top),
+            aapolyx_tile, &polygon);
+}
+
+void aapolyx_tile(context_t* c, const void* args)
 {
     /*
      * NOTE: This routine assumes that the polygon has been clipped to the
@@ -948,11 +1026,10 @@ void aapolyx(void* con,
      * If this happens, the code below won't corrupt memory but the 
      * coverage values may not be correct.
      */
-    
-    GGL_CONTEXT(c, con);
 
-    // we do only quads for now (it's used for thick lines)
-    if ((count>4) || (count<2)) return;
+    const polygon_t* polygon = static_cast<const polygon_t*>(args);
+    const GGLcoord* pts = polygon->pts;
+    const int count = polygon->count;
 
     // take scissor into account
     const int xmin = c->state.scissor.left;
@@ -1040,10 +1117,15 @@ void aapolyx(void* con,
         // if we just stepped to a new scanline, render the previous one.
         // and clear the coverage buffer
         if (retire) {
-            if (c->iterators.xl < c->iterators.xr)
+            if (c->iterators.xl < c->iterators.xr &&
+                    ggl_in_band(c, c->iterators.y))
                 c->scanline(c);
             c->step_y(c);
-            memset(covPtr+xmin, 0, (xmax-xmin)*sizeof(*covPtr));
+            if (ggl_unlikely(c->iterators.y >= c->band.bottom))
+                return;
+            // coverage is only accumulated for the rows of our band
+            if (ggl_in_band(c, c->iterators.y))
+                memset(covPtr+xmin, 0, (xmax-xmin)*sizeof(*covPtr));
             c->iterators.xl = xml;
             c->iterators.xr = xmr;
         } else {
@@ -1052,99 +1134,101 @@ void aapolyx(void* con,
             c->iterators.xr = max(c->iterators.xr, xmr);
         }
 
-        coverage = covPtr + gglFixedToIntFloor(l_min_i);
-        if (l_min_i == gglFloorx(l_max)) {
+        if (ggl_in_band(c, c->iterators.y)) {
+            coverage = covPtr + gglFixedToIntFloor(l_min_i);
+            if (l_min_i == gglFloorx(l_max)) {
             
-            /*
-             *  fully traverse this pixel vertically
-             *       l_max
-             *  +-----/--+  yt
-             *  |    /   |  
-             *  |   /    |
-             *  |  /     |
-             *  +-/------+  y
-             *   l_min  (l_min_i + TRI_ONE)
-             */
+                /*
+                 *  fully traverse this pixel vertically
+                 *       l_max
+                 *  +-----/--+  yt
+                 *  |    /   |  
+                 *  |   /    |
+                 *  |  /     |
+                 *  +-/------+  y
+                 *   l_min  (l_min_i + TRI_ONE)
+                 */
               
-            GGLfixed dx = l_max - l_min;
-            int32_t dy = y - yt;
-            int cf = gglMulx((dx >> 1) + (l_min_i + FIXED_ONE - l_max), dy,
-                FIXED_BITS + TRI_FRACTION_BITS - 15);
-            ADD_COVERAGE(coverage, cf);
-            // all pixels on the right have cf = 1.0
-        } else {
-            /*
-             *  spans several pixels in one scanline
-             *            l_max
-             *  +--------+--/-----+  yt
-             *  |        |/       |
-             *  |       /|        |
-             *  |     /  |        |
-             *  +---/----+--------+  y
-             *   l_min (l_min_i + TRI_ONE)
-             */
-
-            // handle the first pixel separately...
-            const int32_t y_incr = left->y_incr;
-            int32_t dx = TRI_FROM_FIXED(l_min_i - l_min) + TRI_ONE;
-            int32_t cf = (dx * dx * y_incr) >> cf_shift;
-            ADD_COVERAGE(coverage, cf);
-
-            // following pixels get covered by y_incr, but we need
-            // to fix-up the cf to account for previous partial pixel
-            dx = TRI_FROM_FIXED(l_min - l_min_i);
-            cf -= (dx * dx * y_incr) >> cf_shift;
-            for (int x = l_min_i+FIXED_ONE ; x < l_max_i-FIXED_ONE ; x += FIXED_ONE) {
-                cf += y_incr >> (TRI_ITERATORS_BITS-15);
+                GGLfixed dx = l_max - l_min;
+                int32_t dy = y - yt;
+                int cf = gglMulx((dx >> 1) + (l_min_i + FIXED_ONE - l_max), dy,
+                    FIXED_BITS + TRI_FRACTION_BITS - 15);
                 ADD_COVERAGE(coverage, cf);
-            }
+                // all pixels on the right have cf = 1.0
+            } else {
+                /*
+                 *  spans several pixels in one scanline
+                 *            l_max
+                 *  +--------+--/-----+  yt
+                 *  |        |/       |
+                 *  |       /|        |
+                 *  |     /  |        |
+                 *  +---/----+--------+  y
+                 *   l_min (l_min_i + TRI_ONE)
+                 */
+
+                // handle the first pixel separately...
+                const int32_t y_incr = left->y_incr;
+                int32_t dx = TRI_FROM_FIXED(l_min_i - l_min) + TRI_ONE;
+                int32_t cf = (dx * dx * y_incr) >> cf_shift;
+                ADD_COVERAGE(coverage, cf);
+
+                // following pixels get covered by y_incr, but we need
+                // to fix-up the cf to account for previous partial pixel
+                dx = TRI_FROM_FIXED(l_min - l_min_i);
+                cf -= (dx * dx * y_incr) >> cf_shift;
+                for (int x = l_min_i+FIXED_ONE ; x < l_max_i-FIXED_ONE ; x += FIXED_ONE) {
+                    cf += y_incr >> (TRI_ITERATORS_BITS-15);
+                    ADD_COVERAGE(coverage, cf);
+                }
             
-            // and the last pixel
-            dx = TRI_FROM_FIXED(l_max - l_max_i) - TRI_ONE;
-            cf += (dx * dx * y_incr) >> cf_shift;
-            ADD_COVERAGE(coverage, cf);
-        }
-        
-        // now, fill up all fully covered pixels
-        coverage = covPtr + gglFixedToIntFloor(l_max_i);
-        int cf = ((y - yt) << (15 - TRI_FRACTION_BITS));
-        if (ggl_likely(cf >= 0x8000)) {
-            SET_COVERAGE(coverage, 0x7FFF, ((r_max - l_max_i)>>FIXED_BITS)+1);
-        } else {
-            for (int x=l_max_i ; x<r_max ; x+=FIXED_ONE) {
+                // and the last pixel
+                dx = TRI_FROM_FIXED(l_max - l_max_i) - TRI_ONE;
+                cf += (dx * dx * y_incr) >> cf_shift;
                 ADD_COVERAGE(coverage, cf);
             }
-        }
         
-        // subtract the coverage of the right edge
-        coverage = covPtr + gglFixedToIntFloor(r_min_i); 
-        if (r_min_i == gglFloorx(r_max)) {
-            GGLfixed dx = r_max - r_min;
-            int32_t dy = y - yt;
-            int cf = gglMulx((dx >> 1) + (r_min_i + FIXED_ONE - r_max), dy,
-                FIXED_BITS + TRI_FRACTION_BITS - 15);
-            SUB_COVERAGE(coverage, cf);
-            // all pixels on the right have cf = 1.0
-        } else {
-            // handle the first pixel separately...
-            const int32_t y_incr = right->y_incr;
-            int32_t dx = TRI_FROM_FIXED(r_min_i - r_min) + TRI_ONE;
-            int32_t cf = (dx * dx * y_incr) >> cf_shift;
-            SUB_COVERAGE(coverage, cf);
+            // now, fill up all fully covered pixels
+            coverage = covPtr + gglFixedToIntFloor(l_max_i);
+            int cf = ((y - yt) << (15 - TRI_FRACTION_BITS));
+            if (ggl_likely(cf >= 0x8000)) {
+                SET_COVERAGE(coverage, 0x7FFF, ((r_max - l_max_i)>>FIXED_BITS)+1);
+            } else {
+                for (int x=l_max_i ; x<r_max ; x+=FIXED_ONE) {
+                    ADD_COVERAGE(coverage, cf);
+                }
+            }
+        
+            // subtract the coverage of the right edge
+            coverage = covPtr + gglFixedToIntFloor(r_min_i); 
+            if (r_min_i == gglFloorx(r_max)) {
+                GGLfixed dx = r_max - r_min;
+                int32_t dy = y - yt;
+                int cf = gglMulx((dx >> 1) + (r_min_i + FIXED_ONE - r_max), dy,
+                    FIXED_BITS + TRI_FRACTION_BITS - 15);
+                SUB_COVERAGE(coverage, cf);
+                // all pixels on the right have cf = 1.0
+            } else {
+                // handle the first pixel separately...
+                const int32_t y_incr = right->y_incr;
+                int32_t dx = TRI_FROM_FIXED(r_min_i - r_min) + TRI_ONE;
+                int32_t cf = (dx * dx * y_incr) >> cf_shift;
+                SUB_COVERAGE(coverage, cf);
+            
+                // following pixels get covered by y_incr, but we need
+                // to fix-up the cf to account for previous partial pixel
+                dx = TRI_FROM_FIXED(r_min - r_min_i);
+                cf -= (dx * dx * y_incr) >> cf_shift;
+                for (int x = r_min_i+FIXED_ONE ; x < r_max_i-FIXED_ONE ; x += FIXED_ONE) {
+                    cf += y_incr >> (TRI_ITERATORS_BITS-15);
+                    SUB_COVERAGE(coverage, cf);
+                }
             
-            // following pixels get covered by y_incr, but we need
-            // to fix-up the cf to account for previous partial pixel
-            dx = TRI_FROM_FIXED(r_min - r_min_i);
-            cf -= (dx * dx * y_incr) >> cf_shift;
-            for (int x = r_min_i+FIXED_ONE ; x < r_max_i-FIXED_ONE ; x += FIXED_ONE) {
-                cf += y_incr >> (TRI_ITERATORS_BITS-15);
+                // and the last pixel
+                dx = TRI_FROM_FIXED(r_max - r_max_i) - TRI_ONE;
+                cf += (dx * dx * y_incr) >> cf_shift;
                 SUB_COVERAGE(coverage, cf);
             }
-            
-            // and the last pixel
-            dx = TRI_FROM_FIXED(r_max - r_max_i) - TRI_ONE;
-            cf += (dx * dx * y_incr) >> cf_shift;
-            SUB_COVERAGE(coverage, cf);
         }
 
         // did we reach the end of an edge? if so, get a new one.
@@ -1166,7 +1250,7 @@ void aapolyx(void* con,
     } while (true);
 
     // render the last scanline
-    if (c->iterators.xl < c->iterators.xr)
+    if (c->iterators.xl < c->iterators.xr && ggl_in_band(c, c->iterators.y))
         c->scanline(c);
 }
 
@@ -19,6 +19,7 @@
 
 #define LOG_TAG "FrameworkListener"
 
+#include <cutils/atomic.h>
 #include <cutils/log.h>
 
 #include <sysutils/FrameworkListener.h>
@@ -39,62 +40,128 @@ FrameworkListener::FrameworkListener(const char *socketName) :
 
 void FrameworkListener::init(const char *socketName, bool withSeq) {
     mCommands = new FrameworkCommandCollection();
+    for (int i = 0; i < CMD_HASH_BUCKETS; i++)
+        mCommandBuckets[i] = new FrameworkCommandCollection();
     errorRate = 0;
     mCommandCount = 0;
     mWithSeq = withSeq;
+    mPipelined = false;
+}
+
+FrameworkListener::~FrameworkListener() {
+    for (int i = 0; i < CMD_HASH_BUCKETS; i++)
+        delete mCommandBuckets[i];
+    delete mCommands;
+}
+
+static unsigned int hashCommandName(const char *name) {
+    unsigned int hash = 5381;
+
+    while (*name)
+        hash = hash * 33 + (unsigned char) *name++;
+    return hash;
 }
 
 bool FrameworkListener::onDataAvailable(SocketClient *c) {
     char buffer[CMD_BUF_SIZE];
     int len;
+    int start = 0;
+    int offset = 0;
+    int i;
 
-    len = TEMP_FAILURE_RETRY(read(c->getSocket(), buffer, sizeof(buffer)));
+    /* Put back the start of a command left unfinished by the last read */
+    if (mPipelined)
+        start = c->takePendingCommand(buffer, sizeof(buffer));
+
+    len = TEMP_FAILURE_RETRY(read(c->getSocket(), buffer + start, sizeof(buffer) - start));
     if (len < 0) {
         SLOGE("read() failed (%s)", strerror(errno));
         return false;
     } else if (!len)
         return false;
-   if(buffer[len-1] != '\0')
-        SLOGW("String is not zero-terminated");
+    len += start;
 
-    int offset = 0;
-    int i;
+    if (mPipelined) {
+        c->beginBatch();
+    } else if (buffer[len-1] != '\0') {
+        SLOGW("String is not zero-terminated");
+    }
 
-    for (i = 0; i < len; i++) {
+    for (i = start; i < len; i++) {
         if (buffer[i] == '\0') {
-            /* IMPORTANT: dispatchCommand() expects a zero-terminated string */
-            dispatchCommand(c, buffer + offset);
+            if (mPipelined && c->isDiscardingCommand()) {
+                /* This ends the command that was too long */
+                c->setDiscardingCommand(false);
+            } else {
+                /* IMPORTANT: dispatchCommand() expects a zero-terminated string */
+                dispatchCommand(c, buffer + offset);
+            }
             offset = i + 1;
         }
     }
 
+    if (mPipelined) {
+        /*
+         * Keep what's left of a partial trailing command for the next
+         * readable event rather than blocking on the socket for it.
+         */
+        if (c->isDiscardingCommand()) {
+            /* Still no end to the command that was too long */
+        } else if (offset == 0 && len == (int) sizeof(buffer)) {
+            /* Throw the rest away, up to its terminating zero */
+            c->sendMsg(500, "Command too long", false);
+            c->setDiscardingCommand(true);
+        } else if (offset < len) {
+            if (c->setPendingCommand(buffer + offset, len - offset)) {
+                c->endBatch();
+                return false;
+            }
+        }
+        if (c->endBatch())
+            return false;
+    }
+
     return true;
 }
 
 void FrameworkListener::registerCmd(FrameworkCommand *cmd) {
     mCommands->push_back(cmd);
+    mCommandBuckets[hashCommandName(cmd->getCommand()) % CMD_HASH_BUCKETS]->push_back(cmd);
 }
 
-void FrameworkListener::dispatchCommand(SocketClient *cli, char *data) {
+FrameworkCommand *FrameworkListener::findCommand(const char *name) {
+    FrameworkCommandCollection *bucket =
+            mCommandBuckets[hashCommandName(name) % CMD_HASH_BUCKETS];
     FrameworkCommandCollection::iterator i;
+
+    for (i = bucket->begin(); i != bucket->end(); ++i) {
+        if (!strcmp(name, (*i)->getCommand()))
+            return *i;
+    }
+    return NULL;
+}
+
+/*
+ * Splits data into arguments in place: unescaping only ever shrinks the
+ * text, so the arguments are written back over the command buffer and
+ * argv[] points into it.
+ */
+void FrameworkListener::dispatchCommand(SocketClient *cli, char *data) {
+    FrameworkCommand *c;
     int argc = 0;
     char *argv[FrameworkListener::CMD_ARGS_MAX];
-    char tmp[CMD_BUF_SIZE];
     char *p = data;
-    char *q = tmp;
-    char *qlimit = tmp + sizeof(tmp) - 1;
+    char *q = data;
+    char *arg = data;
     bool esc = false;
     bool quote = false;
     int k;
     bool haveCmdNum = !mWithSeq;
 
     memset(argv, 0, sizeof(argv));
-    memset(tmp, 0, sizeof(tmp));
     while(*p) {
         if (*p == '\\') {
             if (esc) {
-                if (q >= qlimit)
-                    goto overflow;
                 *q++ = '\\';
                 esc = false;
             } else
@@ -103,16 +170,12 @@ void FrameworkListener::dispatchCommand(SocketClient *cli, char *data) {
             continue;
         } else if (esc) {
             if (*p == '"') {
-                if (q >= qlimit)
-                    goto overflow;
                 *q++ = '"';
             } else if (*p == '\\') {
-                if (q >= qlimit)
-                    goto overflow;
                 *q++ = '\\';
             } else {
                 cli->sendMsg(500, "Unsupported escape sequence", false);
-                goto out;
+                return;
             }
             p++;
             esc = false;
@@ -128,27 +191,24 @@ void FrameworkListener::dispatchCommand(SocketClient *cli, char *data) {
             continue;
         }
 
-        if (q >= qlimit)
-            goto overflow;
         *q = *p++;
         if (!quote && *q == ' ') {
             *q = '\0';
             if (!haveCmdNum) {
                 char *endptr;
-                int cmdNum = (int)strtol(tmp, &endptr, 0);
+                int cmdNum = (int)strtol(arg, &endptr, 0);
                 if (endptr == NULL || *endptr != '\0') {
                     cli->sendMsg(500, "Invalid sequence number", false);
-                    goto out;
+                    return;
                 }
                 cli->setCmdNum(cmdNum);
                 haveCmdNum = true;
             } else {
                 if (argc >= CMD_ARGS_MAX)
                     goto overflow;
-                argv[argc++] = strdup(tmp);
+                argv[argc++] = arg;
             }
-            memset(tmp, 0, sizeof(tmp));
-            q = tmp;
+            arg = ++q;
             continue;
         }
         q++;
@@ -157,7 +217,7 @@ void FrameworkListener::dispatchCommand(SocketClient *cli, char *data) {
     *q = '\0';
     if (argc >= CMD_ARGS_MAX)
         goto overflow;
-    argv[argc++] = strdup(tmp);
+    argv[argc++] = arg;
 #if 0
     for (k = 0; k < argc; k++) {
         SLOGD("arg[%d] = '%s'", k, argv[k]);
@@ -166,34 +226,26 @@ void FrameworkListener::dispatchCommand(SocketClient *cli, char *data) {
 
     if (quote) {
         cli->sendMsg(500, "Unclosed quotes error", false);
-        goto out;
+        return;
     }
 
-    if (errorRate && (++mCommandCount % errorRate == 0)) {
+    if (errorRate && ((android_atomic_inc(&mCommandCount) + 1) % errorRate == 0)) {
         /* ignore this command - let the timeout handler handle it */
         SLOGE("Faking a timeout");
-        goto out;
+        return;
     }
 
-    for (i = mCommands->begin(); i != mCommands->end(); ++i) {
-        FrameworkCommand *c = *i;
-
-        if (!strcmp(argv[0], c->getCommand())) {
-            if (c->runCommand(cli, argc, argv)) {
-                SLOGW("Handler '%s' error (%s)", c->getCommand(), strerror(errno));
-            }
-            goto out;
-        }
+    c = findCommand(argv[0]);
+    if (c == NULL) {
+        cli->sendMsg(500, "Command not recognized", false);
+        return;
+    }
+    if (c->runCommand(cli, argc, argv)) {
+        SLOGW("Handler '%s' error (%s)", c->getCommand(), strerror(errno));
     }
-    cli->sendMsg(500, "Command not recognized", false);
-out:
-    int j;
-    for (j = 0; j < argc; j++)
-        free(argv[j]);
     return;
 
 overflow:
     LOG_EVENT_INT(78001, cli->getUid());
     cli->sendMsg(500, "Command too long", false);
-    goto out;
 }
@@ -48,21 +48,22 @@ const int NetlinkEvent::NlActionAddressRemoved = 7;
 NetlinkEvent::NetlinkEvent() {
     mAction = NlActionUnknown;
     memset(mParams, 0, sizeof(mParams));
+    mParamsOwned = false;
+    mParamIndexBuilt = false;
     mPath = NULL;
     mSubsystem = NULL;
+    mBuffer = NULL;
 }
 
 NetlinkEvent::~NetlinkEvent() {
     int i;
-    if (mPath)
-        free(mPath);
-    if (mSubsystem)
-        free(mSubsystem);
-    for (i = 0; i < NL_PARAMS_MAX; i++) {
-        if (!mParams[i])
-            break;
-        free(mParams[i]);
+    if (mParamsOwned) {
+        for (i = 0; i < NL_PARAMS_MAX; i++) {
+            if (mParams[i])
+                free(mParams[i]);
+        }
     }
+    free(mBuffer);
 }
 
 void NetlinkEvent::dump() {
@@ -135,7 +136,7 @@ bool NetlinkEvent::parseIfAddrMessage(int type, struct ifaddrmsg *ifaddr,
             // Fill in interface information.
             mAction = (type == RTM_NEWADDR) ? NlActionAddressUpdated :
                                               NlActionAddressRemoved;
-            mSubsystem = strdup("net");
+            mSubsystem = "net";
             asprintf(&mParams[0], "ADDRESS=%s/%d", addrstr,
                      ifaddr->ifa_prefixlen);
             asprintf(&mParams[1], "INTERFACE=%s", ifname);
@@ -177,6 +178,8 @@ bool NetlinkEvent::parseIfAddrMessage(int type, struct ifaddrmsg *ifaddr,
 bool NetlinkEvent::parseBinaryNetlinkMessage(char *buffer, int size) {
     const struct nlmsghdr *nh;
 
+    mParamsOwned = true;
+
     for (nh = (struct nlmsghdr *) buffer;
          NLMSG_OK(nh, size) && (nh->nlmsg_type != NLMSG_DONE);
          nh = NLMSG_NEXT(nh, size)) {
@@ -208,7 +211,7 @@ bool NetlinkEvent::parseBinaryNetlinkMessage(char *buffer, int size) {
                     mParams[0] = strdup(buffer);
                     mAction = (ifi->ifi_flags & IFF_LOWER_UP) ?
                       NlActionLinkUp : NlActionLinkDown;
-                    mSubsystem = strdup("net");
+                    mSubsystem = "net";
                     break;
                 }
 
@@ -227,7 +230,7 @@ bool NetlinkEvent::parseBinaryNetlinkMessage(char *buffer, int size) {
             devname = pm->indev_name[0] ? pm->indev_name : pm->outdev_name;
             asprintf(&mParams[0], "ALERT_NAME=%s", pm->prefix);
             asprintf(&mParams[1], "INTERFACE=%s", devname);
-            mSubsystem = strdup("qlog");
+            mSubsystem = "qlog";
             mAction = NlActionChange;
 
         } else if (nh->nlmsg_type == RTM_NEWADDR ||
@@ -300,7 +303,7 @@ bool NetlinkEvent::parseAsciiNetlinkMessage(char *buffer, int size) {
                     return false;
                 }
             }
-            mPath = strdup(p+1);
+            mPath = p+1;
             first = 0;
         } else {
             const char* a;
@@ -314,9 +317,9 @@ bool NetlinkEvent::parseAsciiNetlinkMessage(char *buffer, int size) {
             } else if ((a = HAS_CONST_PREFIX(s, end, "SEQNUM=")) != NULL) {
                 mSeq = atoi(a);
             } else if ((a = HAS_CONST_PREFIX(s, end, "SUBSYSTEM=")) != NULL) {
-                mSubsystem = strdup(a);
+                mSubsystem = a;
             } else if (param_idx < NL_PARAMS_MAX) {
-                mParams[param_idx++] = strdup(s);
+                mParams[param_idx++] = (char *) s;
             }
         }
         s += strlen(s) + 1;
@@ -325,6 +328,18 @@ bool NetlinkEvent::parseAsciiNetlinkMessage(char *buffer, int size) {
 }
 
 bool NetlinkEvent::decode(char *buffer, int size, int format) {
+    if (format != NetlinkListener::NETLINK_FORMAT_BINARY) {
+        /* One copy of the whole message instead of one per field */
+        mBuffer = (char *) malloc(size);
+        if (mBuffer == NULL)
+            return false;
+        memcpy(mBuffer, buffer, size);
+        buffer = mBuffer;
+    }
+    return decodeInPlace(buffer, size, format);
+}
+
+bool NetlinkEvent::decodeInPlace(char *buffer, int size, int format) {
     if (format == NetlinkListener::NETLINK_FORMAT_BINARY) {
         return parseBinaryNetlinkMessage(buffer, size);
     } else {
@@ -332,12 +347,42 @@ bool NetlinkEvent::decode(char *buffer, int size, int format) {
     }
 }
 
-const char *NetlinkEvent::findParam(const char *paramName) {
-    size_t len = strlen(paramName);
+/* Hashes a parameter name up to its '=' (or the end of the string) */
+static unsigned int hashParamName(const char *name, size_t *len) {
+    unsigned int hash = 5381;
+    const char *p;
+
+    for (p = name; *p && *p != '='; p++)
+        hash = hash * 33 + (unsigned char) *p;
+    *len = p - name;
+    return hash;
+}
+
+void NetlinkEvent::buildParamIndex() {
+    memset(mParamIndex, -1, sizeof(mParamIndex));
     for (int i = 0; i < NL_PARAMS_MAX && mParams[i] != NULL; ++i) {
-        const char *ptr = mParams[i] + len;
-        if (!strncmp(mParams[i], paramName, len) && *ptr == '=')
-            return ++ptr;
+        size_t len;
+        unsigned int slot = hashParamName(mParams[i], &len) % NL_PARAMS_HASH_SIZE;
+        /* The table is twice NL_PARAMS_MAX, so there is always a free slot */
+        while (mParamIndex[slot] >= 0)
+            slot = (slot + 1) % NL_PARAMS_HASH_SIZE;
+        mParamIndex[slot] = i;
+    }
+    mParamIndexBuilt = true;
+}
+
+const char *NetlinkEvent::findParam(const char *paramName) {
+    if (!mParamIndexBuilt)
+        buildParamIndex();
+
+    size_t len;
+    unsigned int slot = hashParamName(paramName, &len) % NL_PARAMS_HASH_SIZE;
+    /* Duplicate names are probed in insertion order, so the first one wins */
+    while (mParamIndex[slot] >= 0) {
+        const char *param = mParams[(int) mParamIndex[slot]];
+        if (!strncmp(param, paramName, len) && param[len] == '=')
+            return param + len + 1;
+        slot = (slot + 1) % NL_PARAMS_HASH_SIZE;
     }
 
     SLOGE("NetlinkEvent::FindParam(): Parameter '%s' not found", paramName);
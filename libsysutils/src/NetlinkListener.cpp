@@ -44,11 +44,17 @@ NetlinkListener::NetlinkListener(int socket, int format) :
 bool NetlinkListener::onDataAvailable(SocketClient *cli)
 {
     int socket = cli->getSocket();
-    ssize_t count;
+    NetlinkEvent *events[NETLINK_BATCH_MAX];
+    ssize_t lengths[NETLINK_BATCH_MAX];
     uid_t uid = -1;
+    int count;
 
-    count = TEMP_FAILURE_RETRY(uevent_kernel_multicast_uid_recv(
-                                       socket, mBuffer, sizeof(mBuffer), &uid));
+    /* Binary messages can be large, so they still get the whole buffer */
+    int batch = (mFormat == NETLINK_FORMAT_BINARY) ? 1 : NETLINK_BATCH_MAX;
+    size_t slotSize = sizeof(mBuffer) / batch;
+
+    count = TEMP_FAILURE_RETRY(uevent_kernel_multicast_uid_recv_batch(
+                                       socket, mBuffer, slotSize, batch, lengths, &uid));
     if (count < 0) {
         if (uid > 0)
             LOG_EVENT_INT(65537, uid);
@@ -56,13 +62,38 @@ bool NetlinkListener::onDataAvailable(SocketClient *cli)
         return false;
     }
 
-    NetlinkEvent *evt = new NetlinkEvent();
-    if (!evt->decode(mBuffer, count, mFormat)) {
-        SLOGE("Error decoding NetlinkEvent");
-    } else {
-        onEvent(evt);
+    /* Events point into mBuffer, which stays untouched until they are deleted */
+    for (int i = 0; i < count; i++) {
+        events[i] = NULL;
+        if (lengths[i] < 0) {
+            if (uid > 0)
+                LOG_EVENT_INT(65537, uid);
+            SLOGE("Rejected netlink message");
+            continue;
+        }
+        NetlinkEvent *evt = new NetlinkEvent();
+        if (!evt->decodeInPlace(mBuffer + i * slotSize, lengths[i], mFormat)) {
+            SLOGE("Error decoding NetlinkEvent");
+            delete evt;
+            continue;
+        }
+        events[i] = evt;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (events[i] == NULL)
+            continue;
+
+        bool superseded = false;
+        for (int j = i + 1; j < count && !superseded; j++) {
+            if (events[j] != NULL)
+                superseded = canCoalesce(events[i], events[j]);
+        }
+        if (!superseded)
+            onEvent(events[i]);
     }
 
-    delete evt;
+    for (int i = 0; i < count; i++)
+        delete events[i];
     return true;
 }
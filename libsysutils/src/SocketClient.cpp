@@ -3,6 +3,7 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 #include <arpa/inet.h>
 
@@ -11,6 +12,9 @@
 
 #include <sysutils/SocketClient.h>
 
+/* Queued replies are flushed early once they reach this size */
+static const int BATCH_MAX_SIZE = 16 * 1024;
+
 SocketClient::SocketClient(int socket, bool owned) {
     init(socket, owned, false);
 }
@@ -30,6 +34,13 @@ void SocketClient::init(int socket, bool owned, bool useCmdNum) {
     mGid = -1;
     mRefCount = 1;
     mCmdNum = 0;
+    mBatching = false;
+    mBatchBuf = NULL;
+    mBatchLen = 0;
+    mBatchSize = 0;
+    mPendingCmd = NULL;
+    mPendingCmdLen = 0;
+    mDiscardingCmd = false;
 
     struct ucred creds;
     socklen_t szCreds = sizeof(creds);
@@ -45,6 +56,8 @@ void SocketClient::init(int socket, bool owned, bool useCmdNum) {
 
 SocketClient::~SocketClient()
 {
+    free(mBatchBuf);
+    free(mPendingCmd);
     if (mSocketOwned) {
         close(mSocket);
     }
@@ -155,7 +168,93 @@ int SocketClient::sendData(const void *data, int len) {
     return rc;
 }
 
+void SocketClient::beginBatch() {
+    pthread_mutex_lock(&mWriteMutex);
+    mBatching = true;
+    mBatchOwner = pthread_self();
+    pthread_mutex_unlock(&mWriteMutex);
+}
+
+int SocketClient::endBatch() {
+    pthread_mutex_lock(&mWriteMutex);
+    mBatching = false;
+    int rc = flushBatchLocked();
+    pthread_mutex_unlock(&mWriteMutex);
+
+    return rc;
+}
+
+int SocketClient::takePendingCommand(char *buf, int size) {
+    int len = mPendingCmdLen;
+
+    if (len > size)
+        len = size;
+    memcpy(buf, mPendingCmd, len);
+    mPendingCmdLen = 0;
+    return len;
+}
+
+int SocketClient::setPendingCommand(const char *data, int len) {
+    char *buf = (char *)realloc(mPendingCmd, len);
+
+    if (buf == NULL && len > 0) {
+        SLOGW("realloc error (%s)", strerror(errno));
+        mPendingCmdLen = 0;
+        return -1;
+    }
+    mPendingCmd = buf;
+    memcpy(mPendingCmd, data, len);
+    mPendingCmdLen = len;
+    return 0;
+}
+
+int SocketClient::flushBatchLocked() {
+    int rc = writeLocked(mBatchBuf, mBatchLen);
+    mBatchLen = 0;
+    return rc;
+}
+
 int SocketClient::sendDataLocked(const void *data, int len) {
+    if (!mBatching) {
+        return writeLocked(data, len);
+    }
+
+    if (!pthread_equal(mBatchOwner, pthread_self())) {
+        /* Don't hold another thread's message back behind the batch */
+        if (flushBatchLocked()) {
+            return -1;
+        }
+        return writeLocked(data, len);
+    }
+
+    if (mBatchLen + len > BATCH_MAX_SIZE) {
+        if (flushBatchLocked()) {
+            return -1;
+        }
+        if (len > BATCH_MAX_SIZE) {
+            return writeLocked(data, len);
+        }
+    }
+
+    if (mBatchLen + len > mBatchSize) {
+        int size = mBatchLen + len < 1024 ? 1024 : BATCH_MAX_SIZE;
+        char *buf = (char *)realloc(mBatchBuf, size);
+        if (buf == NULL) {
+            if (flushBatchLocked()) {
+                return -1;
+            }
+            return writeLocked(data, len);
+        }
+        mBatchBuf = buf;
+        mBatchSize = size;
+    }
+
+    memcpy(mBatchBuf + mBatchLen, data, len);
+    mBatchLen += len;
+    return 0;
+}
+
+int SocketClient::writeLocked(const void *data, int len) {
     int rc = 0;
     const char *p = (const char*) data;
     int brtw = len;
@@ -16,8 +16,9 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
-#include <sys/select.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/un.h>
@@ -31,6 +32,8 @@
 
 #define LOG_NDEBUG 0
 
+#define MAX_EPOLL_EVENTS 32
+
 SocketListener::SocketListener(const char *socketName, bool listen) {
     init(socketName, -1, listen, false);
 }
@@ -48,8 +51,18 @@ void SocketListener::init(const char *socketName, int socketFd, bool listen, boo
     mSocketName = socketName;
     mSock = socketFd;
     mUseCmdNum = useCmdNum;
+    mCtrlPipe[0] = -1;
+    mCtrlPipe[1] = -1;
+    mEpollFd = -1;
     pthread_mutex_init(&mClientsLock, NULL);
     mClients = new SocketClientCollection();
+
+    mWorkerCount = 0;
+    mWorkers = NULL;
+    mWorkersExit = false;
+    mPendingWork = new SocketClientCollection();
+    pthread_mutex_init(&mWorkLock, NULL);
+    pthread_cond_init(&mWorkCond, NULL);
 }
 
 SocketListener::~SocketListener() {
@@ -60,12 +73,40 @@ SocketListener::~SocketListener() {
         close(mCtrlPipe[0]);
         close(mCtrlPipe[1]);
     }
+    if (mEpollFd != -1)
+        close(mEpollFd);
     SocketClientCollection::iterator it;
     for (it = mClients->begin(); it != mClients->end();) {
         (*it)->decRef();
         it = mClients->erase(it);
     }
     delete mClients;
+    delete mPendingWork;
+    delete[] mWorkers;
+    pthread_cond_destroy(&mWorkCond);
+    pthread_mutex_destroy(&mWorkLock);
+}
+
+void SocketListener::setWorkerCount(int workerCount) {
+    mWorkerCount = workerCount > 0 ? workerCount : 0;
+}
+
+/*
+ * Clients are registered one-shot: once a client fires it stays disarmed
+ * until handleClient() has consumed its data and re-armed it.  This is what
+ * keeps per-client ordering when several workers are running.
+ */
+int SocketListener::watchClient(SocketClient *c, int op) {
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = c;
+    if (epoll_ctl(mEpollFd, op, c->getSocket(), &ev)) {
+        SLOGE("epoll_ctl failed (%s)", strerror(errno));
+        return -1;
+    }
+    return 0;
 }
 
 int SocketListener::startListener() {
@@ -83,20 +124,61 @@ int SocketListener::startListener() {
         SLOGV("got mSock = %d for %s", mSock, mSocketName);
     }
 
-    if (mListen && listen(mSock, 4) < 0) {
-        SLOGE("Unable to listen on socket (%s)", strerror(errno));
-        return -1;
-    } else if (!mListen)
-        mClients->push_back(new SocketClient(mSock, false, mUseCmdNum));
+    if ((mEpollFd = epoll_create(MAX_EPOLL_EVENTS)) < 0) {
+        SLOGE("epoll_create failed (%s)", strerror(errno));
+        return failStart(0);
+    }
 
     if (pipe(mCtrlPipe)) {
         SLOGE("pipe failed (%s)", strerror(errno));
-        return -1;
+        mCtrlPipe[0] = -1;
+        mCtrlPipe[1] = -1;
+        return failStart(0);
     }
 
-    if (pthread_create(&mThread, NULL, SocketListener::threadStart, this)) {
-        SLOGE("pthread_create (%s)", strerror(errno));
-        return -1;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = mCtrlPipe;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mCtrlPipe[0], &ev)) {
+        SLOGE("epoll_ctl failed (%s)", strerror(errno));
+        return failStart(0);
+    }
+
+    if (mListen && listen(mSock, 4) < 0) {
+        SLOGE("Unable to listen on socket (%s)", strerror(errno));
+        return failStart(0);
+    } else if (mListen) {
+        ev.data.ptr = this;
+        if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mSock, &ev)) {
+            SLOGE("epoll_ctl failed (%s)", strerror(errno));
+            return failStart(0);
+        }
+    } else {
+        SocketClient *c = new SocketClient(mSock, false, mUseCmdNum);
+        mClients->push_back(c);
+        if (watchClient(c, EPOLL_CTL_ADD))
+            return failStart(0);
+    }
+
+    int err;
+    if (mWorkerCount > 0) {
+        mWorkersExit = false;
+        mWorkers = new pthread_t[mWorkerCount];
+        for (int i = 0; i < mWorkerCount; i++) {
+            if ((err = pthread_create(&mWorkers[i], NULL,
+                                      SocketListener::workerStart, this))) {
+                SLOGE("pthread_create (%s)", strerror(err));
+                errno = err;
+                return failStart(i);
+            }
+        }
+    }
+
+    if ((err = pthread_create(&mThread, NULL, SocketListener::threadStart, this))) {
+        SLOGE("pthread_create (%s)", strerror(err));
+        errno = err;
+        return failStart(mWorkerCount);
     }
 
     return 0;
@@ -117,10 +199,53 @@ int SocketListener::stopListener() {
         SLOGE("Error joining to listener thread (%s)", strerror(errno));
         return -1;
     }
-    close(mCtrlPipe[0]);
-    close(mCtrlPipe[1]);
-    mCtrlPipe[0] = -1;
-    mCtrlPipe[1] = -1;
+
+    stopWorkers(mWorkerCount);
+    releaseResources();
+    return 0;
+}
+
+/*
+ * Tells the first 'count' workers to exit and waits for them.  Only the
+ * listener thread queues work, so once it is gone nothing new can arrive.
+ */
+void SocketListener::stopWorkers(int count) {
+    if (!mWorkers)
+        return;
+
+    pthread_mutex_lock(&mWorkLock);
+    mWorkersExit = true;
+    pthread_cond_broadcast(&mWorkCond);
+    pthread_mutex_unlock(&mWorkLock);
+    for (int i = 0; i < count; i++) {
+        int err = pthread_join(mWorkers[i], NULL);
+        if (err) {
+            SLOGE("Error joining to worker thread (%s)", strerror(err));
+        }
+    }
+    delete[] mWorkers;
+    mWorkers = NULL;
+
+    /* Drop the references held by work that was never picked up */
+    SocketClientCollection::iterator it;
+    for (it = mPendingWork->begin(); it != mPendingWork->end();) {
+        (*it)->decRef();
+        it = mPendingWork->erase(it);
+    }
+}
+
+/* Closes whatever startListener() opened and forgets the clients */
+void SocketListener::releaseResources() {
+    if (mCtrlPipe[0] != -1) {
+        close(mCtrlPipe[0]);
+        close(mCtrlPipe[1]);
+        mCtrlPipe[0] = -1;
+        mCtrlPipe[1] = -1;
+    }
+    if (mEpollFd != -1) {
+        close(mEpollFd);
+        mEpollFd = -1;
+    }
 
     if (mSocketName && mSock > -1) {
         close(mSock);
@@ -132,7 +257,20 @@ int SocketListener::stopListener() {
         delete (*it);
         it = mClients->erase(it);
     }
-    return 0;
+}
+
+/*
+ * Unwinds a partially started listener so that startListener() can be
+ * retried.  'workersStarted' is how many worker threads are running.
+ * Returns -1 with errno still describing the original failure.
+ */
+int SocketListener::failStart(int workersStarted) {
+    int saved = errno;
+
+    stopWorkers(workersStarted);
+    releaseResources();
+    errno = saved;
+    return -1;
 }
 
 void *SocketListener::threadStart(void *obj) {
@@ -143,48 +281,82 @@ void *SocketListener::threadStart(void *obj) {
     return NULL;
 }
 
-void SocketListener::runListener() {
+void *SocketListener::workerStart(void *obj) {
+    SocketListener *me = reinterpret_cast<SocketListener *>(obj);
 
-    SocketClientCollection *pendingList = new SocketClientCollection();
+    me->runWorker();
+    pthread_exit(NULL);
+    return NULL;
+}
 
-    while(1) {
+void SocketListener::handleClient(SocketClient *c) {
+    /* Process it, if false is returned and our sockets are
+     * connection-based, remove and destroy it */
+    if (!onDataAvailable(c) && mListen) {
+        /* Remove the client from our array */
+        SLOGV("going to zap %d for %s", c->getSocket(), mSocketName);
+        pthread_mutex_lock(&mClientsLock);
         SocketClientCollection::iterator it;
-        fd_set read_fds;
-        int rc = 0;
-        int max = -1;
-
-        FD_ZERO(&read_fds);
+        for (it = mClients->begin(); it != mClients->end(); ++it) {
+            if (*it == c) {
+                mClients->erase(it);
+                break;
+            }
+        }
+        pthread_mutex_unlock(&mClientsLock);
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, c->getSocket(), NULL);
+        /* Remove our reference to the client */
+        c->decRef();
+    } else {
+        watchClient(c, EPOLL_CTL_MOD);
+    }
+}
 
-        if (mListen) {
-            max = mSock;
-            FD_SET(mSock, &read_fds);
+void SocketListener::runWorker() {
+    while (1) {
+        pthread_mutex_lock(&mWorkLock);
+        while (mPendingWork->empty() && !mWorkersExit)
+            pthread_cond_wait(&mWorkCond, &mWorkLock);
+        if (mWorkersExit) {
+            pthread_mutex_unlock(&mWorkLock);
+            break;
         }
+        SocketClientCollection::iterator it = mPendingWork->begin();
+        SocketClient *c = *it;
+        mPendingWork->erase(it);
+        pthread_mutex_unlock(&mWorkLock);
+
+        handleClient(c);
+        /* Drop the reference taken when the work was queued */
+        c->decRef();
+    }
+}
 
-        FD_SET(mCtrlPipe[0], &read_fds);
-        if (mCtrlPipe[0] > max)
-            max = mCtrlPipe[0];
+void SocketListener::runListener() {
 
-        pthread_mutex_lock(&mClientsLock);
-        for (it = mClients->begin(); it != mClients->end(); ++it) {
-            int fd = (*it)->getSocket();
-            FD_SET(fd, &read_fds);
-            if (fd > max)
-                max = fd;
-        }
-        pthread_mutex_unlock(&mClientsLock);
-        SLOGV("mListen=%d, max=%d, mSocketName=%s", mListen, max, mSocketName);
-        if ((rc = select(max + 1, &read_fds, NULL, NULL, NULL)) < 0) {
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+
+    while(1) {
+        int rc;
+
+        SLOGV("mListen=%d, mSocketName=%s", mListen, mSocketName);
+        if ((rc = epoll_wait(mEpollFd, events, MAX_EPOLL_EVENTS, -1)) < 0) {
             if (errno == EINTR)
                 continue;
-            SLOGE("select failed (%s) mListen=%d, max=%d", strerror(errno), mListen, max);
+            SLOGE("epoll_wait failed (%s) mListen=%d", strerror(errno), mListen);
             sleep(1);
             continue;
-        } else if (!rc)
-            continue;
+        }
+
+        for (int i = 0; i < rc; i++) {
+            if (events[i].data.ptr == mCtrlPipe)
+                return;
+        }
+
+        for (int i = 0; i < rc; i++) {
+            if (events[i].data.ptr != this)
+                continue;
 
-        if (FD_ISSET(mCtrlPipe[0], &read_fds))
-            break;
-        if (mListen && FD_ISSET(mSock, &read_fds)) {
             struct sockaddr addr;
             socklen_t alen;
             int c;
@@ -199,48 +371,41 @@ void SocketListener::runListener() {
                 sleep(1);
                 continue;
             }
+            SocketClient *client = new SocketClient(c, true, mUseCmdNum);
             pthread_mutex_lock(&mClientsLock);
-            mClients->push_back(new SocketClient(c, true, mUseCmdNum));
+            mClients->push_back(client);
             pthread_mutex_unlock(&mClientsLock);
-        }
-
-        /* Add all active clients to the pending list first */
-        pendingList->clear();
-        pthread_mutex_lock(&mClientsLock);
-        for (it = mClients->begin(); it != mClients->end(); ++it) {
-            int fd = (*it)->getSocket();
-            if (FD_ISSET(fd, &read_fds)) {
-                pendingList->push_back(*it);
-            }
-        }
-        pthread_mutex_unlock(&mClientsLock);
-
-        /* Process the pending list, since it is owned by the thread,
-         * there is no need to lock it */
-        while (!pendingList->empty()) {
-            /* Pop the first item from the list */
-            it = pendingList->begin();
-            SocketClient* c = *it;
-            pendingList->erase(it);
-            /* Process it, if false is returned and our sockets are
-             * connection-based, remove and destroy it */
-            if (!onDataAvailable(c) && mListen) {
-                /* Remove the client from our array */
-                SLOGV("going to zap %d for %s", c->getSocket(), mSocketName);
+            if (watchClient(client, EPOLL_CTL_ADD)) {
                 pthread_mutex_lock(&mClientsLock);
+                SocketClientCollection::iterator it;
                 for (it = mClients->begin(); it != mClients->end(); ++it) {
-                    if (*it == c) {
+                    if (*it == client) {
                         mClients->erase(it);
                         break;
                     }
                 }
                 pthread_mutex_unlock(&mClientsLock);
-                /* Remove our reference to the client */
-                c->decRef();
+                client->decRef();
+            }
+        }
+
+        for (int i = 0; i < rc; i++) {
+            if (events[i].data.ptr == this)
+                continue;
+
+            SocketClient *c = reinterpret_cast<SocketClient *>(events[i].data.ptr);
+            if (mWorkerCount > 0) {
+                /* Keep the client alive until a worker is done with it */
+                c->incRef();
+                pthread_mutex_lock(&mWorkLock);
+                mPendingWork->push_back(c);
+                pthread_cond_signal(&mWorkCond);
+                pthread_mutex_unlock(&mWorkLock);
+            } else {
+                handleClient(c);
             }
         }
     }
-    delete pendingList;
 }
 
 void SocketListener::sendBroadcast(int code, const char *msg, bool addErrno) {
@@ -0,0 +1,11 @@
+# Copyright 2013 The Android Open Source Project
+
+LOCAL_PATH := $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := socket_listener_bench
+LOCAL_SRC_FILES := socket_listener_bench.cpp
+LOCAL_SHARED_LIBRARIES := libsysutils libcutils liblog
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures SocketListener command throughput with many concurrent clients.
+ *
+ *   socket_listener_bench [clients] [commands per client] [workers] [slow us]
+ *
+ * Every client sends zero-terminated commands and waits for each reply.
+ * One command in 16 sleeps for "slow us" microseconds in the handler to
+ * model a slow daemon command; with workers > 0 the other clients keep
+ * being served while it runs.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/sockets.h>
+#include <sysutils/SocketClient.h>
+#include <sysutils/SocketListener.h>
+
+static const char *SOCKET_NAME = "socket_listener_bench";
+
+class BenchListener : public SocketListener {
+    int mSlowUs;
+
+public:
+    BenchListener(int sock, int slowUs) : SocketListener(sock, true), mSlowUs(slowUs) {}
+
+protected:
+    virtual bool onDataAvailable(SocketClient *c) {
+        char buf[256];
+        int len = TEMP_FAILURE_RETRY(read(c->getSocket(), buf, sizeof(buf)));
+        if (len <= 0)
+            return false;
+
+        for (int i = 0; i < len; i++) {
+            if (buf[i] != '\0')
+                continue;
+            if (mSlowUs > 0 && buf[0] == 's')
+                usleep(mSlowUs);
+            c->sendMsg(200, "ok", false);
+        }
+        return true;
+    }
+};
+
+struct client_args {
+    int commands;
+    int failures;
+};
+
+static void *runClient(void *arg) {
+    client_args *args = reinterpret_cast<client_args *>(arg);
+    int sock = socket_local_client(SOCKET_NAME, ANDROID_SOCKET_NAMESPACE_ABSTRACT,
+            SOCK_STREAM);
+    if (sock < 0) {
+        args->failures = args->commands;
+        return NULL;
+    }
+
+    for (int i = 0; i < args->commands; i++) {
+        const char *cmd = (i % 16 == 0) ? "slow" : "fast";
+        char reply[64];
+
+        if (TEMP_FAILURE_RETRY(write(sock, cmd, strlen(cmd) + 1)) < 0 ||
+                TEMP_FAILURE_RETRY(read(sock, reply, sizeof(reply))) <= 0) {
+            args->failures++;
+        }
+    }
+    close(sock);
+    return NULL;
+}
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    int clients = argc > 1 ? atoi(argv[1]) : 64;
+    int commands = argc > 2 ? atoi(argv[2]) : 1000;
+    int workers = argc > 3 ? atoi(argv[3]) : 0;
+    int slowUs = argc > 4 ? atoi(argv[4]) : 0;
+
+    int sock = socket_local_server(SOCKET_NAME, ANDROID_SOCKET_NAMESPACE_ABSTRACT,
+            SOCK_STREAM);
+    if (sock < 0) {
+        fprintf(stderr, "socket_local_server failed: %s\n", strerror(errno));
+        return 1;
+    }
+
+    BenchListener listener(sock, slowUs);
+    listener.setWorkerCount(workers);
+    if (listener.startListener()) {
+        fprintf(stderr, "startListener failed: %s\n", strerror(errno));
+        return 1;
+    }
+
+    pthread_t *threads = new pthread_t[clients];
+    client_args *args = new client_args[clients];
+    double start = now();
+    for (int i = 0; i < clients; i++) {
+        args[i].commands = commands;
+        args[i].failures = 0;
+        pthread_create(&threads[i], NULL, runClient, &args[i]);
+    }
+
+    int failures = 0;
+    for (int i = 0; i < clients; i++) {
+        pthread_join(threads[i], NULL);
+        failures += args[i].failures;
+    }
+    double elapsed = now() - start;
+
+    listener.stopListener();
+    close(sock);
+
+    int total = clients * commands;
+    printf("%d clients x %d commands, %d workers, %d us slow commands: "
+           "%.0f commands/s (%d failed)\n",
+           clients, commands, workers, slowUs, (total - failures) / elapsed, failures);
+
+    delete[] args;
+    delete[] threads;
+    return failures ? 1 : 0;
+}
@@ -26,6 +26,7 @@ commonSources:= \
 	LinearAllocator.cpp \
 	LinearTransform.cpp \
 	Log.cpp \
+	PoolAllocator.cpp \
 	Printer.cpp \
 	ProcessCallStack.cpp \
 	PropertyMap.cpp \
@@ -96,6 +97,7 @@ include $(CLEAR_VARS)
 LOCAL_SRC_FILES:= \
 	$(commonSources) \
 	Looper.cpp \
+	SamplingProfiler.cpp \
 	Trace.cpp
 
 ifeq ($(TARGET_OS),linux)
@@ -22,6 +22,8 @@
 
 #include <utils/BlobCache.h>
 #include <utils/Errors.h>
+#include <utils/FileMap.h>
+#include <utils/JenkinsHash.h>
 #include <utils/Log.h>
 
 namespace android {
@@ -39,20 +41,27 @@ BlobCache::BlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize
         mMaxKeySize(maxKeySize),
         mMaxValueSize(maxValueSize),
         mMaxTotalSize(maxTotalSize),
-        mTotalSize(0) {
-    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
-#ifdef _WIN32
-    srand(now);
-#else
-    mRandState[0] = (now >> 0) & 0xFFFF;
-    mRandState[1] = (now >> 16) & 0xFFFF;
-    mRandState[2] = (now >> 32) & 0xFFFF;
-#endif
-    ALOGV("initializing random seed using %lld", now);
+        mTotalSize(0),
+        mOldest(NULL),
+        mNewest(NULL) {
+}
+
+BlobCache::~BlobCache() {
+    clear();
+}
+
+static inline hash_t hashKey(const void* key, size_t keySize) {
+    return JenkinsHashWhiten(JenkinsHashMixBytes(0,
+            reinterpret_cast<const uint8_t*>(key), keySize));
 }
 
 void BlobCache::set(const void* key, size_t keySize, const void* value,
         size_t valueSize) {
+    set(key, keySize, value, valueSize, NULL);
+}
+
+void BlobCache::set(const void* key, size_t keySize, const void* value,
+        size_t valueSize, FileMap* map) {
     if (mMaxKeySize < keySize) {
         ALOGV("set: not caching because the key is too large: %d (limit: %d)",
                 keySize, mMaxKeySize);
@@ -77,15 +86,11 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
         return;
     }
 
-    sp<Blob> dummyKey(new Blob(key, keySize, false));
-    CacheEntry dummyEntry(dummyKey, NULL);
-
+    hash_t hash = hashKey(key, keySize);
     while (true) {
-        ssize_t index = mCacheEntries.indexOf(dummyEntry);
-        if (index < 0) {
+        CacheEntry* entry = findEntry(key, keySize, hash);
+        if (entry == NULL) {
             // Create a new cache entry.
-            sp<Blob> keyBlob(new Blob(key, keySize, true));
-            sp<Blob> valueBlob(new Blob(value, valueSize, true));
             size_t newTotalSize = mTotalSize + keySize + valueSize;
             if (mMaxTotalSize < newTotalSize) {
                 if (isCleanable()) {
@@ -100,15 +105,18 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
                     break;
                 }
             }
-            mCacheEntries.add(CacheEntry(keyBlob, valueBlob));
+            sp<Blob> keyBlob(map != NULL ? new Blob(key, keySize, map) :
+                    new Blob(key, keySize, true));
+            sp<Blob> valueBlob(map != NULL ? new Blob(value, valueSize, map) :
+                    new Blob(value, valueSize, true));
+            addEntry(new CacheEntry(keyBlob, valueBlob, hash));
             mTotalSize = newTotalSize;
             ALOGV("set: created new cache entry with %d byte key and %d byte value",
                     keySize, valueSize);
         } else {
             // Update the existing cache entry.
-            sp<Blob> valueBlob(new Blob(value, valueSize, true));
-            sp<Blob> oldValueBlob(mCacheEntries[index].getValue());
-            size_t newTotalSize = mTotalSize + valueSize - oldValueBlob->getSize();
+            size_t oldValueSize = entry->getValue()->getSize();
+            size_t newTotalSize = mTotalSize + valueSize - oldValueSize;
             if (mMaxTotalSize < newTotalSize) {
                 if (isCleanable()) {
                     // Clean the cache and try again.
@@ -121,7 +129,9 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
                     break;
                 }
             }
-            mCacheEntries.editItemAt(index).setValue(valueBlob);
+            entry->setValue(map != NULL ? new Blob(value, valueSize, map) :
+                    new Blob(value, valueSize, true));
+            touchEntry(entry);
             mTotalSize = newTotalSize;
             ALOGV("set: updated existing cache entry with %d byte key and %d byte "
                     "value", keySize, valueSize);
@@ -137,17 +147,16 @@ size_t BlobCache::get(const void* key, size_t keySize, void* value,
                 keySize, mMaxKeySize);
         return 0;
     }
-    sp<Blob> dummyKey(new Blob(key, keySize, false));
-    CacheEntry dummyEntry(dummyKey, NULL);
-    ssize_t index = mCacheEntries.indexOf(dummyEntry);
-    if (index < 0) {
+    CacheEntry* entry = findEntry(key, keySize, hashKey(key, keySize));
+    if (entry == NULL) {
         ALOGV("get: no cache entry found for key of size %d", keySize);
         return 0;
     }
+    touchEntry(entry);
 
     // The key was found. Return the value if the caller's buffer is large
     // enough.
-    sp<Blob> valueBlob(mCacheEntries[index].getValue());
+    sp<Blob> valueBlob(entry->getValue());
     size_t valueBlobSize = valueBlob->getSize();
     if (valueBlobSize <= valueSize) {
         ALOGV("get: copying %d bytes to caller's buffer", valueBlobSize);
@@ -165,10 +174,9 @@ static inline size_t align4(size_t size) {
 
 size_t BlobCache::getFlattenedSize() const {
     size_t size = sizeof(Header);
-    for (size_t i = 0; i < mCacheEntries.size(); i++) {
-        const CacheEntry& e(mCacheEntries[i]);
-        sp<Blob> keyBlob = e.getKey();
-        sp<Blob> valueBlob = e.getValue();
+    for (const CacheEntry* e = mOldest; e != NULL; e = e->mNewer) {
+        sp<Blob> keyBlob = e->getKey();
+        sp<Blob> valueBlob = e->getValue();
         size = align4(size);
         size += sizeof(EntryHeader) + keyBlob->getSize() +
                 valueBlob->getSize();
@@ -186,15 +194,14 @@ status_t BlobCache::flatten(void* buffer, size_t size) const {
     header->mMagicNumber = blobCacheMagic;
     header->mBlobCacheVersion = blobCacheVersion;
     header->mDeviceVersion = blobCacheDeviceVersion;
-    header->mNumEntries = mCacheEntries.size();
+    header->mNumEntries = mIndex.size();
 
     // Write cache entries
     uint8_t* byteBuffer = reinterpret_cast<uint8_t*>(buffer);
     off_t byteOffset = align4(sizeof(Header));
-    for (size_t i = 0; i < mCacheEntries.size(); i++) {
-        const CacheEntry& e(mCacheEntries[i]);
-        sp<Blob> keyBlob = e.getKey();
-        sp<Blob> valueBlob = e.getValue();
+    for (const CacheEntry* e = mOldest; e != NULL; e = e->mNewer) {
+        sp<Blob> keyBlob = e->getKey();
+        sp<Blob> valueBlob = e->getValue();
         size_t keySize = keyBlob->getSize();
         size_t valueSize = valueBlob->getSize();
 
@@ -219,8 +226,16 @@ status_t BlobCache::flatten(void* buffer, size_t size) const {
 }
 
 status_t BlobCache::unflatten(void const* buffer, size_t size) {
+    return unflatten(buffer, size, NULL);
+}
+
+status_t BlobCache::unflattenMapped(FileMap* map) {
+    return unflatten(map->getDataPtr(), map->getDataLength(), map);
+}
+
+status_t BlobCache::unflatten(void const* buffer, size_t size, FileMap* map) {
     // All errors should result in the BlobCache being in an empty state.
-    mCacheEntries.clear();
+    clear();
 
     // Read the cache header
     if (size < sizeof(Header)) {
@@ -244,7 +259,7 @@ status_t BlobCache::unflatten(void const* buffer, size_t size) {
     size_t numEntries = header->mNumEntries;
     for (size_t i = 0; i < numEntries; i++) {
         if (byteOffset + sizeof(EntryHeader) > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return BAD_VALUE;
         }
@@ -256,13 +271,13 @@ status_t BlobCache::unflatten(void const* buffer, size_t size) {
         size_t entrySize = sizeof(EntryHeader) + keySize + valueSize;
 
         if (byteOffset + entrySize > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return BAD_VALUE;
         }
 
         const uint8_t* data = eheader->mData;
-        set(data, keySize, data + keySize, valueSize);
+        set(data, keySize, data + keySize, valueSize, map);
 
         byteOffset += align4(entrySize);
     }
@@ -270,22 +285,85 @@ status_t BlobCache::unflatten(void const* buffer, size_t size) {
     return OK;
 }
 
-long int BlobCache::blob_random() {
-#ifdef _WIN32
-    return rand();
-#else
-    return nrand48(mRandState);
-#endif
+BlobCache::CacheEntry* BlobCache::findEntry(const void* key, size_t keySize,
+        hash_t hash) const {
+    KeyRef keyRef = { key, keySize };
+    ssize_t index = mIndex.find(-1, hash, keyRef);
+    return index < 0 ? NULL : mIndex.entryAt(index).entry;
+}
+
+void BlobCache::addEntry(CacheEntry* entry) {
+    sp<Blob> keyBlob(entry->getKey());
+    IndexEntry indexEntry = { { keyBlob->getData(), keyBlob->getSize() }, entry };
+    mIndex.add(entry->getHash(), indexEntry);
+
+    entry->mOlder = mNewest;
+    entry->mNewer = NULL;
+    if (mNewest != NULL) {
+        mNewest->mNewer = entry;
+    } else {
+        mOldest = entry;
+    }
+    mNewest = entry;
+}
+
+void BlobCache::removeEntry(CacheEntry* entry) {
+    sp<Blob> keyBlob(entry->getKey());
+    KeyRef keyRef = { keyBlob->getData(), keyBlob->getSize() };
+    ssize_t index = mIndex.find(-1, entry->getHash(), keyRef);
+    LOG_ALWAYS_FATAL_IF(index < 0, "removeEntry: entry missing from the index");
+    mIndex.removeAt(index);
+
+    if (entry->mOlder != NULL) {
+        entry->mOlder->mNewer = entry->mNewer;
+    } else {
+        mOldest = entry->mNewer;
+    }
+    if (entry->mNewer != NULL) {
+        entry->mNewer->mOlder = entry->mOlder;
+    } else {
+        mNewest = entry->mOlder;
+    }
+    mTotalSize -= keyBlob->getSize() + entry->getValue()->getSize();
+    delete entry;
+}
+
+void BlobCache::touchEntry(CacheEntry* entry) {
+    if (entry == mNewest) {
+        return;
+    }
+    // Unlink the entry; it has a newer neighbour since it isn't mNewest.
+    if (entry->mOlder != NULL) {
+        entry->mOlder->mNewer = entry->mNewer;
+    } else {
+        mOldest = entry->mNewer;
+    }
+    entry->mNewer->mOlder = entry->mOlder;
+
+    entry->mOlder = mNewest;
+    entry->mNewer = NULL;
+    mNewest->mNewer = entry;
+    mNewest = entry;
+}
+
+void BlobCache::clear() {
+    mIndex.clear();
+    CacheEntry* entry = mOldest;
+    while (entry != NULL) {
+        CacheEntry* next = entry->mNewer;
+        delete entry;
+        entry = next;
+    }
+    mOldest = NULL;
+    mNewest = NULL;
+    mTotalSize = 0;
 }
 
 void BlobCache::clean() {
-    // Remove a random cache entry until the total cache size gets below half
-    // the maximum total cache size.
-    while (mTotalSize > mMaxTotalSize / 2) {
-        size_t i = size_t(blob_random() % (mCacheEntries.size()));
-        const CacheEntry& entry(mCacheEntries[i]);
-        mTotalSize -= entry.getKey()->getSize() + entry.getValue()->getSize();
-        mCacheEntries.removeAt(i);
+    // Remove the least recently used cache entry until the total cache size
+    // gets below half the maximum total cache size.
+    while (mTotalSize > mMaxTotalSize / 2 && mOldest != NULL) {
+        removeEntry(mOldest);
     }
 }
 
@@ -296,23 +374,26 @@ bool BlobCache::isCleanable() const {
 BlobCache::Blob::Blob(const void* data, size_t size, bool copyData):
         mData(copyData ? malloc(size) : data),
         mSize(size),
-        mOwnsData(copyData) {
+        mOwnsData(copyData),
+        mMap(NULL) {
     if (data != NULL && copyData) {
         memcpy(const_cast<void*>(mData), data, size);
     }
 }
 
+BlobCache::Blob::Blob(const void* data, size_t size, FileMap* map):
+        mData(data),
+        mSize(size),
+        mOwnsData(false),
+        mMap(map->acquire()) {
+}
+
 BlobCache::Blob::~Blob() {
     if (mOwnsData) {
         free(const_cast<void*>(mData));
     }
-}
-
-bool BlobCache::Blob::operator<(const Blob& rhs) const {
-    if (mSize == rhs.mSize) {
-        return memcmp(mData, rhs.mData, mSize) < 0;
-    } else {
-        return mSize < rhs.mSize;
+    if (mMap != NULL) {
+        mMap->release();
     }
 }
 
@@ -324,27 +405,13 @@ size_t BlobCache::Blob::getSize() const {
     return mSize;
 }
 
-BlobCache::CacheEntry::CacheEntry() {
-}
-
-BlobCache::CacheEntry::CacheEntry(const sp<Blob>& key, const sp<Blob>& value):
+BlobCache::CacheEntry::CacheEntry(const sp<Blob>& key, const sp<Blob>& value,
+        hash_t hash):
+        mOlder(NULL),
+        mNewer(NULL),
         mKey(key),
-        mValue(value) {
-}
-
-BlobCache::CacheEntry::CacheEntry(const CacheEntry& ce):
-        mKey(ce.mKey),
-        mValue(ce.mValue) {
-}
-
-bool BlobCache::CacheEntry::operator<(const CacheEntry& rhs) const {
-    return *mKey < *rhs.mKey;
-}
-
-const BlobCache::CacheEntry& BlobCache::CacheEntry::operator=(const CacheEntry& rhs) {
-    mKey = rhs.mKey;
-    mValue = rhs.mValue;
-    return *this;
+        mValue(value),
+        mHash(hash) {
 }
 
 sp<BlobCache::Blob> BlobCache::CacheEntry::getKey() const {
@@ -355,8 +422,16 @@ sp<BlobCache::Blob> BlobCache::CacheEntry::getValue() const {
     return mValue;
 }
 
+hash_t BlobCache::CacheEntry::getHash() const {
+    return mHash;
+}
+
 void BlobCache::CacheEntry::setValue(const sp<Blob>& value) {
     mValue = value;
 }
 
+bool BlobCache::KeyRef::operator==(const KeyRef& rhs) const {
+    return size == rhs.size && memcmp(data, rhs.data, size) == 0;
+}
+
 } // namespace android
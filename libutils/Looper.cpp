@@ -16,10 +16,12 @@
 #include <cutils/log.h>
 #include <utils/Looper.h>
 #include <utils/Timers.h>
+#include <cutils/atomic.h>
 
 #include <unistd.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <sys/eventfd.h>
 
 
 namespace android {
@@ -67,22 +69,13 @@ static pthread_once_t gTLSOnce = PTHREAD_ONCE_INIT;
 static pthread_key_t gTLSKey = 0;
 
 Looper::Looper(bool allowNonCallbacks) :
-        mAllowNonCallbacks(allowNonCallbacks), mSendingMessage(false),
+        mAllowNonCallbacks(allowNonCallbacks), mNextMessageSeq(0), mSendingMessage(false),
         mResponseIndex(0), mNextMessageUptime(LLONG_MAX) {
-    int wakeFds[2];
-    int result = pipe(wakeFds);
-    LOG_ALWAYS_FATAL_IF(result != 0, "Could not create wake pipe.  errno=%d", errno);
+    mWakeEventFd = eventfd(0, EFD_NONBLOCK);
+    LOG_ALWAYS_FATAL_IF(mWakeEventFd < 0, "Could not create wake event fd.  errno=%d", errno);
 
-    mWakeReadPipeFd = wakeFds[0];
-    mWakeWritePipeFd = wakeFds[1];
-
-    result = fcntl(mWakeReadPipeFd, F_SETFL, O_NONBLOCK);
-    LOG_ALWAYS_FATAL_IF(result != 0, "Could not make wake read pipe non-blocking.  errno=%d",
-            errno);
-
-    result = fcntl(mWakeWritePipeFd, F_SETFL, O_NONBLOCK);
-    LOG_ALWAYS_FATAL_IF(result != 0, "Could not make wake write pipe non-blocking.  errno=%d",
-            errno);
+    mWakePending = 0;
+    mPendingMessages = NULL;
 
     mIdling = false;
 
@@ -93,16 +86,22 @@ Looper::Looper(bool allowNonCallbacks) :
     struct epoll_event eventItem;
     memset(& eventItem, 0, sizeof(epoll_event)); // zero out unused members of data field union
     eventItem.events = EPOLLIN;
-    eventItem.data.fd = mWakeReadPipeFd;
-    result = epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeReadPipeFd, & eventItem);
-    LOG_ALWAYS_FATAL_IF(result != 0, "Could not add wake read pipe to epoll instance.  errno=%d",
+    eventItem.data.fd = mWakeEventFd;
+    int result = epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeEventFd, & eventItem);
+    LOG_ALWAYS_FATAL_IF(result != 0, "Could not add wake event fd to epoll instance.  errno=%d",
             errno);
 }
 
 Looper::~Looper() {
-    close(mWakeReadPipeFd);
-    close(mWakeWritePipeFd);
+    close(mWakeEventFd);
     close(mEpollFd);
+
+    PendingMessage* pending = mPendingMessages;
+    while (pending != NULL) {
+        PendingMessage* next = pending->next;
+        delete pending;
+        pending = next;
+    }
 }
 
 void Looper::initTLSKey() {
@@ -255,11 +254,11 @@ int Looper::pollInner(int timeoutMillis) {
     for (int i = 0; i < eventCount; i++) {
         int fd = eventItems[i].data.fd;
         uint32_t epollEvents = eventItems[i].events;
-        if (fd == mWakeReadPipeFd) {
+        if (fd == mWakeEventFd) {
             if (epollEvents & EPOLLIN) {
                 awoken();
             } else {
-                ALOGW("Ignoring unexpected epoll events 0x%x on wake read pipe.", epollEvents);
+                ALOGW("Ignoring unexpected epoll events 0x%x on wake event fd.", epollEvents);
             }
         } else {
             ssize_t requestIndex = mRequests.indexOfKey(fd);
@@ -280,7 +279,12 @@ Done: ;
 
     // Invoke pending message callbacks.
     mNextMessageUptime = LLONG_MAX;
-    while (mMessageEnvelopes.size() != 0) {
+    for (;;) {
+        drainPendingMessagesLocked();
+        if (mMessageEnvelopes.size() == 0) {
+            break;
+        }
+
         nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
         const MessageEnvelope& messageEnvelope = mMessageEnvelopes.itemAt(0);
         if (messageEnvelope.uptime <= now) {
@@ -291,7 +295,7 @@ Done: ;
             { // obtain handler
                 sp<MessageHandler> handler = messageEnvelope.handler;
                 Message message = messageEnvelope.message;
-                mMessageEnvelopes.removeAt(0);
+                removeHeadMessageLocked();
                 mSendingMessage = true;
                 mLock.unlock();
 
@@ -370,12 +374,19 @@ void Looper::wake() {
     ALOGD("%p ~ wake", this);
 #endif
 
+    // Only the first wake since the last awoken() needs to signal the event fd.
+    // Test before the compare-and-swap so that busy producers only share the line.
+    if (mWakePending || android_atomic_acquire_cas(0, 1, &mWakePending) != 0) {
+        return;
+    }
+
+    uint64_t inc = 1;
     ssize_t nWrite;
     do {
-        nWrite = write(mWakeWritePipeFd, "W", 1);
+        nWrite = write(mWakeEventFd, &inc, sizeof(uint64_t));
     } while (nWrite == -1 && errno == EINTR);
 
-    if (nWrite != 1) {
+    if (nWrite != sizeof(uint64_t)) {
         if (errno != EAGAIN) {
             ALOGW("Could not write wake signal, errno=%d", errno);
         }
@@ -387,11 +398,18 @@ void Looper::awoken() {
     ALOGD("%p ~ awoken", this);
 #endif
 
-    char buffer[16];
+    uint64_t counter;
     ssize_t nRead;
     do {
-        nRead = read(mWakeReadPipeFd, buffer, sizeof(buffer));
-    } while ((nRead == -1 && errno == EINTR) || nRead == sizeof(buffer));
+        nRead = read(mWakeEventFd, &counter, sizeof(uint64_t));
+    } while (nRead == -1 && errno == EINTR);
+
+    // Clear the flag only once the signal is consumed. Clearing it first would let
+    // a racing wake() write a signal that the read above swallows, leaving the flag
+    // set with nothing pending, so that every later wake() would be skipped.
+    // A wake() that lands between the read and the clear is not lost: its message
+    // is already queued and gets handled later in this same pollInner() pass.
+    android_atomic_release_store(0, &mWakePending);
 }
 
 void Looper::pushResponse(int events, const Request& request) {
@@ -488,7 +506,21 @@ int Looper::removeFd(int fd) {
 
 void Looper::sendMessage(const sp<MessageHandler>& handler, const Message& message) {
     nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
-    sendMessageAtTime(now, handler, message);
+#if DEBUG_CALLBACKS
+    ALOGD("%p ~ sendMessage - uptime=%lld, handler=%p, what=%d",
+            this, now, handler.get(), message.what);
+#endif
+
+    // Immediate messages skip mLock: they are pushed on mPendingMessages and
+    // moved into the queue by the next drainPendingMessagesLocked().
+    PendingMessage* pending = new PendingMessage(now, handler, message);
+    PendingMessage* head;
+    do {
+        head = mPendingMessages;
+        pending->next = head;
+    } while (!__sync_bool_compare_and_swap(&mPendingMessages, head, pending));
+
+    wake();
 }
 
 void Looper::sendMessageDelayed(nsecs_t uptimeDelay, const sp<MessageHandler>& handler,
@@ -504,17 +536,15 @@ void Looper::sendMessageAtTime(nsecs_t uptime, const sp<MessageHandler>& handler
             this, uptime, handler.get(), message.what);
 #endif
 
-    size_t i = 0;
+    size_t i;
     { // acquire lock
         AutoMutex _l(mLock);
 
-        size_t messageCount = mMessageEnvelopes.size();
-        while (i < messageCount && uptime >= mMessageEnvelopes.itemAt(i).uptime) {
-            i += 1;
-        }
+        // Keep messages sent earlier through sendMessage() ahead of this one.
+        drainPendingMessagesLocked();
 
-        MessageEnvelope messageEnvelope(uptime, handler, message);
-        mMessageEnvelopes.insertAt(messageEnvelope, i, 1);
+        MessageEnvelope messageEnvelope(uptime, mNextMessageSeq++, handler, message);
+        i = enqueueMessageLocked(messageEnvelope);
 
         // Optimization: If the Looper is currently sending a message, then we can skip
         // the call to wake() because the next thing the Looper will do after processing
@@ -538,13 +568,8 @@ void Looper::removeMessages(const sp<MessageHandler>& handler) {
 
     { // acquire lock
         AutoMutex _l(mLock);
-
-        for (size_t i = mMessageEnvelopes.size(); i != 0; ) {
-            const MessageEnvelope& messageEnvelope = mMessageEnvelopes.itemAt(--i);
-            if (messageEnvelope.handler == handler) {
-                mMessageEnvelopes.removeAt(i);
-            }
-        }
+        drainPendingMessagesLocked();
+        removeMessagesLocked(handler, false, 0);
     } // release lock
 }
 
@@ -555,15 +580,120 @@ void Looper::removeMessages(const sp<MessageHandler>& handler, int what) {
 
     { // acquire lock
         AutoMutex _l(mLock);
+        drainPendingMessagesLocked();
+        removeMessagesLocked(handler, true, what);
+    } // release lock
+}
 
-        for (size_t i = mMessageEnvelopes.size(); i != 0; ) {
-            const MessageEnvelope& messageEnvelope = mMessageEnvelopes.itemAt(--i);
-            if (messageEnvelope.handler == handler
-                    && messageEnvelope.message.what == what) {
-                mMessageEnvelopes.removeAt(i);
-            }
+// Returns the heap index the message settled at; 0 means it is now the next one due.
+size_t Looper::enqueueMessageLocked(const MessageEnvelope& messageEnvelope) {
+    return siftUpLocked(mMessageEnvelopes.add(messageEnvelope));
+}
+
+void Looper::drainPendingMessagesLocked() {
+    if (mPendingMessages == NULL) {
+        return;
+    }
+
+    // Detach the whole list; producers only ever push, so there is no ABA hazard.
+    PendingMessage* head;
+    do {
+        head = mPendingMessages;
+    } while (!__sync_bool_compare_and_swap(&mPendingMessages, head, (PendingMessage*) NULL));
+
+    // The list is newest first; reverse it so sequence numbers follow send order.
+    PendingMessage* oldest = NULL;
+    while (head != NULL) {
+        PendingMessage* next = head->next;
+        head->next = oldest;
+        oldest = head;
+        head = next;
+    }
+
+    while (oldest != NULL) {
+        PendingMessage* next = oldest->next;
+        enqueueMessageLocked(MessageEnvelope(oldest->uptime, mNextMessageSeq++,
+                oldest->handler, oldest->message));
+        delete oldest;
+        oldest = next;
+    }
+}
+
+void Looper::removeHeadMessageLocked() {
+    size_t last = mMessageEnvelopes.size() - 1;
+    if (last != 0) {
+        mMessageEnvelopes.editItemAt(0) = mMessageEnvelopes.itemAt(last);
+    }
+    mMessageEnvelopes.removeAt(last);
+    if (last > 1) {
+        siftDownLocked(0);
+    }
+}
+
+void Looper::removeMessagesLocked(const sp<MessageHandler>& handler, bool matchWhat, int what) {
+    // Compact the survivors in a single pass, then restore the heap order in O(n).
+    size_t count = mMessageEnvelopes.size();
+    if (count == 0) {
+        return;
+    }
+
+    MessageEnvelope* envelopes = mMessageEnvelopes.editArray();
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        const MessageEnvelope& messageEnvelope = envelopes[i];
+        if (messageEnvelope.handler == handler
+                && (!matchWhat || messageEnvelope.message.what == what)) {
+            continue;
         }
-    } // release lock
+        if (kept != i) {
+            envelopes[kept] = messageEnvelope;
+        }
+        kept += 1;
+    }
+
+    if (kept == count) {
+        return;
+    }
+    mMessageEnvelopes.removeItemsAt(kept, count - kept);
+    for (size_t i = kept / 2; i != 0; ) {
+        siftDownLocked(--i);
+    }
+}
+
+size_t Looper::siftUpLocked(size_t index) {
+    MessageEnvelope* envelopes = mMessageEnvelopes.editArray();
+    MessageEnvelope messageEnvelope = envelopes[index];
+    while (index != 0) {
+        size_t parent = (index - 1) / 2;
+        if (!messageEnvelope.isBefore(envelopes[parent])) {
+            break;
+        }
+        envelopes[index] = envelopes[parent];
+        index = parent;
+    }
+    envelopes[index] = messageEnvelope;
+    return index;
+}
+
+void Looper::siftDownLocked(size_t index) {
+    MessageEnvelope* envelopes = mMessageEnvelopes.editArray();
+    size_t count = mMessageEnvelopes.size();
+    MessageEnvelope messageEnvelope = envelopes[index];
+    for (;;) {
+        size_t child = index * 2 + 1;
+        if (child >= count) {
+            break;
+        }
+        if (child + 1 < count && envelopes[child + 1].isBefore(envelopes[child])) {
+            child += 1;
+        }
+        if (!envelopes[child].isBefore(messageEnvelope)) {
+            break;
+        }
+        envelopes[index] = envelopes[child];
+        index = child;
+    }
+    envelopes[index] = messageEnvelope;
 }
 
 bool Looper::isIdling() const {
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PoolAllocator"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <utils/Log.h>
+#include <utils/PoolAllocator.h>
+
+namespace android {
+
+// A ThreadCache holds the free blocks a thread can use without locking.  It
+// is created on a thread's first alloc() or free() and returned to the pool
+// when the thread exits.
+class PoolAllocator::ThreadCache {
+public:
+    PoolAllocator* pool;
+    ThreadCache* prev;
+    ThreadCache* next;
+    Block* lists[NUM_SIZE_CLASSES];
+    size_t counts[NUM_SIZE_CLASSES];
+};
+
+static PoolAllocator* gDefaultPool = NULL;
+
+static void initDefaultPool() {
+    gDefaultPool = new PoolAllocator();
+}
+
+#if defined(HAVE_PTHREADS)
+static pthread_once_t gDefaultPoolOnce = PTHREAD_ONCE_INIT;
+#endif
+
+PoolAllocator& PoolAllocator::getDefault() {
+#if defined(HAVE_PTHREADS)
+    pthread_once(&gDefaultPoolOnce, initDefaultPool);
+#else
+    if (gDefaultPool == NULL) {
+        initDefaultPool();
+    }
+#endif
+    return *gDefaultPool;
+}
+
+PoolAllocator::PoolAllocator()
+        : mSlabs(NULL), mSlabCount(0), mThreadCaches(NULL) {
+    memset(mFreeLists, 0, sizeof(mFreeLists));
+    memset(mFreeCounts, 0, sizeof(mFreeCounts));
+#if defined(HAVE_PTHREADS)
+    mHasCacheKey = pthread_key_create(&mCacheKey, threadCacheDestructor) == 0;
+    ALOGW_IF(!mHasCacheKey, "Could not allocate TLS key, thread caches are disabled.");
+#endif
+}
+
+PoolAllocator::~PoolAllocator() {
+#if defined(HAVE_PTHREADS)
+    if (mHasCacheKey) {
+        pthread_key_delete(mCacheKey);
+    }
+#endif
+    while (mThreadCaches != NULL) {
+        ThreadCache* next = mThreadCaches->next;
+        ::free(mThreadCaches);
+        mThreadCaches = next;
+    }
+    while (mSlabs != NULL) {
+        Slab* next = mSlabs->next;
+        ::free(mSlabs);
+        mSlabs = next;
+    }
+}
+
+void* PoolAllocator::alloc(size_t size) {
+    if (size > MAX_POOLED_SIZE) {
+        return malloc(size);
+    }
+    const size_t sizeClass = sizeClassOf(size);
+
+    ThreadCache* cache = getThreadCache();
+    if (cache == NULL) {
+        AutoMutex _l(mLock);
+        if (mFreeLists[sizeClass] == NULL) {
+            refillLocked(sizeClass);
+        }
+        Block* block = mFreeLists[sizeClass];
+        if (block != NULL) {
+            mFreeLists[sizeClass] = block->next;
+            mFreeCounts[sizeClass]--;
+        }
+        return block;
+    }
+
+    if (cache->lists[sizeClass] == NULL) {
+        cache->counts[sizeClass] = takeBatch(sizeClass, &cache->lists[sizeClass]);
+    }
+    Block* block = cache->lists[sizeClass];
+    if (block != NULL) {
+        cache->lists[sizeClass] = block->next;
+        cache->counts[sizeClass]--;
+    }
+    return block;
+}
+
+void PoolAllocator::free(void* ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+    if (size > MAX_POOLED_SIZE) {
+        ::free(ptr);
+        return;
+    }
+    const size_t sizeClass = sizeClassOf(size);
+    Block* block = static_cast<Block*>(ptr);
+
+    ThreadCache* cache = getThreadCache();
+    if (cache == NULL) {
+        giveBatch(sizeClass, block, block, 1);
+        return;
+    }
+
+    block->next = cache->lists[sizeClass];
+    cache->lists[sizeClass] = block;
+    if (++cache->counts[sizeClass] >= 2 * BATCH_SIZE) {
+        // Keep the most recently freed half, which is likely still in the
+        // CPU cache, and hand the rest back.
+        Block* tail = block;
+        for (size_t i = 1; i < BATCH_SIZE; i++) {
+            tail = tail->next;
+        }
+        Block* rest = tail->next;
+        giveBatch(sizeClass, rest, NULL, cache->counts[sizeClass] - BATCH_SIZE);
+        tail->next = NULL;
+        cache->counts[sizeClass] = BATCH_SIZE;
+    }
+}
+
+PoolAllocator::ThreadCache* PoolAllocator::getThreadCache() {
+#if defined(HAVE_PTHREADS)
+    if (!mHasCacheKey) {
+        return NULL;
+    }
+    ThreadCache* cache = static_cast<ThreadCache*>(pthread_getspecific(mCacheKey));
+    if (cache == NULL) {
+        cache = static_cast<ThreadCache*>(calloc(1, sizeof(ThreadCache)));
+        if (cache == NULL) {
+            return NULL;
+        }
+        if (pthread_setspecific(mCacheKey, cache) != 0) {
+            ::free(cache);
+            return NULL;
+        }
+        cache->pool = this;
+
+        AutoMutex _l(mLock);
+        cache->next = mThreadCaches;
+        if (mThreadCaches != NULL) {
+            mThreadCaches->prev = cache;
+        }
+        mThreadCaches = cache;
+    }
+    return cache;
+#else
+    return NULL;
+#endif
+}
+
+void PoolAllocator::refillLocked(size_t sizeClass) {
+    Slab* slab = static_cast<Slab*>(malloc(SLAB_SIZE));
+    if (slab == NULL) {
+        ALOGE("Could not allocate a %d byte slab", SLAB_SIZE);
+        return;
+    }
+    slab->next = mSlabs;
+    mSlabs = slab;
+    mSlabCount++;
+
+    // Blocks start one step in so that the slab header doesn't upset their
+    // alignment, and are pushed in reverse so they are handed out in address
+    // order.
+    const size_t blockSize = (sizeClass + 1) * SIZE_CLASS_STEP;
+    uint8_t* const first = reinterpret_cast<uint8_t*>(slab) + SIZE_CLASS_STEP;
+    const size_t count = (SLAB_SIZE - SIZE_CLASS_STEP) / blockSize;
+    for (size_t i = count; i > 0; i--) {
+        Block* block = reinterpret_cast<Block*>(first + (i - 1) * blockSize);
+        block->next = mFreeLists[sizeClass];
+        mFreeLists[sizeClass] = block;
+    }
+    mFreeCounts[sizeClass] += count;
+}
+
+size_t PoolAllocator::takeBatch(size_t sizeClass, Block** outHead) {
+    AutoMutex _l(mLock);
+    if (mFreeLists[sizeClass] == NULL) {
+        refillLocked(sizeClass);
+    }
+    Block* head = mFreeLists[sizeClass];
+    if (head == NULL) {
+        *outHead = NULL;
+        return 0;
+    }
+    Block* tail = head;
+    size_t count = 1;
+    while (count < BATCH_SIZE && tail->next != NULL) {
+        tail = tail->next;
+        count++;
+    }
+    mFreeLists[sizeClass] = tail->next;
+    mFreeCounts[sizeClass] -= count;
+    tail->next = NULL;
+    *outHead = head;
+    return count;
+}
+
+void PoolAllocator::giveBatch(size_t sizeClass, Block* head, Block* tail, size_t count) {
+    if (tail == NULL) {
+        for (tail = head; tail->next != NULL; tail = tail->next) {
+        }
+    }
+    AutoMutex _l(mLock);
+    tail->next = mFreeLists[sizeClass];
+    mFreeLists[sizeClass] = head;
+    mFreeCounts[sizeClass] += count;
+}
+
+void PoolAllocator::releaseThreadCache(ThreadCache* cache) {
+    for (size_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+        if (cache->lists[i] != NULL) {
+            giveBatch(i, cache->lists[i], NULL, cache->counts[i]);
+        }
+    }
+
+    AutoMutex _l(mLock);
+    if (cache->prev != NULL) {
+        cache->prev->next = cache->next;
+    } else {
+        mThreadCaches = cache->next;
+    }
+    if (cache->next != NULL) {
+        cache->next->prev = cache->prev;
+    }
+    ::free(cache);
+}
+
+#if defined(HAVE_PTHREADS)
+void PoolAllocator::threadCacheDestructor(void* cache) {
+    ThreadCache* threadCache = static_cast<ThreadCache*>(cache);
+    threadCache->pool->releaseThreadCache(threadCache);
+}
+#endif
+
+void PoolAllocator::dumpMemoryStats(const char* prefix) {
+    AutoMutex _l(mLock);
+    ALOGD("%sSlabs %zu (%zu kb)", prefix, mSlabCount, mSlabCount * SLAB_SIZE / 1024);
+    for (size_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+        if (mFreeCounts[i]) {
+            ALOGD("%s  %zu byte blocks: %zu free in the shared pool", prefix,
+                    (i + 1) * SIZE_CLASS_STEP, mFreeCounts[i]);
+        }
+    }
+}
+
+}; // namespace android
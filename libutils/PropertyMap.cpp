@@ -16,8 +16,12 @@
 
 #define LOG_TAG "PropertyMap"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <utils/PropertyMap.h>
 #include <utils/Log.h>
@@ -37,31 +41,111 @@ static const char* WHITESPACE_OR_PROPERTY_DELIMITER = " \t\r=";
 
 // --- PropertyMap ---
 
-PropertyMap::PropertyMap() {
+PropertyMap::PropertyMap() :
+        mBinaryMap(NULL), mBinaryEntries(NULL), mBinaryCount(0), mMergedProperties(NULL) {
+}
+
+PropertyMap::PropertyMap(const PropertyMap& other) :
+        mProperties(other.mProperties), mBinaryMap(other.mBinaryMap),
+        mBinaryEntries(other.mBinaryEntries), mBinaryCount(other.mBinaryCount),
+        mMergedProperties(NULL) {
+    // Copies share the mapping of a binary file, each holding a reference.
+    if (mBinaryMap) {
+        mBinaryMap->acquire();
+    }
+}
+
+PropertyMap& PropertyMap::operator=(const PropertyMap& other) {
+    if (this != &other) {
+        if (other.mBinaryMap) {
+            other.mBinaryMap->acquire();
+        }
+        clear();
+        mProperties = other.mProperties;
+        mBinaryMap = other.mBinaryMap;
+        mBinaryEntries = other.mBinaryEntries;
+        mBinaryCount = other.mBinaryCount;
+    }
+    return *this;
 }
 
 PropertyMap::~PropertyMap() {
+    if (mBinaryMap) {
+        mBinaryMap->release();
+    }
+    delete mMergedProperties;
+}
+
+void PropertyMap::clearMergedProperties() {
+    delete mMergedProperties;
+    mMergedProperties = NULL;
 }
 
 void PropertyMap::clear() {
     mProperties.clear();
+    clearMergedProperties();
+    if (mBinaryMap) {
+        mBinaryMap->release();
+        mBinaryMap = NULL;
+        mBinaryEntries = NULL;
+        mBinaryCount = 0;
+    }
 }
 
 void PropertyMap::addProperty(const String8& key, const String8& value) {
     mProperties.add(key, value);
+    if (mMergedProperties) {
+        mMergedProperties->add(key, value);
+    }
 }
 
 bool PropertyMap::hasProperty(const String8& key) const {
-    return mProperties.indexOfKey(key) >= 0;
+    return mProperties.indexOfKey(key) >= 0 || findBinaryEntry(key.string()) != NULL;
 }
 
-bool PropertyMap::tryGetProperty(const String8& key, String8& outValue) const {
+const PropertyMap::BinaryEntry* PropertyMap::findBinaryEntry(const char* key) const {
+    const char* base = static_cast<const char*>(mBinaryMap ? mBinaryMap->getDataPtr() : NULL);
+    size_t low = 0;
+    size_t high = mBinaryCount;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        int cmp = strcmp(key, base + mBinaryEntries[mid].keyOffset);
+        if (cmp == 0) {
+            return &mBinaryEntries[mid];
+        }
+        if (cmp < 0) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+const char* PropertyMap::findValue(const String8& key, size_t* outLength) const {
     ssize_t index = mProperties.indexOfKey(key);
-    if (index < 0) {
+    if (index >= 0) {
+        const String8& value = mProperties.valueAt(index);
+        *outLength = value.length();
+        return value.string();
+    }
+
+    const BinaryEntry* entry = findBinaryEntry(key.string());
+    if (entry) {
+        *outLength = entry->valueLength;
+        return static_cast<const char*>(mBinaryMap->getDataPtr()) + entry->valueOffset;
+    }
+    return NULL;
+}
+
+bool PropertyMap::tryGetProperty(const String8& key, String8& outValue) const {
+    size_t length;
+    const char* value = findValue(key, &length);
+    if (!value) {
         return false;
     }
 
-    outValue = mProperties.valueAt(index);
+    outValue.setTo(value, length);
     return true;
 }
 
@@ -76,16 +160,19 @@ bool PropertyMap::tryGetProperty(const String8& key, bool& outValue) const {
 }
 
 bool PropertyMap::tryGetProperty(const String8& key, int32_t& outValue) const {
-    String8 stringValue;
-    if (! tryGetProperty(key, stringValue) || stringValue.length() == 0) {
+    // Values are null-terminated both in mProperties and in binary files, so
+    // they can be parsed in place.
+    size_t length;
+    const char* stringValue = findValue(key, &length);
+    if (!stringValue || length == 0) {
         return false;
     }
 
     char* end;
-    int value = strtol(stringValue.string(), & end, 10);
+    int value = strtol(stringValue, & end, 10);
     if (*end != '\0') {
         ALOGW("Property key '%s' has invalid value '%s'.  Expected an integer.",
-                key.string(), stringValue.string());
+                key.string(), stringValue);
         return false;
     }
     outValue = value;
@@ -93,16 +180,17 @@ bool PropertyMap::tryGetProperty(const String8& key, int32_t& outValue) const {
 }
 
 bool PropertyMap::tryGetProperty(const String8& key, float& outValue) const {
-    String8 stringValue;
-    if (! tryGetProperty(key, stringValue) || stringValue.length() == 0) {
+    size_t length;
+    const char* stringValue = findValue(key, &length);
+    if (!stringValue || length == 0) {
         return false;
     }
 
     char* end;
-    float value = strtof(stringValue.string(), & end);
+    float value = strtof(stringValue, & end);
     if (*end != '\0') {
         ALOGW("Property key '%s' has invalid value '%s'.  Expected a float.",
-                key.string(), stringValue.string());
+                key.string(), stringValue);
         return false;
     }
     outValue = value;
@@ -110,9 +198,186 @@ bool PropertyMap::tryGetProperty(const String8& key, float& outValue) const {
 }
 
 void PropertyMap::addAll(const PropertyMap* map) {
-    for (size_t i = 0; i < map->mProperties.size(); i++) {
-        mProperties.add(map->mProperties.keyAt(i), map->mProperties.valueAt(i));
+    const KeyedVector<String8, String8>& properties = map->getProperties();
+    for (size_t i = 0; i < properties.size(); i++) {
+        addProperty(properties.keyAt(i), properties.valueAt(i));
+    }
+}
+
+const KeyedVector<String8, String8>& PropertyMap::getProperties() const {
+    if (!mBinaryMap) {
+        return mProperties;
+    }
+
+    // The mapping itself is never modified here, so lookups may run concurrently.
+    AutoMutex _l(mMergedLock);
+    if (!mMergedProperties) {
+        KeyedVector<String8, String8>* merged = new KeyedVector<String8, String8>(mProperties);
+        const char* base = static_cast<const char*>(mBinaryMap->getDataPtr());
+        merged->setCapacity(mProperties.size() + mBinaryCount);
+        for (size_t i = 0; i < mBinaryCount; i++) {
+            const BinaryEntry& entry = mBinaryEntries[i];
+            String8 key(base + entry.keyOffset, entry.keyLength);
+            if (mProperties.indexOfKey(key) < 0) {
+                merged->add(key, String8(base + entry.valueOffset, entry.valueLength));
+            }
+        }
+        mMergedProperties = merged;
+    }
+    return *mMergedProperties;
+}
+
+// Checks that every entry of a binary file lies within the file, that keys and
+// values are null-terminated and that the keys are sorted.
+status_t PropertyMap::setBinary(FileMap* map) {
+    const char* base = static_cast<const char*>(map->getDataPtr());
+    size_t size = map->getDataLength();
+    const BinaryHeader* header = reinterpret_cast<const BinaryHeader*>(base);
+
+    if (size < sizeof(BinaryHeader) || header->magic != BINARY_MAGIC
+            || header->version != BINARY_VERSION
+            || header->count > (size - sizeof(BinaryHeader)) / sizeof(BinaryEntry)) {
+        return BAD_VALUE;
+    }
+
+    const BinaryEntry* entries = reinterpret_cast<const BinaryEntry*>(header + 1);
+    for (size_t i = 0; i < header->count; i++) {
+        const BinaryEntry& entry = entries[i];
+        if (entry.keyOffset >= size || entry.keyLength >= size - entry.keyOffset
+                || base[entry.keyOffset + entry.keyLength] != '\0'
+                || entry.valueOffset >= size || entry.valueLength >= size - entry.valueOffset
+                || base[entry.valueOffset + entry.valueLength] != '\0'
+                || strlen(base + entry.keyOffset) != entry.keyLength
+                || (i > 0 && strcmp(base + entries[i - 1].keyOffset,
+                        base + entry.keyOffset) >= 0)) {
+            return BAD_VALUE;
+        }
+    }
+
+    clear();
+    mBinaryMap = map;
+    mBinaryEntries = entries;
+    mBinaryCount = header->count;
+    return NO_ERROR;
+}
+
+status_t PropertyMap::writeBinary(const String8& filename) const {
+    const KeyedVector<String8, String8>& properties = getProperties();
+    const size_t count = properties.size();
+
+    // KeyedVector keeps the keys sorted by strcmp order already.
+    size_t offset = sizeof(BinaryHeader) + count * sizeof(BinaryEntry);
+    BinaryEntry* entries = new BinaryEntry[count];
+    for (size_t i = 0; i < count; i++) {
+        entries[i].keyOffset = offset;
+        entries[i].keyLength = properties.keyAt(i).length();
+        offset += entries[i].keyLength + 1;
+        entries[i].valueOffset = offset;
+        entries[i].valueLength = properties.valueAt(i).length();
+        offset += entries[i].valueLength + 1;
+    }
+
+    char* buffer = static_cast<char*>(malloc(offset));
+    if (!buffer) {
+        delete[] entries;
+        return NO_MEMORY;
+    }
+    BinaryHeader header = { BINARY_MAGIC, BINARY_VERSION, uint32_t(count) };
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), entries, count * sizeof(BinaryEntry));
+    for (size_t i = 0; i < count; i++) {
+        memcpy(buffer + entries[i].keyOffset, properties.keyAt(i).string(),
+                entries[i].keyLength + 1);
+        memcpy(buffer + entries[i].valueOffset, properties.valueAt(i).string(),
+                entries[i].valueLength + 1);
+    }
+    delete[] entries;
+
+    // Write to a temporary file next to the target and rename it over the
+    // target, so that a reader never maps a partly written file.
+    String8 tempName(filename);
+    tempName.append(".XXXXXX");
+    char* tempPath = tempName.lockBuffer(tempName.length());
+    int fd = mkstemp(tempPath);
+    tempName.unlockBuffer();
+
+    status_t result = NO_ERROR;
+    if (fd < 0) {
+        result = -errno;
+        ALOGE("Error creating property file '%s', %s.", tempName.string(), strerror(errno));
+        free(buffer);
+        return result;
+    }
+
+    for (size_t written = 0; written < offset; ) {
+        ssize_t n = TEMP_FAILURE_RETRY(write(fd, buffer + written, offset - written));
+        if (n <= 0) {
+            result = n < 0 ? -errno : UNKNOWN_ERROR;
+            break;
+        }
+        written += n;
+    }
+    if (!result && (fchmod(fd, 0644) || fsync(fd))) {
+        result = -errno;
+    }
+    if (close(fd) && !result) {
+        result = -errno;
+    }
+    if (!result && rename(tempName.string(), filename.string())) {
+        result = -errno;
+    }
+    if (result) {
+        ALOGE("Error writing property file '%s', %s.", filename.string(), strerror(-result));
+        unlink(tempName.string());
     }
+    free(buffer);
+    return result;
+}
+
+status_t PropertyMap::loadBinary(const String8& filename, PropertyMap** outMap) {
+    *outMap = NULL;
+
+    int fd = ::open(filename.string(), O_RDONLY);
+    if (fd < 0) {
+        status_t status = -errno;
+        ALOGE("Error opening binary property file %s, %s.", filename.string(),
+                strerror(errno));
+        return status;
+    }
+
+    status_t status = NO_ERROR;
+    struct stat stat;
+    if (fstat(fd, &stat)) {
+        status = -errno;
+    } else if (size_t(stat.st_size) < sizeof(BinaryHeader)) {
+        status = BAD_VALUE;
+    }
+
+    FileMap* binaryMap = NULL;
+    if (!status) {
+        binaryMap = new FileMap();
+        if (!binaryMap->create(NULL, fd, 0, size_t(stat.st_size), true)) {
+            binaryMap->release();
+            binaryMap = NULL;
+            status = UNKNOWN_ERROR;
+        }
+    }
+    close(fd);
+
+    if (!status) {
+        PropertyMap* map = new PropertyMap();
+        status = map->setBinary(binaryMap);
+        if (status) {
+            binaryMap->release();
+            delete map;
+        } else {
+            *outMap = map;
+        }
+    }
+    if (status) {
+        ALOGE("Error %d loading binary property file %s.", status, filename.string());
+    }
+    return status;
 }
 
 status_t PropertyMap::load(const String8& filename, PropertyMap** outMap) {
@@ -170,8 +435,10 @@ status_t PropertyMap::Parser::parse() {
         mTokenizer->skipDelimiters(WHITESPACE);
 
         if (!mTokenizer->isEol() && mTokenizer->peekChar() != '#') {
-            String8 keyToken = mTokenizer->nextToken(WHITESPACE_OR_PROPERTY_DELIMITER);
-            if (keyToken.isEmpty()) {
+            size_t keyLength;
+            const char* keyChars = mTokenizer->nextTokenView(WHITESPACE_OR_PROPERTY_DELIMITER,
+                    &keyLength);
+            if (keyLength == 0) {
                 ALOGE("%s: Expected non-empty property key.", mTokenizer->getLocation().string());
                 return BAD_VALUE;
             }
@@ -186,8 +453,9 @@ status_t PropertyMap::Parser::parse() {
 
             mTokenizer->skipDelimiters(WHITESPACE);
 
-            String8 valueToken = mTokenizer->nextToken(WHITESPACE);
-            if (valueToken.find("\\", 0) >= 0 || valueToken.find("\"", 0) >= 0) {
+            size_t valueLength;
+            const char* valueChars = mTokenizer->nextTokenView(WHITESPACE, &valueLength);
+            if (memchr(valueChars, '\\', valueLength) || memchr(valueChars, '"', valueLength)) {
                 ALOGE("%s: Found reserved character '\\' or '\"' in property value.",
                         mTokenizer->getLocation().string());
                 return BAD_VALUE;
@@ -201,13 +469,14 @@ status_t PropertyMap::Parser::parse() {
                 return BAD_VALUE;
             }
 
+            String8 keyToken(keyChars, keyLength);
             if (mMap->hasProperty(keyToken)) {
                 ALOGE("%s: Duplicate property value for key '%s'.",
                         mTokenizer->getLocation().string(), keyToken.string());
                 return BAD_VALUE;
             }
 
-            mMap->addProperty(keyToken, valueToken);
+            mMap->addProperty(keyToken, String8(valueChars, valueLength));
         }
 
         mTokenizer->nextLine();
@@ -0,0 +1,422 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "SamplingProfiler"
+// #define LOG_NDEBUG 0
+
+#include <utils/SamplingProfiler.h>
+#include <utils/AndroidThreads.h>
+#include <utils/Log.h>
+#include <utils/Printer.h>
+#include <utils/Thread.h>
+#include <utils/Timers.h>
+
+#include <cutils/atomic.h>
+#include <corkscrew/demangle.h>
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace android {
+
+enum {
+    // How often the drain thread empties the ring.
+    DRAIN_INTERVAL_MS = 50,
+    MAX_PROC_PATH = 1024,
+};
+
+// The profiler the signal handler records into while gProfilerActive is set,
+// and the number of handlers that may be using it.  stop() waits for the
+// latter to drop to zero after clearing gProfilerActive.
+static SamplingProfiler* gActiveProfiler = NULL;
+static volatile int32_t gProfilerActive = 0;
+static volatile int32_t gHandlersRunning = 0;
+// Once installed, the handler stays installed so that a SIGPROF still pending
+// when a profiler stops doesn't kill the process.
+static bool gHandlerInstalled = false;
+static Mutex gActiveProfilerLock;
+
+class SamplingProfiler::DrainThread : public Thread {
+public:
+    DrainThread(const SamplingProfiler* profiler) :
+            Thread(false), mProfiler(profiler) {
+    }
+
+    void requestExitAndWake() {
+        AutoMutex _l(mLock);
+        requestExit();
+        mCondition.signal();
+    }
+
+private:
+    virtual bool threadLoop() {
+        {
+            AutoMutex _l(mProfiler->mLock);
+            mProfiler->drainLocked();
+        }
+        AutoMutex _l(mLock);
+        if (!exitPending()) {
+            mCondition.waitRelative(mLock, milliseconds_to_nanoseconds(DRAIN_INTERVAL_MS));
+        }
+        return true;
+    }
+
+    const SamplingProfiler* mProfiler;
+    Mutex mLock;
+    Condition mCondition;
+};
+
+static String8 getThreadName(pid_t tid) {
+    char path[MAX_PROC_PATH];
+    char name[MAX_PROC_PATH];
+    FILE* fp;
+
+    snprintf(path, sizeof(path), "/proc/self/task/%d/comm", tid);
+    if ((fp = fopen(path, "r")) && fgets(name, sizeof(name), fp)) {
+        strtok(name, "\n");
+    } else {
+        strcpy(name, "<unknown>");
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    snprintf(path, sizeof(path), "%s-%d", name, tid);
+    return String8(path);
+}
+
+SamplingProfiler::SamplingProfiler() :
+        mRing(NULL), mHead(0), mTail(0), mDropped(0), mMapInfoList(NULL),
+        mStacks(0), mSampleCount(0) {
+}
+
+SamplingProfiler::~SamplingProfiler() {
+    stop();
+    delete[] mRing;
+    for (size_t i = 0; i < mSymbolTables.size(); i++) {
+        if (mSymbolTables.valueAt(i)) {
+            free_symbol_table(mSymbolTables.valueAt(i));
+        }
+    }
+}
+
+status_t SamplingProfiler::start(int frequency) {
+    if (frequency <= 0 || frequency > 1000000) {
+        return BAD_VALUE;
+    }
+
+    AutoMutex _active(gActiveProfilerLock);
+    if (gProfilerActive) {
+        ALOGE("%s: another profiler is already running", __FUNCTION__);
+        return INVALID_OPERATION;
+    }
+
+    if (mRing == NULL) {
+        mRing = new Sample[RING_SIZE];
+        memset(mRing, 0, RING_SIZE * sizeof(Sample));
+    }
+    // The handler can't load the maps itself; libraries loaded after this
+    // point show up as unknown frames until the profiler is restarted.
+    mMapInfoList = acquire_my_map_info_list();
+
+    mDrainThread = new DrainThread(this);
+    status_t status = mDrainThread->run("SamplingProfiler");
+    if (status != NO_ERROR) {
+        mDrainThread.clear();
+        release_my_map_info_list(mMapInfoList);
+        mMapInfoList = NULL;
+        return status;
+    }
+
+    gActiveProfiler = this;
+    android_atomic_release_store(1, &gProfilerActive);
+
+    if (!gHandlerInstalled) {
+        struct sigaction act;
+        memset(&act, 0, sizeof(act));
+        act.sa_sigaction = signalHandler;
+        act.sa_flags = SA_RESTART | SA_SIGINFO | SA_ONSTACK;
+        sigemptyset(&act.sa_mask);
+        if (sigaction(SIGPROF, &act, NULL)) {
+            status = -errno;
+        } else {
+            gHandlerInstalled = true;
+        }
+    }
+    if (status == NO_ERROR) {
+        struct itimerval timer;
+        timer.it_interval.tv_sec = 0;
+        timer.it_interval.tv_usec = 1000000 / frequency;
+        timer.it_value = timer.it_interval;
+        if (setitimer(ITIMER_PROF, &timer, NULL)) {
+            status = -errno;
+        }
+    }
+    if (status != NO_ERROR) {
+        ALOGE("%s: failed to start the profiling timer (%s)", __FUNCTION__, strerror(-status));
+        android_atomic_and(0, &gProfilerActive);
+        mDrainThread->requestExitAndWake();
+        mDrainThread->join();
+        mDrainThread.clear();
+        release_my_map_info_list(mMapInfoList);
+        mMapInfoList = NULL;
+    }
+    return status;
+}
+
+void SamplingProfiler::stop() {
+    AutoMutex _active(gActiveProfilerLock);
+    if (!gProfilerActive || gActiveProfiler != this) {
+        return;
+    }
+
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+
+    // Handlers that are already running may still be recording.  The
+    // read-modify-write orders clearing the flag before the check below.
+    android_atomic_and(0, &gProfilerActive);
+    while (android_atomic_acquire_load(&gHandlersRunning)) {
+        usleep(1000);
+    }
+
+    mDrainThread->requestExitAndWake();
+    mDrainThread->join();
+    mDrainThread.clear();
+
+    AutoMutex _l(mLock);
+    drainLocked();
+    release_my_map_info_list(mMapInfoList);
+    mMapInfoList = NULL;
+}
+
+bool SamplingProfiler::isRunning() const {
+    AutoMutex _active(gActiveProfilerLock);
+    return gProfilerActive && gActiveProfiler == this;
+}
+
+void SamplingProfiler::clear() {
+    AutoMutex _l(mLock);
+    drainLocked();
+    mStacks.clear();
+    mSampleCount = 0;
+    android_atomic_release_store(0, &mDropped);
+}
+
+size_t SamplingProfiler::getSampleCount() const {
+    AutoMutex _l(mLock);
+    drainLocked();
+    return mSampleCount;
+}
+
+size_t SamplingProfiler::getDroppedCount() const {
+    return android_atomic_acquire_load(&mDropped);
+}
+
+void SamplingProfiler::getStacks(Vector<Stack>* outStacks, Vector<uint32_t>* outCounts) const {
+    AutoMutex _l(mLock);
+    drainLocked();
+
+    outStacks->clear();
+    outCounts->clear();
+    for (ssize_t i = mStacks.next(-1); i >= 0; i = mStacks.next(i)) {
+        outStacks->add(mStacks.keyAt(i));
+        outCounts->add(mStacks.valueAt(i));
+    }
+}
+
+void SamplingProfiler::signalHandler(int, siginfo_t* info, void* context) {
+    int savedErrno = errno;
+    android_atomic_inc(&gHandlersRunning);
+    if (android_atomic_acquire_load(&gProfilerActive)) {
+        gActiveProfiler->record(info, context);
+    }
+    android_atomic_dec(&gHandlersRunning);
+    errno = savedErrno;
+}
+
+void SamplingProfiler::record(siginfo_t* info, void* context) {
+    backtrace_frame_t frames[MAX_DEPTH];
+    ssize_t count = unwind_backtrace_signal(info, context, mMapInfoList, frames, 0, MAX_DEPTH);
+    if (count <= 0) {
+        android_atomic_inc(&mDropped);
+        return;
+    }
+
+    // Several threads can be sampled at once, so claim a slot first.  The
+    // slot at mHead is free as long as the ring isn't full.
+    int32_t head;
+    do {
+        head = android_atomic_acquire_load(&mHead);
+        if (uint32_t(head - android_atomic_acquire_load(&mTail)) >= RING_SIZE) {
+            android_atomic_inc(&mDropped);
+            return;
+        }
+    } while (android_atomic_release_cas(head, head + 1, &mHead));
+
+    Sample& sample = mRing[head & (RING_SIZE - 1)];
+    sample.stack.tid = androidGetTid();
+    sample.stack.depth = count;
+    for (ssize_t i = 0; i < count; i++) {
+        sample.stack.pcs[i] = frames[i].absolute_pc;
+    }
+    android_atomic_release_store(1, &sample.ready);
+}
+
+void SamplingProfiler::drainLocked() const {
+    if (mRing == NULL) {
+        return;
+    }
+    int32_t tail = mTail;
+    int32_t head = android_atomic_acquire_load(&mHead);
+    while (tail != head) {
+        Sample& sample = mRing[tail & (RING_SIZE - 1)];
+        // The slot may be claimed but not written yet.
+        if (!android_atomic_acquire_load(&sample.ready)) {
+            break;
+        }
+        ssize_t index = mStacks.indexOfKey(sample.stack);
+        if (index >= 0) {
+            mStacks.editValueAt(index)++;
+        } else {
+            mStacks.add(sample.stack, 1);
+        }
+        mSampleCount++;
+        sample.ready = 0;
+        tail++;
+        android_atomic_release_store(tail, &mTail);
+    }
+}
+
+symbol_table_t* SamplingProfiler::symbolTableLocked(const char* mapName) const {
+    String8 name(mapName);
+    ssize_t index = mSymbolTables.indexOfKey(name);
+    if (index >= 0) {
+        return mSymbolTables.valueAt(index);
+    }
+    // Remember failures too, so that each library is only read once.
+    symbol_table_t* table = load_symbol_table(mapName);
+    mSymbolTables.add(name, table);
+    return table;
+}
+
+String8 SamplingProfiler::frameNameLocked(const map_info_t* milist, uintptr_t pc) const {
+    ssize_t index = mFrameNames.indexOfKey(pc);
+    if (index >= 0) {
+        return mFrameNames.valueAt(index);
+    }
+
+    String8 name;
+    char buf[MAX_PROC_PATH];
+    const char* symbolName = NULL;
+    char* demangled = NULL;
+    Dl_info info;
+
+    const map_info_t* mi = find_map_info(milist, pc);
+    if (mi && mi->name[0]) {
+        symbol_table_t* table = symbolTableLocked(mi->name);
+        const symbol_t* symbol = table ? find_symbol(table, pc - mi->start) : NULL;
+        if (symbol) {
+            symbolName = symbol->name;
+        }
+    }
+    if (!symbolName && dladdr(reinterpret_cast<const void*>(pc), &info) && info.dli_sname) {
+        symbolName = info.dli_sname;
+    }
+
+    if (symbolName) {
+        demangled = demangle_symbol_name(symbolName);
+        name.setTo(demangled ? demangled : symbolName);
+        free(demangled);
+    } else if (mi && mi->name[0]) {
+        const char* base = strrchr(mi->name, '/');
+        snprintf(buf, sizeof(buf), "%s+0x%x", base ? base + 1 : mi->name,
+                unsigned(pc - mi->start));
+        name.setTo(buf);
+    } else {
+        snprintf(buf, sizeof(buf), "0x%08x", unsigned(pc));
+        name.setTo(buf);
+    }
+
+    mFrameNames.add(pc, name);
+    return name;
+}
+
+void SamplingProfiler::log(const char* logtag, android_LogPriority priority,
+        const char* prefix) const {
+    LogPrinter printer(logtag, priority, prefix, /*ignoreBlankLines*/false);
+    print(printer);
+}
+
+void SamplingProfiler::dump(int fd, int indent, const char* prefix) const {
+    FdPrinter printer(fd, indent, prefix);
+    print(printer);
+}
+
+String8 SamplingProfiler::toString(const char* prefix) const {
+    String8 str;
+
+    String8Printer printer(&str, prefix);
+    print(printer);
+
+    return str;
+}
+
+void SamplingProfiler::print(Printer& printer) const {
+    AutoMutex _l(mLock);
+    drainLocked();
+
+    map_info_t* milist = acquire_my_map_info_list();
+    KeyedVector<pid_t, String8> threadNames;
+    // Stacks that differ only in PCs within the same functions fold into one
+    // line; keying the lines also sorts the report.
+    KeyedVector<String8, uint32_t> lines;
+
+    for (ssize_t i = mStacks.next(-1); i >= 0; i = mStacks.next(i)) {
+        const Stack& stack = mStacks.keyAt(i);
+
+        ssize_t nameIndex = threadNames.indexOfKey(stack.tid);
+        if (nameIndex < 0) {
+            nameIndex = threadNames.add(stack.tid, getThreadName(stack.tid));
+        }
+        String8 line(threadNames.valueAt(nameIndex));
+
+        // Folded stacks list the outermost frame first.
+        for (size_t j = stack.depth; j-- > 0; ) {
+            line.append(";");
+            line.append(frameNameLocked(milist, stack.pcs[j]));
+        }
+
+        ssize_t lineIndex = lines.indexOfKey(line);
+        if (lineIndex >= 0) {
+            lines.editValueAt(lineIndex) += mStacks.valueAt(i);
+        } else {
+            lines.add(line, mStacks.valueAt(i));
+        }
+    }
+
+    for (size_t i = 0; i < lines.size(); i++) {
+        printer.printFormatLine("%s %u", lines.keyAt(i).string(), lines.valueAt(i));
+    }
+
+    release_my_map_info_list(milist);
+}
+
+}; // namespace android
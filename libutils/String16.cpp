@@ -93,6 +93,11 @@ String16::String16()
 {
 }
 
+const char16_t* String16::emptyString()
+{
+    return getEmptyString();
+}
+
 String16::String16(StaticLinkage)
     : mString(0)
 {
@@ -142,6 +142,11 @@ String8::String8()
 {
 }
 
+const char* String8::emptyString()
+{
+    return getEmptyString();
+}
+
 String8::String8(StaticLinkage)
     : mString(0)
 {
@@ -239,17 +244,30 @@ void String8::setTo(const String8& other)
 
 status_t String8::setTo(const char* other)
 {
-    const char *newString = allocFromUTF8(other, strlen(other));
-    SharedBuffer::bufferFromData(mString)->release();
-    mString = newString;
-    if (mString) return NO_ERROR;
-
-    mString = getEmptyString();
-    return NO_MEMORY;
+    return setTo(other, strlen(other));
 }
 
 status_t String8::setTo(const char* other, size_t len)
 {
+    // If nobody else references our buffer, overwrite it rather than
+    // allocating a new one; strings that are reassigned over and over then
+    // settle into a buffer of the right size.
+    const SharedBuffer* cur = SharedBuffer::bufferFromData(mString);
+    if (len > 0 && cur->onlyOwner()
+            && (other >= mString + cur->size() || other + len <= mString)) {
+        SharedBuffer* buf = cur->editResize(len+1);
+        if (buf) {
+            char* str = (char*)buf->data();
+            memcpy(str, other, len);
+            str[len] = 0;
+            mString = str;
+            return NO_ERROR;
+        }
+        cur->release();
+        mString = getEmptyString();
+        return NO_MEMORY;
+    }
+
     const char *newString = allocFromUTF8(other, len);
     SharedBuffer::bufferFromData(mString)->release();
     mString = newString;
@@ -132,6 +132,12 @@ String8 Tokenizer::nextToken(const char* delimiters) {
 #if DEBUG_TOKENIZER
     ALOGD("nextToken");
 #endif
+    size_t length;
+    const char* tokenStart = nextTokenView(delimiters, &length);
+    return String8(tokenStart, length);
+}
+
+const char* Tokenizer::nextTokenView(const char* delimiters, size_t* outLength) {
     const char* end = getEnd();
     const char* tokenStart = mCurrent;
     while (mCurrent != end) {
@@ -141,7 +147,8 @@ String8 Tokenizer::nextToken(const char* delimiters) {
         }
         mCurrent += 1;
     }
-    return String8(tokenStart, mCurrent - tokenStart);
+    *outLength = mCurrent - tokenStart;
+    return tokenStart;
 }
 
 void Tokenizer::nextLine() {
@@ -18,6 +18,12 @@
 
 #include <stddef.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #ifdef HAVE_WINSOCK
 # undef  nhtol
 # undef  htonl
@@ -68,6 +74,159 @@ static const char32_t kFirstByteMark[] = {
     0x00000000, 0x00000000, 0x000000C0, 0x000000E0, 0x000000F0
 };
 
+// --------------------------------------------------------------------------
+// ASCII runs
+// --------------------------------------------------------------------------
+
+// Most text converted here is largely ASCII.  These helpers consume runs of
+// ASCII characters sixteen at a time with SSE2 or NEON where available and
+// stop at the first non-ASCII character, which the per-code point loops
+// below then handle, so results are identical to the scalar code.
+
+/**
+ * Returns the number of leading ASCII bytes in src[0..len).  If dst is not
+ * NULL, they are also widened into dst.
+ */
+static inline size_t ascii_utf8_to_utf16(const uint8_t* src, size_t len, char16_t* dst)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        if (_mm_movemask_epi8(v)) {
+            break;
+        }
+        if (dst) {
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi8(v, zero));
+            _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+        }
+    }
+#elif defined(__ARM_NEON__)
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(src + i);
+        uint8x8_t any = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+        if (vget_lane_u64(vreinterpret_u64_u8(any), 0) & 0x8080808080808080ULL) {
+            break;
+        }
+        if (dst) {
+            vst1q_u16((uint16_t*)(dst + i), vmovl_u8(vget_low_u8(v)));
+            vst1q_u16((uint16_t*)(dst + i + 8), vmovl_u8(vget_high_u8(v)));
+        }
+    }
+#endif
+    for (; i < len && src[i] < 0x80; i++) {
+        if (dst) {
+            dst[i] = src[i];
+        }
+    }
+    return i;
+}
+
+/**
+ * Returns the number of leading ASCII characters in src[0..len).  If dst is
+ * not NULL, they are also narrowed into dst.
+ */
+static inline size_t ascii_utf16_to_utf8(const char16_t* src, size_t len, char* dst)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i nonAscii = _mm_set1_epi16((short)0xFF80);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 8));
+        __m128i high = _mm_and_si128(_mm_or_si128(a, b), nonAscii);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) != 0xFFFF) {
+            break;
+        }
+        if (dst) {
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+        }
+    }
+#elif defined(__ARM_NEON__)
+    const uint16x8_t nonAscii = vdupq_n_u16(0xFF80);
+    for (; i + 16 <= len; i += 16) {
+        uint16x8_t a = vld1q_u16((const uint16_t*)(src + i));
+        uint16x8_t b = vld1q_u16((const uint16_t*)(src + i + 8));
+        uint64x2_t high = vreinterpretq_u64_u16(vandq_u16(vorrq_u16(a, b), nonAscii));
+        if (vgetq_lane_u64(high, 0) | vgetq_lane_u64(high, 1)) {
+            break;
+        }
+        if (dst) {
+            vst1q_u8((uint8_t*)(dst + i), vcombine_u8(vmovn_u16(a), vmovn_u16(b)));
+        }
+    }
+#endif
+    for (; i < len && src[i] < 0x80; i++) {
+        if (dst) {
+            dst[i] = (char)src[i];
+        }
+    }
+    return i;
+}
+
+// The aligned loads in ascii_cstr_length() may read past the terminator,
+// which AddressSanitizer reports even though those bytes are never used.
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define UNICODE_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#endif
+#elif defined(__SANITIZE_ADDRESS__)
+#define UNICODE_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#endif
+#ifndef UNICODE_NO_SANITIZE_ADDRESS
+#define UNICODE_NO_SANITIZE_ADDRESS
+#endif
+
+/**
+ * Returns the number of leading bytes in the NUL-terminated string src that
+ * are ASCII and not NUL.
+ *
+ * Like strlen(), this reads whole aligned 16-byte blocks, so it may read up
+ * to 15 bytes past the terminator.  An aligned block never crosses a page
+ * boundary, so these reads cannot fault, and the bytes after the terminator
+ * do not affect the result.  The length is not known up front, so there is
+ * no way to bound the loads by it without giving up the vector loop.
+ */
+UNICODE_NO_SANITIZE_ADDRESS
+static size_t ascii_cstr_length(const char* src)
+{
+    const uint8_t* s = (const uint8_t*)src;
+    size_t i = 0;
+#if defined(__SSE2__) || defined(__ARM_NEON__)
+    // Go byte by byte up to a 16-byte boundary, then a block at a time.
+    for (; ((uintptr_t)(s + i) & 15) != 0; i++) {
+        if (s[i] == 0 || s[i] >= 0x80) {
+            return i;
+        }
+    }
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (;; i += 16) {
+        __m128i v = _mm_load_si128((const __m128i*)(s + i));
+        if (_mm_movemask_epi8(v) | _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero))) {
+            break;
+        }
+    }
+#else
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t nonAscii = vdupq_n_u8(0x80);
+    for (;; i += 16) {
+        uint8x16_t v = vld1q_u8(s + i);
+        uint64x2_t stop = vreinterpretq_u64_u8(vorrq_u8(vceqq_u8(v, zero), vcgeq_u8(v, nonAscii)));
+        if (vgetq_lane_u64(stop, 0) | vgetq_lane_u64(stop, 1)) {
+            break;
+        }
+    }
+#endif
+#endif
+    while (s[i] != 0 && s[i] < 0x80) {
+        i++;
+    }
+    return i;
+}
+
 // --------------------------------------------------------------------------
 // UTF-32
 // --------------------------------------------------------------------------
@@ -340,6 +499,12 @@ void utf16_to_utf8(const char16_t* src, size_t src_len, char* dst)
     const char16_t* const end_utf16 = src + src_len;
     char *cur = dst;
     while (cur_utf16 < end_utf16) {
+        size_t ascii = ascii_utf16_to_utf8(cur_utf16, end_utf16 - cur_utf16, cur);
+        cur_utf16 += ascii;
+        cur += ascii;
+        if (cur_utf16 >= end_utf16) {
+            break;
+        }
         char32_t utf32;
         // surrogate pairs
         if ((*cur_utf16 & 0xFC00) == 0xD800) {
@@ -365,6 +530,12 @@ ssize_t utf8_length(const char *src)
     const char *cur = src;
     size_t ret = 0;
     while (*cur != '\0') {
+        size_t ascii = ascii_cstr_length(cur);
+        cur += ascii;
+        ret += ascii;
+        if (*cur == '\0') {
+            break;
+        }
         const char first_char = *cur++;
         if ((first_char & 0x80) == 0) { // ASCII
             ret += 1;
@@ -393,7 +564,7 @@ ssize_t utf8_length(const char *src)
             return -1;
         }
         to_ignore_mask |= mask;
-        utf32 |= ((~to_ignore_mask) & first_char) << (6 * (num_to_read - 1));
+        utf32 |= ((~to_ignore_mask) & (uint8_t)first_char) << (6 * (num_to_read - 1));
         if (utf32 > kUnicodeMaxCodepoint) {
             return -1;
         }
@@ -412,6 +583,12 @@ ssize_t utf16_to_utf8_length(const char16_t *src, size_t src_len)
     size_t ret = 0;
     const char16_t* const end = src + src_len;
     while (src < end) {
+        size_t ascii = ascii_utf16_to_utf8(src, end - src, NULL);
+        src += ascii;
+        ret += ascii;
+        if (src >= end) {
+            break;
+        }
         if ((*src & 0xFC00) == 0xD800 && (src + 1) < end
                 && (*++src & 0xFC00) == 0xDC00) {
             // surrogate pairs are always 4 bytes.
@@ -456,6 +633,12 @@ size_t utf8_to_utf32_length(const char *src, size_t src_len)
     for (cur = src, end = src + src_len, num_to_skip = 1;
          cur < end;
          cur += num_to_skip, ret++) {
+        size_t ascii = ascii_utf8_to_utf16((const uint8_t*)cur, end - cur, NULL);
+        cur += ascii;
+        ret += ascii;
+        if (cur >= end) {
+            break;
+        }
         const char first_char = *cur;
         num_to_skip = 1;
         if ((first_char & 0x80) == 0) {  // ASCII
@@ -479,6 +662,13 @@ void utf8_to_utf32(const char* src, size_t src_len, char32_t* dst)
     const char* const end = src + src_len;
     char32_t* cur_utf32 = dst;
     while (cur < end) {
+        size_t ascii = ascii_utf8_to_utf16((const uint8_t*)cur, end - cur, NULL);
+        for (size_t i = 0; i < ascii; i++) {
+            *cur_utf32++ = (uint8_t)*cur++;
+        }
+        if (cur >= end) {
+            break;
+        }
         size_t num_read;
         *cur_utf32++ = static_cast<char32_t>(utf32_at_internal(cur, &num_read));
         cur += num_read;
@@ -524,6 +714,12 @@ ssize_t utf8_to_utf16_length(const uint8_t* u8str, size_t u8len)
     /* Validate that the UTF-8 is the correct len */
     size_t u16measuredLen = 0;
     while (u8cur < u8end) {
+        size_t ascii = ascii_utf8_to_utf16(u8cur, u8end - u8cur, NULL);
+        u8cur += ascii;
+        u16measuredLen += ascii;
+        if (u8cur >= u8end) {
+            break;
+        }
         u16measuredLen++;
         int u8charLen = utf8_codepoint_len(*u8cur);
         uint32_t codepoint = utf8_to_utf32_codepoint(u8cur, u8charLen);
@@ -549,6 +745,12 @@ char16_t* utf8_to_utf16_no_null_terminator(const uint8_t* u8str, size_t u8len, c
     char16_t* u16cur = u16str;
 
     while (u8cur < u8end) {
+        size_t ascii = ascii_utf8_to_utf16(u8cur, u8end - u8cur, u16cur);
+        u8cur += ascii;
+        u16cur += ascii;
+        if (u8cur >= u8end) {
+            break;
+        }
         size_t u8len = utf8_codepoint_len(*u8cur);
         uint32_t codepoint = utf8_to_utf32_codepoint(u8cur, u8len);
 
@@ -580,6 +782,14 @@ char16_t* utf8_to_utf16_n(const uint8_t* src, size_t srcLen, char16_t* dst, size
     char16_t* u16cur = dst;
 
     while (u8cur < u8end && u16cur < u16end) {
+        size_t room = u16end - u16cur;
+        size_t avail = u8end - u8cur;
+        size_t ascii = ascii_utf8_to_utf16(u8cur, avail < room ? avail : room, u16cur);
+        u8cur += ascii;
+        u16cur += ascii;
+        if (u8cur >= u8end || u16cur >= u16end) {
+            break;
+        }
         size_t u8len = utf8_codepoint_len(*u8cur);
         uint32_t codepoint = utf8_to_utf32_codepoint(u8cur, u8len);
 
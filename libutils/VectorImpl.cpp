@@ -152,6 +152,13 @@ ssize_t VectorImpl::insertAt(const void* item, size_t index, size_t numItems)
     return where ? index : (ssize_t)NO_MEMORY;
 }
 
+void* VectorImpl::insertUninitializedAt(size_t index, size_t numItems)
+{
+    if (index > size())
+        return 0;
+    return _grow(index, numItems);
+}
+
 static int sortProxy(const void* lhs, const void* rhs, void* func)
 {
     return (*(VectorImpl::compar_t)func)(lhs, rhs);
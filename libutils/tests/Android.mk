@@ -7,10 +7,16 @@ test_src_files := \
     BasicHashtable_test.cpp \
     BlobCache_test.cpp \
     BitSet_test.cpp \
+    FlatHashMap_test.cpp \
     Looper_test.cpp \
     LruCache_test.cpp \
+    PoolAllocator_test.cpp \
+    PropertyMap_test.cpp \
+    SamplingProfiler_test.cpp \
+    Unicode_test.cpp
+
+cxx11_test_src_files := \
     String8_test.cpp \
-    Unicode_test.cpp \
     Vector_test.cpp
 
 shared_libraries := \
@@ -32,3 +38,16 @@ $(foreach file,$(test_src_files), \
     $(eval LOCAL_MODULE := $(notdir $(file:%.cpp=%))) \
     $(eval include $(BUILD_NATIVE_TEST)) \
 )
+
+# These also cover the move operations, which only exist in C++11. They must
+# not call libutils functions taking char16_t or char32_t, which are mangled
+# differently in C++11 than in the C++98 libutils.
+$(foreach file,$(cxx11_test_src_files), \
+    $(eval include $(CLEAR_VARS)) \
+    $(eval LOCAL_SHARED_LIBRARIES := $(shared_libraries)) \
+    $(eval LOCAL_STATIC_LIBRARIES := $(static_libraries)) \
+    $(eval LOCAL_CPPFLAGS := -std=gnu++11) \
+    $(eval LOCAL_SRC_FILES := $(file)) \
+    $(eval LOCAL_MODULE := $(notdir $(file:%.cpp=%))) \
+    $(eval include $(BUILD_NATIVE_TEST)) \
+)
@@ -16,11 +16,14 @@
 
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include <gtest/gtest.h>
 
 #include <utils/BlobCache.h>
 #include <utils/Errors.h>
+#include <utils/FileMap.h>
 
 namespace android {
 
@@ -258,6 +261,38 @@ TEST_F(BlobCacheTest, ExceedingTotalLimitHalvesCacheSize) {
     ASSERT_EQ(maxEntries/2 + 1, numCached);
 }
 
+TEST_F(BlobCacheTest, ExceedingTotalLimitEvictsLeastRecentlyUsed) {
+    // Fill up the entire cache with 1 char key/value pairs.
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, "x", 1);
+    }
+    // Use the two oldest entries so that they become the newest ones.
+    for (int i = 0; i < 2; i++) {
+        uint8_t k = i;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, NULL, 0));
+    }
+    // Insert one more entry, causing a cache overflow.
+    {
+        uint8_t k = maxEntries;
+        mBC->set(&k, 1, "x", 1);
+    }
+    // The recently used entries and the new one must have survived.
+    for (int i = 0; i < 2; i++) {
+        uint8_t k = i;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, NULL, 0));
+    }
+    {
+        uint8_t k = maxEntries;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, NULL, 0));
+    }
+    {
+        uint8_t k = 2;
+        ASSERT_EQ(size_t(0), mBC->get(&k, 1, NULL, 0));
+    }
+}
+
 class BlobCacheFlattenTest : public BlobCacheTest {
 protected:
     virtual void SetUp() {
@@ -333,6 +368,84 @@ TEST_F(BlobCacheFlattenTest, FlattenDoesntChangeCache) {
     }
 }
 
+TEST_F(BlobCacheFlattenTest, FlattenPreservesUseOrder) {
+    // Fill up the entire cache with 1 char key/value pairs, then make the
+    // first one the most recently used.
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, &k, 1);
+    }
+    {
+        uint8_t k = 0;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, NULL, 0));
+    }
+
+    roundTrip();
+
+    // Overflowing the deserialized cache must evict the same entries that
+    // overflowing the original one would.
+    {
+        uint8_t k = maxEntries;
+        mBC2->set(&k, 1, &k, 1);
+    }
+    {
+        uint8_t k = 0;
+        ASSERT_EQ(size_t(1), mBC2->get(&k, 1, NULL, 0));
+    }
+    {
+        uint8_t k = 1;
+        ASSERT_EQ(size_t(0), mBC2->get(&k, 1, NULL, 0));
+    }
+}
+
+TEST_F(BlobCacheFlattenTest, UnflattenMappedServesValues) {
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, &k, 1);
+    }
+
+    size_t size = mBC->getFlattenedSize();
+    uint8_t* flat = new uint8_t[size];
+    ASSERT_EQ(OK, mBC->flatten(flat, size));
+
+#ifdef HAVE_ANDROID_OS
+    char path[] = "/data/local/tmp/BlobCache_test.XXXXXX";
+#else
+    char path[] = "/tmp/BlobCache_test.XXXXXX";
+#endif
+    int fd = mkstemp(path);
+    ASSERT_LE(0, fd);
+    unlink(path);
+    ASSERT_EQ(ssize_t(size), write(fd, flat, size));
+    delete[] flat;
+
+    FileMap* map = new FileMap;
+    ASSERT_TRUE(map->create(NULL, fd, 0, size, true));
+    close(fd);
+    ASSERT_EQ(OK, mBC2->unflattenMapped(map));
+    // The cache entries keep the mapping alive.
+    map->release();
+
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        uint8_t v = 0xee;
+        ASSERT_EQ(size_t(1), mBC2->get(&k, 1, &v, 1));
+        ASSERT_EQ(k, v);
+    }
+
+    // Replacing a mapped value copies the new one.
+    {
+        uint8_t k = 0;
+        uint8_t v = 0x42;
+        mBC2->set(&k, 1, &v, 1);
+        v = 0xee;
+        ASSERT_EQ(size_t(1), mBC2->get(&k, 1, &v, 1));
+        ASSERT_EQ(0x42, v);
+    }
+}
+
 TEST_F(BlobCacheFlattenTest, FlattenCatchesBufferTooSmall) {
     // Fill up the entire cache with 1 char key/value pairs.
     const int maxEntries = MAX_TOTAL_SIZE / 2;
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FlatHashMap_test"
+
+#include <utils/FlatHashMap.h>
+#include <cutils/log.h>
+#include <gtest/gtest.h>
+
+namespace android {
+
+typedef FlatHashMap<int, int> SimpleMap;
+
+struct ComplexKey {
+    int k;
+
+    explicit ComplexKey(int k) : k(k) {
+        instanceCount += 1;
+    }
+
+    ComplexKey(const ComplexKey& other) : k(other.k) {
+        instanceCount += 1;
+    }
+
+    ~ComplexKey() {
+        instanceCount -= 1;
+    }
+
+    bool operator ==(const ComplexKey& other) const {
+        return k == other.k;
+    }
+
+    static ssize_t instanceCount;
+};
+
+ssize_t ComplexKey::instanceCount = 0;
+
+template<> inline hash_t hash_type(const ComplexKey& value) {
+    return hash_type(value.k);
+}
+
+struct ComplexValue {
+    int v;
+
+    explicit ComplexValue(int v = -1) : v(v) {
+        instanceCount += 1;
+    }
+
+    ComplexValue(const ComplexValue& other) : v(other.v) {
+        instanceCount += 1;
+    }
+
+    ~ComplexValue() {
+        instanceCount -= 1;
+    }
+
+    static ssize_t instanceCount;
+};
+
+ssize_t ComplexValue::instanceCount = 0;
+
+typedef FlatHashMap<ComplexKey, ComplexValue> ComplexMap;
+
+class FlatHashMapTest : public testing::Test {
+protected:
+    virtual void SetUp() {
+        ComplexKey::instanceCount = 0;
+        ComplexValue::instanceCount = 0;
+    }
+
+    virtual void TearDown() {
+        ASSERT_NO_FATAL_FAILURE(assertInstanceCount(0, 0));
+    }
+
+    void assertInstanceCount(ssize_t keys, ssize_t values) {
+        if (keys != ComplexKey::instanceCount || values != ComplexValue::instanceCount) {
+            FAIL() << "Expected " << keys << " keys and " << values << " values "
+                    "but there were actually " << ComplexKey::instanceCount << " keys and "
+                    << ComplexValue::instanceCount << " values";
+        }
+    }
+};
+
+TEST_F(FlatHashMapTest, DefaultConstructor_IsEmpty) {
+    SimpleMap m;
+
+    EXPECT_EQ(0U, m.size());
+    EXPECT_TRUE(m.isEmpty());
+    EXPECT_EQ(-1, m.next(-1));
+    EXPECT_EQ(NAME_NOT_FOUND, m.indexOfKey(0));
+}
+
+TEST_F(FlatHashMapTest, ValueFor_WhenKeyAbsent_ReturnsDefault) {
+    SimpleMap m(-7);
+    m.add(1, 10);
+
+    EXPECT_EQ(10, m.valueFor(1));
+    EXPECT_EQ(-7, m.valueFor(2));
+}
+
+TEST_F(FlatHashMapTest, Add_WhenKeyPresent_ReplacesValue) {
+    SimpleMap m;
+    ssize_t index = m.add(1, 10);
+    ASSERT_GE(index, 0);
+
+    EXPECT_EQ(index, m.add(1, 11));
+    EXPECT_EQ(1U, m.size());
+    EXPECT_EQ(1, m.keyAt(index));
+    EXPECT_EQ(11, m.valueAt(index));
+}
+
+TEST_F(FlatHashMapTest, Add_ManyKeys_AllFound) {
+    SimpleMap m;
+    const int count = 10000;
+    for (int i = 0; i < count; i++) {
+        ASSERT_GE(m.add(i * 4096, i), 0);
+    }
+
+    EXPECT_EQ(size_t(count), m.size());
+    EXPECT_GE(m.capacity(), m.size());
+    for (int i = 0; i < count; i++) {
+        ssize_t index = m.indexOfKey(i * 4096);
+        ASSERT_GE(index, 0) << "key " << i * 4096;
+        EXPECT_EQ(i, m.valueAt(index));
+    }
+    EXPECT_EQ(NAME_NOT_FOUND, m.indexOfKey(1));
+}
+
+TEST_F(FlatHashMapTest, Next_VisitsEveryEntryOnce) {
+    SimpleMap m;
+    const int count = 1000;
+    for (int i = 0; i < count; i++) {
+        m.add(i, i);
+    }
+
+    int sum = 0;
+    size_t visited = 0;
+    for (ssize_t i = m.next(-1); i >= 0; i = m.next(i)) {
+        EXPECT_EQ(m.keyAt(i), m.valueAt(i));
+        sum += m.valueAt(i);
+        visited++;
+    }
+    EXPECT_EQ(size_t(count), visited);
+    EXPECT_EQ(count * (count - 1) / 2, sum);
+}
+
+TEST_F(FlatHashMapTest, RemoveItem_KeepsOtherKeysReachable) {
+    SimpleMap m;
+    const int count = 5000;
+    for (int i = 0; i < count; i++) {
+        m.add(i, i);
+    }
+
+    // Remove every other key; backward shifting must not lose the rest.
+    for (int i = 0; i < count; i += 2) {
+        ASSERT_GE(m.removeItem(i), 0);
+    }
+    EXPECT_EQ(NAME_NOT_FOUND, m.removeItem(0));
+    EXPECT_EQ(size_t(count / 2), m.size());
+    for (int i = 0; i < count; i++) {
+        if (i % 2) {
+            EXPECT_EQ(i, m.valueFor(i));
+        } else {
+            EXPECT_EQ(NAME_NOT_FOUND, m.indexOfKey(i));
+        }
+    }
+}
+
+TEST_F(FlatHashMapTest, SetCapacity_AvoidsRehash) {
+    SimpleMap m;
+    ASSERT_GE(m.setCapacity(1000), 1000);
+    size_t capacity = m.capacity();
+    for (int i = 0; i < 1000; i++) {
+        m.add(i, i);
+    }
+    EXPECT_EQ(capacity, m.capacity());
+
+    // Capacity can't drop below the size.
+    m.setCapacity(0);
+    EXPECT_GE(m.capacity(), m.size());
+    EXPECT_EQ(999, m.valueFor(999));
+}
+
+TEST_F(FlatHashMapTest, ComplexTypes_AreConstructedAndDestroyed) {
+    {
+        ComplexMap m;
+        for (int i = 0; i < 100; i++) {
+            m.add(ComplexKey(i), ComplexValue(i));
+        }
+        ASSERT_NO_FATAL_FAILURE(assertInstanceCount(100, 101)); // + default value
+
+        for (int i = 0; i < 50; i++) {
+            m.removeItem(ComplexKey(i));
+        }
+        ASSERT_NO_FATAL_FAILURE(assertInstanceCount(50, 51));
+
+        ComplexMap copy(m);
+        ASSERT_NO_FATAL_FAILURE(assertInstanceCount(100, 102));
+        EXPECT_EQ(75, copy.valueFor(ComplexKey(75)).v);
+        EXPECT_EQ(-1, copy.valueFor(ComplexKey(25)).v);
+
+        copy.clear();
+        ASSERT_NO_FATAL_FAILURE(assertInstanceCount(50, 52));
+        EXPECT_EQ(75, m.valueFor(ComplexKey(75)).v);
+    }
+}
+
+} // namespace android
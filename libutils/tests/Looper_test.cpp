@@ -98,6 +98,59 @@ public:
     }
 };
 
+class CountingMessageHandler : public MessageHandler {
+public:
+    volatile int32_t count;
+
+    CountingMessageHandler() : count(0) { }
+
+    virtual void handleMessage(const Message& message) {
+        count += 1;
+    }
+};
+
+class MessageProducer : public Thread {
+    sp<Looper> mLooper;
+    sp<MessageHandler> mHandler;
+    int mCount;
+
+public:
+    MessageProducer(const sp<Looper>& looper, const sp<MessageHandler>& handler, int count) :
+        mLooper(looper), mHandler(handler), mCount(count) {
+    }
+
+protected:
+    virtual bool threadLoop() {
+        for (int i = 0; i < mCount; i++) {
+            mLooper->sendMessage(mHandler, Message(MSG_TEST1));
+        }
+        return false;
+    }
+};
+
+class WakeProducer : public Thread {
+    sp<Looper> mLooper;
+    sp<MessageHandler> mHandler;
+    int mCount;
+
+public:
+    WakeProducer(const sp<Looper>& looper, const sp<MessageHandler>& handler, int count) :
+        mLooper(looper), mHandler(handler), mCount(count) {
+    }
+
+protected:
+    virtual bool threadLoop() {
+        for (int i = 0; i < mCount; i++) {
+            mLooper->sendMessage(mHandler, Message(MSG_TEST1));
+            mLooper->wake();
+            if (i % 64 == 0) {
+                usleep(50);
+            }
+        }
+        return false;
+    }
+};
+
 class LooperTest : public testing::Test {
 protected:
     sp<Looper> mLooper;
@@ -690,4 +743,152 @@ TEST_F(LooperTest, RemoveMessage_WhenRemovingSomeMessagesForHandler_ShouldRemove
             << "no more messages to handle";
 }
 
+TEST_F(LooperTest, SendMessageAtTime_WhenManyMessagesEnqueuedOutOfOrder_ShouldInvokeHandlersInTimeOrder) {
+    sp<StubMessageHandler> handler = new StubMessageHandler();
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    const int count = 1000;
+    int sendOrder[count];
+
+    // Uptimes come from a permutation of 0..count-1 in the past, with pairs sharing
+    // an uptime so that FIFO order among equal uptimes is exercised too.
+    for (int i = 0; i < count; i++) {
+        int slot = (i * 7919) % count;
+        sendOrder[slot] = i;
+        mLooper->sendMessageAtTime(now - ms2ns(count) + ms2ns(slot / 2), handler, Message(slot));
+    }
+
+    int result = mLooper->pollOnce(0);
+
+    EXPECT_EQ(ALOOPER_POLL_CALLBACK, result)
+            << "pollOnce result should be ALOOPER_POLL_CALLBACK because messages were sent";
+    ASSERT_EQ(size_t(count), handler->messages.size())
+            << "handled all messages";
+    for (int i = 1; i < count; i++) {
+        int previous = handler->messages[i - 1].what;
+        int current = handler->messages[i].what;
+        EXPECT_LE(previous / 2, current / 2)
+                << "messages should be handled in uptime order";
+        if (previous / 2 == current / 2) {
+            EXPECT_LT(sendOrder[previous], sendOrder[current])
+                    << "messages with equal uptimes should be handled in send order";
+        }
+    }
+}
+
+TEST_F(LooperTest, RemoveMessage_WhenRemovingFromManyMessages_ShouldKeepRemainingInTimeOrder) {
+    sp<StubMessageHandler> handler1 = new StubMessageHandler();
+    sp<StubMessageHandler> handler2 = new StubMessageHandler();
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    const int count = 1000;
+
+    for (int i = 0; i < count; i++) {
+        int slot = (i * 7919) % count;
+        mLooper->sendMessageAtTime(now - ms2ns(count) + ms2ns(slot), (slot % 3) ? handler1 : handler2,
+                Message(slot));
+    }
+    mLooper->removeMessages(handler2);
+    mLooper->removeMessages(handler1, 1);
+    mLooper->removeMessages(handler1, 500);
+
+    int result = mLooper->pollOnce(0);
+
+    EXPECT_EQ(ALOOPER_POLL_CALLBACK, result)
+            << "pollOnce result should be ALOOPER_POLL_CALLBACK because messages were sent";
+    EXPECT_EQ(size_t(0), handler2->messages.size())
+            << "all messages for handler2 were removed";
+    ASSERT_EQ(size_t(count - count / 3 - 1 - 2), handler1->messages.size())
+            << "only the removed messages for handler1 are missing";
+    for (size_t i = 0; i < handler1->messages.size(); i++) {
+        int what = handler1->messages[i].what;
+        EXPECT_NE(0, what % 3) << "handler2 message was delivered";
+        EXPECT_NE(1, what) << "removed message was delivered";
+        EXPECT_NE(500, what) << "removed message was delivered";
+        if (i != 0) {
+            EXPECT_LT(handler1->messages[i - 1].what, what)
+                    << "messages should be handled in uptime order";
+        }
+    }
+}
+
+TEST_F(LooperTest, Wake_WhenCalledRepeatedly_ShouldBeConsumedByOnePoll) {
+    for (int i = 0; i < 100; i++) {
+        mLooper->wake();
+    }
+
+    int result = mLooper->pollOnce(0);
+    EXPECT_EQ(ALOOPER_POLL_WAKE, result)
+            << "pollOnce result should be ALOOPER_POLL_WAKE because loop was awoken";
+
+    result = mLooper->pollOnce(0);
+    EXPECT_EQ(ALOOPER_POLL_TIMEOUT, result)
+            << "pollOnce result should be ALOOPER_POLL_TIMEOUT because the wakes were coalesced";
+}
+
+TEST_F(LooperTest, Wake_WhenRacingWithPoll_ShouldNeverBeLost) {
+    sp<CountingMessageHandler> handler = new CountingMessageHandler();
+    const int producerCount = 4;
+    const int messagesPerProducer = 20000;
+    const int total = producerCount * messagesPerProducer;
+    sp<WakeProducer> producers[producerCount];
+
+    for (int i = 0; i < producerCount; i++) {
+        producers[i] = new WakeProducer(mLooper, handler, messagesPerProducer);
+        producers[i]->run("WakeProducer");
+    }
+    // Producers never stop signalling until every message is handled, so a poll that
+    // times out means a wake-up was lost.
+    int timeouts = 0;
+    while (handler->count < total && timeouts == 0) {
+        if (mLooper->pollOnce(1000) == ALOOPER_POLL_TIMEOUT && handler->count < total) {
+            timeouts += 1;
+        }
+    }
+    for (int i = 0; i < producerCount; i++) {
+        producers[i]->join();
+    }
+
+    EXPECT_EQ(0, timeouts)
+            << "pollOnce should not time out while producers are waking the looper";
+    EXPECT_EQ(total, handler->count)
+            << "every message sent by the producers should be handled once";
+
+    // The looper must still respond to a wake once the storm is over.
+    mLooper->pollOnce(0);
+    StopWatch stopWatch("pollOnce");
+    mLooper->wake();
+    int result = mLooper->pollOnce(1000);
+    int32_t elapsedMillis = ns2ms(stopWatch.elapsedTime());
+
+    EXPECT_EQ(ALOOPER_POLL_WAKE, result)
+            << "pollOnce result should be ALOOPER_POLL_WAKE because loop was awoken";
+    EXPECT_NEAR(0, elapsedMillis, TIMING_TOLERANCE_MS)
+            << "elapsed time should approx. zero because wake() was called before waiting";
+}
+
+TEST_F(LooperTest, SendMessage_FromConcurrentProducers_ShouldHandleEachMessageOnce) {
+    sp<CountingMessageHandler> handler = new CountingMessageHandler();
+    const int producerCount = 4;
+    const int messagesPerProducer = 10000;
+    const int total = producerCount * messagesPerProducer;
+    sp<MessageProducer> producers[producerCount];
+
+    for (int i = 0; i < producerCount; i++) {
+        producers[i] = new MessageProducer(mLooper, handler, messagesPerProducer);
+        producers[i]->run("MessageProducer");
+    }
+    // Give up after 10 seconds rather than hang if a message is lost.
+    nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + s2ns(10);
+    while (handler->count < total && systemTime(SYSTEM_TIME_MONOTONIC) < deadline) {
+        mLooper->pollOnce(100);
+    }
+    for (int i = 0; i < producerCount; i++) {
+        producers[i]->join();
+    }
+    // Anything still queued now would be a duplicate.
+    mLooper->pollOnce(0);
+
+    EXPECT_EQ(total, handler->count)
+            << "every message sent by the producers should be handled once";
+}
+
 } // namespace android
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PoolAllocator_test"
+
+#include <utils/PoolAllocator.h>
+#include <utils/RefBase.h>
+#include <utils/StrongPointer.h>
+#include <cutils/log.h>
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <list>
+
+namespace android {
+
+class PoolAllocatorTest : public testing::Test {
+protected:
+    PoolAllocator mPool;
+};
+
+TEST_F(PoolAllocatorTest, Alloc_ReturnsDistinctWritableBlocks) {
+    const size_t count = 1000;
+    uint8_t* blocks[count];
+    for (size_t i = 0; i < count; i++) {
+        size_t size = 1 + i % PoolAllocator::MAX_POOLED_SIZE;
+        blocks[i] = static_cast<uint8_t*>(mPool.alloc(size));
+        ASSERT_TRUE(blocks[i] != NULL);
+        EXPECT_EQ(0U, uintptr_t(blocks[i]) % sizeof(void*));
+        memset(blocks[i], int(i), size);
+    }
+    for (size_t i = 0; i < count; i++) {
+        size_t size = 1 + i % PoolAllocator::MAX_POOLED_SIZE;
+        for (size_t j = 0; j < size; j++) {
+            ASSERT_EQ(uint8_t(i), blocks[i][j]) << "block " << i << " byte " << j;
+        }
+        mPool.free(blocks[i], size);
+    }
+}
+
+TEST_F(PoolAllocatorTest, Free_BlockIsReusedBySameSizeClass) {
+    void* a = mPool.alloc(40);
+    mPool.free(a, 40);
+    // 33..48 bytes share a size class.
+    void* b = mPool.alloc(33);
+    EXPECT_EQ(a, b);
+    mPool.free(b, 33);
+}
+
+TEST_F(PoolAllocatorTest, LargeRequests_GoToMalloc) {
+    const size_t size = PoolAllocator::MAX_POOLED_SIZE + 1;
+    void* p = mPool.alloc(size);
+    ASSERT_TRUE(p != NULL);
+    memset(p, 0xa5, size);
+    mPool.free(p, size);
+    mPool.free(NULL, 16);
+}
+
+class PooledEvent : public RefBase, public PoolObject {
+public:
+    PooledEvent(int value, int* destroyed) : mValue(value), mDestroyed(destroyed) { }
+    virtual ~PooledEvent() { (*mDestroyed)++; }
+
+    int mValue;
+    int* mDestroyed;
+};
+
+TEST_F(PoolAllocatorTest, PoolObject_WorksWithStrongPointers) {
+    int destroyed = 0;
+    {
+        sp<PooledEvent> events[100];
+        for (int i = 0; i < 100; i++) {
+            events[i] = new PooledEvent(i, &destroyed);
+        }
+        for (int i = 0; i < 100; i++) {
+            EXPECT_EQ(i, events[i]->mValue);
+        }
+    }
+    EXPECT_EQ(100, destroyed);
+}
+
+TEST_F(PoolAllocatorTest, StlAllocator_BacksList) {
+    PoolStlAllocator<int> allocator(mPool);
+    std::list<int, PoolStlAllocator<int> > list(allocator);
+    for (int i = 0; i < 10000; i++) {
+        list.push_back(i);
+    }
+    int expected = 0;
+    for (std::list<int, PoolStlAllocator<int> >::const_iterator it = list.begin();
+            it != list.end(); ++it) {
+        EXPECT_EQ(expected++, *it);
+    }
+    EXPECT_TRUE(list.get_allocator() == allocator);
+    EXPECT_TRUE(PoolStlAllocator<char>() != allocator);
+}
+
+struct StressArgs {
+    PoolAllocator* pool;
+    int iterations;
+    bool failed;
+};
+
+// Allocates and frees blocks of assorted sizes, checking that no other thread
+// scribbles over them.  Half of the blocks are handed to the next round so
+// that frees don't simply mirror allocations.
+static void* stressThread(void* cookie) {
+    StressArgs* args = static_cast<StressArgs*>(cookie);
+    const int slots = 64;
+    uint32_t* blocks[slots];
+    size_t sizes[slots];
+    memset(blocks, 0, sizeof(blocks));
+    uint32_t tag = uint32_t(uintptr_t(cookie));
+    unsigned seed = tag;
+
+    for (int i = 0; i < args->iterations; i++) {
+        int slot = rand_r(&seed) % slots;
+        if (blocks[slot] != NULL) {
+            for (size_t j = 0; j < sizes[slot] / sizeof(uint32_t); j++) {
+                if (blocks[slot][j] != tag + slot) {
+                    args->failed = true;
+                }
+            }
+            args->pool->free(blocks[slot], sizes[slot]);
+        }
+        sizes[slot] = sizeof(uint32_t) * (1 + rand_r(&seed) % 64);
+        blocks[slot] = static_cast<uint32_t*>(args->pool->alloc(sizes[slot]));
+        for (size_t j = 0; j < sizes[slot] / sizeof(uint32_t); j++) {
+            blocks[slot][j] = tag + slot;
+        }
+    }
+    for (int slot = 0; slot < slots; slot++) {
+        if (blocks[slot] != NULL) {
+            args->pool->free(blocks[slot], sizes[slot]);
+        }
+    }
+    return NULL;
+}
+
+TEST_F(PoolAllocatorTest, Stress_ManyThreads) {
+    const int threadCount = 8;
+    pthread_t threads[threadCount];
+    StressArgs args[threadCount];
+    for (int i = 0; i < threadCount; i++) {
+        args[i].pool = &mPool;
+        args[i].iterations = 100000;
+        args[i].failed = false;
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, stressThread, &args[i]));
+    }
+    for (int i = 0; i < threadCount; i++) {
+        pthread_join(threads[i], NULL);
+        EXPECT_FALSE(args[i].failed) << "thread " << i;
+    }
+    mPool.dumpMemoryStats("  ");
+}
+
+} // namespace android
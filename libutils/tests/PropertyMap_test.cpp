@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PropertyMap_test"
+
+#include <utils/PropertyMap.h>
+#include <utils/Tokenizer.h>
+#include <cutils/log.h>
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace android {
+
+class PropertyMapTest : public testing::Test {
+protected:
+    virtual void SetUp() {
+#ifdef HAVE_ANDROID_OS
+        strcpy(mTextPath, "/data/local/tmp/PropertyMap_test.XXXXXX");
+        strcpy(mBinaryPath, "/data/local/tmp/PropertyMap_test.XXXXXX");
+#else
+        strcpy(mTextPath, "/tmp/PropertyMap_test.XXXXXX");
+        strcpy(mBinaryPath, "/tmp/PropertyMap_test.XXXXXX");
+#endif
+        close(mkstemp(mTextPath));
+        close(mkstemp(mBinaryPath));
+    }
+
+    virtual void TearDown() {
+        unlink(mTextPath);
+        unlink(mBinaryPath);
+    }
+
+    void writeText(const char* text) {
+        int fd = open(mTextPath, O_WRONLY | O_TRUNC);
+        ASSERT_LE(0, fd);
+        ASSERT_EQ(ssize_t(strlen(text)), write(fd, text, strlen(text)));
+        close(fd);
+    }
+
+    char mTextPath[64];
+    char mBinaryPath[64];
+};
+
+static const char* const TEXT =
+        "# comment\n"
+        "  touch.deviceType = touchScreen\n"
+        "cursor.mode=pointer\n"
+        "\n"
+        "touch.size.scale = 12\n"
+        "touch.size.bias = -1.5\n";
+
+TEST_F(PropertyMapTest, Tokenizer_NextTokenView_DoesNotCopy) {
+    Tokenizer* tokenizer;
+    ASSERT_EQ(NO_ERROR, Tokenizer::fromContents(String8("x"), "key = value  \n", &tokenizer));
+
+    size_t length;
+    const char* token = tokenizer->nextTokenView(" =", &length);
+    EXPECT_EQ(0, strncmp("key", token, length));
+    EXPECT_EQ(3U, length);
+    tokenizer->skipDelimiters(" =");
+    token = tokenizer->nextTokenView(" ", &length);
+    EXPECT_EQ(0, strncmp("value", token, length));
+    EXPECT_EQ(5U, length);
+    tokenizer->skipDelimiters(" ");
+    EXPECT_TRUE(tokenizer->isEol());
+    token = tokenizer->nextTokenView(" ", &length);
+    EXPECT_EQ(0U, length);
+    delete tokenizer;
+}
+
+TEST_F(PropertyMapTest, Load_Text) {
+    writeText(TEXT);
+    PropertyMap* map;
+    ASSERT_EQ(NO_ERROR, PropertyMap::load(String8(mTextPath), &map));
+
+    String8 value;
+    ASSERT_TRUE(map->tryGetProperty(String8("touch.deviceType"), value));
+    EXPECT_STREQ("touchScreen", value.string());
+    ASSERT_TRUE(map->tryGetProperty(String8("cursor.mode"), value));
+    EXPECT_STREQ("pointer", value.string());
+    int32_t i;
+    ASSERT_TRUE(map->tryGetProperty(String8("touch.size.scale"), i));
+    EXPECT_EQ(12, i);
+    float f;
+    ASSERT_TRUE(map->tryGetProperty(String8("touch.size.bias"), f));
+    EXPECT_EQ(-1.5f, f);
+    EXPECT_FALSE(map->hasProperty(String8("touch")));
+    EXPECT_EQ(4U, map->getProperties().size());
+    delete map;
+}
+
+TEST_F(PropertyMapTest, Load_TextWithReservedCharacter_Fails) {
+    writeText("key = va\"lue\n");
+    PropertyMap* map;
+    EXPECT_EQ(BAD_VALUE, PropertyMap::load(String8(mTextPath), &map));
+    EXPECT_TRUE(map == NULL);
+}
+
+TEST_F(PropertyMapTest, WriteBinary_RoundTrips) {
+    writeText(TEXT);
+    PropertyMap* text;
+    ASSERT_EQ(NO_ERROR, PropertyMap::load(String8(mTextPath), &text));
+    ASSERT_EQ(NO_ERROR, text->writeBinary(String8(mBinaryPath)));
+
+    PropertyMap* binary;
+    ASSERT_EQ(NO_ERROR, PropertyMap::loadBinary(String8(mBinaryPath), &binary));
+    String8 value;
+    ASSERT_TRUE(binary->tryGetProperty(String8("touch.deviceType"), value));
+    EXPECT_STREQ("touchScreen", value.string());
+    int32_t i;
+    ASSERT_TRUE(binary->tryGetProperty(String8("touch.size.scale"), i));
+    EXPECT_EQ(12, i);
+    float f;
+    ASSERT_TRUE(binary->tryGetProperty(String8("touch.size.bias"), f));
+    EXPECT_EQ(-1.5f, f);
+    EXPECT_FALSE(binary->hasProperty(String8("touch")));
+    EXPECT_FALSE(binary->hasProperty(String8("zzz")));
+
+    const KeyedVector<String8, String8>& properties = binary->getProperties();
+    const KeyedVector<String8, String8>& expected = text->getProperties();
+    ASSERT_EQ(expected.size(), properties.size());
+    for (size_t j = 0; j < expected.size(); j++) {
+        EXPECT_STREQ(expected.keyAt(j).string(), properties.keyAt(j).string());
+        EXPECT_STREQ(expected.valueAt(j).string(), properties.valueAt(j).string());
+    }
+    // Still answers lookups after copying.
+    EXPECT_TRUE(binary->hasProperty(String8("cursor.mode")));
+    delete binary;
+    delete text;
+}
+
+TEST_F(PropertyMapTest, AddProperty_OverridesBinary) {
+    writeText(TEXT);
+    PropertyMap* text;
+    ASSERT_EQ(NO_ERROR, PropertyMap::load(String8(mTextPath), &text));
+    ASSERT_EQ(NO_ERROR, text->writeBinary(String8(mBinaryPath)));
+    delete text;
+
+    PropertyMap* binary;
+    ASSERT_EQ(NO_ERROR, PropertyMap::loadBinary(String8(mBinaryPath), &binary));
+    binary->addProperty(String8("cursor.mode"), String8("navigation"));
+    binary->addProperty(String8("new.key"), String8("1"));
+
+    String8 value;
+    ASSERT_TRUE(binary->tryGetProperty(String8("cursor.mode"), value));
+    EXPECT_STREQ("navigation", value.string());
+    EXPECT_TRUE(binary->hasProperty(String8("new.key")));
+    EXPECT_EQ(5U, binary->getProperties().size());
+    ASSERT_TRUE(binary->tryGetProperty(String8("cursor.mode"), value));
+    EXPECT_STREQ("navigation", value.string());
+
+    PropertyMap merged;
+    merged.addAll(binary);
+    EXPECT_EQ(5U, merged.getProperties().size());
+    delete binary;
+}
+
+TEST_F(PropertyMapTest, Copy_SharesBinaryMap) {
+    PropertyMap map;
+    map.addProperty(String8("a"), String8("1"));
+    map.addProperty(String8("b"), String8("2"));
+    ASSERT_EQ(NO_ERROR, map.writeBinary(String8(mBinaryPath)));
+
+    PropertyMap* binary;
+    ASSERT_EQ(NO_ERROR, PropertyMap::loadBinary(String8(mBinaryPath), &binary));
+    PropertyMap* copy = new PropertyMap(*binary);
+    PropertyMap assigned;
+    assigned.addProperty(String8("c"), String8("3"));
+    assigned = *binary;
+    delete binary;
+
+    // Both still read the mapping after the original is gone.
+    String8 value;
+    ASSERT_TRUE(copy->tryGetProperty(String8("b"), value));
+    EXPECT_STREQ("2", value.string());
+    delete copy;
+    ASSERT_TRUE(assigned.tryGetProperty(String8("a"), value));
+    EXPECT_STREQ("1", value.string());
+    EXPECT_FALSE(assigned.hasProperty(String8("c")));
+    assigned = assigned;
+    EXPECT_EQ(2U, assigned.getProperties().size());
+}
+
+TEST_F(PropertyMapTest, WriteBinary_ReplacesFile) {
+    PropertyMap map;
+    map.addProperty(String8("a"), String8("1"));
+    ASSERT_EQ(NO_ERROR, map.writeBinary(String8(mBinaryPath)));
+    PropertyMap* first;
+    ASSERT_EQ(NO_ERROR, PropertyMap::loadBinary(String8(mBinaryPath), &first));
+
+    // A map of the old file keeps its contents when the file is replaced.
+    map.addProperty(String8("a"), String8("2"));
+    ASSERT_EQ(NO_ERROR, map.writeBinary(String8(mBinaryPath)));
+    PropertyMap* second;
+    ASSERT_EQ(NO_ERROR, PropertyMap::loadBinary(String8(mBinaryPath), &second));
+
+    String8 value;
+    ASSERT_TRUE(first->tryGetProperty(String8("a"), value));
+    EXPECT_STREQ("1", value.string());
+    ASSERT_TRUE(second->tryGetProperty(String8("a"), value));
+    EXPECT_STREQ("2", value.string());
+    delete first;
+    delete second;
+}
+
+TEST_F(PropertyMapTest, LoadBinary_Corrupt_Fails) {
+    PropertyMap map;
+    map.addProperty(String8("a"), String8("1"));
+    map.addProperty(String8("b"), String8("2"));
+    ASSERT_EQ(NO_ERROR, map.writeBinary(String8(mBinaryPath)));
+
+    // Point the second key past the end of the file.
+    int fd = open(mBinaryPath, O_RDWR);
+    ASSERT_LE(0, fd);
+    uint32_t offset = 0x10000;
+    ASSERT_EQ(ssize_t(sizeof(offset)),
+            pwrite(fd, &offset, sizeof(offset), 3 * sizeof(uint32_t) + 4 * sizeof(uint32_t)));
+    close(fd);
+
+    PropertyMap* loaded;
+    EXPECT_EQ(BAD_VALUE, PropertyMap::loadBinary(String8(mBinaryPath), &loaded));
+    EXPECT_TRUE(loaded == NULL);
+}
+
+TEST_F(PropertyMapTest, Load_TextStartingWithBinaryMagic) {
+    writeText("PMAP = 1\n");
+    PropertyMap* map;
+    ASSERT_EQ(NO_ERROR, PropertyMap::load(String8(mTextPath), &map));
+    int32_t i;
+    ASSERT_TRUE(map->tryGetProperty(String8("PMAP"), i));
+    EXPECT_EQ(1, i);
+    delete map;
+
+    EXPECT_EQ(BAD_VALUE, PropertyMap::loadBinary(String8(mTextPath), &map));
+    EXPECT_TRUE(map == NULL);
+}
+
+struct GetPropertiesThreadArgs {
+    const PropertyMap* map;
+    size_t size;
+    bool found;
+};
+
+static void* getPropertiesThread(void* arg) {
+    GetPropertiesThreadArgs* args = static_cast<GetPropertiesThreadArgs*>(arg);
+    String8 value;
+    args->found = args->map->tryGetProperty(String8("cursor.mode"), value);
+    args->size = args->map->getProperties().size();
+    args->found = args->found && args->map->tryGetProperty(String8("touch.size.scale"), value);
+    return NULL;
+}
+
+TEST_F(PropertyMapTest, GetProperties_BinaryFromSeveralThreads) {
+    writeText(TEXT);
+    PropertyMap* text;
+    ASSERT_EQ(NO_ERROR, PropertyMap::load(String8(mTextPath), &text));
+    ASSERT_EQ(NO_ERROR, text->writeBinary(String8(mBinaryPath)));
+    delete text;
+
+    PropertyMap* binary;
+    ASSERT_EQ(NO_ERROR, PropertyMap::loadBinary(String8(mBinaryPath), &binary));
+    const int threadCount = 4;
+    pthread_t threads[threadCount];
+    GetPropertiesThreadArgs args[threadCount];
+    for (int t = 0; t < threadCount; t++) {
+        args[t].map = binary;
+        ASSERT_EQ(0, pthread_create(&threads[t], NULL, getPropertiesThread, &args[t]));
+    }
+    for (int t = 0; t < threadCount; t++) {
+        pthread_join(threads[t], NULL);
+        EXPECT_EQ(4U, args[t].size);
+        EXPECT_TRUE(args[t].found);
+    }
+
+    // Properties added later show up in the merged copy too.
+    binary->addProperty(String8("new.key"), String8("1"));
+    EXPECT_EQ(5U, binary->getProperties().size());
+    delete binary;
+}
+
+} // namespace android
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "SamplingProfiler_test"
+
+#include <utils/SamplingProfiler.h>
+#include <utils/Timers.h>
+#include <cutils/log.h>
+#include <gtest/gtest.h>
+#include <stdio.h>
+
+namespace android {
+
+class SamplingProfilerTest : public testing::Test {
+};
+
+static volatile uint32_t gSink;
+
+// Uses CPU for about the given time, so that the profiling timer fires.
+extern "C" __attribute__((noinline)) void samplingProfilerTestSpin(int ms) {
+    nsecs_t end = systemTime(SYSTEM_TIME_MONOTONIC) + milliseconds_to_nanoseconds(ms);
+    uint32_t x = 1;
+    while (systemTime(SYSTEM_TIME_MONOTONIC) < end) {
+        for (int i = 0; i < 10000; i++) {
+            x = x * 1664525 + 1013904223;
+        }
+        gSink = x;
+    }
+}
+
+TEST_F(SamplingProfilerTest, Start_WhenAnotherProfilerRuns_Fails) {
+    SamplingProfiler first;
+    SamplingProfiler second;
+
+    ASSERT_EQ(NO_ERROR, first.start());
+    EXPECT_TRUE(first.isRunning());
+    EXPECT_EQ(INVALID_OPERATION, second.start());
+    EXPECT_FALSE(second.isRunning());
+
+    first.stop();
+    EXPECT_FALSE(first.isRunning());
+    EXPECT_EQ(NO_ERROR, second.start());
+    second.stop();
+}
+
+TEST_F(SamplingProfilerTest, Start_WithInvalidFrequency_Fails) {
+    SamplingProfiler profiler;
+
+    EXPECT_EQ(BAD_VALUE, profiler.start(0));
+    EXPECT_FALSE(profiler.isRunning());
+}
+
+TEST_F(SamplingProfilerTest, Samples_ContainBusyFunction) {
+    SamplingProfiler profiler;
+
+    ASSERT_EQ(NO_ERROR, profiler.start(1000));
+    samplingProfilerTestSpin(300);
+    profiler.stop();
+
+    // Around 300 samples are expected; leave plenty of room for a loaded device.
+    EXPECT_GT(profiler.getSampleCount(), 20U);
+
+    // Look for the busy function by address, since the test binary may be stripped.
+    // Its code is well within SPIN_SIZE bytes; the low bit is the Thumb bit on ARM.
+    const uintptr_t SPIN_SIZE = 1024;
+    const uintptr_t spin = uintptr_t(samplingProfilerTestSpin) & ~uintptr_t(1);
+    Vector<SamplingProfiler::Stack> stacks;
+    Vector<uint32_t> counts;
+    profiler.getStacks(&stacks, &counts);
+    ASSERT_EQ(stacks.size(), counts.size());
+    size_t samples = 0;
+    size_t spinSamples = 0;
+    for (size_t i = 0; i < stacks.size(); i++) {
+        const SamplingProfiler::Stack& stack = stacks[i];
+        samples += counts[i];
+        for (size_t j = 0; j < stack.depth; j++) {
+            if (stack.pcs[j] - spin < SPIN_SIZE) {
+                spinSamples += counts[i];
+                break;
+            }
+        }
+    }
+    EXPECT_EQ(profiler.getSampleCount(), samples);
+    EXPECT_GT(spinSamples, samples / 2);
+
+    // Every line of the report ends with its sample count.
+    String8 report = profiler.toString();
+    size_t total = 0;
+    const char* line = report.string();
+    while (*line) {
+        const char* end = strchr(line, '\n');
+        ASSERT_TRUE(end != NULL);
+        String8 text(line, end - line);
+        const char* count = strrchr(text.string(), ' ');
+        ASSERT_TRUE(count != NULL) << text.string();
+        total += atoi(count + 1);
+        line = end + 1;
+    }
+    EXPECT_EQ(profiler.getSampleCount(), total);
+
+    profiler.clear();
+    EXPECT_EQ(0U, profiler.getSampleCount());
+    EXPECT_EQ(0U, profiler.toString().length());
+}
+
+} // namespace android
@@ -16,6 +16,7 @@
 
 #define LOG_TAG "String8_test"
 #include <utils/Log.h>
+#include <utils/String16.h>
 #include <utils/String8.h>
 
 #include <gtest/gtest.h>
@@ -72,4 +73,42 @@ TEST_F(String8Test, OperatorPlusEquals) {
     EXPECT_STREQ(src3, " Verify me.");
 }
 
+TEST_F(String8Test, SetTo_WhenUnshared_ReusesBuffer) {
+    String8 s("0123456789");
+    const char* buffer = s.string();
+
+    s.setTo("abcdefghij");
+    EXPECT_EQ(buffer, s.string());
+    EXPECT_STREQ("abcdefghij", s.string());
+
+    // A shared buffer must not be overwritten.
+    String8 copy(s);
+    s = "ABCDEFGHIJ";
+    EXPECT_STREQ("abcdefghij", copy.string());
+    EXPECT_STREQ("ABCDEFGHIJ", s.string());
+
+    // Nor may a source that points into the buffer be clobbered.
+    s.setTo(s.string() + 5, 3);
+    EXPECT_STREQ("FGH", s.string());
+}
+
+TEST_F(String8Test, Move_TakesOverBuffer) {
+    String8 s("Hello, world!");
+    const char* buffer = s.string();
+
+    String8 moved(static_cast<String8&&>(s));
+    EXPECT_EQ(buffer, moved.string());
+    EXPECT_EQ(0U, s.length());
+
+    s = static_cast<String8&&>(moved);
+    EXPECT_EQ(buffer, s.string());
+    EXPECT_EQ(0U, moved.length());
+
+    String16 s16("Hello");
+    const char16_t* buffer16 = s16.string();
+    String16 moved16(static_cast<String16&&>(s16));
+    EXPECT_EQ(buffer16, moved16.string());
+    EXPECT_EQ(0U, s16.size());
+}
+
 }
@@ -19,6 +19,8 @@
 #include <utils/Unicode.h>
 
 #include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
 
 namespace android {
 
@@ -112,4 +114,101 @@ TEST_F(UnicodeTest, UTF8toUTF16Normal) {
             << "should be NULL terminated";
 }
 
+// Appends the UTF-8 encoding of codepoint to dst and returns its length.
+static size_t appendUtf8(uint8_t* dst, char32_t codepoint) {
+    if (codepoint < 0x80) {
+        dst[0] = codepoint;
+        return 1;
+    } else if (codepoint < 0x800) {
+        dst[0] = 0xC0 | (codepoint >> 6);
+        dst[1] = 0x80 | (codepoint & 0x3F);
+        return 2;
+    } else if (codepoint < 0x10000) {
+        dst[0] = 0xE0 | (codepoint >> 12);
+        dst[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+        dst[2] = 0x80 | (codepoint & 0x3F);
+        return 3;
+    }
+    dst[0] = 0xF0 | (codepoint >> 18);
+    dst[1] = 0x80 | ((codepoint >> 12) & 0x3F);
+    dst[2] = 0x80 | ((codepoint >> 6) & 0x3F);
+    dst[3] = 0x80 | (codepoint & 0x3F);
+    return 4;
+}
+
+// Returns a random non-NUL, non-surrogate code point, mostly ASCII so that
+// long ASCII runs are interrupted at varying offsets.
+static char32_t randomCodepoint(unsigned int* seed) {
+    int r = rand_r(seed) % 100;
+    if (r < 85) {
+        return 1 + rand_r(seed) % 0x7F;
+    } else if (r < 92) {
+        return 0x80 + rand_r(seed) % (0x800 - 0x80);
+    } else if (r < 97) {
+        char32_t c = 0x800 + rand_r(seed) % (0x10000 - 0x800);
+        return (c >= 0xD800 && c <= 0xDFFF) ? 0xFFFD : c;
+    }
+    return 0x10000 + rand_r(seed) % (0x110000 - 0x10000);
+}
+
+TEST_F(UnicodeTest, RandomStringsMatchPerCodepointConversion) {
+    const size_t maxCodepoints = 300;
+    uint8_t* u8 = new uint8_t[maxCodepoints * 4 + 1];
+    char16_t* u16 = new char16_t[maxCodepoints * 2 + 1];
+    char16_t* u16expected = new char16_t[maxCodepoints * 2 + 1];
+    char* u8back = new char[maxCodepoints * 4 + 1];
+    char32_t* u32 = new char32_t[maxCodepoints + 1];
+    unsigned int seed = 42;
+
+    for (int iteration = 0; iteration < 2000; iteration++) {
+        size_t codepoints = rand_r(&seed) % maxCodepoints;
+        size_t u8len = 0;
+        size_t u16len = 0;
+        for (size_t i = 0; i < codepoints; i++) {
+            char32_t c = randomCodepoint(&seed);
+            size_t n = appendUtf8(u8 + u8len, c);
+            // Converting one code point at a time stays off the ASCII run
+            // fast paths, which gives the expected output of the bulk call.
+            utf8_to_utf16(u8 + u8len, n, u16expected + u16len);
+            u16len += utf8_to_utf16_length(u8 + u8len, n);
+            u8len += n;
+        }
+        u8[u8len] = 0;
+        SCOPED_TRACE(iteration);
+
+        ASSERT_EQ(ssize_t(u16len), utf8_to_utf16_length(u8, u8len));
+        ASSERT_EQ(ssize_t(u8len), utf8_length((const char*)u8));
+        ASSERT_EQ(codepoints, utf8_to_utf32_length((const char*)u8, u8len));
+
+        utf8_to_utf16(u8, u8len, u16);
+        ASSERT_EQ(0, memcmp(u16expected, u16, u16len * sizeof(char16_t)));
+        ASSERT_EQ(0, u16[u16len]);
+
+        if (u16len > 0) {
+            ASSERT_EQ(ssize_t(u8len), utf16_to_utf8_length(u16, u16len));
+            utf16_to_utf8(u16, u16len, u8back);
+            ASSERT_EQ(0, memcmp(u8, u8back, u8len + 1));
+        }
+
+        // A bounded conversion must stop exactly at the bound.
+        size_t bound = u16len / 2;
+        char16_t* end = utf8_to_utf16_n(u8, u8len, u16, bound);
+        ASSERT_GE(u16 + bound, end);
+        ASSERT_EQ(0, memcmp(u16expected, u16, (end - u16) * sizeof(char16_t)));
+
+        if (codepoints > 0) {
+            utf8_to_utf32((const char*)u8, u8len, u32);
+            ASSERT_EQ(ssize_t(u8len), utf32_to_utf8_length(u32, codepoints));
+            utf32_to_utf8(u32, codepoints, u8back);
+            ASSERT_EQ(0, memcmp(u8, u8back, u8len + 1));
+        }
+    }
+
+    delete[] u8;
+    delete[] u16;
+    delete[] u16expected;
+    delete[] u8back;
+    delete[] u32;
+}
+
 }
@@ -16,6 +16,7 @@
 
 #define LOG_TAG "Vector_test"
 
+#include <utils/KeyedVector.h>
 #include <utils/Vector.h>
 #include <cutils/log.h>
 #include <gtest/gtest.h>
@@ -71,5 +72,83 @@ TEST_F(VectorTest, CopyOnWrite_CopyAndAddElements) {
     EXPECT_EQ(other[3], 5);
 }
 
+struct CountedItem {
+    int a, b;
+
+    CountedItem() : a(0), b(0) { }
+    CountedItem(int a, int b) : a(a), b(b) { }
+    CountedItem(const CountedItem& o) : a(o.a), b(o.b) {
+        copies++;
+    }
+
+    static int copies;
+};
+
+int CountedItem::copies = 0;
+
+TEST_F(VectorTest, Move_TakesOverStorage) {
+    Vector<int> vector;
+    vector.add(1);
+    vector.add(2);
+    const int* storage = vector.array();
+
+    Vector<int> moved(static_cast<Vector<int>&&>(vector));
+    EXPECT_EQ(storage, moved.array());
+    EXPECT_EQ(2U, moved.size());
+    EXPECT_TRUE(vector.isEmpty());
+
+    Vector<int> assigned;
+    assigned.add(3);
+    assigned = static_cast<Vector<int>&&>(moved);
+    EXPECT_EQ(storage, assigned.array());
+    EXPECT_EQ(1, assigned[0]);
+    EXPECT_TRUE(moved.isEmpty());
+
+    // The moved-from vector is still usable.
+    moved.add(4);
+    EXPECT_EQ(4, moved[0]);
+}
+
+TEST_F(VectorTest, Move_SortedAndKeyedVectors) {
+    SortedVector<int> sorted;
+    sorted.add(2);
+    sorted.add(1);
+    SortedVector<int> movedSorted(static_cast<SortedVector<int>&&>(sorted));
+    EXPECT_TRUE(sorted.isEmpty());
+    EXPECT_EQ(1, movedSorted[0]);
+
+    KeyedVector<int, int> keyed;
+    keyed.add(1, 10);
+    KeyedVector<int, int> movedKeyed(static_cast<KeyedVector<int, int>&&>(keyed));
+    EXPECT_TRUE(keyed.isEmpty());
+    EXPECT_EQ(10, movedKeyed.valueFor(1));
+
+    KeyedVector<int, int> copiedKeyed(movedKeyed);
+    EXPECT_EQ(10, copiedKeyed.valueFor(1));
+}
+
+TEST_F(VectorTest, Emplace_ConstructsInPlace) {
+    Vector<CountedItem> vector;
+    vector.setCapacity(16);
+
+    CountedItem::copies = 0;
+    for (int i = 0; i < 8; i++) {
+        vector.add(CountedItem(i, -i));
+    }
+    int addCopies = CountedItem::copies;
+
+    CountedItem::copies = 0;
+    for (int i = 0; i < 8; i++) {
+        EXPECT_EQ(ssize_t(8 + i), vector.emplace(i, -i));
+    }
+    EXPECT_EQ(0, CountedItem::copies);
+    EXPECT_EQ(8, addCopies);
+
+    EXPECT_EQ(0, vector.emplaceAt(0, 42, 43));
+    EXPECT_EQ(42, vector[0].a);
+    EXPECT_EQ(43, vector[0].b);
+    EXPECT_EQ(7, vector[16].a);
+    EXPECT_EQ(BAD_INDEX, vector.emplaceAt(100, 0, 0));
+}
 
 } // namespace android
@@ -30,6 +30,16 @@ read_le_short(const unsigned char* buf)
     return buf[0] | (buf[1] << 8);
 }
 
+unsigned int
+hash_zipentry_name(const unsigned char* name, size_t len)
+{
+    unsigned int hash = 0;
+    while (len--) {
+        hash = hash * 31 + *name++;
+    }
+    return hash;
+}
+
 static int
 read_central_dir_values(Zipfile* file, const unsigned char* buf, int len)
 {
@@ -228,11 +238,29 @@ read_central_dir(Zipfile *file)
         goto bail;
     }
 
+    // Size the name index for a load factor of at most 3/4, so that
+    // lookup_zipentry() doesn't have to walk the whole list.
+    file->hashSize = 1;
+    while (file->hashSize * 3 < file->totalEntryCount * 4) {
+        file->hashSize <<= 1;
+    }
+    file->hashTable = calloc(file->hashSize, sizeof(Zipentry*));
+    if (file->hashTable == NULL) {
+        fprintf(stderr, "can't allocate the index of %d entries\n",
+                file->totalEntryCount);
+        goto bail;
+    }
+
     // Loop through and read the central dir entries.
     p = buf + file->centralDirOffest;
     len = (buf+bufsize)-p;
     for (i=0; i < file->totalEntryCount; i++) {
         Zipentry* entry = malloc(sizeof(Zipentry));
+        unsigned int bucket;
+        if (entry == NULL) {
+            fprintf(stderr, "can't allocate entry %d\n", i);
+            goto bail;
+        }
         memset(entry, 0, sizeof(Zipentry));
 
         err = read_central_directory_entry(file, entry, &p, &len);
@@ -245,6 +273,13 @@ read_central_dir(Zipfile *file)
         // add it to our list
         entry->next = file->entries;
         file->entries = entry;
+
+        // and to the index. Like the list, the buckets are in reverse
+        // order, so a duplicate name finds the last entry in both.
+        bucket = hash_zipentry_name(entry->fileName, entry->fileNameLength)
+                & (file->hashSize - 1);
+        entry->hashNext = file->hashTable[bucket];
+        file->hashTable[bucket] = entry;
     }
 
     return 0;
@@ -16,6 +16,7 @@ typedef struct Zipentry {
     const unsigned char* data;
     
     struct Zipentry* next;
+    struct Zipentry* hashNext;  // next entry in the same hash bucket
 } Zipentry;
 
 typedef struct Zipfile
@@ -34,10 +35,16 @@ typedef struct Zipfile
     const unsigned char*  comment;            //mComment;
 
     Zipentry* entries;
+
+    // Entries hashed by name, see hash_zipentry_name()
+    Zipentry** hashTable;
+    unsigned int hashSize;              // a power of 2
 } Zipfile;
 
 int read_central_dir(Zipfile* file);
 
+unsigned int hash_zipentry_name(const unsigned char* name, size_t len);
+
 unsigned int read_le_int(const unsigned char* buf);
 unsigned int read_le_short(const unsigned char* buf);
 
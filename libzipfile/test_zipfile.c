@@ -15,7 +15,7 @@ main(int argc, char** argv)
     zipfile_t zip;
     zipentry_t entry;
     int err;
-    enum { HUH, LIST, UNZIP } what = HUH;
+    enum { HUH, LIST, UNZIP, STREAM } what = HUH;
 
     if (strcmp(argv[2], "-l") == 0 && argc == 3) {
         what = LIST;
@@ -23,11 +23,16 @@ main(int argc, char** argv)
     else if (strcmp(argv[2], "-u") == 0 && argc == 5) {
         what = UNZIP;
     }
+    else if (strcmp(argv[2], "-s") == 0 && argc == 5) {
+        what = STREAM;
+    }
     else {
         fprintf(stderr, "usage: test_zipfile ZIPFILE -l\n"
                         "          lists the files in the zipfile\n"
                         "       test_zipfile ZIPFILE -u FILENAME SAVETO\n"
-                        "          saves FILENAME from the zip file into SAVETO\n");
+                        "          saves FILENAME from the zip file into SAVETO\n"
+                        "       test_zipfile ZIPFILE -s FILENAME SAVETO\n"
+                        "          same as -u, decompressing in chunks\n");
         return 1;
     }
     
@@ -85,6 +90,25 @@ main(int argc, char** argv)
             free(scratch);
             fclose(f);
             break;
+        case STREAM:
+            entry = lookup_zipentry(zip, argv[3]);
+            if (entry == NULL) {
+                fprintf(stderr, "zip file '%s' does not contain file '%s'\n",
+                                argv[1], argv[3]);
+                return 1;
+            }
+            f = fopen(argv[4], "w");
+            if (f == NULL) {
+                fprintf(stderr, "can't open file for writing '%s'\n", argv[4]);
+                return 1;
+            }
+            err = decompress_zipentry_fd(entry, fileno(f));
+            fclose(f);
+            if (err != 0) {
+                fprintf(stderr, "error decompressing file\n");
+                return 1;
+            }
+            break;
     }
     
     free(buf);
@@ -1,8 +1,10 @@
 #include <zipfile/zipfile.h>
 
 #include "private.h"
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <zlib.h>
 #define DEF_MEM_LEVEL 8                // normally in zutil.h?
 
@@ -22,7 +24,7 @@ init_zipfile(const void* data, size_t size)
 
     return file;
 fail:
-    free(file);
+    release_zipfile(file);
     return NULL;
 }
 
@@ -36,6 +38,7 @@ release_zipfile(zipfile_t f)
         free(entry);
         entry = next;
     }
+    free(file->hashTable);
     free(file);
 }
 
@@ -43,12 +46,16 @@ zipentry_t
 lookup_zipentry(zipfile_t f, const char* entryName)
 {
     Zipfile* file = (Zipfile*)f;
-    Zipentry* entry = file->entries;
+    size_t len = strlen(entryName);
+    unsigned int bucket = hash_zipentry_name((const unsigned char*)entryName,
+            len) & (file->hashSize - 1);
+    Zipentry* entry = file->hashTable[bucket];
     while (entry) {
-        if (0 == memcmp(entryName, entry->fileName, entry->fileNameLength)) {
+        if (entry->fileNameLength == len &&
+                0 == memcmp(entryName, entry->fileName, len)) {
             return entry;
         }
-        entry = entry->next;
+        entry = entry->hashNext;
     }
     return NULL;
 }
@@ -128,6 +135,107 @@ decompress_zipentry(zipentry_t e, void* buf, int bufsize)
     }
 }
 
+enum {
+    // how much is inflated between two calls to the writer
+    CHUNK_SIZE = 64 * 1024
+};
+
+static int
+uninflate_stream(const unsigned char* in, unsigned int clen, unsigned int unlen,
+        zipentry_writer_t writer, void* cookie)
+{
+    z_stream zstream;
+    unsigned char* out;
+    int err = 0;
+    int zerr;
+
+    out = malloc(CHUNK_SIZE);
+    if (out == NULL) {
+        return -1;
+    }
+
+    memset(&zstream, 0, sizeof(zstream));
+    zstream.zalloc = Z_NULL;
+    zstream.zfree = Z_NULL;
+    zstream.opaque = Z_NULL;
+    zstream.next_in = (void*)in;
+    zstream.avail_in = clen;
+    zstream.data_type = Z_UNKNOWN;
+
+    // no zlib header, see uninflate()
+    zerr = inflateInit2(&zstream, -MAX_WBITS);
+    if (zerr != Z_OK) {
+        free(out);
+        return -1;
+    }
+
+    do {
+        zstream.next_out = (Bytef*) out;
+        zstream.avail_out = CHUNK_SIZE;
+        zerr = inflate(&zstream, Z_NO_FLUSH);
+        if (zerr != Z_OK && zerr != Z_STREAM_END) {
+            // Z_BUF_ERROR here means the compressed data is truncated
+            fprintf(stderr, "zerr=%d total_out=%lu\n", zerr, zstream.total_out);
+            err = -1;
+            break;
+        }
+        if (writer(cookie, out, CHUNK_SIZE - zstream.avail_out) != 0) {
+            err = -1;
+            break;
+        }
+    } while (zerr != Z_STREAM_END);
+
+    if (err == 0 && zstream.total_out != unlen) {
+        fprintf(stderr, "inflated %lu bytes, expected %u\n",
+                zstream.total_out, unlen);
+        err = -1;
+    }
+
+    inflateEnd(&zstream);
+    free(out);
+    return err;
+}
+
+int
+decompress_zipentry_stream(zipentry_t e, zipentry_writer_t writer, void* cookie)
+{
+    Zipentry* entry = (Zipentry*)e;
+    switch (entry->compressionMethod)
+    {
+        case STORED:
+            return writer(cookie, entry->data, entry->uncompressedSize);
+        case DEFLATED:
+            return uninflate_stream(entry->data, entry->compressedSize,
+                    entry->uncompressedSize, writer, cookie);
+        default:
+            return -1;
+    }
+}
+
+static int
+write_to_fd(void* cookie, const void* data, size_t size)
+{
+    int fd = *(int*)cookie;
+    const char* p = data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "write failed: %s\n", strerror(errno));
+            return -1;
+        }
+        p += n;
+        size -= n;
+    }
+    return 0;
+}
+
+int
+decompress_zipentry_fd(zipentry_t entry, int fd)
+{
+    return decompress_zipentry_stream(entry, write_to_fd, &fd);
+}
+
 void
 dump_zipfile(FILE* to, zipfile_t file)
 {
@@ -5,7 +5,9 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= logcat.cpp event.logtags
 
-LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_SHARED_LIBRARIES := liblog libz
+
+LOCAL_C_INCLUDES += external/zlib
 
 LOCAL_MODULE:= logcat
 
@@ -6,6 +6,10 @@
 #include <log/event_tag_map.h>
 #include <cutils/sockets.h>
 
+#include <pthread.h>
+#include <signal.h>
+#include <zlib.h>
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -22,6 +26,7 @@
 
 #define DEFAULT_LOG_ROTATE_SIZE_KBYTES 16
 #define DEFAULT_MAX_ROTATED_LOGS 4
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
 
 static AndroidLogFormat * g_logformat;
 static bool g_nonblock = false;
@@ -99,21 +104,280 @@ static int g_devCount = 0;
 
 static EventTagMap* g_eventTagMap = NULL;
 
+/*
+ * Compressed archive mode (-z): output is staged in g_outBuf and written in
+ * large chunks, rotated segments are gzipped by a background thread, and
+ * "<file>.idx" records the time range covered by each archived segment so
+ * that a reader can pick the segments it needs without inflating them all.
+ */
+static bool g_compressRotated = false;
+static char* g_outBuf = NULL;
+static size_t g_outBufLen = 0;
+
+struct segment_range_t {
+    uint32_t firstSec;
+    uint32_t firstNsec;
+    uint32_t lastSec;
+    uint32_t lastNsec;
+    off_t size;
+    bool archived;      // set once the segment has been gzipped
+};
+
+static segment_range_t g_curSegment;
+static segment_range_t* g_segments = NULL;  // g_segments[i] describes "<file>.<i+1>.gz"
+static int g_segmentCount = 0;
+
+static pthread_t g_compressThread;
+static bool g_compressPending = false;
+
 static int openLogFile (const char *pathname)
 {
     return open(pathname, O_WRONLY | O_APPEND | O_CREAT, S_IRUSR | S_IWUSR);
 }
 
-static void rotateLogs()
+static void writeFully(const void* buf, size_t size)
 {
-    int err;
+    const char* p = (const char*) buf;
 
-    // Can't rotate logs if we're not outputting to a file
-    if (g_outputFileName == NULL) {
+    while (size > 0) {
+        ssize_t ret = write(g_outFD, p, size);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("output error");
+            exit(-1);
+        }
+        p += ret;
+        size -= ret;
+    }
+}
+
+/* the signals that make logcat write out g_outBuf before it dies */
+static void getFlushSignals(sigset_t* set)
+{
+    sigemptyset(set);
+    sigaddset(set, SIGINT);
+    sigaddset(set, SIGTERM);
+}
+
+static void flushOutput()
+{
+    if (g_outBufLen > 0) {
+        sigset_t flushSet, oldSet;
+
+        // flushOnTerm() must not write out the same data again meanwhile
+        getFlushSignals(&flushSet);
+        pthread_sigmask(SIG_BLOCK, &flushSet, &oldSet);
+        writeFully(g_outBuf, g_outBufLen);
+        g_outBufLen = 0;
+        pthread_sigmask(SIG_SETMASK, &oldSet, NULL);
+    }
+}
+
+/* writes out what's still staged in g_outBuf when logcat is stopped */
+static void flushOnTerm(int sig)
+{
+    const char* p = g_outBuf;
+    size_t size = g_outBufLen;
+
+    while (size > 0) {
+        ssize_t ret = write(g_outFD, p, size);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        p += ret;
+        size -= ret;
+    }
+
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/* writes to the output file, staging through g_outBuf in -z mode */
+static void writeOutput(const void* buf, size_t size)
+{
+    if (g_outBuf == NULL) {
+        writeFully(buf, size);
         return;
     }
 
-    close(g_outFD);
+    if (g_outBufLen + size > OUTPUT_BUFFER_SIZE) {
+        flushOutput();
+    }
+    if (size >= OUTPUT_BUFFER_SIZE) {
+        writeFully(buf, size);
+    } else {
+        memcpy(g_outBuf + g_outBufLen, buf, size);
+        g_outBufLen += size;
+    }
+}
+
+static void noteEntryTime(const struct logger_entry* entry)
+{
+    if (g_curSegment.firstSec == 0 && g_curSegment.firstNsec == 0) {
+        g_curSegment.firstSec = entry->sec;
+        g_curSegment.firstNsec = entry->nsec;
+    }
+    g_curSegment.lastSec = entry->sec;
+    g_curSegment.lastNsec = entry->nsec;
+}
+
+static void loadSegmentIndex()
+{
+    char* indexName;
+    FILE* fp;
+
+    g_segments = (segment_range_t*) calloc(g_maxRotatedLogs + 1, sizeof(segment_range_t));
+    if (g_segments == NULL) {
+        perror("couldn't allocate segment index");
+        exit(-1);
+    }
+
+    asprintf(&indexName, "%s.idx", g_outputFileName);
+    fp = fopen(indexName, "r");
+    free(indexName);
+    if (fp == NULL) {
+        return;
+    }
+
+    // segments that couldn't be compressed have no line
+    int i;
+    segment_range_t range;
+    long long size;
+    while (fscanf(fp, "%d %u.%u %u.%u %lld\n", &i,
+                    &range.firstSec, &range.firstNsec,
+                    &range.lastSec, &range.lastNsec, &size) == 6) {
+        if (i <= g_segmentCount || i > g_maxRotatedLogs) {
+            break;
+        }
+        range.size = (off_t) size;
+        range.archived = true;
+        g_segments[i - 1] = range;
+        g_segmentCount = i;
+    }
+    fclose(fp);
+}
+
+/* rewrites "<file>.idx" atomically: "<n> <first sec.nsec> <last sec.nsec> <bytes>" */
+static void writeSegmentIndex()
+{
+    char *indexName, *tmpName;
+    FILE* fp;
+
+    asprintf(&indexName, "%s.idx", g_outputFileName);
+    asprintf(&tmpName, "%s.idx.tmp", g_outputFileName);
+
+    fp = fopen(tmpName, "w");
+    if (fp == NULL) {
+        perror("couldn't write log index");
+    } else {
+        for (int i = 0; i < g_segmentCount; i++) {
+            const segment_range_t& range = g_segments[i];
+            if (!range.archived) {
+                continue;
+            }
+            fprintf(fp, "%d %u.%09u %u.%09u %lld\n", i + 1,
+                    range.firstSec, range.firstNsec,
+                    range.lastSec, range.lastNsec, (long long) range.size);
+        }
+        if (fclose(fp) != 0 || rename(tmpName, indexName) < 0) {
+            perror("couldn't write log index");
+        }
+    }
+
+    free(tmpName);
+    free(indexName);
+}
+
+static void* compressSegment(void* arg)
+{
+    char* src = (char*) arg;
+    char* dst;
+    char buf[16 * 1024];
+    bool ok = true;
+
+    asprintf(&dst, "%s.gz", src);
+
+    int fd = open(src, O_RDONLY);
+    gzFile out = gzopen(dst, "wb");
+    if (fd < 0 || out == NULL) {
+        ok = false;
+    } else {
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof(buf))) != 0) {
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ok = false;
+                break;
+            }
+            if (gzwrite(out, buf, n) != n) {
+                ok = false;
+                break;
+            }
+        }
+    }
+    if (out != NULL && gzclose(out) != Z_OK) {
+        ok = false;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    if (ok) {
+        unlink(src);
+        // the reader doesn't touch the index again before joining this thread
+        g_segments[0].archived = true;
+        writeSegmentIndex();
+    } else {
+        fprintf(stderr, "couldn't compress rotated log %s\n", src);
+        unlink(dst);
+    }
+
+    free(dst);
+    free(src);
+    return NULL;
+}
+
+static void waitForCompression()
+{
+    if (g_compressPending) {
+        pthread_join(g_compressThread, NULL);
+        g_compressPending = false;
+    }
+}
+
+static void renameLogFile(const char* file0, const char* file1)
+{
+    int err = rename (file0, file1);
+
+    if (err < 0 && errno != ENOENT) {
+        perror("while rotating log files");
+    }
+}
+
+/*
+ * Shifts "<file>.<n>" to "<file>.<n+1>" and the output file to "<file>.1".
+ * In -z mode the gzipped segments shift along with any that couldn't be
+ * compressed, which keep their plain name.
+ */
+static void rotateLogFiles()
+{
+    if (g_compressRotated && g_maxRotatedLogs > 0) {
+        // the oldest segment may be in either form, make sure it goes
+        char* oldest;
+        asprintf(&oldest, "%s.%d", g_outputFileName, g_maxRotatedLogs);
+        unlink(oldest);
+        free(oldest);
+        asprintf(&oldest, "%s.%d.gz", g_outputFileName, g_maxRotatedLogs);
+        unlink(oldest);
+        free(oldest);
+    }
 
     for (int i = g_maxRotatedLogs ; i > 0 ; i--) {
         char *file0, *file1;
@@ -126,14 +390,74 @@ static void rotateLogs()
             asprintf(&file0, "%s.%d", g_outputFileName, i - 1);
         }
 
-        err = rename (file0, file1);
-
-        if (err < 0 && errno != ENOENT) {
-            perror("while rotating log files");
-        }
+        renameLogFile(file0, file1);
 
         free(file1);
         free(file0);
+
+        if (g_compressRotated && i - 1 > 0) {
+            asprintf(&file1, "%s.%d.gz", g_outputFileName, i);
+            asprintf(&file0, "%s.%d.gz", g_outputFileName, i - 1);
+
+            renameLogFile(file0, file1);
+
+            free(file1);
+            free(file0);
+        }
+    }
+}
+
+/* compresses "<file>.1"; it's indexed once it has been compressed */
+static void archiveSegment()
+{
+    if (g_maxRotatedLogs > 0) {
+        if (g_segmentCount == g_maxRotatedLogs) {
+            g_segmentCount--;
+        }
+        memmove(g_segments + 1, g_segments, g_segmentCount * sizeof(segment_range_t));
+        g_curSegment.size = g_outByteCount;
+        g_segments[0] = g_curSegment;
+        g_segmentCount++;
+        // the older segments have been renamed
+        writeSegmentIndex();
+
+        // SIGINT and SIGTERM are left to the reader, see flushOutput()
+        sigset_t flushSet, oldSet;
+        getFlushSignals(&flushSet);
+        pthread_sigmask(SIG_BLOCK, &flushSet, &oldSet);
+
+        char* archived;
+        asprintf(&archived, "%s.1", g_outputFileName);
+        g_compressPending = pthread_create(&g_compressThread, NULL, compressSegment,
+                archived) == 0;
+        pthread_sigmask(SIG_SETMASK, &oldSet, NULL);
+        if (!g_compressPending) {
+            // compress it here rather than lose it at the next rotation
+            perror("couldn't start log compression");
+            compressSegment(archived);
+        }
+    }
+
+    memset(&g_curSegment, 0, sizeof(g_curSegment));
+}
+
+static void rotateLogs()
+{
+    // Can't rotate logs if we're not outputting to a file
+    if (g_outputFileName == NULL) {
+        return;
+    }
+
+    flushOutput();
+    close(g_outFD);
+
+    if (g_compressRotated) {
+        // the previous segment must be archived before the names shift under it
+        waitForCompression();
+    }
+    rotateLogFiles();
+    if (g_compressRotated) {
+        archiveSegment();
     }
 
     g_outFD = openLogFile (g_outputFileName);
@@ -150,11 +474,11 @@ static void rotateLogs()
 void printBinary(struct logger_entry *buf)
 {
     size_t size = sizeof(logger_entry) + buf->len;
-    int ret;
-    
-    do {
-        ret = write(g_outFD, buf, size);
-    } while (ret < 0 && errno == EINTR);
+
+    if (g_compressRotated) {
+        noteEntryTime(buf);
+    }
+    writeOutput(buf, size);
 }
 
 static void processBuffer(log_device_t* dev, struct logger_entry *buf)
@@ -187,7 +511,24 @@ static void processBuffer(log_device_t* dev, struct logger_entry *buf)
             }
         }
 
-        bytesWritten = android_log_printLogLine(g_logformat, g_outFD, &entry);
+        if (g_outBuf != NULL) {
+            char defaultBuffer[512];
+            size_t totalLen;
+            char* outBuffer = android_log_formatLogLine(g_logformat, defaultBuffer,
+                    sizeof(defaultBuffer), &entry, &totalLen);
+            if (outBuffer == NULL) {
+                perror("output error");
+                exit(-1);
+            }
+            noteEntryTime(buf);
+            writeOutput(outBuffer, totalLen);
+            bytesWritten = totalLen;
+            if (outBuffer != defaultBuffer) {
+                free(outBuffer);
+            }
+        } else {
+            bytesWritten = android_log_printLogLine(g_logformat, g_outFD, &entry);
+        }
 
         if (bytesWritten < 0) {
             perror("output error");
@@ -222,10 +563,7 @@ static void maybePrintStart(log_device_t* dev) {
         if (g_devCount > 1 && !g_printBinary) {
             char buf[1024];
             snprintf(buf, sizeof(buf), "--------- beginning of %s\n", dev->device);
-            if (write(g_outFD, buf, strlen(buf)) < 0) {
-                perror("output error");
-                exit(-1);
-            }
+            writeOutput(buf, strlen(buf));
         }
     }
 }
@@ -325,6 +663,7 @@ static void readLogLines(log_device_t* devices)
                     }
                     --queued_lines;
                 }
+                flushOutput();
 
                 // the caller requested to just dump the log and exit
                 if (g_nonblock) {
@@ -388,6 +727,17 @@ static void setupOutput()
         fstat(g_outFD, &statbuf);
 
         g_outByteCount = statbuf.st_size;
+
+        if (g_compressRotated) {
+            g_outBuf = (char*) malloc(OUTPUT_BUFFER_SIZE);
+            if (g_outBuf == NULL) {
+                perror ("couldn't allocate output buffer");
+                exit(-1);
+            }
+            loadSegmentIndex();
+            signal(SIGINT, flushOnTerm);
+            signal(SIGTERM, flushOnTerm);
+        }
     }
 }
 
@@ -401,6 +751,8 @@ static void show_help(const char *cmd)
                     "  -f <filename>   Log to file. Default to stdout\n"
                     "  -r [<kbytes>]   Rotate log every kbytes. (16 if unspecified). Requires -f\n"
                     "  -n <count>      Sets max number of rotated logs to <count>, default 4\n"
+                    "  -z              Buffer output and gzip rotated logs in the background,\n"
+                    "                  indexing their time ranges in <filename>.idx. Requires -r\n"
                     "  -v <format>     Sets the log print format, where <format> is one of:\n\n"
                     "                  brief process tag thread raw time threadtime long\n\n"
                     "  -c              clear (flush) the entire log and exit\n"
@@ -481,7 +833,7 @@ int main(int argc, char **argv)
     for (;;) {
         int ret;
 
-        ret = getopt(argc, argv, "cdt:gsQf:r::n:v:b:B");
+        ret = getopt(argc, argv, "cdt:gsQf:r::n:v:b:Bz");
 
         if (ret < 0) {
             break;
@@ -538,6 +890,10 @@ int main(int argc, char **argv)
                 android::g_printBinary = 1;
             break;
 
+            case 'z':
+                android::g_compressRotated = true;
+            break;
+
             case 'f':
                 // redirect output to a file
 
@@ -679,6 +1035,12 @@ int main(int argc, char **argv)
         exit(-1);
     }
 
+    if (android::g_compressRotated && android::g_logRotateSizeKBytes == 0) {
+        fprintf(stderr,"-z requires -r as well\n");
+        android::show_help(argv[0]);
+        exit(-1);
+    }
+
     android::setupOutput();
 
     if (hasSetLogFormat == 0) {
@@ -785,5 +1147,8 @@ int main(int argc, char **argv)
 
     android::readLogLines(devices);
 
+    android::flushOutput();
+    android::waitForCompression();
+
     return 0;
 }
@@ -42,7 +42,8 @@ __BEGIN_DECLS
  *   ignore_int_quit: set to true if you want to completely ignore SIGINT and
  *           SIGQUIT while logwrap is running. This may force the end-user to
  *           send a signal twice to signal the caller (once for the child, and
- *           once for the caller)
+ *           once for the caller). Only calls with this set to false can run
+ *           concurrently from several threads.
  *   log_target: Specify where to log the output of the child, either LOG_NONE,
  *           LOG_ALOG (for the Android system log), LOG_KLOG (for the kernel
  *           log), or LOG_FILE (and you need to specify a pathname in the
@@ -82,6 +83,14 @@ static inline int android_fork_execvp(int argc, char* argv[], int *status,
                                    (logwrap ? LOG_ALOG : LOG_NONE), false, NULL);
 }
 
+/* Same as android_fork_execvp_ext() with ignore_int_quit set to false, for
+ * callers that ignore SIGINT and SIGQUIT themselves around several concurrent
+ * calls: the child starts with the default SIGINT and SIGQUIT dispositions
+ * instead of inheriting the ignored ones.
+ */
+int android_fork_execvp_dfl_int_quit(int argc, char* argv[], int *status,
+        int log_target, bool abbreviated, char *file_path);
+
 __END_DECLS
 
 #endif /* __LIBS_LOGWRAP_H */
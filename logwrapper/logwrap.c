@@ -315,10 +315,8 @@ static int parent(const char *tag, int parent_read, pid_t pid,
     bool found_child = false;
     char tmpbuf[256];
 
-    log_info.btag = basename(tag);
-    if (!log_info.btag) {
-        log_info.btag = (char*) tag;
-    }
+    log_info.btag = strrchr(tag, '/');
+    log_info.btag = log_info.btag ? log_info.btag + 1 : (char*) tag;
 
     if (abbreviated && (log_target == LOG_NONE)) {
         abbreviated = 0;
@@ -338,13 +336,16 @@ static int parent(const char *tag, int parent_read, pid_t pid,
     }
 
     if (log_target & LOG_FILE) {
-        fd = open(file_path, O_WRONLY | O_CREAT, 0664);
+        /* Several commands may log to the same file at once, append and
+         * write whole lines so that their output doesn't overwrite or
+         * split each other's */
+        fd = open(file_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0664);
         if (fd < 0) {
             ERROR("Cannot log to file %s\n", file_path);
             log_target &= ~LOG_FILE;
         } else {
-            lseek(fd, 0, SEEK_END);
             log_info.fp = fdopen(fd, "a");
+            setvbuf(log_info.fp, NULL, _IOLBF, 0);
         }
     }
 
@@ -476,8 +477,8 @@ static void child(int argc, char* argv[]) {
     }
 }
 
-int android_fork_execvp_ext(int argc, char* argv[], int *status, bool ignore_int_quit,
-        int log_target, bool abbreviated, char *file_path) {
+static int fork_execvp(int argc, char* argv[], int *status, bool ignore_int_quit,
+        bool dfl_int_quit, int log_target, bool abbreviated, char *file_path) {
     pid_t pid;
     int parent_ptty;
     int child_ptty;
@@ -486,6 +487,7 @@ int android_fork_execvp_ext(int argc, char* argv[], int *status, bool ignore_int
     struct sigaction quitact;
     sigset_t blockset;
     sigset_t oldset;
+    bool locked = true;
     int rc = 0;
 
     rc = pthread_mutex_lock(&fd_mutex);
@@ -494,8 +496,9 @@ int android_fork_execvp_ext(int argc, char* argv[], int *status, bool ignore_int
         goto err_lock;
     }
 
-    /* Use ptty instead of socketpair so that STDOUT is not buffered */
-    parent_ptty = open("/dev/ptmx", O_RDWR);
+    /* Use ptty instead of socketpair so that STDOUT is not buffered, and
+     * don't let commands run from other threads inherit it */
+    parent_ptty = open("/dev/ptmx", O_RDWR | O_CLOEXEC);
     if (parent_ptty < 0) {
         ERROR("Cannot create parent ptty\n");
         rc = -1;
@@ -529,6 +532,10 @@ int android_fork_execvp_ext(int argc, char* argv[], int *status, bool ignore_int
         goto err_fork;
     } else if (pid == 0) {
         pthread_mutex_unlock(&fd_mutex);
+        if (dfl_int_quit) {
+            signal(SIGINT, SIG_DFL);
+            signal(SIGQUIT, SIG_DFL);
+        }
         pthread_sigmask(SIG_SETMASK, &oldset, NULL);
         close(parent_ptty);
 
@@ -547,6 +554,12 @@ int android_fork_execvp_ext(int argc, char* argv[], int *status, bool ignore_int
             ignact.sa_handler = SIG_IGN;
             sigaction(SIGINT, &ignact, &intact);
             sigaction(SIGQUIT, &ignact, &quitact);
+        } else {
+            /* The lock only covers ptsname() and the signal dispositions,
+             * let other threads run their commands while this one runs.
+             */
+            pthread_mutex_unlock(&fd_mutex);
+            locked = false;
         }
 
         rc = parent(argv[0], parent_ptty, pid, status, log_target,
@@ -563,7 +576,21 @@ err_child_ptty:
 err_ptty:
     close(parent_ptty);
 err_open:
-    pthread_mutex_unlock(&fd_mutex);
+    if (locked) {
+        pthread_mutex_unlock(&fd_mutex);
+    }
 err_lock:
     return rc;
 }
+
+int android_fork_execvp_ext(int argc, char* argv[], int *status, bool ignore_int_quit,
+        int log_target, bool abbreviated, char *file_path) {
+    return fork_execvp(argc, argv, status, ignore_int_quit, false, log_target,
+                       abbreviated, file_path);
+}
+
+int android_fork_execvp_dfl_int_quit(int argc, char* argv[], int *status,
+        int log_target, bool abbreviated, char *file_path) {
+    return fork_execvp(argc, argv, status, false, true, log_target,
+                       abbreviated, file_path);
+}